@@ -0,0 +1,232 @@
+﻿/*
+ *  File: AesCtr.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+#include "KeyXor.h"
+
+// AES-128 CTR mode for the already expanded Wolf round keys
+// Only the key expansion of Wolf is non-standard, the rounds are plain AES-128 so they can run on AES-NI,
+// the portable path uses T-tables instead of the byte oriented tiny-AES rounds.
+// The counter is the 16 byte IV incremented as a big endian number, like in aesCtrXCrypt
+namespace aesCtr
+{
+static constexpr std::size_t BLOCK_SIZE      = 16;
+static constexpr std::size_t ROUNDS          = 10;
+static constexpr std::size_t PARALLEL_BLOCKS = 8;
+static constexpr std::size_t KEY_STREAM_SIZE = PARALLEL_BLOCKS * BLOCK_SIZE;
+
+namespace detail
+{
+inline constexpr uint8_t SBOX[256] = {
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76, 0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0, 0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15, 0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75, 0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B,
+	0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84, 0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF, 0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8, 0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2, 0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73, 0x60, 0x81, 0x4F, 0xDC,
+	0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB, 0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79, 0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08, 0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A, 0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1,
+	0x1D, 0x9E, 0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF, 0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+constexpr uint8_t xtime(const uint8_t x)
+{
+	return static_cast<uint8_t>((x << 1) ^ (((x >> 7) & 1) * 0x1B));
+}
+
+// Te0[x] holds the column ( 2 * S[x], S[x], S[x], 3 * S[x] ) as little endian word, the other tables are rotations of it
+constexpr std::array<uint32_t, 256> makeTe0()
+{
+	std::array<uint32_t, 256> table = {};
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		const uint8_t s  = SBOX[i];
+		const uint8_t s2 = xtime(s);
+		const uint8_t s3 = s2 ^ s;
+		table[i]         = static_cast<uint32_t>(s2) | (static_cast<uint32_t>(s) << 8) | (static_cast<uint32_t>(s) << 16) | (static_cast<uint32_t>(s3) << 24);
+	}
+
+	return table;
+}
+
+inline constexpr std::array<uint32_t, 256> TE0 = makeTe0();
+
+inline uint32_t load32(const uint8_t *p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t te(const uint32_t &w, const uint32_t &row)
+{
+	return std::rotl(TE0[(w >> (8 * row)) & 0xFF], static_cast<int>(8 * row));
+}
+
+inline uint32_t sub(const uint32_t &w, const uint32_t &row)
+{
+	return static_cast<uint32_t>(SBOX[(w >> (8 * row)) & 0xFF]) << (8 * row);
+}
+} // namespace detail
+
+// --- Implementations ---
+
+// Every kernel encrypts blockCount counter blocks from pCounters into pOut
+
+inline void encryptBlocksTTable(const uint8_t *pRoundKey, const uint8_t *pCounters, uint8_t *pOut, const std::size_t &blockCount)
+{
+	using namespace detail;
+
+	for (std::size_t b = 0; b < blockCount; b++)
+	{
+		uint32_t s[4];
+		uint32_t t[4];
+
+		for (uint32_t c = 0; c < 4; c++)
+			s[c] = load32(pCounters + b * BLOCK_SIZE + c * 4) ^ load32(pRoundKey + c * 4);
+
+		for (uint32_t round = 1; round < ROUNDS; round++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+				t[c] = te(s[c], 0) ^ te(s[(c + 1) % 4], 1) ^ te(s[(c + 2) % 4], 2) ^ te(s[(c + 3) % 4], 3) ^ load32(pRoundKey + round * BLOCK_SIZE + c * 4);
+
+			std::memcpy(s, t, sizeof(s));
+		}
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			t[c] = sub(s[c], 0) ^ sub(s[(c + 1) % 4], 1) ^ sub(s[(c + 2) % 4], 2) ^ sub(s[(c + 3) % 4], 3) ^ load32(pRoundKey + ROUNDS * BLOCK_SIZE + c * 4);
+			std::memcpy(pOut + b * BLOCK_SIZE + c * 4, &t[c], 4);
+		}
+	}
+}
+
+inline void encryptBlocksAESNI(const uint8_t *pRoundKey, const uint8_t *pCounters, uint8_t *pOut, const std::size_t &blockCount)
+{
+	__m128i roundKeys[ROUNDS + 1];
+
+	for (std::size_t r = 0; r <= ROUNDS; r++)
+		roundKeys[r] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRoundKey + r * BLOCK_SIZE));
+
+	std::size_t b = 0;
+
+	// Eight independent blocks keep the AES unit busy
+	for (; b + PARALLEL_BLOCKS <= blockCount; b += PARALLEL_BLOCKS)
+	{
+		__m128i x[PARALLEL_BLOCKS];
+
+		for (std::size_t i = 0; i < PARALLEL_BLOCKS; i++)
+			x[i] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pCounters + (b + i) * BLOCK_SIZE)), roundKeys[0]);
+
+		for (std::size_t r = 1; r < ROUNDS; r++)
+		{
+			for (std::size_t i = 0; i < PARALLEL_BLOCKS; i++)
+				x[i] = _mm_aesenc_si128(x[i], roundKeys[r]);
+		}
+
+		for (std::size_t i = 0; i < PARALLEL_BLOCKS; i++)
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pOut + (b + i) * BLOCK_SIZE), _mm_aesenclast_si128(x[i], roundKeys[ROUNDS]));
+	}
+
+	for (; b < blockCount; b++)
+	{
+		__m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pCounters + b * BLOCK_SIZE)), roundKeys[0]);
+
+		for (std::size_t r = 1; r < ROUNDS; r++)
+			x = _mm_aesenc_si128(x, roundKeys[r]);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pOut + b * BLOCK_SIZE), _mm_aesenclast_si128(x, roundKeys[ROUNDS]));
+	}
+}
+
+// --- Dispatcher ---
+
+using EncryptBlocksFunction = void (*)(const uint8_t *, const uint8_t *, uint8_t *, const std::size_t &);
+
+inline EncryptBlocksFunction selectEncryptBlocksFunc(const simd::CpuFeatures &features)
+{
+	if (features.aes && features.sse2)
+		return encryptBlocksAESNI;
+	else
+		return encryptBlocksTTable;
+}
+
+inline EncryptBlocksFunction encryptBlocksFunc()
+{
+	static const EncryptBlocksFunction func = selectEncryptBlocksFunc(simd::detectCpuFeatures());
+	return func;
+}
+
+// --- CTR ---
+
+// Increments the big endian counter by one
+inline void incrementCounter(uint8_t *pCounter)
+{
+	for (int32_t i = BLOCK_SIZE - 1; i >= 0; i--)
+	{
+		if (++pCounter[i] != 0)
+			break;
+	}
+}
+
+// XORs size bytes of the key stream, starting skip bytes into the block of pCounter, with pData
+// pCounter is advanced past every block that was used, including a partially used last block
+inline void xcrypt(uint8_t *pData, const uint8_t *pRoundKey, uint8_t *pCounter, const std::size_t &size, const std::size_t &skip = 0)
+{
+	const EncryptBlocksFunction encryptBlocks = encryptBlocksFunc();
+
+	uint8_t counters[KEY_STREAM_SIZE];
+	uint8_t keyStream[KEY_STREAM_SIZE];
+
+	std::size_t done   = 0;
+	std::size_t offset = skip;
+
+	while (done < size)
+	{
+		const std::size_t blocks = std::min<std::size_t>(PARALLEL_BLOCKS, (offset + size - done + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+		for (std::size_t b = 0; b < blocks; b++)
+		{
+			std::memcpy(counters + b * BLOCK_SIZE, pCounter, BLOCK_SIZE);
+			incrementCounter(pCounter);
+		}
+
+		encryptBlocks(pRoundKey, counters, keyStream, blocks);
+
+		const std::size_t run = std::min<std::size_t>(blocks * BLOCK_SIZE - offset, size - done);
+		keyXor::xorStream(pData + done, keyStream + offset, run);
+
+		done += run;
+		offset = 0;
+	}
+}
+
+} // namespace aesCtr
@@ -0,0 +1,156 @@
+﻿/*
+ *  File: Benchmark.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "KeyXor.h"
+#include "LzEncoder.h"
+
+// Throughput benchmarks of the DXLib codecs, kept out of the codec headers so these do not pull in the
+// stream, file and timing headers
+
+namespace keyXor
+{
+// Prints the throughput of every kernel the CPU supports for a buffer of the given size
+inline void benchmark(const std::size_t &size = 64 * 1024 * 1024, const uint32_t &rounds = 16)
+{
+	const simd::CpuFeatures features = simd::detectCpuFeatures();
+
+	struct Kernel
+	{
+		const char *pName;
+		XorStreamFunction func;
+		bool supported;
+	};
+
+	const Kernel kernels[] = {
+		{ "Plain  ", xorStreamPlain, true },
+		{ "SSE2   ", xorStreamSSE2, features.sse2 },
+		{ "AVX2   ", xorStreamAVX2, features.avx2 },
+		{ "AVX-512", xorStreamAVX512, features.avx512f && features.avx512bw },
+	};
+
+	std::vector<uint8_t> data(size);
+	std::vector<uint8_t> stream(size);
+	std::vector<uint8_t> expected;
+
+	for (std::size_t i = 0; i < size; i++)
+	{
+		data[i]   = static_cast<uint8_t>(i * 7);
+		stream[i] = static_cast<uint8_t>(i % 251);
+	}
+
+	for (const Kernel &kernel : kernels)
+	{
+		if (!kernel.supported)
+		{
+			std::cout << kernel.pName << ": not supported" << std::endl;
+			continue;
+		}
+
+		std::vector<uint8_t> buffer = data;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t r = 0; r < rounds; r++)
+			kernel.func(buffer.data(), stream.data(), size, static_cast<uint8_t>(r));
+		auto end = std::chrono::high_resolution_clock::now();
+
+		const std::chrono::duration<double> elapsed = end - start;
+
+		// Every kernel has to produce the same result as the plain one
+		if (expected.empty())
+			expected = buffer;
+
+		std::cout << kernel.pName << ": " << (static_cast<double>(size) * rounds / elapsed.count() / 1e9) << " GB/s"
+				  << (buffer == expected ? "" : " (MISMATCH)") << std::endl;
+	}
+}
+} // namespace keyXor
+
+namespace lzEncoder
+{
+// Compresses every file below path with the given encoder (level 0 = list encoder of DXArchive) and every level,
+// prints throughput and ratio and checks that DXArchive::Decode restores the files.
+// The callbacks keep this header independent of DXArchive.h, e.g.
+//   lzEncoder::benchmark(L"Data", [](void *pSrc, uint32_t size, void *pDest) { return DXArchive::Encode(pSrc, size, pDest, false); }, DXArchive::Decode)
+template<typename ListEncodeFunc, typename DecodeFunc>
+inline void benchmark(const std::filesystem::path &path, const ListEncodeFunc &listEncode, const DecodeFunc &decode)
+{
+	std::vector<std::vector<uint8_t>> files;
+	uint64_t totalSize = 0;
+
+	for (const auto &entry : std::filesystem::recursive_directory_iterator(path))
+	{
+		if (!entry.is_regular_file() || entry.file_size() == 0) continue;
+
+		std::ifstream in(entry.path(), std::ios::binary);
+		files.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		totalSize += files.back().size();
+	}
+
+	std::cout << files.size() << " files, " << (static_cast<double>(totalSize) / 1e6) << " MB" << std::endl;
+
+	std::vector<uint8_t> packed;
+	std::vector<uint8_t> unpacked;
+
+	for (int level = 0; level <= LEVEL_MAX; level++)
+	{
+		uint64_t packedSize = 0;
+		bool mismatch       = false;
+		std::chrono::duration<double> elapsed(0);
+
+		for (const std::vector<uint8_t> &file : files)
+		{
+			const uint32_t size = static_cast<uint32_t>(file.size());
+			packed.resize(static_cast<std::size_t>(size) * 2 + HEADER_SIZE);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			const uint32_t encSize = level == 0 ? static_cast<uint32_t>(listEncode(const_cast<uint8_t *>(file.data()), size, packed.data())) : encode(file.data(), size, packed.data(), level);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			elapsed += end - start;
+			packedSize += encSize;
+
+			unpacked.assign(file.size(), 0);
+			if (static_cast<uint32_t>(decode(packed.data(), unpacked.data())) != size || unpacked != file)
+				mismatch = true;
+		}
+
+		std::cout << (level == 0 ? "List   " : "Level " + std::to_string(level)) << ": "
+				  << (static_cast<double>(totalSize) / elapsed.count() / 1e6) << " MB/s, "
+				  << (static_cast<double>(packedSize) * 100 / static_cast<double>(totalSize)) << "%"
+				  << (mismatch ? " (MISMATCH)" : "") << std::endl;
+	}
+}
+} // namespace lzEncoder
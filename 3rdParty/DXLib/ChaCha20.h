@@ -0,0 +1,298 @@
+﻿/*
+ *  File: ChaCha20.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+#include "KeyXor.h"
+#include "WolfNew.h"
+
+// ChaCha20 key stream for the ChaCha2 archives
+// Produces several blocks at once, one block per vector lane, and keeps the generated key stream between calls
+// so sequential reads of a file do not restart the cipher. The stream is the same as the one of chacha20_xor,
+// i.e., byte p of the data uses the block with counter 1 + p / 64
+namespace chacha20
+{
+static constexpr std::size_t BLOCK_SIZE  = 64;
+static constexpr std::size_t PAGE_BLOCKS = 16;
+static constexpr std::size_t PAGE_SIZE   = PAGE_BLOCKS * BLOCK_SIZE;
+
+// --- SIMD Implementations ---
+
+// Every kernel writes the blocks for the counters counter, counter + 1, ... to pOut
+
+inline void blocksPlain(const uint32_t *pState, const uint32_t &counter, uint8_t *pOut)
+{
+	uint32_t state[16];
+	uint32_t keyStream[16];
+
+	std::memcpy(state, pState, sizeof(state));
+	state[12] = counter;
+
+	chacha20_block_next(state, keyStream);
+	std::memcpy(pOut, keyStream, BLOCK_SIZE);
+}
+
+// Writes the lanes of the 16 state words as consecutive blocks
+inline void storeLanes(const uint32_t *pWords, const std::size_t &lanes, uint8_t *pOut)
+{
+	uint32_t block[16];
+
+	for (std::size_t l = 0; l < lanes; l++)
+	{
+		for (std::size_t w = 0; w < 16; w++)
+			block[w] = pWords[w * lanes + l];
+
+		std::memcpy(pOut + l * BLOCK_SIZE, block, BLOCK_SIZE);
+	}
+}
+
+#define CHACHA20_DOUBLEROUNDS(QR, x)  \
+	for (uint32_t i = 0; i < 10; i++) \
+	{                                 \
+		QR(x, 0, 4, 8, 12)            \
+		QR(x, 1, 5, 9, 13)            \
+		QR(x, 2, 6, 10, 14)           \
+		QR(x, 3, 7, 11, 15)           \
+		QR(x, 0, 5, 10, 15)           \
+		QR(x, 1, 6, 11, 12)           \
+		QR(x, 2, 7, 8, 13)            \
+		QR(x, 3, 4, 9, 14)            \
+	}
+
+#define CHACHA20_ROTL_SSE2(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - n))
+
+#define CHACHA20_QUARTERROUND_SSE2(x, a, b, c, d)                \
+	x[a] = _mm_add_epi32(x[a], x[b]);                              \
+	x[d] = CHACHA20_ROTL_SSE2(_mm_xor_si128(x[d], x[a]), 16);      \
+	x[c] = _mm_add_epi32(x[c], x[d]);                              \
+	x[b] = CHACHA20_ROTL_SSE2(_mm_xor_si128(x[b], x[c]), 12);      \
+	x[a] = _mm_add_epi32(x[a], x[b]);                              \
+	x[d] = CHACHA20_ROTL_SSE2(_mm_xor_si128(x[d], x[a]), 8);       \
+	x[c] = _mm_add_epi32(x[c], x[d]);                              \
+	x[b] = CHACHA20_ROTL_SSE2(_mm_xor_si128(x[b], x[c]), 7);
+
+inline void blocksSSE2(const uint32_t *pState, const uint32_t &counter, uint8_t *pOut)
+{
+	constexpr std::size_t lanes = 4;
+
+	__m128i s[16];
+	__m128i x[16];
+	alignas(16) uint32_t words[16 * lanes];
+
+	for (uint32_t i = 0; i < 16; i++)
+		s[i] = _mm_set1_epi32(static_cast<int>(pState[i]));
+
+	s[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(counter)), _mm_setr_epi32(0, 1, 2, 3));
+
+	for (uint32_t i = 0; i < 16; i++)
+		x[i] = s[i];
+
+	CHACHA20_DOUBLEROUNDS(CHACHA20_QUARTERROUND_SSE2, x)
+
+	for (uint32_t i = 0; i < 16; i++)
+		_mm_store_si128(reinterpret_cast<__m128i *>(words + i * lanes), _mm_add_epi32(x[i], s[i]));
+
+	storeLanes(words, lanes, pOut);
+}
+
+#define CHACHA20_ROTL_AVX2(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - n))
+
+#define CHACHA20_QUARTERROUND_AVX2(x, a, b, c, d)                  \
+	x[a] = _mm256_add_epi32(x[a], x[b]);                             \
+	x[d] = CHACHA20_ROTL_AVX2(_mm256_xor_si256(x[d], x[a]), 16);     \
+	x[c] = _mm256_add_epi32(x[c], x[d]);                             \
+	x[b] = CHACHA20_ROTL_AVX2(_mm256_xor_si256(x[b], x[c]), 12);     \
+	x[a] = _mm256_add_epi32(x[a], x[b]);                             \
+	x[d] = CHACHA20_ROTL_AVX2(_mm256_xor_si256(x[d], x[a]), 8);      \
+	x[c] = _mm256_add_epi32(x[c], x[d]);                             \
+	x[b] = CHACHA20_ROTL_AVX2(_mm256_xor_si256(x[b], x[c]), 7);
+
+inline void blocksAVX2(const uint32_t *pState, const uint32_t &counter, uint8_t *pOut)
+{
+	constexpr std::size_t lanes = 8;
+
+	__m256i s[16];
+	__m256i x[16];
+	alignas(32) uint32_t words[16 * lanes];
+
+	for (uint32_t i = 0; i < 16; i++)
+		s[i] = _mm256_set1_epi32(static_cast<int>(pState[i]));
+
+	s[12] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(counter)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+	for (uint32_t i = 0; i < 16; i++)
+		x[i] = s[i];
+
+	CHACHA20_DOUBLEROUNDS(CHACHA20_QUARTERROUND_AVX2, x)
+
+	for (uint32_t i = 0; i < 16; i++)
+		_mm256_store_si256(reinterpret_cast<__m256i *>(words + i * lanes), _mm256_add_epi32(x[i], s[i]));
+
+	storeLanes(words, lanes, pOut);
+}
+
+#define CHACHA20_QUARTERROUND_AVX512(x, a, b, c, d)                \
+	x[a] = _mm512_add_epi32(x[a], x[b]);                             \
+	x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 16);       \
+	x[c] = _mm512_add_epi32(x[c], x[d]);                             \
+	x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 12);       \
+	x[a] = _mm512_add_epi32(x[a], x[b]);                             \
+	x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 8);        \
+	x[c] = _mm512_add_epi32(x[c], x[d]);                             \
+	x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 7);
+
+inline void blocksAVX512(const uint32_t *pState, const uint32_t &counter, uint8_t *pOut)
+{
+	constexpr std::size_t lanes = 16;
+
+	__m512i s[16];
+	__m512i x[16];
+	alignas(64) uint32_t words[16 * lanes];
+
+	for (uint32_t i = 0; i < 16; i++)
+		s[i] = _mm512_set1_epi32(static_cast<int>(pState[i]));
+
+	s[12] = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(counter)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+	for (uint32_t i = 0; i < 16; i++)
+		x[i] = s[i];
+
+	CHACHA20_DOUBLEROUNDS(CHACHA20_QUARTERROUND_AVX512, x)
+
+	for (uint32_t i = 0; i < 16; i++)
+		_mm512_store_si512(words + i * lanes, _mm512_add_epi32(x[i], s[i]));
+
+	storeLanes(words, lanes, pOut);
+}
+
+#undef CHACHA20_QUARTERROUND_AVX512
+#undef CHACHA20_QUARTERROUND_AVX2
+#undef CHACHA20_ROTL_AVX2
+#undef CHACHA20_QUARTERROUND_SSE2
+#undef CHACHA20_ROTL_SSE2
+#undef CHACHA20_DOUBLEROUNDS
+
+// --- Dispatcher ---
+
+using BlocksFunction = void (*)(const uint32_t *, const uint32_t &, uint8_t *);
+
+struct BlocksKernel
+{
+	BlocksFunction func;
+	uint32_t blocks;
+};
+
+inline BlocksKernel selectBlocksKernel(const simd::CpuFeatures &features)
+{
+	if (features.avx512f)
+		return { blocksAVX512, 16 };
+	else if (features.avx2)
+		return { blocksAVX2, 8 };
+	else if (features.sse2)
+		return { blocksSSE2, 4 };
+	else
+		return { blocksPlain, 1 };
+}
+
+inline const BlocksKernel &blocksKernel()
+{
+	static const BlocksKernel kernel = selectBlocksKernel(simd::detectCpuFeatures());
+	return kernel;
+}
+
+// --- Stream ---
+
+class Stream
+{
+public:
+	// Sets up the cipher state, the key stream of the last key and nonce is kept
+	void init(const uint8_t *pKey, const uint8_t *pNonce)
+	{
+		if (m_init && std::memcmp(m_key, pKey, sizeof(m_key)) == 0 && std::memcmp(m_nonce, pNonce, sizeof(m_nonce)) == 0)
+			return;
+
+		std::memcpy(m_key, pKey, sizeof(m_key));
+		std::memcpy(m_nonce, pNonce, sizeof(m_nonce));
+		chacha20_init_block(m_state, pKey, pNonce);
+
+		m_init      = true;
+		m_pageValid = false;
+	}
+
+	// Same result as chacha20_xor with a freshly initialized state
+	void xorAt(const uint32_t &startPos, uint8_t *pData, const uint64_t &length)
+	{
+		uint64_t position = startPos;
+		uint64_t done     = 0;
+
+		while (done < length)
+		{
+			const uint64_t block = position / BLOCK_SIZE;
+
+			if (!m_pageValid || block < m_pageBlock || block >= m_pageBlock + PAGE_BLOCKS)
+				fillPage(block);
+
+			const std::size_t offset = static_cast<std::size_t>(position - m_pageBlock * BLOCK_SIZE);
+			const std::size_t run    = static_cast<std::size_t>(std::min<uint64_t>(PAGE_SIZE - offset, length - done));
+
+			keyXor::xorStream(pData + done, m_page + offset, run);
+
+			done += run;
+			position += run;
+		}
+	}
+
+private:
+	void fillPage(const uint64_t &block)
+	{
+		const BlocksKernel &kernel = blocksKernel();
+
+		// The counter of the first block is 1, it is only 32 bit wide like in chacha20_block_next
+		const uint32_t counter = static_cast<uint32_t>(m_state[12] + block);
+
+		for (uint32_t i = 0; i < PAGE_BLOCKS; i += kernel.blocks)
+			kernel.func(m_state, counter + i, m_page + i * BLOCK_SIZE);
+
+		m_pageBlock = block;
+		m_pageValid = true;
+	}
+
+	uint32_t m_state[16] = { 0 };
+	uint8_t m_key[32]    = { 0 };
+	uint8_t m_nonce[12]  = { 0 };
+	bool m_init          = false;
+
+	alignas(64) uint8_t m_page[PAGE_SIZE] = { 0 };
+	uint64_t m_pageBlock                  = 0;
+	bool m_pageValid                      = false;
+};
+
+} // namespace chacha20
@@ -679,6 +679,22 @@ extern int InitCharCode( void )
 	return 0 ;
 }
 
+// Returns the Shift-JIS to UTF-16 table, indexed by a single byte or by lead byte << 8 | trail byte,
+// codes without a mapping are 0. The setup is not thread safe, callers have to serialize the first call
+extern const u16 *GetShiftJISToUTF16Table( void )
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+	InitCharCode() ;
+#else
+	if( g_CharCodeSystem.InitializeCharCodeCP932InfoFlag == FALSE )
+	{
+		SetupCharCodeCP932TableInfo() ;
+	}
+#endif
+
+	return g_CharCodeSystem.CharCodeCP932Info.MultiByteToUTF16 ;
+}
+
 // 指定のコードページの情報最少サイズを取得する( 戻り値：バイト数 )
 __inline int GetCharCodeFormatUnitSize_inline( int CharCodeFormat )
 {
@@ -61,6 +61,7 @@
 // function proto type --------------------------
 
 extern	int				InitCharCode( void ) ;																	// 文字コードライブラリの初期化
+extern	const u16 *		GetShiftJISToUTF16Table( void ) ;														// Shift-JIS to UTF-16 table, 0 for unmapped codes
 
 extern	int				GetCharCodeFormatUnitSize(	int CharCodeFormat ) ;													// 指定のコードページの情報最少サイズを取得する( 戻り値：バイト数 )
 extern	int				GetCharBytes(			const char *CharCode, int CharCodeFormat ) ;									// １文字のバイト数を取得する( 戻り値：１文字のバイト数 )
@@ -12,13 +12,20 @@
 
 // include ----------------------------
 #include "DXArchive.h"
+#include "DXArchiveDecoder.h"
 #include "CharCode.h"
 #include "FileLib.h"
 #include "Huffman.h"
+#include "LzDecoder.h"
+#include "LzEncoder.h"
 #include <stdio.h>
 #include <string.h>
 #include <windows.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 // define -----------------------------
 
 #define MIN_COMPRESS       (4)                     // 最低圧縮バイト数
@@ -28,15 +35,16 @@
 #define MAX_ADDRESSLISTNUM (1024 * 1024 * 1)       // スライド辞書の最大サイズ
 #define MAX_POSITION       (1 << 24)               // 参照可能な最大相対アドレス( 16MB )
 
+#define ENCODE_WORK_KEEP_SIZE (0x400000) // 圧縮用の作業バッファを次のファイルでも使い回す最大サイズ( 4MB )
+
 #define GLOBAL_CHAR_CODE 932
 
-uint8_t g_specialKey[768] = {};
-bool g_newCrypt           = false;
-bool g_chacha20           = false;
-uint16_t g_cryptVersion   = 0;
+// Default ChaCha20 key and nonce (ChaCha2 v1)
+static const u8 DefaultCC20Key[32]   = { 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD };
+static const u8 DefaultCC20Nonce[12] = { 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85 };
 
-uint8_t g_cc20Key[32]   = { 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD };
-uint8_t g_cc20Nonce[12] = { 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85 };
+// Crypt state used by the encoder and the archive reader, DXArchiveDecoder keeps its own state per instance
+static DARC_CRYPTSTATE g_crypt = {};
 
 
 
@@ -62,6 +70,7 @@ size_t LogStringLength = 0;
 
 // Functions for new Wolf Crypt
 #include "WolfNew.h"
+#include "ChaCha20.h"
 
 // class code -------------------------
 
@@ -349,6 +358,17 @@ int DXArchive::AddFileNameData(const TCHAR *FileName, u8 *FileNameTable)
 	return PackNum * 4 * 2 + 4;
 }
 
+// ファイル名データが使用する最大のバイト数を取得する
+// ( Shift-JIS では UTF-16 の一文字は２バイト以下になる、AddFileNameData と同じくパック数分の２つの文字列とパック数、パリティの分 )
+u64 DXArchive::GetFileNameDataMaxSize(const TCHAR *FileName)
+{
+	u64 Length;
+
+	Length = _tcslen(FileName) * 2 + 1;
+
+	return (Length + 3) / 4 * 4 * 2 + 4;
+}
+
 // ファイル名データから元のファイル名の文字列を取得する
 TCHAR *DXArchive::GetOriginalFileName(u8 *FileNameTable)
 {
@@ -570,22 +590,25 @@ void DXArchive::KeyCreate(const char *Source, size_t SourceBytes, u8 *Key)
 // 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 void DXArchive::KeyConv(void *Data, s64 Size, s64 Position, unsigned char *Key)
 {
-	if (g_newCrypt)
+	KeyConv(Data, Size, Position, Key, &g_crypt);
+}
+
+// KeyConv using the given crypt state instead of the shared one
+void DXArchive::KeyConv(void *Data, s64 Size, s64 Position, unsigned char *Key, const DARC_CRYPTSTATE *Crypt)
+{
+	if (Crypt->NewCrypt)
 	{
-		wolfCrypt(g_specialKey, reinterpret_cast<uint8_t *>(Data), Position, Position + Size, false, g_cryptVersion);
+		wolfCrypt(Crypt->SpecialKey, reinterpret_cast<uint8_t *>(Data), Position, Position + Size, false, Crypt->CryptVersion);
 		return;
 	}
 
-	if (g_chacha20)
+	if (Crypt->ChaCha20)
 	{
-		uint32_t state[16];
-		uint32_t keystream32[16];
+		// One stream per thread, it keeps the key stream of the last read for the next sequential read
+		thread_local chacha20::Stream stream;
 
-		std::memset(state, 0, sizeof(state));
-		std::memset(keystream32, 0, sizeof(keystream32));
-
-		chacha20_init_block(state, g_cc20Key, g_cc20Nonce);
-		chacha20_xor(state, keystream32, static_cast<uint32_t>(Position), reinterpret_cast<uint8_t *>(Data), Size);
+		stream.init(Crypt->CC20Key, Crypt->CC20Nonce);
+		stream.xorAt(static_cast<uint32_t>(Position), reinterpret_cast<uint8_t *>(Data), Size);
 		return;
 	}
 
@@ -594,34 +617,13 @@ void DXArchive::KeyConv(void *Data, s64 Size, s64 Position, unsigned char *Key)
 		return;
 	}
 
-	Position %= DXA_KEY_BYTES;
-
-	if (Size < 0x100000000)
+	if (Size <= 0)
 	{
-		u32 i, j;
-
-		j = (u32)Position;
-		for (i = 0; i < Size; i++)
-		{
-			((u8 *)Data)[i] ^= Key[j];
-
-			j++;
-			if (j == DXA_KEY_BYTES) j = 0;
-		}
+		return;
 	}
-	else
-	{
-		s64 i, j;
-
-		j = Position;
-		for (i = 0; i < Size; i++)
-		{
-			((u8 *)Data)[i] ^= Key[j];
 
-			j++;
-			if (j == DXA_KEY_BYTES) j = 0;
-		}
-	}
+	// The key is expanded to a page and XORed with the vector kernels
+	keyXor::xorRepeatKey(reinterpret_cast<uint8_t *>(Data), static_cast<uint64_t>(Size), Key, DXA_KEY_BYTES, static_cast<std::size_t>(Position % DXA_KEY_BYTES));
 }
 
 // データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
@@ -669,17 +671,42 @@ void DXArchive::KeyConvFileRead(void *Data, s64 Size, FILE *fp, unsigned char *K
 	}
 }
 
-// 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
-int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, FILE *DestFp, void *TempBuffer, bool Press, bool MaxPress, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, DARC_ENCODEINFO *EncodeInfo)
+// Sets up the crypt flags and ChaCha20 key for the given crypt version
+void DXArchive::InitCryptState(DARC_CRYPTSTATE *Crypt, u16 CryptVersion, const char *KeyString, size_t KeyStringBytes)
+{
+	Crypt->CryptVersion = CryptVersion;
+	Crypt->NewCrypt     = (CryptVersion >= 331 && CryptVersion < 1000 || CryptVersion >= 1010);
+	Crypt->ChaCha20     = CryptVersion == 0x64 || CryptVersion == 0xC8;
+
+	memset(Crypt->SpecialKey, 0, sizeof(Crypt->SpecialKey));
+	memcpy(Crypt->CC20Key, DefaultCC20Key, sizeof(Crypt->CC20Key));
+	memcpy(Crypt->CC20Nonce, DefaultCC20Nonce, sizeof(Crypt->CC20Nonce));
+
+	// CC2 Pro stores the data for the key setup right behind the key string
+	if (CryptVersion == 0xC8)
+	{
+		std::array<uint8_t, 4> data;
+		std::array<uint8_t, 64> key;
+
+		std::memcpy(data.data(), (uint8_t *)KeyString + KeyStringBytes + 1, 4);
+		chacha20_keySetup(data, key);
+
+		std::memcpy(Crypt->CC20Key, key.data(), 32);
+		std::memcpy(Crypt->CC20Nonce, key.data() + 34, 12);
+	}
+}
+
+// 指定のディレクトリにあるファイルのヘッダを作成し、ファイルを書き出す一覧に追加する
+int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, ENCODETABLE *Table, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, std::vector<ENCODETASK> *Tasks)
 {
 	TCHAR DirPath[MAX_PATH];
 	WIN32_FIND_DATA FindData;
 	HANDLE FindHandle;
 	DARC_DIRECTORY Dir;
-	DARC_DIRECTORY *DirectoryP;
+	u64 DirectoryAddress;
 	DARC_FILEHEAD File;
-	u8 lKey[DXA_KEY_BYTES];
 	size_t KeyStringBufferBytes;
+	u8 *NameP, *FileP, *DirP;
 
 	// ディレクトリの情報を得る
 	FindHandle = FindFirstFile(DirectoryName, &FindData);
@@ -699,10 +726,16 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 	}
 
 	// ディレクトリ名を書き出す
+	NameP = ReserveTable(&Table->Name, Size->NameSize + GetFileNameDataMaxSize(FindData.cFileName));
+	if (NameP == NULL)
+	{
+		FindClose(FindHandle);
+		return -1;
+	}
 	Size->NameSize += AddFileNameData(FindData.cFileName, NameP + Size->NameSize);
 
 	// ディレクトリ情報が入ったファイルヘッダを書き出す
-	memcpy(FileP + ParentDir->FileHeadAddress + DataNumber * sizeof(DARC_FILEHEAD),
+	memcpy(Table->File.data() + ParentDir->FileHeadAddress + DataNumber * sizeof(DARC_FILEHEAD),
 		   &File, sizeof(DARC_FILEHEAD));
 
 	// Find ハンドルを閉じる
@@ -720,7 +753,7 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 		// 親ディレクトリの情報位置をセット
 		if (ParentDir->DirectoryAddress != 0xffffffffffffffff && ParentDir->DirectoryAddress != 0)
 		{
-			Dir.ParentDirectoryAddress = ((DARC_FILEHEAD *)(FileP + ParentDir->DirectoryAddress))->DataAddress;
+			Dir.ParentDirectoryAddress = ((DARC_FILEHEAD *)(Table->File.data() + ParentDir->DirectoryAddress))->DataAddress;
 		}
 		else
 		{
@@ -731,9 +764,18 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 		Dir.FileHeadNum = GetDirectoryFilePath(TEXT(""), NULL);
 	}
 
+	// ディレクトリの情報とファイルヘッダの領域を確保する
+	DirP  = ReserveTable(&Table->Directory, Size->DirectorySize + sizeof(DARC_DIRECTORY));
+	FileP = ReserveTable(&Table->File, Size->FileSize + sizeof(DARC_FILEHEAD) * Dir.FileHeadNum);
+	if (DirP == NULL || FileP == NULL)
+	{
+		SetCurrentDirectory(DirPath);
+		return -1;
+	}
+
 	// ディレクトリの情報を出力する
 	memcpy(DirP + Size->DirectorySize, &Dir, sizeof(DARC_DIRECTORY));
-	DirectoryP = (DARC_DIRECTORY *)(DirP + Size->DirectorySize);
+	DirectoryAddress = Size->DirectorySize;
 
 	// アドレスを推移させる
 	Size->DirectorySize += sizeof(DARC_DIRECTORY);
@@ -760,11 +802,19 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 			// 上のディレクトリに戻ったりするためのパスは無視する
 			if (_tcscmp(FindData.cFileName, TEXT(".")) == 0 || _tcscmp(FindData.cFileName, TEXT("..")) == 0) continue;
 
+			// 数えた後に増えたファイルはファイルヘッダの領域が無いので格納しない
+			if ((u64)i >= Dir.FileHeadNum) break;
+
 			// ファイルではなく、ディレクトリだった場合は再帰する
 			if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 			{
 				// ディレクトリだった場合の処理
-				if (DirectoryEncode(CharCodeFormat, FindData.cFileName, NameP, DirP, FileP, &Dir, Size, i, DestFp, TempBuffer, Press, MaxPress, AlwaysHuffman, HuffmanEncodeKB, KeyString, KeyStringBytes, NoKey, KeyStringBuffer, EncodeInfo) < 0) return -1;
+				if (DirectoryEncode(CharCodeFormat, FindData.cFileName, Table, &Dir, Size, i, KeyString, KeyStringBytes, NoKey, KeyStringBuffer, Tasks) < 0)
+				{
+					FindClose(FindHandle);
+					SetCurrentDirectory(DirPath);
+					return -1;
+				}
 			}
 			else
 			{
@@ -776,613 +826,612 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 				File.Time.LastAccess   = (((LONGLONG)FindData.ftLastAccessTime.dwHighDateTime) << 32) + FindData.ftLastAccessTime.dwLowDateTime;
 				File.Time.LastWrite    = (((LONGLONG)FindData.ftLastWriteTime.dwHighDateTime) << 32) + FindData.ftLastWriteTime.dwLowDateTime;
 				File.Attributes        = FindData.dwFileAttributes;
-				File.DataAddress       = Size->DataSize;
+				File.DataAddress       = 0; // 書き出す時にセットする
 				File.DataSize          = (((LONGLONG)FindData.nFileSizeHigh) << 32) + FindData.nFileSizeLow;
 				File.PressDataSize     = 0xffffffffffffffff;
 				File.HuffPressDataSize = 0xffffffffffffffff;
 
-				// 進行状況出力
-				if (EncodeInfo->OutputStatus)
+				// ファイル名を書き出す
+				NameP = ReserveTable(&Table->Name, Size->NameSize + GetFileNameDataMaxSize(FindData.cFileName));
+				if (NameP == NULL)
 				{
-					// 処理ファイル名をセット
-					wcscpy(EncodeInfo->ProcessFileName, FindData.cFileName);
-
-					// ファイル数を増やす
-					EncodeInfo->CompFileNum++;
-
-					// 表示
-					EncodeStatusOutput(EncodeInfo);
+					FindClose(FindHandle);
+					SetCurrentDirectory(DirPath);
+					return -1;
 				}
-
-				// ファイル名を書き出す
 				Size->NameSize += AddFileNameData(FindData.cFileName, NameP + Size->NameSize);
 
-				// ファイル個別の鍵を作成
+				// ファイルを書き出す一覧に追加する、圧縮と書き出しは全てのヘッダを作成した後に行う
+				AddEncodeTask(Tasks, FindData.cFileName, FindData.cFileName, Dir.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, File.DataSize);
+
+				// ファイル個別の鍵を作成( 再帰でテーブルが拡張されている場合があるので、ディレクトリ情報はアドレスから求める )
 				if (NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString(CharCodeFormat, KeyString, KeyStringBytes, DirectoryP, &File, FileP, DirP, NameP, (BYTE *)KeyStringBuffer);
-					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
+					KeyStringBufferBytes = CreateKeyFileString(CharCodeFormat, KeyString, KeyStringBytes, (DARC_DIRECTORY *)(Table->Directory.data() + DirectoryAddress), &File, Table->File.data(), Table->Directory.data(), Table->Name.data(), (BYTE *)KeyStringBuffer);
+					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, Tasks->back().Key);
 				}
 
-				// ファイルデータを書き出す
-				if (File.DataSize != 0)
-				{
-					FILE *SrcP;
-					u64 FileSize, WriteSize, MoveSize;
-					bool Huffman     = false;
-					bool AlwaysPress = false;
-
-					// ファイルを開く
-					SrcP = _tfopen(FindData.cFileName, TEXT("rb"));
+				// ファイルヘッダを書き出す
+				memcpy(Table->File.data() + Dir.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, &File, sizeof(DARC_FILEHEAD));
+			}
 
-					// サイズを得る
-					_fseeki64(SrcP, 0, SEEK_END);
-					FileSize = _ftelli64(SrcP);
-					_fseeki64(SrcP, 0, SEEK_SET);
+			i++;
+		} while (FindNextFile(FindHandle, &FindData) != 0);
 
-					// 圧縮の対象となるファイルフォーマットか調べる
-					{
-						u32 Len;
-						Len = (u32)_tcslen(FindData.cFileName);
-						if (Len > 4)
-						{
-							TCHAR *sp;
-
-							sp = &FindData.cFileName[Len - 3];
-							if (StrICmp(sp, TEXT("wav")) == 0 ||
-								StrICmp(sp, TEXT("jpg")) == 0 ||
-								StrICmp(sp, TEXT("png")) == 0 ||
-								StrICmp(sp, TEXT("mpg")) == 0 ||
-								StrICmp(sp, TEXT("mp3")) == 0 ||
-								StrICmp(sp, TEXT("mp4")) == 0 ||
-								StrICmp(sp, TEXT("m4a")) == 0 ||
-								StrICmp(sp, TEXT("ogg")) == 0 ||
-								StrICmp(sp, TEXT("ogv")) == 0 ||
-								StrICmp(sp, TEXT("ops")) == 0 ||
-								StrICmp(sp, TEXT("wmv")) == 0 ||
-								StrICmp(sp, TEXT("tif")) == 0 ||
-								StrICmp(sp, TEXT("tga")) == 0 ||
-								StrICmp(sp, TEXT("bmp")) == 0 ||
-								StrICmp(sp - 1, TEXT("jpeg")) == 0)
-							{
-								Huffman = true;
-							}
+		// Find ハンドルを閉じる
+		FindClose(FindHandle);
+	}
 
-							// wav や bmp の場合は必ず圧縮する
-							if (StrICmp(sp, TEXT("wav")) == 0 ||
-								StrICmp(sp, TEXT("tga")) == 0 ||
-								StrICmp(sp, TEXT("bmp")) == 0)
-							{
-								AlwaysPress = true;
-							}
-						}
-					}
+	// もとのディレクトリをカレントディレクトリにセット
+	SetCurrentDirectory(DirPath);
 
-					// AlwaysHuffman が true の場合は必ずハフマン圧縮する
-					if (AlwaysHuffman)
-					{
-						Huffman = true;
-					}
+	// 終了
+	return 0;
+}
 
-					// ハフマン圧縮するサイズが 0 の場合はハフマン圧縮を行わない
-					if (HuffmanEncodeKB == 0)
-					{
-						Huffman = false;
-					}
+// 指定のパス以下を格納するのに必要なテーブルのサイズとファイルの数を加算する
+// ( ファイル名は最大のサイズで数えるので、実際に使用するサイズ以上になる )
+void DXArchive::ScanEncodeTableSize(const TCHAR *Path, SIZESAVE *Size, int *FileNum)
+{
+	FILE_INFOLIST FileList;
+	u32 Type;
+	int i;
 
-					// 圧縮の指定がある場合で、
-					// 必ず圧縮するファイルフォーマットか、ファイルサイズが 10MB 以下の場合は圧縮を試みる
-					if (Press == true && (AlwaysPress || File.DataSize < 10 * 1024 * 1024))
-					{
-						void *SrcBuf, *DestBuf;
-						u32 DestSize, Len;
+	// 指定されたファイルがあるかどうか検査
+	Type = GetFileAttributes(Path);
+	if ((signed int)Type == -1) return;
 
-						// 一部のファイル形式の場合は予め弾く
-						if (AlwaysPress == false && (Len = (int)_tcslen(FindData.cFileName)) > 4)
-						{
-							TCHAR *sp;
-
-							sp = &FindData.cFileName[Len - 3];
-							if (StrICmp(sp, TEXT("wav")) == 0 ||
-								StrICmp(sp, TEXT("jpg")) == 0 ||
-								StrICmp(sp, TEXT("png")) == 0 ||
-								StrICmp(sp, TEXT("mpg")) == 0 ||
-								StrICmp(sp, TEXT("mp3")) == 0 ||
-								StrICmp(sp, TEXT("mp4")) == 0 ||
-								StrICmp(sp, TEXT("ogg")) == 0 ||
-								StrICmp(sp, TEXT("ogv")) == 0 ||
-								StrICmp(sp, TEXT("ops")) == 0 ||
-								StrICmp(sp, TEXT("wmv")) == 0 ||
-								StrICmp(sp - 1, TEXT("jpeg")) == 0) goto NOPRESS;
-						}
+	// 指定のパス自体のファイル名、ファイルヘッダは格納する側のディレクトリで数える
+	Size->NameSize += GetFileNameDataMaxSize(Path);
 
-						// データが丸ごと入るメモリ領域の確保
-						SrcBuf  = malloc((size_t)(FileSize + FileSize * 2 + 64));
-						DestBuf = (u8 *)SrcBuf + FileSize;
+	// ファイルだった場合はファイルの数を増やす
+	if ((Type & FILE_ATTRIBUTE_DIRECTORY) == 0)
+	{
+		(*FileNum)++;
+		return;
+	}
 
-						// ファイルを丸ごと読み込む
-						fread64(SrcBuf, FileSize, SrcP);
+	// ディレクトリ自体の情報
+	Size->DirectorySize += sizeof(DARC_DIRECTORY);
 
-						// 圧縮する場合は強制的に進行状況出力を更新
-						if (EncodeInfo->OutputStatus)
-						{
-							EncodeStatusOutput(EncodeInfo, true);
-						}
+	// フォルダ以下のファイルとディレクトリを取得する
+	if (CreateFileList(Path, &FileList, FALSE, TRUE, NULL, NULL, NULL) < 0) return;
 
-						// 圧縮
-						DestSize = Encode(SrcBuf, (u32)FileSize, DestBuf, EncodeInfo->OutputStatus, MaxPress);
+	for (i = 0; i < FileList.Num; i++)
+	{
+		Size->NameSize += GetFileNameDataMaxSize(FileList.List[i].FileName);
+		Size->FileSize += sizeof(DARC_FILEHEAD);
 
-						// 殆ど圧縮出来なかった場合は圧縮無しでアーカイブする
-						if (AlwaysPress == false && ((f64)DestSize / (f64)FileSize > 0.90))
-						{
-							_fseeki64(SrcP, 0L, SEEK_SET);
-							free(SrcBuf);
-							goto NOPRESS;
-						}
+		if (FileList.List[i].IsDirectory)
+		{
+			Size->DirectorySize += sizeof(DARC_DIRECTORY);
+		}
+		else
+		{
+			(*FileNum)++;
+		}
+	}
 
-						// 圧縮データのサイズを保存する
-						File.PressDataSize = DestSize;
+	// ファイルリスト情報の後始末
+	ReleaseFileList(&FileList);
+}
 
-						// ハフマン圧縮も行うかどうかで処理を分岐
-						if (Huffman)
-						{
-							u8 *HuffData;
+// テーブルが指定のサイズに足りない場合は拡張する( 内容は保持する、確保できなかった場合は NULL を返す )
+u8 *DXArchive::ReserveTable(std::vector<u8> *Table, u64 Size)
+{
+	if (Table->size() < Size)
+	{
+		try
+		{
+			// 少しずつ足りなくなる場合に何度も確保し直さないように倍以上のサイズにする
+			Table->resize((size_t)(Size > Table->size() * 2 ? Size : Table->size() * 2));
+		}
+		catch (const std::bad_alloc &)
+		{
+			return NULL;
+		}
+	}
 
-							// ハフマン圧縮するサイズによって処理を分岐
-							if (HuffmanEncodeKB == 0xff || DestSize <= (u64)(HuffmanEncodeKB * 1024 * 2))
-							{
-								// ハフマン圧縮用のメモリ領域を確保
-								HuffData = (u8 *)calloc(1, DestSize * 2 + 256 * 2 + 32);
+	return Table->data();
+}
 
-								// ファイル全体をハフマン圧縮
-								File.HuffPressDataSize = Huffman_Encode(DestBuf, DestSize, HuffData);
+// 作業バッファから 0 で初期化した指定のサイズの領域を取得する( 確保できなかった場合は std::bad_alloc を投げる )
+u8 *DXArchive::GetEncodeWorkBuffer(ENCODEBUFFER *Buffer, u64 Size)
+{
+	if (Buffer->Size < Size)
+	{
+		// 今の内容は要らないので、解放してから確保し直す
+		free(Buffer->Data);
+		Buffer->Size = 0;
+		Buffer->Data = calloc(1, (size_t)Size);
+		if (Buffer->Data == NULL) throw std::bad_alloc();
+		Buffer->Size = Size;
+	}
+	else
+	{
+		memset(Buffer->Data, 0, (size_t)Size);
+	}
 
-								// 圧縮データに鍵を適用して書き出す
-								WriteSize = (File.HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-								KeyConvFileWrite(HuffData, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-							}
-							else
-							{
-								// ハフマン圧縮用のメモリ領域を確保
-								HuffData = (u8 *)calloc(1, HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
+	return (u8 *)Buffer->Data;
+}
 
-								// ファイルの前後をハフマン圧縮
-								memcpy(HuffData, DestBuf, HuffmanEncodeKB * 1024);
-								memcpy(HuffData + HuffmanEncodeKB * 1024, (u8 *)DestBuf + DestSize - HuffmanEncodeKB * 1024, HuffmanEncodeKB * 1024);
-								File.HuffPressDataSize = Huffman_Encode(HuffData, HuffmanEncodeKB * 1024 * 2, HuffData + HuffmanEncodeKB * 1024 * 2);
+// 指定のサイズより大きい作業バッファを解放する
+void DXArchive::ReleaseEncodeWork(ENCODEWORK *Work, u64 KeepSize)
+{
+	ENCODEBUFFER *Buffers[] = { &Work->Buffer, &Work->HuffBuffer };
 
-								// ハフマン圧縮した部分を書き出す
-								KeyConvFileWrite(HuffData + HuffmanEncodeKB * 1024 * 2, File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
+	for (ENCODEBUFFER *Buffer : Buffers)
+	{
+		if (Buffer->Size > KeepSize)
+		{
+			free(Buffer->Data);
+			Buffer->Data = NULL;
+			Buffer->Size = 0;
+		}
+	}
+}
 
-								// ハフマン圧縮していない箇所を書き出す
-								WriteSize = File.HuffPressDataSize + DestSize - HuffmanEncodeKB * 1024 * 2;
-								WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-								KeyConvFileWrite((u8 *)DestBuf + HuffmanEncodeKB * 1024, WriteSize - File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize + File.HuffPressDataSize);
-							}
+// ファイルを書き出す一覧に追加する
+void DXArchive::AddEncodeTask(std::vector<ENCODETASK> *Tasks, const TCHAR *FilePath, const TCHAR *FileName, u64 FileHeadAddress, u64 DataSize)
+{
+	ENCODETASK &Task = Tasks->emplace_back();
+
+	// The encoder threads can not use the current directory which DirectoryEncode changes, so the full path is kept
+	Task.FilePath.resize(GetFullPathName(FilePath, 0, NULL, NULL));
+	Task.FilePath.resize(GetFullPathName(FilePath, (DWORD)Task.FilePath.size(), Task.FilePath.data(), NULL));
+
+	Task.FileName          = FileName;
+	Task.FileHeadAddress   = FileHeadAddress;
+	Task.DataSize          = DataSize;
+	Task.PressDataSize     = 0xffffffffffffffff;
+	Task.HuffPressDataSize = 0xffffffffffffffff;
+	Task.Stream            = false;
+	Task.Ready             = false;
+	Task.Result            = 0;
+}
 
-							// メモリの解放
-							free(HuffData);
-						}
-						else
-						{
-							// 圧縮データを反転して書き出す
-							WriteSize = (DestSize + 3) / 4 * 4;
-							KeyConvFileWrite(DestBuf, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-						}
+// 圧縮したデータに鍵を適用して書き出すデータに追加する( KeyConvFileWrite と同じ結果になる )
+void DXArchive::AppendEncodeData(ENCODETASK *Task, const void *Data, u64 Size, bool NoKey, s64 Position)
+{
+	const size_t Offset = Task->Data.size();
 
-						// メモリの解放
-						free(SrcBuf);
-					}
-					else
-					{
-					NOPRESS:
-						// ハフマン圧縮も行うかどうかで処理を分岐
-						if (Press && Huffman)
-						{
-							u8 *SrcBuf, *HuffData;
+	Task->Data.insert(Task->Data.end(), (const u8 *)Data, (const u8 *)Data + Size);
 
-							// データが丸ごと入るメモリ領域の確保
-							SrcBuf = (u8 *)calloc(1, (size_t)(FileSize + 32));
+	if (NoKey == false)
+	{
+		KeyConv(Task->Data.data() + Offset, Size, Position, Task->Key);
+	}
+}
 
-							// ファイルを丸ごと読み込む
-							fread64(SrcBuf, FileSize, SrcP);
+// ファイルのデータを圧縮して鍵を適用する( 各スレッドで実行 )
+// Only the task and read-only data are used, so any number of files can be encoded at the same time
+int DXArchive::EncodeFileData(ENCODETASK *Task, const ENCODEPARAM *Param, ENCODEWORK *Work)
+{
+	FILE *SrcP;
+	u64 FileSize, WriteSize;
+	bool Huffman     = false;
+	bool AlwaysPress = false;
 
-							// ハフマン圧縮するサイズによって処理を分岐
-							if (HuffmanEncodeKB == 0xff || FileSize <= HuffmanEncodeKB * 1024 * 2)
-							{
-								// ハフマン圧縮用のメモリ領域を確保
-								HuffData = (u8 *)calloc(1, (size_t)(FileSize * 2 + 256 * 2 + 32));
+	// 空のファイルは書き出すデータが無い
+	if (Task->DataSize == 0)
+	{
+		return 0;
+	}
 
-								// ファイル全体をハフマン圧縮
-								File.HuffPressDataSize = Huffman_Encode(SrcBuf, FileSize, HuffData);
+	// ファイルを開く
+	SrcP = _tfopen(Task->FilePath.c_str(), TEXT("rb"));
+	if (SrcP == NULL) return -1;
+
+	// サイズを得る
+	_fseeki64(SrcP, 0, SEEK_END);
+	FileSize = _ftelli64(SrcP);
+	_fseeki64(SrcP, 0, SEEK_SET);
+
+	// 圧縮の対象となるファイルフォーマットか調べる
+	{
+		u32 Len;
+		Len = (u32)_tcslen(Task->FileName.c_str());
+		if (Len > 4)
+		{
+			const TCHAR *sp;
+
+			sp = &Task->FileName.c_str()[Len - 3];
+			if (StrICmp(sp, TEXT("wav")) == 0 ||
+				StrICmp(sp, TEXT("jpg")) == 0 ||
+				StrICmp(sp, TEXT("png")) == 0 ||
+				StrICmp(sp, TEXT("mpg")) == 0 ||
+				StrICmp(sp, TEXT("mp3")) == 0 ||
+				StrICmp(sp, TEXT("mp4")) == 0 ||
+				StrICmp(sp, TEXT("m4a")) == 0 ||
+				StrICmp(sp, TEXT("ogg")) == 0 ||
+				StrICmp(sp, TEXT("ogv")) == 0 ||
+				StrICmp(sp, TEXT("ops")) == 0 ||
+				StrICmp(sp, TEXT("wmv")) == 0 ||
+				StrICmp(sp, TEXT("tif")) == 0 ||
+				StrICmp(sp, TEXT("tga")) == 0 ||
+				StrICmp(sp, TEXT("bmp")) == 0 ||
+				StrICmp(sp - 1, TEXT("jpeg")) == 0)
+			{
+				Huffman = true;
+			}
 
-								// 圧縮データに鍵を適用して書き出す
-								WriteSize = (File.HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-								KeyConvFileWrite(HuffData, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-							}
-							else
-							{
-								// ハフマン圧縮用のメモリ領域を確保
-								HuffData = (u8 *)calloc(1, HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
+			// wav や bmp の場合は必ず圧縮する
+			if (StrICmp(sp, TEXT("wav")) == 0 ||
+				StrICmp(sp, TEXT("tga")) == 0 ||
+				StrICmp(sp, TEXT("bmp")) == 0)
+			{
+				AlwaysPress = true;
+			}
+		}
+	}
 
-								// ファイルの前後をハフマン圧縮
-								memcpy(HuffData, SrcBuf, HuffmanEncodeKB * 1024);
-								memcpy(HuffData + HuffmanEncodeKB * 1024, SrcBuf + FileSize - HuffmanEncodeKB * 1024, HuffmanEncodeKB * 1024);
-								File.HuffPressDataSize = Huffman_Encode(HuffData, HuffmanEncodeKB * 1024 * 2, HuffData + HuffmanEncodeKB * 1024 * 2);
+	// AlwaysHuffman が true の場合は必ずハフマン圧縮する
+	if (Param->AlwaysHuffman)
+	{
+		Huffman = true;
+	}
 
-								// ハフマン圧縮した部分を書き出す
-								KeyConvFileWrite(HuffData + HuffmanEncodeKB * 1024 * 2, File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
+	// ハフマン圧縮するサイズが 0 の場合はハフマン圧縮を行わない
+	if (Param->HuffmanEncodeKB == 0)
+	{
+		Huffman = false;
+	}
 
-								// ハフマン圧縮していない箇所を書き出す
-								WriteSize = File.HuffPressDataSize + FileSize - HuffmanEncodeKB * 1024 * 2;
-								WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-								KeyConvFileWrite(SrcBuf + HuffmanEncodeKB * 1024, WriteSize - File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize + File.HuffPressDataSize);
-							}
+	// 圧縮の指定がある場合で、
+	// 必ず圧縮するファイルフォーマットか、ファイルサイズが 10MB 以下の場合は圧縮を試みる
+	if (Param->Press == true && (AlwaysPress || Task->DataSize < 10 * 1024 * 1024))
+	{
+		void *SrcBuf, *DestBuf;
+		u32 DestSize, Len;
 
-							// メモリの解放
-							free(SrcBuf);
-							free(HuffData);
-						}
-						else
-						{
-							// 転送開始
-							WriteSize = 0;
-							while (WriteSize < FileSize)
-							{
-								// 転送サイズ決定
-								MoveSize = DXA_BUFFERSIZE < FileSize - WriteSize ? DXA_BUFFERSIZE : FileSize - WriteSize;
-								MoveSize = (MoveSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+		// 一部のファイル形式の場合は予め弾く
+		if (AlwaysPress == false && (Len = (int)_tcslen(Task->FileName.c_str())) > 4)
+		{
+			const TCHAR *sp;
 
-								// ファイルの鍵適用読み込み
-								memset(TempBuffer, 0, (size_t)MoveSize);
-								KeyConvFileRead(TempBuffer, MoveSize, SrcP, NoKey ? NULL : lKey, File.DataSize + WriteSize);
+			sp = &Task->FileName.c_str()[Len - 3];
+			if (StrICmp(sp, TEXT("wav")) == 0 ||
+				StrICmp(sp, TEXT("jpg")) == 0 ||
+				StrICmp(sp, TEXT("png")) == 0 ||
+				StrICmp(sp, TEXT("mpg")) == 0 ||
+				StrICmp(sp, TEXT("mp3")) == 0 ||
+				StrICmp(sp, TEXT("mp4")) == 0 ||
+				StrICmp(sp, TEXT("ogg")) == 0 ||
+				StrICmp(sp, TEXT("ogv")) == 0 ||
+				StrICmp(sp, TEXT("ops")) == 0 ||
+				StrICmp(sp, TEXT("wmv")) == 0 ||
+				StrICmp(sp - 1, TEXT("jpeg")) == 0) goto NOPRESS;
+		}
 
-								// 書き出し
-								fwrite64(TempBuffer, MoveSize, DestFp);
+		// データが丸ごと入るメモリ領域の確保
+		SrcBuf  = GetEncodeWorkBuffer(&Work->Buffer, FileSize + FileSize * 2 + 64);
+		DestBuf = (u8 *)SrcBuf + FileSize;
 
-								// 書き出しサイズの加算
-								WriteSize += MoveSize;
-							}
-						}
-					}
+		// ファイルを丸ごと読み込む
+		fread64(SrcBuf, FileSize, SrcP);
 
-					// 書き出したファイルを閉じる
-					fclose(SrcP);
+		// 圧縮
+		DestSize = Encode(SrcBuf, (u32)FileSize, DestBuf, false, Param->MaxPress, Param->PressLevel);
 
-					// データサイズの加算
-					Size->DataSize += WriteSize;
-				}
+		// 殆ど圧縮出来なかった場合は圧縮無しでアーカイブする
+		if (AlwaysPress == false && ((f64)DestSize / (f64)FileSize > 0.90))
+		{
+			_fseeki64(SrcP, 0L, SEEK_SET);
+			goto NOPRESS;
+		}
 
-				// ファイルヘッダを書き出す
-				memcpy(FileP + Dir.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, &File, sizeof(DARC_FILEHEAD));
-			}
+		// 圧縮データのサイズを保存する
+		Task->PressDataSize = DestSize;
 
-			i++;
-		} while (FindNextFile(FindHandle, &FindData) != 0);
+		// ハフマン圧縮も行うかどうかで処理を分岐
+		if (Huffman)
+		{
+			u8 *HuffData;
 
-		// Find ハンドルを閉じる
-		FindClose(FindHandle);
-	}
+			// ハフマン圧縮するサイズによって処理を分岐
+			if (Param->HuffmanEncodeKB == 0xff || DestSize <= (u64)(Param->HuffmanEncodeKB * 1024 * 2))
+			{
+				// ハフマン圧縮用のメモリ領域を確保
+				HuffData = GetEncodeWorkBuffer(&Work->HuffBuffer, DestSize * 2 + 256 * 2 + 32);
 
-	// もとのディレクトリをカレントディレクトリにセット
-	SetCurrentDirectory(DirPath);
+				// ファイル全体をハフマン圧縮
+				Task->HuffPressDataSize = Huffman_Encode(DestBuf, DestSize, HuffData);
 
-	// 終了
-	return 0;
-}
+				// 圧縮データに鍵を適用して書き出す
+				WriteSize = (Task->HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+				AppendEncodeData(Task, HuffData, WriteSize, Param->NoKey, Task->DataSize);
+			}
+			else
+			{
+				// ハフマン圧縮用のメモリ領域を確保
+				HuffData = GetEncodeWorkBuffer(&Work->HuffBuffer, Param->HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
 
-// 指定のディレクトリデータにあるファイルを展開する
-int DXArchive::DirectoryDecode(u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD *Head, DARC_DIRECTORY *Dir, FILE *ArcP, unsigned char *Key, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer)
-{
-	TCHAR DirPath[MAX_PATH];
+				// ファイルの前後をハフマン圧縮
+				memcpy(HuffData, DestBuf, Param->HuffmanEncodeKB * 1024);
+				memcpy(HuffData + Param->HuffmanEncodeKB * 1024, (u8 *)DestBuf + DestSize - Param->HuffmanEncodeKB * 1024, Param->HuffmanEncodeKB * 1024);
+				Task->HuffPressDataSize = Huffman_Encode(HuffData, Param->HuffmanEncodeKB * 1024 * 2, HuffData + Param->HuffmanEncodeKB * 1024 * 2);
 
-	// 現在のカレントディレクトリを保存
-	GetCurrentDirectory(MAX_PATH, DirPath);
+				// ハフマン圧縮した部分を書き出す
+				AppendEncodeData(Task, HuffData + Param->HuffmanEncodeKB * 1024 * 2, Task->HuffPressDataSize, Param->NoKey, Task->DataSize);
 
-	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
-	if (Dir->DirectoryAddress != 0xffffffffffffffff && Dir->ParentDirectoryAddress != 0xffffffffffffffff)
+				// ハフマン圧縮していない箇所を書き出す
+				WriteSize = Task->HuffPressDataSize + DestSize - Param->HuffmanEncodeKB * 1024 * 2;
+				WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+				AppendEncodeData(Task, (u8 *)DestBuf + Param->HuffmanEncodeKB * 1024, WriteSize - Task->HuffPressDataSize, Param->NoKey, Task->DataSize + Task->HuffPressDataSize);
+			}
+		}
+		else
+		{
+			// 圧縮データを反転して書き出す
+			WriteSize = (DestSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+			AppendEncodeData(Task, DestBuf, WriteSize, Param->NoKey, Task->DataSize);
+		}
+	}
+	else
 	{
-		DARC_FILEHEAD *DirFile;
+	NOPRESS:
+		// ハフマン圧縮も行うかどうかで処理を分岐
+		if (Param->Press && Huffman)
+		{
+			u8 *SrcBuf, *HuffData;
 
-		// DARC_FILEHEAD のアドレスを取得
-		DirFile = (DARC_FILEHEAD *)(FileP + Dir->DirectoryAddress);
+			// データが丸ごと入るメモリ領域の確保
+			SrcBuf = GetEncodeWorkBuffer(&Work->Buffer, FileSize + 32);
 
-		// ディレクトリの作成
-		TCHAR *pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		CreateDirectory(pName, NULL);
-		delete[] pName;
+			// ファイルを丸ごと読み込む
+			fread64(SrcBuf, FileSize, SrcP);
 
-		// そのディレクトリにカレントディレクトリを移す
-		pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		SetCurrentDirectory(pName);
-		delete[] pName;
-	}
+			// ハフマン圧縮するサイズによって処理を分岐
+			if (Param->HuffmanEncodeKB == 0xff || FileSize <= Param->HuffmanEncodeKB * 1024 * 2)
+			{
+				// ハフマン圧縮用のメモリ領域を確保
+				HuffData = GetEncodeWorkBuffer(&Work->HuffBuffer, FileSize * 2 + 256 * 2 + 32);
 
-	// 展開処理開始
-	{
-		u32 i, FileHeadSize;
-		DARC_FILEHEAD *File;
-		size_t KeyStringBufferBytes;
-		unsigned char lKey[DXA_KEY_BYTES];
+				// ファイル全体をハフマン圧縮
+				Task->HuffPressDataSize = Huffman_Encode(SrcBuf, FileSize, HuffData);
 
-		// 格納されているファイルの数だけ繰り返す
-		FileHeadSize = sizeof(DARC_FILEHEAD);
-		File         = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
-		for (i = 0; i < Dir->FileHeadNum; i++, File = (DARC_FILEHEAD *)((u8 *)File + FileHeadSize))
-		{
-			// ディレクトリかどうかで処理を分岐
-			if (File->Attributes & FILE_ATTRIBUTE_DIRECTORY)
-			{
-				// ディレクトリの場合は再帰をかける
-				DirectoryDecode(NameP, DirP, FileP, Head, (DARC_DIRECTORY *)(DirP + File->DataAddress), ArcP, Key, KeyString, KeyStringBytes, NoKey, KeyStringBuffer);
+				// 圧縮データに鍵を適用して書き出す
+				WriteSize = (Task->HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+				AppendEncodeData(Task, HuffData, WriteSize, Param->NoKey, Task->DataSize);
 			}
 			else
 			{
-				FILE *DestP;
-				void *Buffer;
+				// ハフマン圧縮用のメモリ領域を確保
+				HuffData = GetEncodeWorkBuffer(&Work->HuffBuffer, Param->HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
 
-				// ファイルの場合は展開する
+				// ファイルの前後をハフマン圧縮
+				memcpy(HuffData, SrcBuf, Param->HuffmanEncodeKB * 1024);
+				memcpy(HuffData + Param->HuffmanEncodeKB * 1024, SrcBuf + FileSize - Param->HuffmanEncodeKB * 1024, Param->HuffmanEncodeKB * 1024);
+				Task->HuffPressDataSize = Huffman_Encode(HuffData, Param->HuffmanEncodeKB * 1024 * 2, HuffData + Param->HuffmanEncodeKB * 1024 * 2);
 
-				// バッファを確保する
-				Buffer = malloc(DXA_BUFFERSIZE);
-				if (Buffer == NULL) return -1;
+				// ハフマン圧縮した部分を書き出す
+				AppendEncodeData(Task, HuffData + Param->HuffmanEncodeKB * 1024 * 2, Task->HuffPressDataSize, Param->NoKey, Task->DataSize);
 
-				// ファイルを開く
-				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
+				// ハフマン圧縮していない箇所を書き出す
+				WriteSize = Task->HuffPressDataSize + FileSize - Param->HuffmanEncodeKB * 1024 * 2;
+				WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
+				AppendEncodeData(Task, SrcBuf + Param->HuffmanEncodeKB * 1024, WriteSize - Task->HuffPressDataSize, Param->NoKey, Task->DataSize + Task->HuffPressDataSize);
+			}
+		}
+		else
+		{
+			// 圧縮しない場合は書き出す時に元のファイルから転送する
+			Task->Stream = true;
+		}
+	}
 
-				DestP = _tfopen(pName, TEXT("wb"));
-				// ファイル個別の鍵を作成
-				if (NoKey == false)
-				{
-					KeyStringBufferBytes = CreateKeyFileString((int)Head->CharCodeFormat, KeyString, KeyStringBytes, Dir, File, FileP, DirP, NameP, (BYTE *)KeyStringBuffer);
-					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
-				}
+	// ファイルを閉じる
+	fclose(SrcP);
 
-				delete[] pName;
+	return 0;
+}
 
-				// データがある場合のみ転送
-				if (File->DataSize != 0)
-				{
-					void *temp;
+// 一覧のファイルを複数のスレッドで圧縮しながら順番に書き出す
+// The threads compress at most two files per thread ahead of the writer, so only those are kept in memory.
+// The data is written and the data addresses are assigned in the order of the list, which is the order
+// the single threaded encoder wrote the files in, so the archive does not depend on the number of threads
+int DXArchive::WriteEncodeTasks(std::vector<ENCODETASK> &Tasks, int ThreadNum, const ENCODEPARAM *Param, FILE *DestFp, u8 *FileP, SIZESAVE *Size, DARC_ENCODEINFO *EncodeInfo)
+{
+	std::vector<u8> CopyBuffer; // 圧縮しないファイルの転送用バッファ、転送するファイルがある場合だけ確保する
+	ENCODEWORK Work;            // スレッドが一つの場合の作業バッファ
+	std::mutex Mutex;
+	std::condition_variable Cond;
+	std::vector<std::thread> Threads;
+	const size_t MaxAhead = (size_t)ThreadNum * 2;
+	size_t NextTask       = 0; // 次に圧縮するファイルの番号
+	size_t WrittenNum     = 0; // 書き出したファイルの数
+	bool Abort            = false;
+	int Result            = 0;
 
-					// 初期位置をセットする
-					if (_ftelli64(ArcP) != (s32)(Head->DataStartAddress + File->DataAddress))
-						_fseeki64(ArcP, Head->DataStartAddress + File->DataAddress, SEEK_SET);
+	// 作業バッファはスレッド毎に使い回す、大きなファイルで大きくなった場合は次のファイルまで持ち越さない
+	auto EncodeTask = [Param](ENCODETASK *Task, ENCODEWORK *Work) {
+		int TaskResult;
 
-					// データが圧縮されているかどうかで処理を分岐
-					if (File->PressDataSize != 0xffffffffffffffff)
-					{
-						// 圧縮されている場合
+		try
+		{
+			TaskResult = EncodeFileData(Task, Param, Work);
+		}
+		catch (const std::bad_alloc &)
+		{
+			TaskResult = -1;
+		}
 
-						// ハフマン圧縮もされているかどうかで処理を分岐
-						if (File->HuffPressDataSize != 0xffffffffffffffff)
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->PressDataSize + File->HuffPressDataSize + File->DataSize));
+		ReleaseEncodeWork(Work, ENCODE_WORK_KEEP_SIZE);
 
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->HuffPressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
+		return TaskResult;
+	};
 
-							// ハフマン圧縮を解凍
-							Huffman_Decode(temp, (u8 *)temp + File->HuffPressDataSize);
+	auto Worker = [&]() {
+		ENCODEWORK Work;
+		std::unique_lock<std::mutex> Lock(Mutex);
 
-							// ファイルの前後をハフマン圧縮している場合は処理を分岐
-							if (Head->HuffmanEncodeKB != 0xff && File->PressDataSize > Head->HuffmanEncodeKB * 1024 * 2)
-							{
-								// 解凍したデータの内、後ろ半分を移動する
-								memmove(
-									(u8 *)temp + File->HuffPressDataSize + File->PressDataSize - Head->HuffmanEncodeKB * 1024,
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									Head->HuffmanEncodeKB * 1024);
-
-								// 残りのLZ圧縮データを読み込む
-								KeyConvFileRead(
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									File->PressDataSize - Head->HuffmanEncodeKB * 1024 * 2,
-									ArcP, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize);
-							}
+		memset(&Work, 0, sizeof(Work));
 
-							// 解凍
-							Decode((u8 *)temp + File->HuffPressDataSize, (u8 *)temp + File->HuffPressDataSize + File->PressDataSize);
+		while (true)
+		{
+			// 書き出しより先に進み過ぎないように待つ
+			Cond.wait(Lock, [&]() { return Abort || NextTask >= Tasks.size() || NextTask < WrittenNum + MaxAhead; });
+			if (Abort || NextTask >= Tasks.size()) break;
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->HuffPressDataSize + File->PressDataSize, File->DataSize, DestP);
+			ENCODETASK *Task = &Tasks[NextTask++];
+			Lock.unlock();
 
-							// メモリの解放
-							free(temp);
-						}
-						else
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->PressDataSize + File->DataSize));
+			const int TaskResult = EncodeTask(Task, &Work);
 
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->PressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
+			Lock.lock();
+			Task->Result = TaskResult;
+			Task->Ready  = true;
+			Cond.notify_all();
+		}
 
-							// 解凍
-							Decode(temp, (u8 *)temp + File->PressDataSize);
+		// 作業バッファの解放
+		ReleaseEncodeWork(&Work, 0);
+	};
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->PressDataSize, File->DataSize, DestP);
+	memset(&Work, 0, sizeof(Work));
 
-							// メモリの解放
-							free(temp);
-						}
-					}
-					else
-					{
-						// 圧縮されていない場合
-
-						// ハフマン圧縮はされているかどうかで処理を分岐
-						if (File->HuffPressDataSize != 0xffffffffffffffff)
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->HuffPressDataSize + File->DataSize));
-
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->HuffPressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
+	// スレッドが一つの場合は書き出す前にその場で圧縮する
+	if (ThreadNum > 1)
+	{
+		for (int i = 0; i < ThreadNum; i++)
+			Threads.emplace_back(Worker);
+	}
 
-							// ハフマン圧縮を解凍
-							Huffman_Decode(temp, (u8 *)temp + File->HuffPressDataSize);
+	for (ENCODETASK &Task : Tasks)
+	{
+		DARC_FILEHEAD *File = (DARC_FILEHEAD *)(FileP + Task.FileHeadAddress);
+		u64 WriteSize       = 0;
 
-							// ファイルの前後のみハフマン圧縮している場合は処理を分岐
-							if (Head->HuffmanEncodeKB != 0xff && File->DataSize > Head->HuffmanEncodeKB * 1024 * 2)
-							{
-								// 解凍したデータの内、後ろ半分を移動する
-								memmove(
-									(u8 *)temp + File->HuffPressDataSize + File->DataSize - Head->HuffmanEncodeKB * 1024,
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									Head->HuffmanEncodeKB * 1024);
-
-								// 残りのデータを読み込む
-								KeyConvFileRead(
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									File->DataSize - Head->HuffmanEncodeKB * 1024 * 2,
-									ArcP, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize);
-							}
+		// 圧縮が終わるのを待つ
+		if (Threads.empty())
+		{
+			Task.Result = EncodeTask(&Task, &Work);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			Cond.wait(Lock, [&]() { return Task.Ready; });
+		}
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->HuffPressDataSize, File->DataSize, DestP);
+		if (Task.Result < 0)
+		{
+			Result = -1;
+			break;
+		}
 
-							// メモリの解放
-							free(temp);
-						}
-						else
-						{
-							u64 MoveSize, WriteSize;
+		// 進行状況出力
+		if (EncodeInfo->OutputStatus)
+		{
+			// 処理ファイル名をセット
+			wcscpy(EncodeInfo->ProcessFileName, Task.FileName.c_str());
 
-							// 転送処理開始
-							WriteSize = 0;
-							while (WriteSize < File->DataSize)
-							{
-								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE ? DXA_BUFFERSIZE : File->DataSize - WriteSize;
+			// ファイル数を増やす
+			EncodeInfo->CompFileNum++;
 
-								// ファイルの反転読み込み
-								KeyConvFileRead(Buffer, MoveSize, ArcP, NoKey ? NULL : lKey, File->DataSize + WriteSize);
+			// 表示
+			EncodeStatusOutput(EncodeInfo);
+		}
 
-								// 書き出し
-								fwrite64(Buffer, MoveSize, DestP);
+		// 圧縮の結果をファイルヘッダにセットする
+		File->DataAddress       = Size->DataSize;
+		File->PressDataSize     = Task.PressDataSize;
+		File->HuffPressDataSize = Task.HuffPressDataSize;
 
-								WriteSize += MoveSize;
-							}
-						}
-					}
-				}
+		// ファイルデータを書き出す
+		if (Task.Stream)
+		{
+			FILE *SrcP;
+			u64 FileSize, MoveSize;
 
-				// ファイルを閉じる
-				fclose(DestP);
+			// ファイルを開く
+			SrcP = _tfopen(Task.FilePath.c_str(), TEXT("rb"));
+			if (SrcP == NULL)
+			{
+				Result = -1;
+				break;
+			}
 
-				// バッファを開放する
-				free(Buffer);
+			// サイズを得る
+			_fseeki64(SrcP, 0, SEEK_END);
+			FileSize = _ftelli64(SrcP);
+			_fseeki64(SrcP, 0, SEEK_SET);
 
-				//////////////////////////////
-				///// Remove Unpack Protection
-				if (isV35(g_cryptVersion))
+			// 転送用バッファの確保( 今までに転送したファイルより大きい場合だけ、最大 DXA_BUFFERSIZE まで拡張する )
+			MoveSize = DXA_BUFFERSIZE < FileSize ? DXA_BUFFERSIZE : (FileSize + 3) / 4 * 4;
+			if (CopyBuffer.size() < MoveSize)
+			{
+				try
 				{
-					const std::vector<std::wstring> UNPACK_PROTECTION_FILES = { L"game.dat", L"cdatabase.dat", L"database.dat", L"commonevent.dat" };
-					const uint8_t ANTI_UNPACK_DATA[62]                      = { 0x45, 0x78, 0x74, 0x72, 0x61, 0x63, 0x74, 0x69, 0x6E, 0x67, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x72, 0x6F, 0x6D, 0x20, 0x65, 0x6E, 0x63, 0x72, 0x79, 0x70, 0x74, 0x65, 0x64, 0x20, 0x66, 0x69, 0x6C, 0x65, 0x73, 0x20, 0x76, 0x69, 0x6F, 0x6C, 0x61, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x75, 0x69, 0x64, 0x65, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x00 };
-					const uint32_t ANTI_UNPACK_DATA_SIZE                    = 62;
-
-					pName = GetOriginalFileName(NameP + File->NameAddress);
-
-					std::wstring fileName = std::wstring(pName);
-					std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-
-					// As I am not sure if the file name will contain only the actual file name or also a directory
-					// check if the file name ends with any of the unpack protection files
-					bool isUnpackProtectionFile = false;
-
-					for (const std::wstring &unpackProtectionFile : UNPACK_PROTECTION_FILES)
-					{
-						if (fileName.ends_with(unpackProtectionFile))
-						{
-							isUnpackProtectionFile = true;
-							break;
-						}
-					}
-
-					if (isUnpackProtectionFile)
-					{
-						DestP = _tfopen(pName, TEXT("rb"));
-
-						// Get the file size
-						_fseeki64(DestP, 0, SEEK_END);
-						int64_t fileSize = _ftelli64(DestP);
-
-						if (fileSize >= ANTI_UNPACK_DATA_SIZE)
-						{
-							// Check if the file begins with the anti-unpack data
-							_fseeki64(DestP, 0, SEEK_SET);
-
-							void *pFileBeginning = malloc(ANTI_UNPACK_DATA_SIZE);
-							fread64(pFileBeginning, ANTI_UNPACK_DATA_SIZE, DestP);
-
-							if (pFileBeginning && std::memcmp(pFileBeginning, ANTI_UNPACK_DATA, ANTI_UNPACK_DATA_SIZE) == 0)
-							{
-								fileSize -= ANTI_UNPACK_DATA_SIZE;
-
-								// Remove the first 62 bytes from the file
-								_fseeki64(DestP, ANTI_UNPACK_DATA_SIZE, SEEK_SET);
-
-								std::vector<uint8_t> buffer(fileSize);
-								fread64(buffer.data(), fileSize, DestP);
-								fclose(DestP);
+					// 今の内容は要らないので、解放してから確保し直す
+					std::vector<u8>().swap(CopyBuffer);
+					CopyBuffer.resize((size_t)MoveSize);
+				}
+				catch (const std::bad_alloc &)
+				{
+					fclose(SrcP);
+					Result = -1;
+					break;
+				}
+			}
 
-								DestP = _tfopen(pName, TEXT("wb"));
+			// 転送開始
+			while (WriteSize < FileSize)
+			{
+				// 転送サイズ決定
+				MoveSize = DXA_BUFFERSIZE < FileSize - WriteSize ? DXA_BUFFERSIZE : FileSize - WriteSize;
+				MoveSize = (MoveSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
 
-								fwrite64(buffer.data(), fileSize, DestP);
-							}
+				// ファイルの鍵適用読み込み
+				memset(CopyBuffer.data(), 0, (size_t)MoveSize);
+				KeyConvFileRead(CopyBuffer.data(), MoveSize, SrcP, Param->NoKey ? NULL : Task.Key, Task.DataSize + WriteSize);
 
-							free(pFileBeginning);
-						}
+				// 書き出し
+				fwrite64(CopyBuffer.data(), MoveSize, DestFp);
 
-						fclose(DestP);
-					}
+				// 書き出しサイズの加算
+				WriteSize += MoveSize;
+			}
 
-					delete[] pName;
-				}
+			// ファイルを閉じる
+			fclose(SrcP);
+		}
+		else if (Task.Data.empty() == false)
+		{
+			WriteSize = Task.Data.size();
+			fwrite64(Task.Data.data(), WriteSize, DestFp);
+		}
 
-				///// Remove Unpack Protection
-				//////////////////////////////
+		// データサイズの加算
+		Size->DataSize += WriteSize;
 
-				// ファイルのタイムスタンプを設定する
-				{
-					HANDLE HFile;
-					FILETIME CreateTime, LastAccessTime, LastWriteTime;
-					TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-					HFile        = CreateFile(pName,
-											  GENERIC_WRITE, 0, NULL,
-											  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-					delete[] pName;
-
-					if (HFile == INVALID_HANDLE_VALUE)
-					{
-						HFile = HFile;
-					}
+		// 書き出したデータを解放して、次のファイルの圧縮を始められるようにする
+		std::vector<u8>().swap(Task.Data);
 
-					CreateTime.dwHighDateTime     = (u32)(File->Time.Create >> 32);
-					CreateTime.dwLowDateTime      = (u32)(File->Time.Create & 0xffffffffffffffff);
-					LastAccessTime.dwHighDateTime = (u32)(File->Time.LastAccess >> 32);
-					LastAccessTime.dwLowDateTime  = (u32)(File->Time.LastAccess & 0xffffffffffffffff);
-					LastWriteTime.dwHighDateTime  = (u32)(File->Time.LastWrite >> 32);
-					LastWriteTime.dwLowDateTime   = (u32)(File->Time.LastWrite & 0xffffffffffffffff);
-					SetFileTime(HFile, &CreateTime, &LastAccessTime, &LastWriteTime);
-					CloseHandle(HFile);
-				}
+		if (Threads.empty() == false)
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			WrittenNum++;
+			Cond.notify_all();
+		}
+	}
 
-				// ファイル属性を付ける
-				pName = GetOriginalFileName(NameP + File->NameAddress);
-				SetFileAttributes(pName, (u32)File->Attributes & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
-				delete[] pName;
-			}
+	// スレッドを終了させる
+	if (Threads.empty() == false)
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Abort = true;
+			Cond.notify_all();
 		}
+
+		for (std::thread &Thread : Threads)
+			Thread.join();
 	}
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(DirPath);
+	// 作業バッファの解放
+	ReleaseEncodeWork(&Work, 0);
 
-	// 終了
-	return 0;
+	return Result;
 }
 
 // ディレクトリ内のファイルパスを取得する
@@ -1519,7 +1568,7 @@ void DXArchive::AnalyseHuffmanEncode(u64 DataSize, u8 HuffmanEncodeKB, u64 *Head
 }
 
 // エンコード( 戻り値:圧縮後のサイズ  -1 はエラー  Dest に NULL を入れることも可能 )
-int DXArchive::Encode(void *Src, u32 SrcSize, void *Dest, bool OutStatus, bool MaxPress)
+int DXArchive::Encode(void *Src, u32 SrcSize, void *Dest, bool OutStatus, bool MaxPress, int Level)
 {
 	s32 dstsize;
 	s32 bonus, conbo, conbosize, address, addresssize;
@@ -1534,6 +1583,10 @@ int DXArchive::Encode(void *Src, u32 SrcSize, void *Dest, bool OutStatus, bool M
 	u8 *listfirsttable, *usesublistflagtable, *sublistbuf;
 	u32 searchlistnum;
 
+	// レベルが指定されている場合はハッシュチェーンで一致を探す
+	if (Level > 0)
+		return (int)lzEncoder::encode(Src, SrcSize, Dest, Level);
+
 	// 最大一致長を捜すためのリストを辿る最大数のセット
 	searchlistnum = MaxPress ? 0xffffffff : MAX_SEARCHLISTNUM;
 
@@ -1882,142 +1935,29 @@ int DXArchive::Encode(void *Src, u32 SrcSize, void *Dest, bool OutStatus, bool M
 }
 
 // デコード( 戻り値:解凍後のサイズ  -1 はエラー  Dest に NULL を入れることも可能 )
+// Dest には圧縮データに記録されている解凍後のサイズ分の領域が必要、壊れたデータの場合はその範囲内で処理を止めて -1 を返す
 int DXArchive::Decode(void *Src, void *Dest)
 {
-	u32 srcsize, destsize, code, indexsize, keycode, conbo, index = 0;
-	u8 *srcp, *destp, *dp, *sp;
-
-	destp = (u8 *)Dest;
-	srcp  = (u8 *)Src;
-
-	// 解凍後のデータサイズを得る
-	destsize = *((u32 *)&srcp[0]);
-
-	// 圧縮データのサイズを得る
-	srcsize = *((u32 *)&srcp[4]) - 9;
-
-	// キーコード
-	keycode = srcp[8];
-
 	// 出力先がない場合はサイズだけ返す
 	if (Dest == NULL)
-		return destsize;
-
-	// 展開開始
-	sp = srcp + 9;
-	dp = destp;
-	while (srcsize)
-	{
-		// キーコードか同かで処理を分岐
-		if (sp[0] != keycode)
-		{
-			// 非圧縮コードの場合はそのまま出力
-			*dp = *sp;
-			dp++;
-			sp++;
-			srcsize--;
-			continue;
-		}
-
-		// キーコードが連続していた場合はキーコード自体を出力
-		if (sp[1] == keycode)
-		{
-			*dp = (u8)keycode;
-			dp++;
-			sp += 2;
-			srcsize -= 2;
-
-			continue;
-		}
-
-		// 第一バイトを得る
-		code = sp[1];
-
-		// もしキーコードよりも大きな値だった場合はキーコード
-		// とのバッティング防止の為に＋１しているので－１する
-		if (code > keycode) code--;
-
-		sp += 2;
-		srcsize -= 2;
-
-		// 連続長を取得する
-		conbo = code >> 3;
-		if (code & (0x1 << 2))
-		{
-			conbo |= *sp << 5;
-			sp++;
-			srcsize--;
-		}
-		conbo += MIN_COMPRESS; // 保存時に減算した最小圧縮バイト数を足す
-
-		// 参照相対アドレスを取得する
-		indexsize = code & 0x3;
-		switch (indexsize)
-		{
-			case 0:
-				index = *sp;
-				sp++;
-				srcsize--;
-				break;
-
-			case 1:
-				index = *((u16 *)sp);
-				sp += 2;
-				srcsize -= 2;
-				break;
-
-			case 2:
-				index = *((u16 *)sp) | (sp[2] << 16);
-				sp += 3;
-				srcsize -= 3;
-				break;
-		}
-		index++; // 保存時に－１しているので＋１する
-
-		// 展開
-		if (index < conbo)
-		{
-			u32 num;
+		return *((u32 *)Src);
 
-			num = index;
-			while (conbo > num)
-			{
-				memcpy(dp, dp - num, num);
-				dp += num;
-				conbo -= num;
-				num += num;
-			}
-			if (conbo != 0)
-			{
-				memcpy(dp, dp - num, conbo);
-				dp += conbo;
-			}
-		}
-		else
-		{
-			memcpy(dp, dp - index, conbo);
-			dp += conbo;
-		}
-	}
-
-	// 解凍後のサイズを返す
-	return (int)destsize;
+	return lzDecoder::decode(Src, Dest);
 }
 
 // バイナリデータを元に CRC32 のハッシュ値を計算する
 u32 DXArchive::HashCRC32(const void *SrcData, size_t SrcDataSize)
 {
 	static DWORD CRC32Table[256];
-	static int CRC32TableInit = 0;
-	DWORD CRC                 = 0xffffffff;
-	BYTE *SrcByte             = (BYTE *)SrcData;
+	DWORD CRC     = 0xffffffff;
+	BYTE *SrcByte = (BYTE *)SrcData;
 	DWORD i;
 
 	// テーブルが初期化されていなかったら初期化する
-	if (CRC32TableInit == 0)
-	{
+	// (static initialization so the table is set up exactly once even if several decoders run in parallel)
+	static const int CRC32TableInit = []() {
 		DWORD Magic = 0xedb88320; // 0x4c11db7 をビットレベルで順番を逆にしたものが 0xedb88320
-		DWORD j;
+		DWORD i, j;
 
 		for (i = 0; i < 256; i++)
 		{
@@ -2035,8 +1975,9 @@ u32 DXArchive::HashCRC32(const void *SrcData, size_t SrcDataSize)
 		}
 
 		// テーブルを初期化したフラグを立てる
-		CRC32TableInit = 1;
-	}
+		return 1;
+	}();
+	(void)CRC32TableInit;
 
 	for (i = 0; i < SrcDataSize; i++)
 	{
@@ -2048,11 +1989,12 @@ u32 DXArchive::HashCRC32(const void *SrcData, size_t SrcDataSize)
 
 int DXArchive::EncodeArchiveOneDirectoryWolf(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press, const char *KeyString_, uint16_t cryptVersion)
 {
-	return EncodeArchiveOneDirectory(OutputFileName, DirectoryPath, Press, true, 0xC, KeyString_, false, false, false, cryptVersion);
+	// ハッシュチェーン検索の方が速く、圧縮率も同じか高いので標準のレベルで圧縮する
+	return EncodeArchiveOneDirectory(OutputFileName, DirectoryPath, Press, true, 0xC, KeyString_, false, false, false, cryptVersion, 0, lzEncoder::LEVEL_DEFAULT);
 }
 
 // アーカイブファイルを作成する(ディレクトリ一個だけ)
-int DXArchive::EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString_, bool NoKey, bool OutputStatus, bool MaxPress, uint16_t cryptVersion)
+int DXArchive::EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString_, bool NoKey, bool OutputStatus, bool MaxPress, uint16_t cryptVersion, int ThreadNum, int PressLevel)
 {
 	int FileNum, Result;
 	// TCHAR **FilePathList, *NameBuffer ;
@@ -2075,7 +2017,7 @@ int DXArchive::EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHA
 	//	FilePathList[i] = NameBuffer + i * 256 ;
 
 	// エンコード
-	Result = EncodeArchive(OutputFileName, filePathList, FileNum, Press, AlwaysHuffman, HuffmanEncodeKB, KeyString_, NoKey, OutputStatus, MaxPress, cryptVersion);
+	Result = EncodeArchive(OutputFileName, filePathList, FileNum, Press, AlwaysHuffman, HuffmanEncodeKB, KeyString_, NoKey, OutputStatus, MaxPress, cryptVersion, ThreadNum, PressLevel);
 
 	// 確保したメモリの解放
 	// free( NameBuffer ) ;
@@ -2085,55 +2027,32 @@ int DXArchive::EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHA
 }
 
 // アーカイブファイルを作成する
-int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std::wstring> &FileOrDirectoryPath, int FileNum, bool Press, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString_, bool NoKey, bool OutputStatus, bool MaxPress, uint16_t cryptVersion)
+int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std::wstring> &FileOrDirectoryPath, int FileNum, bool Press, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString_, bool NoKey, bool OutputStatus, bool MaxPress, uint16_t cryptVersion, int ThreadNum, int PressLevel)
 {
 	DARC_HEAD Head;
-	DARC_DIRECTORY Directory, *DirectoryP;
+	DARC_DIRECTORY Directory;
 	u64 HeaderHuffDataSize;
-	SIZESAVE SizeSave;
+	SIZESAVE SizeSave, TableSize;
 	FILE *DestFp;
-	u8 *NameP, *FileP, *DirP;
+	ENCODETABLE Table;
 	int i;
 	u32 Type;
-	void *TempBuffer;
 	u8 Key[DXA_KEY_BYTES];
 	char KeyString[DXA_KEY_STRING_LENGTH + 1];
 	size_t KeyStringBytes;
 	char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
 	DARC_ENCODEINFO EncodeInfo;
+	std::vector<ENCODETASK> Tasks;
+	ENCODEPARAM Param;
 
-	// 状況出力を行う場合はファイルの総数を数える
+	// 各テーブルに必要なサイズとファイルの総数を数える
+	memset(&TableSize, 0, sizeof(TableSize));
 	EncodeInfo.CompFileNum  = 0;
 	EncodeInfo.TotalFileNum = 0;
 	EncodeInfo.OutputStatus = OutputStatus;
-	if (EncodeInfo.OutputStatus)
+	for (i = 0; i < FileNum; i++)
 	{
-		for (i = 0; i < FileNum; i++)
-		{
-			// 指定されたファイルがあるかどうか検査
-			Type = GetFileAttributes(FileOrDirectoryPath[i].c_str());
-			if ((signed int)Type == -1) continue;
-
-			// ファイルのタイプによって処理を分岐
-			if ((Type & FILE_ATTRIBUTE_DIRECTORY) != 0)
-			{
-				FILE_INFOLIST FileList;
-
-				// フォルダ以下のファイルを取得する
-				CreateFileList(FileOrDirectoryPath[i].c_str(), &FileList, TRUE, TRUE, NULL, NULL, NULL);
-
-				// フォルダ以下のファイル数を加算する
-				EncodeInfo.TotalFileNum += FileList.Num;
-
-				// ファイルリスト情報の後始末
-				ReleaseFileList(&FileList);
-			}
-			else
-			{
-				// ファイルだった場合はファイルの数を増やす
-				EncodeInfo.TotalFileNum++;
-			}
-		}
+		ScanEncodeTableSize(FileOrDirectoryPath[i].c_str(), &TableSize, &EncodeInfo.TotalFileNum);
 	}
 
 	// 鍵文字列の保存と鍵の作成
@@ -2157,40 +2076,21 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		KeyCreate(KeyString, KeyStringBytes, Key);
 	}
 
-	// ファイル読み込みに使用するバッファの確保
-	TempBuffer = malloc(DXA_BUFFERSIZE);
-
 	// 出力ファイルを開く
 	DestFp = _tfopen(OutputFileName, TEXT("wb+"));
 
-	g_cryptVersion = cryptVersion;
-	g_newCrypt     = (cryptVersion >= 331 && cryptVersion < 1000 || cryptVersion >= 1010);
-	g_chacha20     = cryptVersion == 0x64 || cryptVersion == 0xC8;
-
-	if (cryptVersion == 0xC8)
-	{
-		std::array<uint8_t, 4> data;
-		std::array<uint8_t, 64> key;
-
-		std::memcpy(data.data(), (uint8_t *)KeyString_ + KeyStringBytes + 1, 4);
-		chacha20_keySetup(data, key);
-
-		std::memcpy(g_cc20Key, key.data(), 32);
-		std::memcpy(g_cc20Nonce, key.data() + 34, 12);
-	}
+	InitCryptState(&g_crypt, cryptVersion, KeyString_, KeyStringBytes);
 
 	uint8_t *pK2 = nullptr;
 
-	if (g_newCrypt)
+	if (g_crypt.NewCrypt)
 	{
 		memset(&Head, 0, sizeof(Head));
 
-		memset(g_specialKey, 0, 768);
-
 		if (cryptVersion >= 1010)
 			pK2 = (uint8_t *)KeyString_ + KeyStringBytes + 1;
 
-		initWolfCrypt(cryptVersion, Head.Reserve, g_specialKey, pK2);
+		initWolfCrypt(cryptVersion, Head.Reserve, g_crypt.SpecialKey, pK2);
 	}
 
 	// アーカイブのヘッダを出力する
@@ -2213,18 +2113,14 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		KeyConvFileWrite(&Head, sizeof(DARC_HEAD), DestFp, NoKey ? NULL : Key, 0);
 	}
 
-	// 各バッファを確保する
-	NameP = (u8 *)malloc(DXA_BUFFERSIZE);
-	if (NameP == NULL) return -1;
-	memset(NameP, 0, DXA_BUFFERSIZE);
-
-	FileP = (u8 *)malloc(DXA_BUFFERSIZE);
-	if (FileP == NULL) return -1;
-	memset(FileP, 0, DXA_BUFFERSIZE);
-
-	DirP = (u8 *)malloc(DXA_BUFFERSIZE);
-	if (DirP == NULL) return -1;
-	memset(DirP, 0, DXA_BUFFERSIZE);
+	// 各テーブルを走査したサイズで確保する( 最初のディレクトリの分を加える、足りなくなった場合は書き出す時に拡張する )
+	if (ReserveTable(&Table.Name, TableSize.NameSize + GetFileNameDataMaxSize(TEXT(""))) == NULL ||
+		ReserveTable(&Table.File, TableSize.FileSize + sizeof(DARC_FILEHEAD) * (FileNum + 1)) == NULL ||
+		ReserveTable(&Table.Directory, TableSize.DirectorySize + sizeof(DARC_DIRECTORY)) == NULL)
+	{
+		fclose(DestFp);
+		return -1;
+	}
 
 	// サイズ保存構造体にデータをセット
 	SizeSave.DataSize      = 0;
@@ -2244,10 +2140,10 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		File.PressDataSize = 0xffffffffffffffff;
 
 		// ディレクトリ名の書き出し
-		SizeSave.NameSize += AddFileNameData(TEXT(""), NameP + SizeSave.NameSize);
+		SizeSave.NameSize += AddFileNameData(TEXT(""), Table.Name.data() + SizeSave.NameSize);
 
 		// ファイル情報の書き出し
-		memcpy(FileP + SizeSave.FileSize, &File, sizeof(DARC_FILEHEAD));
+		memcpy(Table.File.data() + SizeSave.FileSize, &File, sizeof(DARC_FILEHEAD));
 		SizeSave.FileSize += sizeof(DARC_FILEHEAD);
 	}
 
@@ -2256,8 +2152,7 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 	Directory.ParentDirectoryAddress = 0xffffffffffffffff;
 	Directory.FileHeadNum            = FileNum;
 	Directory.FileHeadAddress        = SizeSave.FileSize;
-	memcpy(DirP + SizeSave.DirectorySize, &Directory, sizeof(DARC_DIRECTORY));
-	DirectoryP = (DARC_DIRECTORY *)(DirP + SizeSave.DirectorySize);
+	memcpy(Table.Directory.data() + SizeSave.DirectorySize, &Directory, sizeof(DARC_DIRECTORY));
 
 	// サイズを加算する
 	SizeSave.DirectorySize += sizeof(DARC_DIRECTORY);
@@ -2274,33 +2169,23 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		if ((Type & FILE_ATTRIBUTE_DIRECTORY) != 0)
 		{
 			// ディレクトリの場合はディレクトリのアーカイブに回す
-			DirectoryEncode((int)Head.CharCodeFormat, const_cast<wchar_t *>(FileOrDirectoryPath[i].c_str()), NameP, DirP, FileP, &Directory, &SizeSave, i, DestFp, TempBuffer, Press, MaxPress, AlwaysHuffman, HuffmanEncodeKB, KeyString, KeyStringBytes, NoKey, KeyStringBuffer, &EncodeInfo);
+			if (DirectoryEncode((int)Head.CharCodeFormat, const_cast<wchar_t *>(FileOrDirectoryPath[i].c_str()), &Table, &Directory, &SizeSave, i, KeyString, KeyStringBytes, NoKey, KeyStringBuffer, &Tasks) < 0)
+			{
+				fclose(DestFp);
+				return -1;
+			}
 		}
 		else
 		{
 			WIN32_FIND_DATA FindData;
 			HANDLE FindHandle;
 			DARC_FILEHEAD File;
-			u8 lKey[DXA_KEY_BYTES];
 			size_t KeyStringBufferBytes;
 
 			// ファイルの情報を得る
 			FindHandle = FindFirstFile(FileOrDirectoryPath[i].c_str(), &FindData);
 			if (FindHandle == INVALID_HANDLE_VALUE) continue;
 
-			// 進行状況出力
-			if (EncodeInfo.OutputStatus)
-			{
-				// 処理ファイル名をセット
-				wcscpy(EncodeInfo.ProcessFileName, FindData.cFileName);
-
-				// ファイル数を増やす
-				EncodeInfo.CompFileNum++;
-
-				// 表示
-				EncodeStatusOutput(&EncodeInfo);
-			}
-
 			// ファイルヘッダをセットする
 			{
 				File.NameAddress       = SizeSave.NameSize;
@@ -2308,279 +2193,63 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 				File.Time.LastAccess   = (((LONGLONG)FindData.ftLastAccessTime.dwHighDateTime) << 32) + FindData.ftLastAccessTime.dwLowDateTime;
 				File.Time.LastWrite    = (((LONGLONG)FindData.ftLastWriteTime.dwHighDateTime) << 32) + FindData.ftLastWriteTime.dwLowDateTime;
 				File.Attributes        = FindData.dwFileAttributes;
-				File.DataAddress       = SizeSave.DataSize;
+				File.DataAddress       = 0; // 書き出す時にセットする
 				File.DataSize          = (((LONGLONG)FindData.nFileSizeHigh) << 32) + FindData.nFileSizeLow;
 				File.PressDataSize     = 0xffffffffffffffff;
 				File.HuffPressDataSize = 0xffffffffffffffff;
 			}
 
 			// ファイル名を書き出す
-			SizeSave.NameSize += AddFileNameData(FindData.cFileName, NameP + SizeSave.NameSize);
-
-			// ファイル個別の鍵を作成
-			if (NoKey == false)
+			if (ReserveTable(&Table.Name, SizeSave.NameSize + GetFileNameDataMaxSize(FindData.cFileName)) == NULL)
 			{
-				KeyStringBufferBytes = CreateKeyFileString((int)Head.CharCodeFormat, KeyString, KeyStringBytes, DirectoryP, &File, FileP, DirP, NameP, (BYTE *)KeyStringBuffer);
-				KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
+				FindClose(FindHandle);
+				fclose(DestFp);
+				return -1;
 			}
+			SizeSave.NameSize += AddFileNameData(FindData.cFileName, Table.Name.data() + SizeSave.NameSize);
 
-			// ファイルデータを書き出す
-			if (File.DataSize != 0)
-			{
-				FILE *SrcP;
-				u64 FileSize, WriteSize, MoveSize;
-				bool Huffman     = false;
-				bool AlwaysPress = false;
-
-				// ファイルを開く
-				SrcP = _tfopen(FileOrDirectoryPath[i].c_str(), TEXT("rb"));
-
-				// サイズを得る
-				_fseeki64(SrcP, 0, SEEK_END);
-				FileSize = _ftelli64(SrcP);
-				_fseeki64(SrcP, 0, SEEK_SET);
-
-				// 圧縮の対象となるファイルフォーマットか調べる
-				{
-					u32 Len;
-					Len = (u32)_tcslen(FindData.cFileName);
-					if (Len > 4)
-					{
-						TCHAR *sp;
-
-						sp = &FindData.cFileName[Len - 3];
-						if (StrICmp(sp, TEXT("wav")) == 0 ||
-							StrICmp(sp, TEXT("jpg")) == 0 ||
-							StrICmp(sp, TEXT("png")) == 0 ||
-							StrICmp(sp, TEXT("mpg")) == 0 ||
-							StrICmp(sp, TEXT("mp3")) == 0 ||
-							StrICmp(sp, TEXT("mp4")) == 0 ||
-							StrICmp(sp, TEXT("m4a")) == 0 ||
-							StrICmp(sp, TEXT("ogg")) == 0 ||
-							StrICmp(sp, TEXT("ogv")) == 0 ||
-							StrICmp(sp, TEXT("ops")) == 0 ||
-							StrICmp(sp, TEXT("wmv")) == 0 ||
-							StrICmp(sp, TEXT("tif")) == 0 ||
-							StrICmp(sp, TEXT("tga")) == 0 ||
-							StrICmp(sp, TEXT("bmp")) == 0 ||
-							StrICmp(sp - 1, TEXT("jpeg")) == 0)
-						{
-							Huffman = true;
-						}
-
-						// wav や bmp の場合は必ず圧縮する
-						if (StrICmp(sp, TEXT("wav")) == 0 ||
-							StrICmp(sp, TEXT("tga")) == 0 ||
-							StrICmp(sp, TEXT("bmp")) == 0)
-						{
-							AlwaysPress = true;
-						}
-					}
-				}
-
-				// AlwaysHuffman が true の場合は必ずハフマン圧縮する
-				if (AlwaysHuffman)
-				{
-					Huffman = true;
-				}
-
-				// ハフマン圧縮するサイズが 0 の場合はハフマン圧縮を行わない
-				if (HuffmanEncodeKB == 0)
-				{
-					Huffman = false;
-				}
-
-				// 圧縮の指定がある場合で、
-				// 必ず圧縮するファイルフォーマットか、ファイルサイズが 10MB 以下の場合は圧縮を試みる
-				if (Press == true && (AlwaysPress || File.DataSize < 10 * 1024 * 1024))
-				{
-					void *SrcBuf, *DestBuf;
-					u32 DestSize, Len;
-
-					// 一部のファイル形式の場合は予め弾く
-					if (AlwaysPress == false && (Len = (int)_tcslen(FindData.cFileName)) > 4)
-					{
-						TCHAR *sp;
-
-						sp = &FindData.cFileName[Len - 3];
-						if (StrICmp(sp, TEXT("wav")) == 0 ||
-							StrICmp(sp, TEXT("jpg")) == 0 ||
-							StrICmp(sp, TEXT("png")) == 0 ||
-							StrICmp(sp, TEXT("mpg")) == 0 ||
-							StrICmp(sp, TEXT("mp3")) == 0 ||
-							StrICmp(sp, TEXT("mp4")) == 0 ||
-							StrICmp(sp, TEXT("ogg")) == 0 ||
-							StrICmp(sp, TEXT("ogv")) == 0 ||
-							StrICmp(sp, TEXT("ops")) == 0 ||
-							StrICmp(sp, TEXT("wmv")) == 0 ||
-							StrICmp(sp - 1, TEXT("jpeg")) == 0) goto NOPRESS;
-					}
-
-					// データが丸ごと入るメモリ領域の確保
-					SrcBuf  = calloc(1, (size_t)(FileSize + FileSize * 2 + 64));
-					DestBuf = (u8 *)SrcBuf + FileSize;
-
-					// ファイルを丸ごと読み込む
-					fread64(SrcBuf, FileSize, SrcP);
-
-					// 圧縮する場合は強制的に進行状況出力を更新
-					if (EncodeInfo.OutputStatus)
-					{
-						EncodeStatusOutput(&EncodeInfo, true);
-					}
-
-					// 圧縮
-					DestSize = Encode(SrcBuf, (u32)FileSize, DestBuf, EncodeInfo.OutputStatus, MaxPress);
-
-					// 殆ど圧縮出来なかった場合は圧縮無しでアーカイブする
-					if (AlwaysPress == false && ((f64)DestSize / (f64)FileSize > 0.90))
-					{
-						_fseeki64(SrcP, 0L, SEEK_SET);
-						free(SrcBuf);
-						goto NOPRESS;
-					}
-
-					// 圧縮データのサイズを保存する
-					File.PressDataSize = DestSize;
-
-					// ハフマン圧縮も行うかどうかで処理を分岐
-					if (Huffman)
-					{
-						u8 *HuffData;
+			// ファイルを書き出す一覧に追加する
+			AddEncodeTask(&Tasks, FileOrDirectoryPath[i].c_str(), FindData.cFileName, Directory.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, File.DataSize);
 
-						// ハフマン圧縮するサイズによって処理を分岐
-						if (HuffmanEncodeKB == 0xff || DestSize <= (u64)(HuffmanEncodeKB * 1024 * 2))
-						{
-							// ハフマン圧縮用のメモリ領域を確保
-							HuffData = (u8 *)calloc(1, DestSize * 2 + 256 * 2 + 32);
-
-							// ファイル全体をハフマン圧縮
-							File.HuffPressDataSize = Huffman_Encode(DestBuf, DestSize, HuffData);
-
-							// 圧縮データに鍵を適用して書き出す
-							WriteSize = (File.HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-							KeyConvFileWrite(HuffData, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-						}
-						else
-						{
-							// ハフマン圧縮用のメモリ領域を確保
-							HuffData = (u8 *)calloc(1, HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
-
-							// ファイルの前後をハフマン圧縮
-							memcpy(HuffData, DestBuf, HuffmanEncodeKB * 1024);
-							memcpy(HuffData + HuffmanEncodeKB * 1024, (u8 *)DestBuf + DestSize - HuffmanEncodeKB * 1024, HuffmanEncodeKB * 1024);
-							File.HuffPressDataSize = Huffman_Encode(HuffData, HuffmanEncodeKB * 1024 * 2, HuffData + HuffmanEncodeKB * 1024 * 2);
-
-							// ハフマン圧縮した部分を書き出す
-							KeyConvFileWrite(HuffData + HuffmanEncodeKB * 1024 * 2, File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-
-							// ハフマン圧縮していない箇所を書き出す
-							WriteSize = File.HuffPressDataSize + DestSize - HuffmanEncodeKB * 1024 * 2;
-							WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-							KeyConvFileWrite((u8 *)DestBuf + HuffmanEncodeKB * 1024, WriteSize - File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize + File.HuffPressDataSize);
-						}
-
-						// メモリの解放
-						free(HuffData);
-					}
-					else
-					{
-						// 圧縮データを反転して書き出す
-						WriteSize = (DestSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-						KeyConvFileWrite(DestBuf, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-					}
-
-					// メモリの解放
-					free(SrcBuf);
-				}
-				else
-				{
-				NOPRESS:
-					// ハフマン圧縮も行うかどうかで処理を分岐
-					if (Press && Huffman)
-					{
-						u8 *SrcBuf, *HuffData;
-
-						// データが丸ごと入るメモリ領域の確保
-						SrcBuf = (u8 *)calloc(1, (size_t)(FileSize + 32));
-
-						// ファイルを丸ごと読み込む
-						fread64(SrcBuf, FileSize, SrcP);
-
-						// ハフマン圧縮するサイズによって処理を分岐
-						if (HuffmanEncodeKB == 0xff || FileSize <= HuffmanEncodeKB * 1024 * 2)
-						{
-							// ハフマン圧縮用のメモリ領域を確保
-							HuffData = (u8 *)calloc(1, (size_t)(FileSize * 2 + 256 * 2 + 32));
-
-							// ファイル全体をハフマン圧縮
-							File.HuffPressDataSize = Huffman_Encode(SrcBuf, FileSize, HuffData);
-
-							// 圧縮データに鍵を適用して書き出す
-							WriteSize = (File.HuffPressDataSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-							KeyConvFileWrite(HuffData, WriteSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-						}
-						else
-						{
-							// ハフマン圧縮用のメモリ領域を確保
-							HuffData = (u8 *)calloc(1, HuffmanEncodeKB * 1024 * 2 * 4 + 256 * 2 + 32);
-
-							// ファイルの前後をハフマン圧縮
-							memcpy(HuffData, SrcBuf, HuffmanEncodeKB * 1024);
-							memcpy(HuffData + HuffmanEncodeKB * 1024, SrcBuf + FileSize - HuffmanEncodeKB * 1024, HuffmanEncodeKB * 1024);
-							File.HuffPressDataSize = Huffman_Encode(HuffData, HuffmanEncodeKB * 1024 * 2, HuffData + HuffmanEncodeKB * 1024 * 2);
-
-							// ハフマン圧縮した部分を書き出す
-							KeyConvFileWrite(HuffData + HuffmanEncodeKB * 1024 * 2, File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize);
-
-							// ハフマン圧縮していない箇所を書き出す
-							WriteSize = File.HuffPressDataSize + FileSize - HuffmanEncodeKB * 1024 * 2;
-							WriteSize = (WriteSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-							KeyConvFileWrite(SrcBuf + HuffmanEncodeKB * 1024, WriteSize - File.HuffPressDataSize, DestFp, NoKey ? NULL : lKey, File.DataSize + File.HuffPressDataSize);
-						}
-
-						// メモリの解放
-						free(SrcBuf);
-						free(HuffData);
-					}
-					else
-					{
-						// 転送開始
-						WriteSize = 0;
-						while (WriteSize < FileSize)
-						{
-							// 転送サイズ決定
-							MoveSize = DXA_BUFFERSIZE < FileSize - WriteSize ? DXA_BUFFERSIZE : FileSize - WriteSize;
-							MoveSize = (MoveSize + 3) / 4 * 4; // サイズは４の倍数に合わせる
-
-							// ファイルの鍵適用読み込み
-							memset(TempBuffer, 0, (size_t)MoveSize);
-							KeyConvFileRead(TempBuffer, MoveSize, SrcP, NoKey ? NULL : lKey, File.DataSize + WriteSize);
-
-							// 書き出し
-							fwrite64(TempBuffer, MoveSize, DestFp);
-
-							// 書き出しサイズの加算
-							WriteSize += MoveSize;
-						}
-					}
-				}
-
-				// 書き出したファイルを閉じる
-				fclose(SrcP);
-
-				// データサイズの加算
-				SizeSave.DataSize += WriteSize;
+			// ファイル個別の鍵を作成
+			if (NoKey == false)
+			{
+				KeyStringBufferBytes = CreateKeyFileString((int)Head.CharCodeFormat, KeyString, KeyStringBytes, (DARC_DIRECTORY *)Table.Directory.data(), &File, Table.File.data(), Table.Directory.data(), Table.Name.data(), (BYTE *)KeyStringBuffer);
+				KeyCreate(KeyStringBuffer, KeyStringBufferBytes, Tasks.back().Key);
 			}
 
 			// ファイルヘッダを書き出す
-			memcpy(FileP + Directory.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, &File, sizeof(DARC_FILEHEAD));
+			memcpy(Table.File.data() + Directory.FileHeadAddress + sizeof(DARC_FILEHEAD) * i, &File, sizeof(DARC_FILEHEAD));
 
 			// Find ハンドルを閉じる
 			FindClose(FindHandle);
 		}
 	}
 
+	// 一覧のファイルを圧縮して書き出す
+	{
+		Param.Press           = Press;
+		Param.MaxPress        = MaxPress;
+		Param.PressLevel      = PressLevel;
+		Param.AlwaysHuffman   = AlwaysHuffman;
+		Param.HuffmanEncodeKB = HuffmanEncodeKB;
+		Param.NoKey           = NoKey;
+
+		// 指定が無い場合は CPU のコア数だけスレッドを使う
+		if (ThreadNum <= 0)
+		{
+			ThreadNum = (int)std::thread::hardware_concurrency();
+			if (ThreadNum <= 0) ThreadNum = 1;
+		}
+
+		if (WriteEncodeTasks(Tasks, ThreadNum, &Param, DestFp, Table.File.data(), &SizeSave, &EncodeInfo) < 0)
+		{
+			fclose(DestFp);
+			EncodeStatusErase();
+			return -1;
+		}
+	}
+
 	// バッファに溜め込んだ各種ヘッダデータを出力する
 	{
 		u8 *PressSource;
@@ -2589,9 +2258,9 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		// 全部のデータを纏める
 		PressSource = (u8 *)malloc((size_t)TotalSize);
 		if (PressSource == NULL) return -1;
-		memcpy(PressSource, NameP, (size_t)SizeSave.NameSize);
-		memcpy(PressSource + SizeSave.NameSize, FileP, (size_t)SizeSave.FileSize);
-		memcpy(PressSource + SizeSave.NameSize + SizeSave.FileSize, DirP, (size_t)SizeSave.DirectorySize);
+		memcpy(PressSource, Table.Name.data(), (size_t)SizeSave.NameSize);
+		memcpy(PressSource + SizeSave.NameSize, Table.File.data(), (size_t)SizeSave.FileSize);
+		memcpy(PressSource + SizeSave.NameSize + SizeSave.FileSize, Table.Directory.data(), (size_t)SizeSave.DirectorySize);
 
 		// 圧縮するかどうかで処理を分岐
 		if (Press)
@@ -2606,7 +2275,7 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 			if (PressData == NULL) return -1;
 
 			// LZ圧縮
-			LZDataSize = Encode(PressSource, (u32)TotalSize, PressData, false);
+			LZDataSize = Encode(PressSource, (u32)TotalSize, PressData, false, false, PressLevel);
 
 			// ハフマン圧縮
 			HeaderHuffDataSize = Huffman_Encode(PressData, (u64)LZDataSize, PressData + TotalSize * 2 + 32);
@@ -2641,7 +2310,7 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		fwrite64(&Head, sizeof(DARC_HEAD), DestFp);
 	}
 
-	if (g_newCrypt)
+	if (g_crypt.NewCrypt)
 	{
 		uint8_t roundKey[AES_ROUND_KEY_SIZE] = { 0 };
 
@@ -2686,7 +2355,7 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		aesCtrXCrypt(pFileData + 64, roundKey, bodySize);
 		aesCtrXCrypt(pFileData + Head.FileNameTableStartAddress, roundKey, size - static_cast<int32_t>(Head.FileNameTableStartAddress));
 
-		initWolfCrypt(cryptVersion, pPwd, g_specialKey, nullptr, pFileData, 64, size - 64, true, KeyString_);
+		initWolfCrypt(cryptVersion, pPwd, g_crypt.SpecialKey, nullptr, pFileData, 64, size - 64, true, KeyString_);
 
 		cryptAddresses(pFileData, pPwd, cryptVersion);
 
@@ -2699,12 +2368,6 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 	// 書き出したファイルを閉じる
 	fclose(DestFp);
 
-	// 確保したバッファを開放する
-	free(NameP);
-	free(FileP);
-	free(DirP);
-	free(TempBuffer);
-
 	// 圧縮状況表示をクリア
 	EncodeStatusErase();
 
@@ -2715,243 +2378,9 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 // アーカイブファイルを展開する
 int DXArchive::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_)
 {
-	u8 *HeadBuffer = NULL;
-	DARC_HEAD Head;
-	u8 *FileP, *NameP, *DirP;
-	FILE *ArcP = NULL;
-	TCHAR OldDir[MAX_PATH];
-	u8 Key[DXA_KEY_BYTES];
-	char KeyString[DXA_KEY_STRING_LENGTH + 1];
-	size_t KeyStringBytes;
-	char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
-	bool NoKey;
-
-	// 鍵文字列の保存と鍵の作成
-	{
-		// 指定が無い場合はデフォルトの鍵文字列を使用する
-		if (KeyString_ == NULL)
-		{
-			KeyString_ = DefaultKeyString;
-		}
-
-		KeyStringBytes = CL_strlen(CHARCODEFORMAT_ASCII, KeyString_);
-		if (KeyStringBytes > DXA_KEY_STRING_LENGTH)
-		{
-			KeyStringBytes = DXA_KEY_STRING_LENGTH;
-		}
-		memcpy(KeyString, KeyString_, KeyStringBytes);
-		KeyString[KeyStringBytes] = '\0';
-
-		// 鍵の作成
-		KeyCreate(KeyString, KeyStringBytes, Key);
-	}
-
-	// アーカイブファイルを開く
-	ArcP = _tfopen(ArchiveName, TEXT("rb"));
-	if (ArcP == NULL) return -1;
-
-	// 出力先のディレクトリにカレントディレクトリを変更する
-	GetCurrentDirectory(MAX_PATH, OldDir);
-	SetCurrentDirectory(OutputPath);
-
-	// ヘッダを解析する
-	{
-		s64 FileSize;
-
-		// ヘッダの読み込み
-		fread64(&Head, sizeof(DARC_HEAD), ArcP);
-
-		// ＩＤの検査
-		if (Head.Head != DXA_HEAD)
-		{
-			goto ERR;
-		}
-
-		// バージョン検査
-		if (Head.Version > DXA_VER || Head.Version < DXA_VER_MIN) goto ERR;
-
-		const uint16_t cryptVersion = Head.Flags >> 16;
+	DXArchiveDecoder Decoder;
 
-		g_cryptVersion = cryptVersion;
-		g_newCrypt     = (cryptVersion >= 331 && cryptVersion < 1000 || cryptVersion >= 1010);
-		g_chacha20     = cryptVersion == 0x64 || cryptVersion == 0xC8;
-
-		if (cryptVersion == 0xC8)
-		{
-			std::array<uint8_t, 4> data;
-			std::array<uint8_t, 64> key;
-
-			std::memcpy(data.data(), (uint8_t *)KeyString_ + KeyStringBytes + 1, 4);
-			chacha20_keySetup(data, key);
-
-			std::memcpy(g_cc20Key, key.data(), 32);
-			std::memcpy(g_cc20Nonce, key.data() + 34, 12);
-		}
-
-		if (g_newCrypt)
-		{
-			const uint8_t *pPwd = Head.Reserve;
-
-			memset(g_specialKey, 0, 768);
-			cryptAddresses((uint8_t *)&Head, pPwd, cryptVersion);
-
-			fseek(ArcP, 0, SEEK_END);
-			int32_t size = ftell(ArcP);
-			fseek(ArcP, 0, SEEK_SET);
-
-			uint8_t *pFileData = new uint8_t[size]();
-
-			size_t ret = fread(pFileData, 1, size, ArcP);
-
-			// Replace the beginning of the file data with the decrypted header
-			std::memcpy(pFileData, &Head, sizeof(DARC_HEAD));
-
-			uint8_t roundKey[AES_ROUND_KEY_SIZE] = { 0 };
-			initWolfCrypt(cryptVersion, pPwd, g_specialKey, nullptr, pFileData, 64, size - 64, true, KeyString_);
-
-			uint8_t *pK2 = nullptr;
-
-			if (cryptVersion >= 1010)
-				pK2 = (uint8_t *)KeyString_ + KeyStringBytes + 1;
-
-			initAES128(roundKey, pPwd, pK2, cryptVersion);
-
-			if ((size - 64) < 0x400)
-				return 0;
-
-			uint32_t bodySize = 0x400;
-
-			if (isV35(cryptVersion))
-			{
-				uint32_t seed = 0;
-
-				if (cryptVersion >= 1020)
-					seed = pK2[0] * pK2[1] + pPwd[2] * pPwd[4] + pPwd[11];
-				else
-					seed = pPwd[2] * pPwd[4] + pPwd[12]; // xorShift32 seed
-
-				if (!seed) seed = 1;
-				xorshift32(seed);
-
-				if (size >= static_cast<int32_t>(xorshift32() % 500 + 800))
-					xorshift32();
-
-				bodySize = size - 64; // 64 is the header size -- maybe replace with a constant
-
-				if (bodySize >= (xorshift32() % 500 + 800))
-					bodySize = (xorshift32() % 500) + 800;
-			}
-
-			aesCtrXCrypt(pFileData + 64, roundKey, bodySize); // For v3.31 this has to be 0x400
-			aesCtrXCrypt(pFileData + Head.FileNameTableStartAddress, roundKey, size - static_cast<int32_t>(Head.FileNameTableStartAddress));
-
-			// Write to file
-			FILE *fp = fopen("decrypt_temp", "wb");
-			fwrite(pFileData, size, 1, fp);
-			fclose(fp);
-
-			delete[] pFileData;
-
-			// Close the current arc file and open the decrypted one
-			fclose(ArcP);
-
-			ArcP = fopen("decrypt_temp", "rb");
-			fseek(ArcP, sizeof(DARC_HEAD), SEEK_SET);
-
-			initWolfCrypt(cryptVersion, pPwd, g_specialKey, pK2);
-		}
-
-		// 鍵処理が行われていないかを取得する
-		NoKey = (Head.Flags & DXA_FLAG_NO_KEY) != 0;
-
-		// ヘッダのサイズ分のメモリを確保する
-		HeadBuffer = (u8 *)malloc((size_t)Head.HeadSize);
-		if (HeadBuffer == NULL) goto ERR;
-
-		// ヘッダが圧縮されている場合は解凍する
-		if ((Head.Flags & DXA_FLAG_NO_HEAD_PRESS) != 0)
-		{
-			// 圧縮されていない場合は普通に読み込む
-			KeyConvFileRead(HeadBuffer, Head.HeadSize, ArcP, NoKey ? NULL : Key, 0);
-		}
-		else
-		{
-			void *HuffHeadBuffer;
-			u64 HuffHeadSize;
-			void *LzHeadBuffer;
-			u64 LzHeadSize;
-
-			// ハフマン圧縮されたヘッダのサイズを取得する
-			_fseeki64(ArcP, 0, SEEK_END);
-			FileSize = _ftelli64(ArcP);
-			_fseeki64(ArcP, Head.FileNameTableStartAddress, SEEK_SET);
-			HuffHeadSize = (u32)(FileSize - _ftelli64(ArcP));
-
-			// ハフマン圧縮されたヘッダを読み込むメモリを確保する
-			HuffHeadBuffer = malloc((size_t)HuffHeadSize);
-			if (HuffHeadBuffer == NULL) goto ERR;
-
-			// ハフマン圧縮されたヘッダをコピーと暗号化解除
-			KeyConvFileRead(HuffHeadBuffer, HuffHeadSize, ArcP, NoKey ? NULL : Key, 0);
-
-			// ハフマン圧縮されたヘッダの解凍後の容量を取得する
-			LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
-
-			// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
-			LzHeadBuffer = malloc((size_t)LzHeadSize);
-			if (LzHeadBuffer == NULL)
-			{
-				free(HuffHeadBuffer);
-				goto ERR;
-			}
-
-			// ハフマン圧縮されたヘッダを解凍する
-			Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
-
-			// LZ圧縮されたヘッダを解凍する
-			Decode(LzHeadBuffer, HeadBuffer);
-
-			// メモリの解放
-			free(HuffHeadBuffer);
-			free(LzHeadBuffer);
-		}
-
-		// 各アドレスをセットする
-		NameP = HeadBuffer;
-		FileP = NameP + Head.FileTableStartAddress;
-		DirP  = NameP + Head.DirectoryTableStartAddress;
-	}
-
-	// アーカイブの展開を開始する
-	DirectoryDecode(NameP, DirP, FileP, &Head, (DARC_DIRECTORY *)DirP, ArcP, Key, KeyString, KeyStringBytes, NoKey, KeyStringBuffer);
-
-	// ファイルを閉じる
-	fclose(ArcP);
-
-	// ヘッダを読み込んでいたメモリを解放する
-	free(HeadBuffer);
-
-	if (g_newCrypt)
-	{
-		// Remove the decrypted file
-		remove("decrypt_temp");
-	}
-
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(OldDir);
-
-	// 終了
-	return 0;
-
-ERR:
-	if (HeadBuffer != NULL) free(HeadBuffer);
-	if (ArcP != NULL) fclose(ArcP);
-
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(OldDir);
-
-	// 終了
-	return -1;
+	return Decoder.DecodeArchive(ArchiveName, OutputPath, KeyString_) == DXArchiveDecoder::DECODE_RESULT_OK ? 0 : -1;
 }
 
 // コンストラクタ
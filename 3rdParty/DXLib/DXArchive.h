@@ -177,11 +177,24 @@ typedef struct tagDARC_ENCODEINFO
 	bool OutputStatus ;				// 状況出力を行うかどうか
 } DARC_ENCODEINFO ;
 
+// Wolf RPG crypt state, set up from the crypt version stored in DARC_HEAD::Flags
+typedef struct tagDARC_CRYPTSTATE
+{
+	bool NewCrypt ;					// v3.31+ / Pro crypt (wolfCrypt with SpecialKey)
+	bool ChaCha20 ;					// ChaCha2 v1 / CC2 Pro crypt
+	u16 CryptVersion ;				// Crypt version ( DARC_HEAD::Flags >> 16 )
+	u8 SpecialKey[ 768 ] ;			// wolfCrypt key
+	u8 CC20Key[ 32 ] ;				// ChaCha20 key
+	u8 CC20Nonce[ 12 ] ;			// ChaCha20 nonce
+} DARC_CRYPTSTATE ;
+
 // class ----------------------------------------
 
 // アーカイブクラス
 class DXArchive
 {
+	friend class DXArchiveDecoder ;
+
 public :
 	// 日付の比較結果
 	enum DATE_RESULT
@@ -194,8 +207,8 @@ public :
 	DXArchive(TCHAR *ArchivePath = NULL ) ;
 	~DXArchive() ;
 
-	static int			EncodeArchive(const TCHAR *OutputFileName, const std::vector<std::wstring> &FileOrDirectoryPath, int FileNum, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0); // アーカイブファイルを作成する
-	static int 			EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *FolderPath, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0);                               // アーカイブファイルを作成する(ディレクトリ一個だけ)
+	static int			EncodeArchive(const TCHAR *OutputFileName, const std::vector<std::wstring> &FileOrDirectoryPath, int FileNum, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0, int ThreadNum = 0, int PressLevel = 0); // アーカイブファイルを作成する( ThreadNum:ファイルの圧縮に使うスレッドの数 0 の場合は CPU のコア数  PressLevel:Encode の Level )
+	static int 			EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *FolderPath, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0, int ThreadNum = 0, int PressLevel = 0);           // アーカイブファイルを作成する(ディレクトリ一個だけ)
 	static int			EncodeArchiveOneDirectoryWolf(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press = false, const char *KeyString_ = NULL, uint16_t cryptVersion = 0);
 	static int			DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_ = NULL ) ;								// アーカイブファイルを展開する
 
@@ -227,10 +240,12 @@ public :
 	static size_t CreateKeyFileString( int CharCodeFormat, const char *KeyString, size_t KeyStringBytes, DARC_DIRECTORY *Directory, DARC_FILEHEAD *FileHead, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable, u8 *FileString ) ;	// カレントディレクトリにある指定のファイルの鍵用の文字列を作成する、戻り値は文字列の長さ( 単位：Byte )( FileString は DXA_KEY_STRING_MAXLENGTH の長さが必要 )
 	static void KeyCreate( const char *Source, size_t SourceBytes, u8 *Key ) ;									// 鍵文字列を作成
 	static void KeyConv( void *Data, s64 Size, s64 Position, unsigned char *Key ) ;								// 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEY_BYTES の長さがなければならない )
+	static void KeyConv( void *Data, s64 Size, s64 Position, unsigned char *Key, const DARC_CRYPTSTATE *Crypt ) ;	// KeyConv using the given crypt state instead of the shared one
+	static void InitCryptState( DARC_CRYPTSTATE *Crypt, u16 CryptVersion, const char *KeyString, size_t KeyStringBytes ) ;	// Sets up the crypt flags and ChaCha20 key for the given crypt version
 	static void KeyConvFileWrite( void *Data, s64 Size, FILE *fp, unsigned char *Key, s64 Position = -1 ) ;		// データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 	static void KeyConvFileRead( void *Data, s64 Size, FILE *fp, unsigned char *Key, s64 Position = -1 ) ;		// ファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 	static DATE_RESULT DateCmp( DARC_FILETIME *date1, DARC_FILETIME *date2 ) ;									// どちらが新しいかを比較する
-	static int Encode( void *Src, u32 SrcSize, void *Dest, bool OutStatus = true, bool MaxPress = false ) ;		// データを圧縮する( 戻り値:圧縮後のデータサイズ )
+	static int Encode( void *Src, u32 SrcSize, void *Dest, bool OutStatus = true, bool MaxPress = false, int Level = 0 ) ;		// データを圧縮する( Level:0 の場合はリスト検索、1 以上はハッシュチェーン検索の圧縮レベル( lzEncoder::LEVEL_MAX まで、OutStatus と MaxPress は無効 )  戻り値:圧縮後のデータサイズ )
 	static int Decode( void *Src, void *Dest ) ;																// データを解凍する( 戻り値:解凍後のデータサイズ )
 	static u32 HashCRC32( const void *SrcData, size_t SrcDataSize ) ;											// バイナリデータを元に CRC32 のハッシュ値を計算する
 
@@ -274,6 +289,56 @@ protected :
 		u64 FileSize ;			// ファイルプロパティデータの総量
 	} SIZESAVE ;
 
+	// ファイルデータの圧縮設定
+	typedef struct tagENCODEPARAM
+	{
+		bool Press ;			// 圧縮するかどうか
+		bool MaxPress ;			// 最大圧縮を行うかどうか
+		int PressLevel ;		// LZ 圧縮のレベル( 0:リスト検索 )
+		bool AlwaysHuffman ;	// 必ずハフマン圧縮するかどうか
+		u8 HuffmanEncodeKB ;	// ファイルの前後のハフマン圧縮するサイズ
+		bool NoKey ;			// 鍵処理を行わないかどうか
+	} ENCODEPARAM ;
+
+	// アーカイブに格納するファイル、圧縮は複数のスレッドで行い、書き出しはディレクトリを辿った順に行う
+	typedef struct tagENCODETASK
+	{
+		std::wstring FilePath ;			// ファイルのフルパス
+		std::wstring FileName ;			// ファイル名
+		u64 FileHeadAddress ;			// ファイルヘッダのファイルテーブル内のアドレス
+		u64 DataSize ;					// ファイルのデータサイズ
+		u8 Key[ DXA_KEY_BYTES ] ;		// ファイル個別の鍵
+		std::vector< u8 > Data ;		// 鍵を適用した書き出すデータ
+		u64 PressDataSize ;				// 圧縮後のデータのサイズ
+		u64 HuffPressDataSize ;			// ハフマン圧縮後のデータのサイズ
+		bool Stream ;					// 圧縮せずに書き出し時に元のファイルから転送するかどうか
+		bool Ready ;					// 圧縮が終わったかどうか
+		int Result ;					// 圧縮の結果( -1:エラー )
+	} ENCODETASK ;
+
+	// アーカイブ作成時のヘッダの各テーブル、事前に走査したサイズで確保して足りない場合は拡張する
+	// ( 拡張するとアドレスが変わるので、テーブル内のデータはポインタではなくテーブル内のアドレスで保持する )
+	typedef struct tagENCODETABLE
+	{
+		std::vector< u8 > Name ;		// ファイル名テーブル
+		std::vector< u8 > File ;		// ファイルヘッダテーブル
+		std::vector< u8 > Directory ;	// ディレクトリテーブル
+	} ENCODETABLE ;
+
+	// 使い回す作業バッファ
+	typedef struct tagENCODEBUFFER
+	{
+		void *Data ;					// 確保したメモリ
+		u64 Size ;						// 確保したサイズ
+	} ENCODEBUFFER ;
+
+	// ファイルの圧縮に使う作業バッファ、スレッド毎に一つ用意して使い回す
+	typedef struct tagENCODEWORK
+	{
+		ENCODEBUFFER Buffer ;			// 読み込んだファイルと LZ 圧縮したデータ
+		ENCODEBUFFER HuffBuffer ;		// ハフマン圧縮用のデータ
+	} ENCODEWORK ;
+
 	// ファイル名検索用データ構造体
 	typedef struct tagSEARCHDATA
 	{
@@ -282,11 +347,19 @@ protected :
 		u16 PackNum ;
 	} SEARCHDATA ;
 
-	static int DirectoryEncode( int CharCodeFormat, TCHAR *DirectoryName, u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, FILE *DestFp, void *TempBuffer, bool Press, bool MaxPress, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, DARC_ENCODEINFO *EncodeInfo ) ;	// 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
-	static int DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD *Head, DARC_DIRECTORY *Dir, FILE *ArcP, unsigned char *Key, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer ) ;											// 指定のディレクトリデータにあるファイルを展開する
+	static int DirectoryEncode( int CharCodeFormat, TCHAR *DirectoryName, ENCODETABLE *Table, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, std::vector< ENCODETASK > *Tasks ) ;	// 指定のディレクトリにあるファイルのヘッダを作成し、ファイルを書き出す一覧に追加する
+	static void AddEncodeTask( std::vector< ENCODETASK > *Tasks, const TCHAR *FilePath, const TCHAR *FileName, u64 FileHeadAddress, u64 DataSize ) ;	// ファイルを書き出す一覧に追加する
+	static void ScanEncodeTableSize( const TCHAR *Path, SIZESAVE *Size, int *FileNum ) ;		// 指定のパス以下を格納するのに必要なテーブルのサイズとファイルの数を加算する
+	static u8 *ReserveTable( std::vector< u8 > *Table, u64 Size ) ;								// テーブルが指定のサイズに足りない場合は拡張する( 内容は保持する、確保できなかった場合は NULL を返す )
+	static u8 *GetEncodeWorkBuffer( ENCODEBUFFER *Buffer, u64 Size ) ;							// 作業バッファから 0 で初期化した指定のサイズの領域を取得する
+	static void ReleaseEncodeWork( ENCODEWORK *Work, u64 KeepSize ) ;							// 指定のサイズより大きい作業バッファを解放する
+	static int EncodeFileData( ENCODETASK *Task, const ENCODEPARAM *Param, ENCODEWORK *Work ) ;		// ファイルのデータを圧縮して鍵を適用する( 各スレッドで実行 )
+	static void AppendEncodeData( ENCODETASK *Task, const void *Data, u64 Size, bool NoKey, s64 Position ) ;	// 圧縮したデータに鍵を適用して書き出すデータに追加する
+	static int WriteEncodeTasks( std::vector< ENCODETASK > &Tasks, int ThreadNum, const ENCODEPARAM *Param, FILE *DestFp, u8 *FileP, SIZESAVE *Size, DARC_ENCODEINFO *EncodeInfo ) ;	// 一覧のファイルを複数のスレッドで圧縮しながら順番に書き出す
 	static int StrICmp( const TCHAR *Str1, const TCHAR *Str2 ) ;							// 比較対照の文字列中の大文字を小文字として扱い比較する( 0:等しい  1:違う )
 	static int ConvSearchData( SEARCHDATA *Dest, const TCHAR *Src, int *Length ) ;		// 文字列を検索用のデータに変換( ヌル文字か \ があったら終了 )
 	static int AddFileNameData( const TCHAR *FileName, u8 *FileNameTable ) ;				// ファイル名データを追加する( 戻り値は使用したデータバイト数 )
+	static u64 GetFileNameDataMaxSize( const TCHAR *FileName ) ;							// ファイル名データが使用する最大のバイト数を取得する
 	static TCHAR *GetOriginalFileName( u8 *FileNameTable ) ;						// ファイル名データから元のファイル名の文字列を取得する
 	static int GetDirectoryFilePath(const TCHAR *DirectoryPath, std::vector<std::wstring> *FilePathBuffer = NULL); // ディレクトリ内のファイルのパスを取得する( FilePathBuffer は一ファイルに付き256バイトの容量が必要 )
 	static void EncodeStatusErase( void ) ;														// エンコードの進行状況を表示を消去する
@@ -0,0 +1,1020 @@
+﻿// -------------------------------------------------------------------------------
+//
+// 		ＤＸライブラリアーカイバ 展開クラス
+//
+//	Re-entrant version of DXArchive::DecodeArchive
+//
+// -------------------------------------------------------------------------------
+
+// include ----------------------------
+#include "DXArchiveDecoder.h"
+#include "CharCode.h"
+#include "Huffman.h"
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include <algorithm>
+#include <cwctype>
+#include <new>
+#include <thread>
+
+// Functions for new Wolf Crypt
+#include "WolfNew.h"
+
+// define -----------------------------
+
+#define DXA_NONE                 (0xffffffffffffffff)	// 圧縮されていない / 親ディレクトリ無し
+#define DXA_DECODE_MAX_DEPTH     (256)					// ディレクトリの最大の深さ
+#define DXA_DECODE_SIZE_LIMIT    (1ULL << 48)			// これ以上のサイズは壊れたテーブルとして扱う
+#define DXA_DECODE_WORK_PADDING  (4096)					// 作業バッファの後ろに確保する余白( 壊れたデータを読み込んだ場合用 )
+#define DXA_DECODE_COPY_SIZE     (0x100000)				// 圧縮されていないファイルを転送する単位
+
+// data -------------------------------
+
+// デフォルト鍵文字列
+static const char DefaultKeyString[9] = { 0x44, 0x58, 0x42, 0x44, 0x58, 0x41, 0x52, 0x43, 0x00 }; // "DXLIBARC"
+
+// Files that v3.5 archives prefix with an anti-unpack message
+static const wchar_t *UnpackProtectionFiles[] = { L"game.dat", L"cdatabase.dat", L"database.dat", L"commonevent.dat" };
+
+static const u8 AntiUnpackData[62] = { 0x45, 0x78, 0x74, 0x72, 0x61, 0x63, 0x74, 0x69, 0x6E, 0x67, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x72, 0x6F, 0x6D, 0x20, 0x65, 0x6E, 0x63, 0x72, 0x79, 0x70, 0x74, 0x65, 0x64, 0x20, 0x66, 0x69, 0x6C, 0x65, 0x73, 0x20, 0x76, 0x69, 0x6F, 0x6C, 0x61, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x75, 0x69, 0x64, 0x65, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x00 };
+
+// proto type -------------------------
+
+static bool CheckPressData(const u8 *Src, u64 SrcSize, u64 DestSize);
+static bool IsUnpackProtectionFile(const std::wstring &FilePath);
+
+// class code -------------------------
+
+// コンストラクタ
+DXArchiveDecoder::DXArchiveDecoder()
+{
+	memset(&Crypt, 0, sizeof(Crypt));
+	memset(&Head, 0, sizeof(Head));
+
+	ArcCrypt   = false;
+	ArcSize    = 0;
+	ArcAesBodySize = 0;
+	HeadBuffer = NULL;
+	NameP = FileP = DirP = NULL;
+	NameSize = FileSize = DirSize = 0;
+	NoKey          = false;
+	KeyStringBytes = 0;
+	ThreadNum      = 1;
+	NextTask       = 0;
+	TaskResult     = DECODE_RESULT_OK;
+
+	memset(&MainWork, 0, sizeof(MainWork));
+	memset(&ArcMap, 0, sizeof(ArcMap));
+}
+
+// デストラクタ
+DXArchiveDecoder::~DXArchiveDecoder()
+{
+	Release();
+}
+
+// アーカイブファイルを OutputPath 以下に展開する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::DecodeArchive(const TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_)
+{
+	DECODE_RESULT Result;
+
+	Release();
+
+	try
+	{
+		// 出力先のディレクトリを決める、指定が無い場合はカレントディレクトリに展開する
+		if (OutputPath == NULL || OutputPath[0] == TEXT('\0'))
+		{
+			TCHAR CurrentDir[MAX_PATH];
+
+			GetCurrentDirectory(MAX_PATH, CurrentDir);
+			OutputRoot = CurrentDir;
+		}
+		else
+		{
+			OutputRoot = OutputPath;
+
+			while (OutputRoot.size() > 3 && (OutputRoot.back() == L'\\' || OutputRoot.back() == L'/'))
+				OutputRoot.pop_back();
+
+			CreateDirectory(OutputRoot.c_str(), NULL);
+		}
+
+		ArchivePath = ArchiveName;
+
+		Result = OpenArchive(ArchiveName, KeyString_);
+
+		// New crypt archives without a complete first AES block are skipped, the same as the original decoder did
+		if (Result == DECODE_RESULT_OK && Crypt.NewCrypt && ArcSize - sizeof(DARC_HEAD) < 0x400)
+		{
+			Release();
+			return DECODE_RESULT_OK;
+		}
+
+		if (Result == DECODE_RESULT_OK)
+			Result = GuardedCall(&DXArchiveDecoder::ReadHeader);
+
+		if (Result == DECODE_RESULT_OK)
+			Result = GuardedCall(&DXArchiveDecoder::ExtractAll);
+	}
+	catch (const std::bad_alloc &)
+	{
+		Result = DECODE_RESULT_MEMORY_ERROR;
+	}
+
+	Release();
+
+	return Result;
+}
+
+// 展開に使うスレッドの数を設定する
+void DXArchiveDecoder::SetThreadNum(int Num)
+{
+	ThreadNum = Num < 1 ? 1 : Num;
+}
+
+// 展開結果の説明文を取得する
+const TCHAR *DXArchiveDecoder::GetResultString(DECODE_RESULT Result)
+{
+	switch (Result)
+	{
+		case DECODE_RESULT_OK:
+			return TEXT("Success");
+		case DECODE_RESULT_OPEN_ERROR:
+			return TEXT("Failed to open the archive");
+		case DECODE_RESULT_HEADER_ERROR:
+			return TEXT("Not a supported DX archive");
+		case DECODE_RESULT_TABLE_ERROR:
+			return TEXT("Invalid archive tables (wrong key?)");
+		case DECODE_RESULT_DATA_ERROR:
+			return TEXT("Invalid file data (wrong key?)");
+		case DECODE_RESULT_MEMORY_ERROR:
+			return TEXT("Out of memory");
+		case DECODE_RESULT_OUTPUT_ERROR:
+			return TEXT("Failed to write the output");
+		case DECODE_RESULT_EXCEPTION:
+			return TEXT("Exception while decoding");
+		default:
+			return TEXT("Unknown error");
+	}
+}
+
+// アーカイブを開き、ヘッダと暗号化処理の状態を準備する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::OpenArchive(const TCHAR *ArchiveName, const char *KeyString_)
+{
+	// 鍵文字列の保存と鍵の作成
+	{
+		// 指定が無い場合はデフォルトの鍵文字列を使用する
+		if (KeyString_ == NULL)
+		{
+			KeyString_ = DefaultKeyString;
+		}
+
+		KeyStringBytes = CL_strlen(CHARCODEFORMAT_ASCII, KeyString_);
+		if (KeyStringBytes > DXA_KEY_STRING_LENGTH)
+		{
+			KeyStringBytes = DXA_KEY_STRING_LENGTH;
+		}
+		memcpy(KeyString, KeyString_, KeyStringBytes);
+		KeyString[KeyStringBytes] = '\0';
+
+		// 鍵の作成
+		DXArchive::KeyCreate(KeyString, KeyStringBytes, Key);
+	}
+
+	// アーカイブファイルをメモリにマップする、マップできない場合はファイルから読み込む
+	if (OpenFileMap(ArchiveName, &ArcMap) == 0)
+	{
+		ArcSize = ArcMap.Size;
+	}
+	else
+	{
+		MainWork.ArcP = _tfopen(ArchiveName, TEXT("rb"));
+		if (MainWork.ArcP == NULL) return DECODE_RESULT_OPEN_ERROR;
+
+		_fseeki64(MainWork.ArcP, 0, SEEK_END);
+		ArcSize = _ftelli64(MainWork.ArcP);
+		_fseeki64(MainWork.ArcP, 0, SEEK_SET);
+	}
+
+	if (ArcSize < sizeof(DARC_HEAD)) return DECODE_RESULT_HEADER_ERROR;
+
+	// ヘッダの読み込み
+	if (ReadData(&MainWork, &Head, 0, sizeof(DARC_HEAD), NULL, 0) != DECODE_RESULT_OK) return DECODE_RESULT_HEADER_ERROR;
+
+	// ＩＤの検査
+	if (Head.Head != DXA_HEAD) return DECODE_RESULT_HEADER_ERROR;
+
+	// バージョン検査
+	if (Head.Version > DXA_VER || Head.Version < DXA_VER_MIN) return DECODE_RESULT_HEADER_ERROR;
+
+	const u16 CryptVersion = Head.Flags >> 16;
+
+	DXArchive::InitCryptState(&Crypt, CryptVersion, KeyString_, KeyStringBytes);
+
+	if (Crypt.NewCrypt)
+	{
+		static_assert(sizeof(ArcAesKey) == AES_ROUND_KEY_SIZE, "ArcAesKey has to hold the AES round key and IV");
+
+		const uint8_t *pPwd = Head.Reserve;
+		uint8_t *pK2        = nullptr;
+		const int64_t size  = static_cast<int64_t>(ArcSize);
+		uint8_t dummy       = 0;
+
+		cryptAddresses((uint8_t *)&Head, pPwd, CryptVersion);
+
+		if ((size - 64) < 0x400)
+			return DECODE_RESULT_OK;
+
+		// The whole archive used to be decrypted up front, now only the keys are set up here in the same order
+		// and ArchiveDecrypt removes the archive crypt from the parts that are actually read
+		initWolfCrypt(CryptVersion, pPwd, ArcCryptKey, nullptr, &dummy, 0, 0, true, KeyString_);
+
+		if (CryptVersion >= 1010)
+			pK2 = (uint8_t *)KeyString_ + KeyStringBytes + 1;
+
+		initAES128(ArcAesKey, pPwd, pK2, CryptVersion);
+
+		uint32_t bodySize = 0x400;
+
+		if (isV35(CryptVersion))
+		{
+			uint32_t seed = 0;
+
+			if (CryptVersion >= 1020)
+				seed = pK2[0] * pK2[1] + pPwd[2] * pPwd[4] + pPwd[11];
+			else
+				seed = pPwd[2] * pPwd[4] + pPwd[12]; // xorShift32 seed
+
+			if (!seed) seed = 1;
+			xorshift32(seed);
+
+			if (size >= static_cast<int64_t>(xorshift32() % 500 + 800))
+				xorshift32();
+
+			bodySize = static_cast<uint32_t>(size - 64);
+
+			if (bodySize >= (xorshift32() % 500 + 800))
+				bodySize = (xorshift32() % 500) + 800;
+		}
+
+		if (Head.FileNameTableStartAddress > ArcSize) return DECODE_RESULT_TABLE_ERROR;
+
+		ArcAesBodySize = bodySize; // For v3.31 this has to be 0x400
+		ArcCrypt       = true;
+
+		initWolfCrypt(CryptVersion, pPwd, Crypt.SpecialKey, pK2);
+	}
+
+	// 鍵処理が行われていないかを取得する
+	NoKey = (Head.Flags & DXA_FLAG_NO_KEY) != 0;
+
+	return DECODE_RESULT_OK;
+}
+
+// ヘッダのテーブルを読み込んで検査する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::ReadHeader(void)
+{
+	DECODE_RESULT Result;
+	u64 DirCount = 0;
+
+	// テーブルの位置がヘッダに収まっているか調べる
+	if (Head.FileTableStartAddress > Head.DirectoryTableStartAddress ||
+		Head.DirectoryTableStartAddress > Head.HeadSize ||
+		Head.HeadSize - Head.DirectoryTableStartAddress < sizeof(DARC_DIRECTORY))
+		return DECODE_RESULT_TABLE_ERROR;
+
+	// ヘッダのサイズ分のメモリを確保する
+	HeadBuffer = (u8 *)malloc((size_t)Head.HeadSize);
+	if (HeadBuffer == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+	// ヘッダが圧縮されている場合は解凍する
+	if ((Head.Flags & DXA_FLAG_NO_HEAD_PRESS) != 0)
+	{
+		// 圧縮されていない場合は普通に読み込む
+		Result = ReadData(&MainWork, HeadBuffer, Head.FileNameTableStartAddress, Head.HeadSize, NoKey ? NULL : Key, 0);
+		if (Result != DECODE_RESULT_OK) return Result;
+	}
+	else
+	{
+		u8 *HuffHeadBuffer;
+		u64 HuffHeadSize;
+		u8 *LzHeadBuffer;
+		u64 LzHeadSize;
+
+		// ハフマン圧縮されたヘッダのサイズを取得する
+		if (Head.FileNameTableStartAddress >= ArcSize) return DECODE_RESULT_TABLE_ERROR;
+		HuffHeadSize = ArcSize - Head.FileNameTableStartAddress;
+
+		// ハフマン圧縮されたヘッダをコピーと暗号化解除
+		HuffHeadBuffer = GetWorkBuffer(&MainWork, HuffHeadSize);
+		if (HuffHeadBuffer == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+		Result = ReadData(&MainWork, HuffHeadBuffer, Head.FileNameTableStartAddress, HuffHeadSize, NoKey ? NULL : Key, 0);
+		if (Result != DECODE_RESULT_OK) return Result;
+
+		// ハフマン圧縮されたヘッダの解凍後の容量を取得する
+		// LZ compression never more than doubles the data, anything bigger comes from a wrong key
+		LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
+		if (LzHeadSize < 9 || LzHeadSize > (u64)Head.HeadSize * 2 + 9) return DECODE_RESULT_TABLE_ERROR;
+
+		// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
+		HuffHeadBuffer = GetWorkBuffer(&MainWork, HuffHeadSize + LzHeadSize);
+		if (HuffHeadBuffer == NULL) return DECODE_RESULT_MEMORY_ERROR;
+		LzHeadBuffer = HuffHeadBuffer + HuffHeadSize;
+
+		// ハフマン圧縮されたヘッダを解凍する
+		Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
+
+		// LZ圧縮されたヘッダを解凍する
+		if (!CheckPressData(LzHeadBuffer, LzHeadSize, Head.HeadSize)) return DECODE_RESULT_TABLE_ERROR;
+		if (DXArchive::Decode(LzHeadBuffer, HeadBuffer) != (int)Head.HeadSize) return DECODE_RESULT_TABLE_ERROR;
+	}
+
+	// 各アドレスをセットする
+	NameP    = HeadBuffer;
+	FileP    = NameP + Head.FileTableStartAddress;
+	DirP     = NameP + Head.DirectoryTableStartAddress;
+	NameSize = Head.FileTableStartAddress;
+	FileSize = Head.DirectoryTableStartAddress - Head.FileTableStartAddress;
+	DirSize  = Head.HeadSize - Head.DirectoryTableStartAddress;
+
+	// 展開を始める前にディレクトリのテーブルを全て検査する
+	return CheckDirectory(0, 0, &DirCount);
+}
+
+// ルートディレクトリから展開する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::ExtractAll(void)
+{
+	DECODE_RESULT Result;
+
+	if (ThreadNum <= 1)
+		return DirectoryDecode((DARC_DIRECTORY *)DirP, OutputRoot);
+
+	// 先にディレクトリを全て作成し、展開するファイルの一覧を作る
+	Tasks.clear();
+	Result = CollectTasks((DARC_DIRECTORY *)DirP, OutputRoot);
+	if (Result != DECODE_RESULT_OK) return Result;
+
+	return ExtractParallel();
+}
+
+// 構造化例外を展開結果に変換して呼び出す
+// Anything the table checks did not catch (e.g. a corrupted compressed stream) ends up here as an error code
+// instead of terminating the process, this function must not contain objects that need unwinding
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::GuardedCall(DECODE_RESULT (DXArchiveDecoder::*Func)(void))
+{
+	__try
+	{
+		return (this->*Func)();
+	}
+	__except (GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION || GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR || GetExceptionCode() == EXCEPTION_ARRAY_BOUNDS_EXCEEDED ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return DECODE_RESULT_EXCEPTION;
+	}
+}
+
+// ディレクトリのテーブルを検査する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::CheckDirectory(u64 DirAddress, int Depth, u64 *DirCount)
+{
+	DARC_DIRECTORY *Dir, *Parent;
+	DARC_FILEHEAD *File;
+	DECODE_RESULT Result;
+	u64 i;
+	int j;
+
+	// A directory table with loops would otherwise recurse forever
+	if (Depth > DXA_DECODE_MAX_DEPTH) return DECODE_RESULT_TABLE_ERROR;
+	if (++*DirCount > DirSize / sizeof(DARC_DIRECTORY)) return DECODE_RESULT_TABLE_ERROR;
+
+	if (DirAddress > DirSize || DirSize - DirAddress < sizeof(DARC_DIRECTORY)) return DECODE_RESULT_TABLE_ERROR;
+	Dir = (DARC_DIRECTORY *)(DirP + DirAddress);
+
+	// ファイルヘッダの列がファイルテーブルに収まっているか
+	if (Dir->FileHeadAddress > FileSize || Dir->FileHeadNum > (FileSize - Dir->FileHeadAddress) / sizeof(DARC_FILEHEAD)) return DECODE_RESULT_TABLE_ERROR;
+
+	// CreateKeyFileString walks the parent chain up to the root and appends every directory name
+	Parent = Dir;
+	for (j = 0; Parent->ParentDirectoryAddress != DXA_NONE; j++)
+	{
+		if (j > DXA_DECODE_MAX_DEPTH) return DECODE_RESULT_TABLE_ERROR;
+
+		if (Parent->DirectoryAddress > FileSize || FileSize - Parent->DirectoryAddress < sizeof(DARC_FILEHEAD)) return DECODE_RESULT_TABLE_ERROR;
+		if (!CheckName(((DARC_FILEHEAD *)(FileP + Parent->DirectoryAddress))->NameAddress)) return DECODE_RESULT_TABLE_ERROR;
+
+		if (Parent->ParentDirectoryAddress > DirSize || DirSize - Parent->ParentDirectoryAddress < sizeof(DARC_DIRECTORY)) return DECODE_RESULT_TABLE_ERROR;
+		Parent = (DARC_DIRECTORY *)(DirP + Parent->ParentDirectoryAddress);
+	}
+
+	File = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
+	for (i = 0; i < Dir->FileHeadNum; i++, File++)
+	{
+		if (!CheckName(File->NameAddress)) return DECODE_RESULT_TABLE_ERROR;
+
+		if (File->Attributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			Result = CheckDirectory(File->DataAddress, Depth + 1, DirCount);
+			if (Result != DECODE_RESULT_OK) return Result;
+		}
+	}
+
+	return DECODE_RESULT_OK;
+}
+
+// 指定のディレクトリデータにあるファイルを展開する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::DirectoryDecode(DARC_DIRECTORY *Dir, const std::wstring &OutputDir)
+{
+	std::wstring DirPath = OutputDir;
+	std::wstring Name;
+	DECODE_RESULT Result;
+	DARC_FILEHEAD *File;
+	u64 i;
+
+	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
+	if (Dir->DirectoryAddress != DXA_NONE && Dir->ParentDirectoryAddress != DXA_NONE)
+	{
+		if (!GetFileName((DARC_FILEHEAD *)(FileP + Dir->DirectoryAddress), Name)) return DECODE_RESULT_TABLE_ERROR;
+
+		DirPath = OutputDir + L"\\" + Name;
+		CreateDirectory(DirPath.c_str(), NULL);
+	}
+
+	// 格納されているファイルの数だけ繰り返す
+	File = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
+	for (i = 0; i < Dir->FileHeadNum; i++, File++)
+	{
+		// ディレクトリかどうかで処理を分岐
+		if (File->Attributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			// ディレクトリの場合は再帰をかける
+			Result = DirectoryDecode((DARC_DIRECTORY *)(DirP + File->DataAddress), DirPath);
+		}
+		else
+		{
+			if (!GetFileName(File, Name)) return DECODE_RESULT_TABLE_ERROR;
+
+			Result = FileDecode(&MainWork, Dir, File, DirPath + L"\\" + Name);
+		}
+
+		if (Result != DECODE_RESULT_OK) return Result;
+	}
+
+	return DECODE_RESULT_OK;
+}
+
+// ディレクトリを作成し、展開するファイルを一覧に追加する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::CollectTasks(DARC_DIRECTORY *Dir, const std::wstring &OutputDir)
+{
+	std::wstring DirPath = OutputDir;
+	std::wstring Name;
+	DECODE_RESULT Result;
+	DARC_FILEHEAD *File;
+	u64 i;
+
+	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
+	if (Dir->DirectoryAddress != DXA_NONE && Dir->ParentDirectoryAddress != DXA_NONE)
+	{
+		if (!GetFileName((DARC_FILEHEAD *)(FileP + Dir->DirectoryAddress), Name)) return DECODE_RESULT_TABLE_ERROR;
+
+		DirPath = OutputDir + L"\\" + Name;
+		CreateDirectory(DirPath.c_str(), NULL);
+	}
+
+	File = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
+	for (i = 0; i < Dir->FileHeadNum; i++, File++)
+	{
+		if (File->Attributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			Result = CollectTasks((DARC_DIRECTORY *)(DirP + File->DataAddress), DirPath);
+			if (Result != DECODE_RESULT_OK) return Result;
+		}
+		else
+		{
+			if (!GetFileName(File, Name)) return DECODE_RESULT_TABLE_ERROR;
+
+			Tasks.push_back({ Dir, File, DirPath + L"\\" + Name });
+		}
+	}
+
+	return DECODE_RESULT_OK;
+}
+
+// 一覧のファイルを展開する( 各スレッドで実行 )
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::ExtractTasks(DECODE_WORK *Work)
+{
+	DECODE_RESULT Result;
+	size_t i;
+
+	// 他のスレッドでエラーが発生した場合はそこで終了する
+	for (i = NextTask++; i < Tasks.size() && TaskResult == DECODE_RESULT_OK; i = NextTask++)
+	{
+		Result = FileDecode(Work, Tasks[i].Dir, Tasks[i].File, Tasks[i].FilePath);
+		if (Result != DECODE_RESULT_OK) return Result;
+	}
+
+	return DECODE_RESULT_OK;
+}
+
+// 構造化例外を展開結果に変換して ExtractTasks を呼び出す
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::GuardedExtractTasks(DECODE_WORK *Work)
+{
+	__try
+	{
+		return ExtractTasks(Work);
+	}
+	__except (GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION || GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR || GetExceptionCode() == EXCEPTION_ARRAY_BOUNDS_EXCEEDED ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return DECODE_RESULT_EXCEPTION;
+	}
+}
+
+// 一覧のファイルを複数のスレッドで展開する
+// Every thread has its own work buffer, output file and ( if the archive could not be mapped ) archive file pointer,
+// the tables, the key and the crypt state are only read, so the output is the same as with a single thread
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::ExtractParallel(void)
+{
+	const size_t Num = Tasks.size() < (size_t)ThreadNum ? Tasks.size() : (size_t)ThreadNum;
+	std::vector< DECODE_WORK > Works(Num);
+	std::vector< std::thread > Threads;
+
+	NextTask   = 0;
+	TaskResult = DECODE_RESULT_OK;
+
+	// 呼び出したスレッドは既に開いているアーカイブと作業バッファを使う
+	if (Num == 0) return DECODE_RESULT_OK;
+	Works[0] = MainWork;
+
+	for (size_t i = 0; i < Num; i++)
+	{
+		DECODE_WORK *Work = &Works[i];
+
+		if (i != 0)
+		{
+			memset(Work, 0, sizeof(DECODE_WORK));
+
+			// アーカイブをマップできなかった場合はスレッド毎にアーカイブを開く
+			if (ArcMap.Data == NULL)
+			{
+				Work->ArcP = _tfopen(ArchivePath.c_str(), TEXT("rb"));
+				if (Work->ArcP == NULL)
+				{
+					TaskResult = DECODE_RESULT_OPEN_ERROR;
+					break;
+				}
+			}
+		}
+	}
+
+	auto Worker = [this](DECODE_WORK *Work) {
+		DECODE_RESULT Result;
+
+		try
+		{
+			Result = GuardedExtractTasks(Work);
+		}
+		catch (const std::bad_alloc &)
+		{
+			Result = DECODE_RESULT_MEMORY_ERROR;
+		}
+
+		// 例外で中断した場合も展開中のファイルを閉じる
+		if (Work->DestP != NULL)
+		{
+			fclose(Work->DestP);
+			Work->DestP = NULL;
+		}
+
+		// 最初に発生したエラーを保存する
+		int Expected = DECODE_RESULT_OK;
+		if (Result != DECODE_RESULT_OK)
+			TaskResult.compare_exchange_strong(Expected, Result);
+	};
+
+	if (TaskResult == DECODE_RESULT_OK)
+	{
+		for (size_t i = 1; i < Num; i++)
+			Threads.emplace_back(Worker, &Works[i]);
+
+		Worker(&Works[0]);
+
+		for (std::thread &Thread : Threads)
+			Thread.join();
+	}
+
+	// 呼び出したスレッドの作業用情報を戻して、他のスレッドの作業用情報を解放する
+	MainWork = Works[0];
+	for (size_t i = 1; i < Num; i++)
+		ReleaseWork(&Works[i]);
+
+	return (DECODE_RESULT)TaskResult.load();
+}
+
+// 指定のファイルを展開する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::FileDecode(DECODE_WORK *Work, DARC_DIRECTORY *Dir, DARC_FILEHEAD *File, const std::wstring &FilePath)
+{
+	DECODE_RESULT Result = DECODE_RESULT_OK;
+	char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
+	u8 lKey[DXA_KEY_BYTES];
+	u8 *FileKey = NULL;
+
+	// Sizes this big can not come from a valid archive, reject them before they are used for allocations
+	if (File->DataSize >= DXA_DECODE_SIZE_LIMIT ||
+		(File->PressDataSize != DXA_NONE && File->PressDataSize >= DXA_DECODE_SIZE_LIMIT) ||
+		(File->HuffPressDataSize != DXA_NONE && File->HuffPressDataSize >= DXA_DECODE_SIZE_LIMIT))
+		return DECODE_RESULT_DATA_ERROR;
+
+	// ファイル個別の鍵を作成
+	if (NoKey == false)
+	{
+		size_t KeyStringBufferBytes = DXArchive::CreateKeyFileString((int)Head.CharCodeFormat, KeyString, KeyStringBytes, Dir, File, FileP, DirP, NameP, (u8 *)KeyStringBuffer);
+		DXArchive::KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
+		FileKey = lKey;
+	}
+
+	// ファイルを開く
+	Work->DestP = _tfopen(FilePath.c_str(), TEXT("wb"));
+	if (Work->DestP == NULL) return DECODE_RESULT_OUTPUT_ERROR;
+
+	// データを転送する
+	// The output file is closed on every result, so no thread keeps it open after an error
+	Result = FileTransfer(Work, File, FilePath, FileKey);
+
+	// ファイルを閉じる
+	fclose(Work->DestP);
+	Work->DestP = NULL;
+
+	if (Result != DECODE_RESULT_OK) return Result;
+
+	// ファイルのタイムスタンプと属性を設定する
+	SetFileInfo(File, FilePath);
+
+	return DECODE_RESULT_OK;
+}
+
+// 開いたファイルにデータを転送する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::FileTransfer(DECODE_WORK *Work, DARC_FILEHEAD *File, const std::wstring &FilePath, u8 *FileKey)
+{
+	DECODE_RESULT Result = DECODE_RESULT_OK;
+
+	// データがある場合のみ転送
+	if (File->DataSize != 0)
+	{
+		const u64 DataPos = Head.DataStartAddress + File->DataAddress;
+		const u64 HuffKB  = (u64)Head.HuffmanEncodeKB * 1024;
+		u8 *Temp;
+
+		// データが圧縮されているかどうかで処理を分岐
+		if (File->PressDataSize != DXA_NONE)
+		{
+			// ハフマン圧縮もされているかどうかで処理を分岐
+			if (File->HuffPressDataSize != DXA_NONE)
+			{
+				// ファイルの前後のみハフマン圧縮しているかどうか
+				const bool Split = Head.HuffmanEncodeKB != 0xff && File->PressDataSize > HuffKB * 2;
+
+				// 圧縮データが収まるメモリ領域の確保
+				Temp = GetWorkBuffer(Work, File->HuffPressDataSize + File->PressDataSize + File->DataSize);
+				if (Temp == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+				// 圧縮データの読み込み
+				Result = ReadData(Work, Temp, DataPos, File->HuffPressDataSize, FileKey, File->DataSize);
+				if (Result != DECODE_RESULT_OK) return Result;
+
+				// ハフマン圧縮を解凍
+				if (Huffman_Decode(Temp, NULL) != (Split ? HuffKB * 2 : File->PressDataSize)) return DECODE_RESULT_DATA_ERROR;
+				Huffman_Decode(Temp, Temp + File->HuffPressDataSize);
+
+				if (Split)
+				{
+					// 解凍したデータの内、後ろ半分を移動する
+					memmove(
+						Temp + File->HuffPressDataSize + File->PressDataSize - HuffKB,
+						Temp + File->HuffPressDataSize + HuffKB,
+						HuffKB);
+
+					// 残りのLZ圧縮データを読み込む
+					Result = ReadData(Work,
+						Temp + File->HuffPressDataSize + HuffKB,
+						DataPos + File->HuffPressDataSize,
+						File->PressDataSize - HuffKB * 2,
+						FileKey, File->DataSize + File->HuffPressDataSize);
+					if (Result != DECODE_RESULT_OK) return Result;
+				}
+
+				// 解凍
+				if (!CheckPressData(Temp + File->HuffPressDataSize, File->PressDataSize, File->DataSize)) return DECODE_RESULT_DATA_ERROR;
+				if (DXArchive::Decode(Temp + File->HuffPressDataSize, Temp + File->HuffPressDataSize + File->PressDataSize) != (int)File->DataSize) return DECODE_RESULT_DATA_ERROR;
+
+				// 書き出し
+				Result = WriteData(Work, Temp + File->HuffPressDataSize + File->PressDataSize, File->DataSize, true, FilePath);
+			}
+			else
+			{
+				// 圧縮データが収まるメモリ領域の確保
+				Temp = GetWorkBuffer(Work, File->PressDataSize + File->DataSize);
+				if (Temp == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+				// 圧縮データの読み込み
+				Result = ReadData(Work, Temp, DataPos, File->PressDataSize, FileKey, File->DataSize);
+				if (Result != DECODE_RESULT_OK) return Result;
+
+				// 解凍
+				if (!CheckPressData(Temp, File->PressDataSize, File->DataSize)) return DECODE_RESULT_DATA_ERROR;
+				if (DXArchive::Decode(Temp, Temp + File->PressDataSize) != (int)File->DataSize) return DECODE_RESULT_DATA_ERROR;
+
+				// 書き出し
+				Result = WriteData(Work, Temp + File->PressDataSize, File->DataSize, true, FilePath);
+			}
+		}
+		else
+		{
+			// 圧縮されていない場合
+
+			// ハフマン圧縮はされているかどうかで処理を分岐
+			if (File->HuffPressDataSize != DXA_NONE)
+			{
+				// ファイルの前後のみハフマン圧縮しているかどうか
+				const bool Split = Head.HuffmanEncodeKB != 0xff && File->DataSize > HuffKB * 2;
+
+				// 圧縮データが収まるメモリ領域の確保
+				Temp = GetWorkBuffer(Work, File->HuffPressDataSize + File->DataSize);
+				if (Temp == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+				// 圧縮データの読み込み
+				Result = ReadData(Work, Temp, DataPos, File->HuffPressDataSize, FileKey, File->DataSize);
+				if (Result != DECODE_RESULT_OK) return Result;
+
+				// ハフマン圧縮を解凍
+				if (Huffman_Decode(Temp, NULL) != (Split ? HuffKB * 2 : File->DataSize)) return DECODE_RESULT_DATA_ERROR;
+				Huffman_Decode(Temp, Temp + File->HuffPressDataSize);
+
+				if (Split)
+				{
+					// 解凍したデータの内、後ろ半分を移動する
+					memmove(
+						Temp + File->HuffPressDataSize + File->DataSize - HuffKB,
+						Temp + File->HuffPressDataSize + HuffKB,
+						HuffKB);
+
+					// 残りのデータを読み込む
+					Result = ReadData(Work,
+						Temp + File->HuffPressDataSize + HuffKB,
+						DataPos + File->HuffPressDataSize,
+						File->DataSize - HuffKB * 2,
+						FileKey, File->DataSize + File->HuffPressDataSize);
+					if (Result != DECODE_RESULT_OK) return Result;
+				}
+
+				// 書き出し
+				Result = WriteData(Work, Temp + File->HuffPressDataSize, File->DataSize, true, FilePath);
+			}
+			else if (FileKey == NULL && ArcCrypt == false && ArcMap.Data != NULL)
+			{
+				// 暗号化されていない場合はマップしたアーカイブから直接書き出す
+				if (DataPos > ArcSize || File->DataSize > ArcSize - DataPos) return DECODE_RESULT_DATA_ERROR;
+
+				Result = WriteData(Work, ArcMap.Data + DataPos, File->DataSize, true, FilePath);
+			}
+			else
+			{
+				u64 MoveSize, WriteSize;
+
+				Temp = GetWorkBuffer(Work, File->DataSize > DXA_DECODE_COPY_SIZE ? DXA_DECODE_COPY_SIZE : File->DataSize);
+				if (Temp == NULL) return DECODE_RESULT_MEMORY_ERROR;
+
+				// 転送処理開始
+				WriteSize = 0;
+				while (WriteSize < File->DataSize && Result == DECODE_RESULT_OK)
+				{
+					MoveSize = File->DataSize - WriteSize > DXA_DECODE_COPY_SIZE ? DXA_DECODE_COPY_SIZE : File->DataSize - WriteSize;
+
+					// ファイルの反転読み込み
+					Result = ReadData(Work, Temp, DataPos + WriteSize, MoveSize, FileKey, File->DataSize + WriteSize);
+
+					// 書き出し
+					if (Result == DECODE_RESULT_OK)
+						Result = WriteData(Work, Temp, MoveSize, WriteSize == 0, FilePath);
+
+					WriteSize += MoveSize;
+				}
+			}
+		}
+	}
+
+	return Result;
+}
+
+// 展開したデータを書き出す
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::WriteData(DECODE_WORK *Work, const u8 *Data, u64 Size, bool First, const std::wstring &FilePath)
+{
+	// Remove the anti-unpack message v3.5 puts in front of the basic data files
+	if (First && isV35(Crypt.CryptVersion) && Size >= sizeof(AntiUnpackData) &&
+		memcmp(Data, AntiUnpackData, sizeof(AntiUnpackData)) == 0 && IsUnpackProtectionFile(FilePath))
+	{
+		Data += sizeof(AntiUnpackData);
+		Size -= sizeof(AntiUnpackData);
+	}
+
+	DXArchive::fwrite64((void *)Data, Size, Work->DestP);
+
+	return ferror(Work->DestP) ? DECODE_RESULT_OUTPUT_ERROR : DECODE_RESULT_OK;
+}
+
+// アーカイブからデータを読み込み暗号化を解除する
+DXArchiveDecoder::DECODE_RESULT DXArchiveDecoder::ReadData(DECODE_WORK *Work, void *Buffer, u64 Position, u64 Size, u8 *FileKey, s64 KeyPosition)
+{
+	// 読み込む範囲がアーカイブに収まっているか
+	if (Position > ArcSize || Size > ArcSize - Position) return DECODE_RESULT_DATA_ERROR;
+
+	if (ArcMap.Data != NULL)
+	{
+		memcpy(Buffer, ArcMap.Data + Position, (size_t)Size);
+	}
+	else
+	{
+		// 初期位置をセットする
+		if ((u64)_ftelli64(Work->ArcP) != Position)
+			_fseeki64(Work->ArcP, Position, SEEK_SET);
+
+		DXArchive::fread64(Buffer, Size, Work->ArcP);
+	}
+
+	// アーカイブ全体の暗号化を解除する
+	if (ArcCrypt)
+		ArchiveDecrypt(Buffer, Position, Size);
+
+	// データを鍵文字列を使って Xor 演算
+	if (FileKey != NULL)
+		DXArchive::KeyConv(Buffer, Size, KeyPosition, FileKey, &Crypt);
+
+	return DECODE_RESULT_OK;
+}
+
+// 読み込んだデータのアーカイブ全体に掛けられている暗号化を解除する
+// Does the same as the original in-place decryption of the whole archive, but only for the given range,
+// all layers are XORs with a position dependent key stream so they can be applied to any part independently
+void DXArchiveDecoder::ArchiveDecrypt(void *Buffer, u64 Position, u64 Size) const
+{
+	const u64 End      = Position + Size;
+	const u64 AesStart = Head.FileNameTableStartAddress;
+	u8 *Data           = (u8 *)Buffer;
+	u64 Start, Stop;
+
+	// The header was replaced with the decrypted one before the other layers were applied
+	if (Position < sizeof(DARC_HEAD))
+	{
+		Stop = End < sizeof(DARC_HEAD) ? End : sizeof(DARC_HEAD);
+		memcpy(Data, (const u8 *)&Head + Position, (size_t)(Stop - Position));
+	}
+
+	// wolfCrypt over [ 64, ArcSize - 64 )
+	Start = Position > sizeof(DARC_HEAD) ? Position : sizeof(DARC_HEAD);
+	Stop  = End < ArcSize - sizeof(DARC_HEAD) ? End : ArcSize - sizeof(DARC_HEAD);
+	if (Start < Stop)
+		wolfCrypt(ArcCryptKey, Data + (Start - Position), Start, Stop, false, Crypt.CryptVersion);
+
+	// AES over the beginning of the body
+	Start = Position > sizeof(DARC_HEAD) ? Position : sizeof(DARC_HEAD);
+	Stop  = End < sizeof(DARC_HEAD) + ArcAesBodySize ? End : sizeof(DARC_HEAD) + ArcAesBodySize;
+	if (Start < Stop)
+		aesCtrXCryptAt(Data + (Start - Position), ArcAesKey, Start - sizeof(DARC_HEAD), (size_t)(Stop - Start));
+
+	// AES over the name table up to the end, the counter continues after the blocks of the body
+	Start = Position > AesStart ? Position : AesStart;
+	if (Start < End)
+		aesCtrXCryptAt(Data + (Start - Position), ArcAesKey, (ArcAesBodySize + AES_BLOCKLEN - 1) / AES_BLOCKLEN * AES_BLOCKLEN + (Start - AesStart), (size_t)(End - Start));
+}
+
+// 作業バッファを取得する( 既存の内容は保持される )
+u8 *DXArchiveDecoder::GetWorkBuffer(DECODE_WORK *Work, u64 Size)
+{
+	if (Size > Work->WorkBufferSize)
+	{
+		u8 *NewBuffer = (u8 *)realloc(Work->WorkBuffer, (size_t)(Size + DXA_DECODE_WORK_PADDING));
+		if (NewBuffer == NULL) return NULL;
+
+		Work->WorkBuffer     = NewBuffer;
+		Work->WorkBufferSize = Size;
+	}
+
+	return Work->WorkBuffer;
+}
+
+// ファイル名データが名前テーブルに収まっているか調べる
+bool DXArchiveDecoder::CheckName(u64 NameAddress) const
+{
+	const u8 *Start;
+	u64 Rest, PackBytes;
+
+	if (NameAddress > NameSize || NameSize - NameAddress < 4) return false;
+
+	Start     = NameP + NameAddress + 4;
+	Rest      = NameSize - NameAddress - 4;
+	PackBytes = (u64)*((u16 *)(NameP + NameAddress)) * 4;
+
+	if (PackBytes * 2 > Rest) return false;
+
+	// 名前が無い場合
+	if (PackBytes == 0) return memchr(Start, 0, (size_t)Rest) != NULL;
+
+	// Both the upper case and the original name have to be terminated inside their pack
+	return memchr(Start, 0, (size_t)PackBytes) != NULL && memchr(Start + PackBytes, 0, (size_t)PackBytes) != NULL;
+}
+
+// ファイル名を取得する( パスとして使えない名前の場合は false )
+bool DXArchiveDecoder::GetFileName(DARC_FILEHEAD *File, std::wstring &Name) const
+{
+	TCHAR *pName = DXArchive::GetOriginalFileName(NameP + File->NameAddress);
+	Name         = pName;
+	delete[] pName;
+
+	// Never write outside of the output directory
+	if (Name.empty() || Name == L"." || Name == L".." || Name.find_first_of(L"\\/:") != std::wstring::npos)
+		return false;
+
+	return true;
+}
+
+// ファイルのタイムスタンプと属性を設定する
+void DXArchiveDecoder::SetFileInfo(DARC_FILEHEAD *File, const std::wstring &FilePath) const
+{
+	// ファイルのタイムスタンプを設定する
+	{
+		HANDLE HFile;
+		FILETIME CreateTime, LastAccessTime, LastWriteTime;
+
+		HFile = CreateFile(FilePath.c_str(),
+						   GENERIC_WRITE, 0, NULL,
+						   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (HFile != INVALID_HANDLE_VALUE)
+		{
+			CreateTime.dwHighDateTime     = (u32)(File->Time.Create >> 32);
+			CreateTime.dwLowDateTime      = (u32)(File->Time.Create & 0xffffffffffffffff);
+			LastAccessTime.dwHighDateTime = (u32)(File->Time.LastAccess >> 32);
+			LastAccessTime.dwLowDateTime  = (u32)(File->Time.LastAccess & 0xffffffffffffffff);
+			LastWriteTime.dwHighDateTime  = (u32)(File->Time.LastWrite >> 32);
+			LastWriteTime.dwLowDateTime   = (u32)(File->Time.LastWrite & 0xffffffffffffffff);
+			SetFileTime(HFile, &CreateTime, &LastAccessTime, &LastWriteTime);
+			CloseHandle(HFile);
+		}
+	}
+
+	// ファイル属性を付ける
+	SetFileAttributes(FilePath.c_str(), (u32)File->Attributes & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
+}
+
+// 作業用情報のリソースを解放する
+void DXArchiveDecoder::ReleaseWork(DECODE_WORK *Work)
+{
+	if (Work->ArcP != NULL) fclose(Work->ArcP);
+	if (Work->DestP != NULL) fclose(Work->DestP);
+	if (Work->WorkBuffer != NULL) free(Work->WorkBuffer);
+
+	memset(Work, 0, sizeof(DECODE_WORK));
+}
+
+// 確保したリソースを解放する
+void DXArchiveDecoder::Release(void)
+{
+	ReleaseWork(&MainWork);
+
+	if (ArcMap.Data != NULL) CloseFileMap(&ArcMap);
+	if (HeadBuffer != NULL) free(HeadBuffer);
+
+	ArcCrypt   = false;
+	HeadBuffer = NULL;
+	NameP = FileP = DirP = NULL;
+
+	Tasks.clear();
+}
+
+// LZ 圧縮データのヘッダが展開後のサイズと圧縮データのサイズに合っているか調べる
+static bool CheckPressData(const u8 *Src, u64 SrcSize, u64 DestSize)
+{
+	if (SrcSize < 9) return false;
+
+	const u32 PressDestSize = *((u32 *)&Src[0]);
+	const u32 PressSrcSize  = *((u32 *)&Src[4]);
+
+	return PressDestSize == DestSize && PressSrcSize >= 9 && PressSrcSize <= SrcSize;
+}
+
+// Checks if the file is one of the files v3.5 protects against unpacking
+static bool IsUnpackProtectionFile(const std::wstring &FilePath)
+{
+	std::wstring FileName = FilePath;
+	std::transform(FileName.begin(), FileName.end(), FileName.begin(), [](const wchar_t &c) { return static_cast<wchar_t>(std::towlower(c)); });
+
+	// As I am not sure if the file name will contain only the actual file name or also a directory
+	// check if the file name ends with any of the unpack protection files
+	for (const wchar_t *UnpackProtectionFile : UnpackProtectionFiles)
+	{
+		if (FileName.ends_with(UnpackProtectionFile))
+			return true;
+	}
+
+	return false;
+}
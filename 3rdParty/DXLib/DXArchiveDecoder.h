@@ -0,0 +1,117 @@
+﻿// -------------------------------------------------------------------------------
+//
+// 		ＤＸライブラリアーカイバ 展開クラス
+//
+//	Re-entrant version of DXArchive::DecodeArchive, all crypt state is kept per
+//	instance and the output is written below an explicit output directory, so
+//	several archives can be decoded in the same process at the same time
+//
+// -------------------------------------------------------------------------------
+
+// 多重インクルード防止用定義
+#ifndef DX_ARCHIVE_DECODER_H
+#define DX_ARCHIVE_DECODER_H
+
+// include --------------------------------------
+#include "DXArchive.h"
+#include "FileLib.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// class ----------------------------------------
+
+// アーカイブ展開クラス
+class DXArchiveDecoder
+{
+public :
+	// 展開結果
+	enum DECODE_RESULT
+	{
+		DECODE_RESULT_OK = 0,			// 成功
+		DECODE_RESULT_OPEN_ERROR,		// アーカイブファイルを開けなかった
+		DECODE_RESULT_HEADER_ERROR,		// DX アーカイブではない、又は対応していないバージョン
+		DECODE_RESULT_TABLE_ERROR,		// ヘッダのテーブルが壊れている( 鍵が違う場合も含む )
+		DECODE_RESULT_DATA_ERROR,		// ファイルのデータが壊れている
+		DECODE_RESULT_MEMORY_ERROR,		// メモリの確保に失敗した
+		DECODE_RESULT_OUTPUT_ERROR,		// 出力先のファイル、又はディレクトリを作成できなかった
+		DECODE_RESULT_EXCEPTION,		// 展開中に例外が発生した
+	} ;
+
+	DXArchiveDecoder() ;
+	~DXArchiveDecoder() ;
+
+	DXArchiveDecoder( const DXArchiveDecoder & ) = delete ;
+	DXArchiveDecoder &operator=( const DXArchiveDecoder & ) = delete ;
+
+	DECODE_RESULT		DecodeArchive( const TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_ = NULL ) ;	// アーカイブファイルを OutputPath 以下に展開する( OutputPath が空の場合はカレントディレクトリ )
+	void				SetThreadNum( int Num ) ;				// 展開に使うスレッドの数を設定する( 1 以下の場合は呼び出したスレッドだけで順番に展開する )
+
+	static const TCHAR	*GetResultString( DECODE_RESULT Result ) ;		// 展開結果の説明文を取得する
+
+protected :
+	// 展開作業用の情報( スレッド毎に一つ )
+	struct DECODE_WORK
+	{
+		FILE *ArcP ;						// アーカイブファイルのポインタ( ArcMap が無い場合 )
+		FILE *DestP ;						// 展開中のファイルのポインタ
+		u8 *WorkBuffer ;					// 展開用の作業バッファ
+		u64 WorkBufferSize ;				// 作業バッファのサイズ
+	} ;
+
+	// 展開するファイルの情報
+	struct DECODE_TASK
+	{
+		DARC_DIRECTORY *Dir ;				// ファイルが含まれるディレクトリ
+		DARC_FILEHEAD *File ;				// ファイルヘッダ
+		std::wstring FilePath ;				// 展開先のパス
+	} ;
+
+	DARC_CRYPTSTATE Crypt ;				// 暗号化処理の状態
+	DARC_HEAD Head ;					// アーカイブのヘッダ
+	std::wstring ArchivePath ;			// アーカイブファイルのパス
+	FILE_MAP ArcMap ;					// メモリにマップしたアーカイブ( マップできなかった場合はファイルから読み込む )
+	bool ArcCrypt ;						// アーカイブ全体が暗号化されているかどうか( NewCrypt の場合のみ )
+	u8 ArcCryptKey[ 768 ] ;				// アーカイブ全体に掛けられている wolfCrypt の鍵
+	u8 ArcAesKey[ 192 ] ;				// アーカイブの先頭と名前テーブル以降に掛けられている AES の鍵と IV
+	u64 ArcAesBodySize ;				// アーカイブの先頭の AES で暗号化されているサイズ
+	u64 ArcSize ;						// アーカイブファイルのサイズ
+	u8 *HeadBuffer ;					// ヘッダーバッファー
+	u8 *NameP, *FileP, *DirP ;			// 各種テーブルへのポインタ
+	u64 NameSize, FileSize, DirSize ;	// 各種テーブルのサイズ
+	bool NoKey ;						// 鍵処理を行わないかどうか
+	u8 Key[ DXA_KEY_BYTES ] ;			// 鍵
+	char KeyString[ DXA_KEY_STRING_LENGTH + 1 ] ;	// 鍵文字列
+	size_t KeyStringBytes ;				// 鍵文字列のバイト数
+	std::wstring OutputRoot ;			// 展開先のディレクトリ
+	DECODE_WORK MainWork ;				// 呼び出したスレッドの作業用情報
+	int ThreadNum ;						// 展開に使うスレッドの数
+	std::vector< DECODE_TASK > Tasks ;	// 並列展開するファイルの一覧
+	std::atomic< size_t > NextTask ;		// 次に展開するファイルの番号
+	std::atomic< int > TaskResult ;		// 並列展開の結果( 最初に発生したエラー )
+
+	DECODE_RESULT OpenArchive( const TCHAR *ArchiveName, const char *KeyString_ ) ;					// アーカイブを開き、ヘッダと暗号化処理の状態を準備する
+	DECODE_RESULT ReadHeader( void ) ;																	// ヘッダのテーブルを読み込んで検査する
+	DECODE_RESULT ExtractAll( void ) ;																	// ルートディレクトリから展開する
+	DECODE_RESULT GuardedCall( DECODE_RESULT ( DXArchiveDecoder::*Func )( void ) ) ;					// 構造化例外を展開結果に変換して呼び出す
+	DECODE_RESULT CheckDirectory( u64 DirAddress, int Depth, u64 *DirCount ) ;							// ディレクトリのテーブルを検査する
+	DECODE_RESULT DirectoryDecode( DARC_DIRECTORY *Dir, const std::wstring &OutputDir ) ;				// 指定のディレクトリデータにあるファイルを展開する
+	DECODE_RESULT CollectTasks( DARC_DIRECTORY *Dir, const std::wstring &OutputDir ) ;					// ディレクトリを作成し、展開するファイルを一覧に追加する
+	DECODE_RESULT ExtractTasks( DECODE_WORK *Work ) ;													// 一覧のファイルを展開する( 各スレッドで実行 )
+	DECODE_RESULT GuardedExtractTasks( DECODE_WORK *Work ) ;											// 構造化例外を展開結果に変換して ExtractTasks を呼び出す
+	DECODE_RESULT ExtractParallel( void ) ;																// 一覧のファイルを複数のスレッドで展開する
+	DECODE_RESULT FileDecode( DECODE_WORK *Work, DARC_DIRECTORY *Dir, DARC_FILEHEAD *File, const std::wstring &FilePath ) ;	// 指定のファイルを展開する
+	DECODE_RESULT FileTransfer( DECODE_WORK *Work, DARC_FILEHEAD *File, const std::wstring &FilePath, u8 *FileKey ) ;		// 開いたファイルにデータを転送する
+	DECODE_RESULT WriteData( DECODE_WORK *Work, const u8 *Data, u64 Size, bool First, const std::wstring &FilePath ) ;		// 展開したデータを書き出す
+	DECODE_RESULT ReadData( DECODE_WORK *Work, void *Buffer, u64 Position, u64 Size, u8 *FileKey, s64 KeyPosition ) ;		// アーカイブからデータを読み込み暗号化を解除する
+	void ArchiveDecrypt( void *Buffer, u64 Position, u64 Size ) const ;								// 読み込んだデータのアーカイブ全体に掛けられている暗号化を解除する
+	u8 *GetWorkBuffer( DECODE_WORK *Work, u64 Size ) ;													// 作業バッファを取得する
+	bool CheckName( u64 NameAddress ) const ;															// ファイル名データが名前テーブルに収まっているか調べる
+	bool GetFileName( DARC_FILEHEAD *File, std::wstring &Name ) const ;									// ファイル名を取得する( パスとして使えない名前の場合は false )
+	void SetFileInfo( DARC_FILEHEAD *File, const std::wstring &FilePath ) const ;						// ファイルのタイムスタンプと属性を設定する
+	void ReleaseWork( DECODE_WORK *Work ) ;																// 作業用情報のリソースを解放する
+	void Release( void ) ;																				// 確保したリソースを解放する
+} ;
+
+#endif
@@ -689,6 +689,19 @@ void DXArchive_VER5::KeyConvFileRead( void *Data, int Size, FILE *fp, unsigned c
 	KeyConv( Data, Size, pos, Key ) ;
 }
 
+// マップしたファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEYSTR_LENGTH_VER5 の長さがなければならない )
+int DXArchive_VER5::KeyConvMapRead( void *Data, int Size, const FILE_MAP *Map, u64 Address, unsigned char *Key, int Position )
+{
+	// 読み込む
+	if( ReadFileMap( Map, Data, Address, Size ) < 0 ) return -1 ;
+
+	// データを鍵文字列を使って Xor 演算
+	KeyConv( Data, Size, Position == -1 ? ( int )Address : Position, Key ) ;
+
+	// 終了
+	return 0 ;
+}
+
 /*
 // ２バイト文字か調べる( TRUE:２バイト文字 FALSE:１バイト文字 )
 int DXArchive_VER5::CheckMultiByteChar( const char *Buf )
@@ -920,7 +933,7 @@ NOPRESS:
 }
 
 // 指定のディレクトリデータにあるファイルを展開する
-int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, FILE *ArcP, unsigned char *Key )
+int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, const FILE_MAP *ArcMap, unsigned char *Key )
 {
 	TCHAR DirPath[MAX_PATH] ;
 	
@@ -960,18 +973,14 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 			if( File->Attributes & FILE_ATTRIBUTE_DIRECTORY )
 			{
 				// ディレクトリの場合は再帰をかける
-				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER5 * )( DirP + File->DataAddress ), ArcP, Key ) ;
+				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER5 * )( DirP + File->DataAddress ), ArcMap, Key ) ;
 			}
 			else
 			{
 				FILE *DestP ;
-				void *Buffer ;
+				u64 DataPos ;
 			
 				// ファイルの場合は展開する
-				
-				// バッファを確保する
-				Buffer = malloc( DXA_BUFFERSIZE_VER5 ) ;
-				if( Buffer == NULL ) return -1 ;
 
 				// ファイルを開く
 				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
@@ -979,11 +988,10 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 				delete[] pName;
 				
 				// データがある場合のみ転送
-				if( File->DataSize != 0 )
+				if( DestP != NULL && File->DataSize != 0 )
 				{
 					// 初期位置をセットする
-					if( ftell( ArcP ) != ( s32 )( Head->DataStartAddress + File->DataAddress ) )
-						fseek( ArcP, Head->DataStartAddress + File->DataAddress, SEEK_SET ) ;
+					DataPos = ( u64 )Head->DataStartAddress + File->DataAddress ;
 						
 					// データが圧縮されているかどうかで処理を分岐
 					if( Head->Version >= 0x0002 && File->PressDataSize != 0xffffffff )
@@ -993,26 +1001,20 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						// 圧縮されている場合
 
 						// 圧縮データが収まるメモリ領域の確保
-						temp = malloc( File->PressDataSize + File->DataSize ) ;
+						temp = malloc( ( size_t )File->PressDataSize + File->DataSize ) ;
 
 						// 圧縮データの読み込み
-						if( Head->Version >= 0x0005 )
+						if( temp != NULL && KeyConvMapRead( temp, File->PressDataSize, ArcMap, DataPos, Key, Head->Version >= 0x0005 ? ( int )File->DataSize : -1 ) == 0 )
 						{
-							KeyConvFileRead( temp, File->PressDataSize, ArcP, Key, File->DataSize ) ;
-						}
-						else
-						{
-							KeyConvFileRead( temp, File->PressDataSize, ArcP, Key ) ;
-						}
-						
-						// 解凍
-						Decode( temp, (u8 *)temp + File->PressDataSize ) ;
+							// 解凍
+							Decode( temp, (u8 *)temp + File->PressDataSize ) ;
 						
-						// 書き出し
-						fwrite( (u8 *)temp + File->PressDataSize, File->DataSize, 1, DestP ) ;
+							// 書き出し
+							fwrite( (u8 *)temp + File->PressDataSize, File->DataSize, 1, DestP ) ;
+						}
 						
 						// メモリの解放
-						free( temp ) ;
+						if( temp != NULL ) free( temp ) ;
 					}
 					else
 					{
@@ -1021,6 +1023,15 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						// 転送処理開始
 						{
 							u32 MoveSize, WriteSize ;
+							void *Buffer ;
+
+							// バッファを確保する( ファイルより大きくは確保しない )
+							Buffer = malloc( File->DataSize > DXA_BUFFERSIZE_VER5 ? DXA_BUFFERSIZE_VER5 : File->DataSize ) ;
+							if( Buffer == NULL )
+							{
+								fclose( DestP ) ;
+								return -1 ;
+							}
 							
 							WriteSize = 0 ;
 							while( WriteSize < File->DataSize )
@@ -1028,29 +1039,23 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE_VER5 ? DXA_BUFFERSIZE_VER5 : File->DataSize - WriteSize ;
 
 								// ファイルの反転読み込み
-								if( Head->Version >= 0x0005 )
-								{
-									KeyConvFileRead( Buffer, MoveSize, ArcP, Key, File->DataSize + WriteSize ) ;
-								}
-								else
-								{
-									KeyConvFileRead( Buffer, MoveSize, ArcP, Key ) ;
-								}
+								if( KeyConvMapRead( Buffer, MoveSize, ArcMap, DataPos + WriteSize, Key, Head->Version >= 0x0005 ? ( int )( File->DataSize + WriteSize ) : -1 ) < 0 )
+									break ;
 
 								// 書き出し
 								fwrite( Buffer, MoveSize, 1, DestP ) ;
 								
 								WriteSize += MoveSize ;
 							}
+
+							// バッファを開放する
+							free( Buffer ) ;
 						}
 					}
 				}
 				
 				// ファイルを閉じる
-				fclose( DestP ) ;
-
-				// バッファを開放する
-				free( Buffer ) ;
+				if( DestP != NULL ) fclose( DestP ) ;
 
 				// ファイルのタイムスタンプを設定する
 				{
@@ -1915,16 +1920,15 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	u8 *HeadBuffer = NULL ;
 	DARC_HEAD_VER5 Head ;
 	u8 *FileP, *NameP, *DirP ;
-	FILE *ArcP = NULL ;
+	FILE_MAP ArcMap ;
 	TCHAR OldDir[MAX_PATH] ;
 	u8 Key[DXA_KEYSTR_LENGTH_VER5] ;
 
 	// 鍵文字列の作成
 	KeyCreate( KeyString, Key ) ;
 
-	// アーカイブファイルを開く
-	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
-	if( ArcP == NULL ) return -1 ;
+	// アーカイブファイルをメモリにマップする
+	if( OpenFileMap( ArchiveName, &ArcMap ) < 0 ) return -1 ;
 
 	// 出力先のディレクトリにカレントディレクトリを変更する
 	GetCurrentDirectory( MAX_PATH, OldDir ) ;
@@ -1932,7 +1936,7 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 
 	// ヘッダを解析する
 	{
-		KeyConvFileRead( &Head, sizeof( DARC_HEAD_VER5 ), ArcP, Key, 0 ) ;
+		if( KeyConvMapRead( &Head, sizeof( DARC_HEAD_VER5 ), &ArcMap, 0, Key, 0 ) < 0 ) goto ERR ;
 
 		// ＩＤの検査
 		if( Head.Head != DXA_HEAD_VER5 )
@@ -1940,8 +1944,7 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 			// バージョン２以前か調べる
 			memset( Key, 0xffffffff, DXA_KEYSTR_LENGTH_VER5 ) ;
 
-			fseek( ArcP, 0L, SEEK_SET ) ;
-			KeyConvFileRead( &Head, sizeof( DARC_HEAD_VER5 ), ArcP, Key, 0 ) ;
+			KeyConvMapRead( &Head, sizeof( DARC_HEAD_VER5 ), &ArcMap, 0, Key, 0 ) ;
 
 			// バージョン２以前でもない場合はエラー
 			if( Head.Head != DXA_HEAD_VER5 )
@@ -1956,15 +1959,8 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 		if( HeadBuffer == NULL ) goto ERR ;
 		
 		// ヘッダパックをメモリに読み込む
-		fseek( ArcP, Head.FileNameTableStartAddress, SEEK_SET ) ;
-		if( Head.Version >= 0x0005 )
-		{
-			KeyConvFileRead( HeadBuffer, Head.HeadSize, ArcP, Key, 0 ) ;
-		}
-		else
-		{
-			KeyConvFileRead( HeadBuffer, Head.HeadSize, ArcP, Key ) ;
-		}
+		if( KeyConvMapRead( HeadBuffer, Head.HeadSize, &ArcMap, Head.FileNameTableStartAddress, Key, Head.Version >= 0x0005 ? 0 : -1 ) < 0 )
+			goto ERR ;
 		
 		// 各アドレスをセットする
 		NameP = HeadBuffer ;
@@ -1973,10 +1969,10 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	}
 
 	// アーカイブの展開を開始する
-	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER5 * )DirP, ArcP, Key ) ;
+	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER5 * )DirP, &ArcMap, Key ) ;
 	
 	// ファイルを閉じる
-	fclose( ArcP ) ;
+	CloseFileMap( &ArcMap ) ;
 	
 	// ヘッダを読み込んでいたメモリを解放する
 	free( HeadBuffer ) ;
@@ -1989,7 +1985,7 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 
 ERR :
 	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
-	if( ArcP != NULL ) fclose( ArcP ) ;
+	CloseFileMap( &ArcMap ) ;
 
 	// カレントディレクトリを元に戻す
 	SetCurrentDirectory( OldDir ) ;
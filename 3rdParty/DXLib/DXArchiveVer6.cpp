@@ -544,6 +544,19 @@ void DXArchive_VER6::KeyConvFileRead( void *Data, s64 Size, FILE *fp, unsigned c
 	KeyConv( Data, Size, pos, Key ) ;
 }
 
+// マップしたファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEYSTR_LENGTH_VER6 の長さがなければならない )
+int DXArchive_VER6::KeyConvMapRead( void *Data, s64 Size, const FILE_MAP *Map, u64 Address, unsigned char *Key, s64 Position )
+{
+	// 読み込む
+	if( ReadFileMap( Map, Data, Address, Size ) < 0 ) return -1 ;
+
+	// データを鍵文字列を使って Xor 演算
+	KeyConv( Data, Size, Position, Key ) ;
+
+	// 終了
+	return 0 ;
+}
+
 /*
 // ２バイト文字か調べる( TRUE:２バイト文字 FALSE:１バイト文字 )
 int DXArchive_VER6::CheckMultiByteChar( const char *Buf )
@@ -776,7 +789,7 @@ NOPRESS:
 #include <vector>
 
 // 指定のディレクトリデータにあるファイルを展開する
-int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER6 *Head, DARC_DIRECTORY_VER6 *Dir, FILE *ArcP, unsigned char *Key )
+int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER6 *Head, DARC_DIRECTORY_VER6 *Dir, const FILE_MAP *ArcMap, unsigned char *Key )
 {
 	TCHAR DirPath[MAX_PATH] ;
 	
@@ -816,18 +829,14 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 			if( File->Attributes & FILE_ATTRIBUTE_DIRECTORY )
 			{
 				// ディレクトリの場合は再帰をかける
-				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER6 * )( DirP + File->DataAddress ), ArcP, Key ) ;
+				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER6 * )( DirP + File->DataAddress ), ArcMap, Key ) ;
 			}
 			else
 			{
 				FILE *DestP ;
-				void *Buffer ;
+				u64 DataPos ;
 			
 				// ファイルの場合は展開する
-				
-				// バッファを確保する
-				Buffer = malloc( DXA_BUFFERSIZE_VER6 ) ;
-				if( Buffer == NULL ) return -1 ;
 
 				// ファイルを開く
 				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
@@ -837,11 +846,10 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 				delete[] pName;
 			
 				// データがある場合のみ転送
-				if( File->DataSize != 0 )
+				if( DestP != NULL && File->DataSize != 0 )
 				{
 					// 初期位置をセットする
-					if( _ftelli64( ArcP ) != ( s32 )( Head->DataStartAddress + File->DataAddress ) )
-						_fseeki64( ArcP, Head->DataStartAddress + File->DataAddress, SEEK_SET ) ;
+					DataPos = Head->DataStartAddress + File->DataAddress ;
 						
 					// データが圧縮されているかどうかで処理を分岐
 					if( File->PressDataSize != 0xffffffffffffffff )
@@ -854,16 +862,17 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						temp = malloc( ( size_t )( File->PressDataSize + File->DataSize ) ) ;
 
 						// 圧縮データの読み込み
-						KeyConvFileRead( temp, File->PressDataSize, ArcP, Key, File->DataSize ) ;
-						
-						// 解凍
-						Decode( temp, (u8 *)temp + File->PressDataSize ) ;
+						if( temp != NULL && KeyConvMapRead( temp, File->PressDataSize, ArcMap, DataPos, Key, File->DataSize ) == 0 )
+						{
+							// 解凍
+							Decode( temp, (u8 *)temp + File->PressDataSize ) ;
 						
-						// 書き出し
-						fwrite64( (u8 *)temp + File->PressDataSize, File->DataSize, DestP ) ;
+							// 書き出し
+							fwrite64( (u8 *)temp + File->PressDataSize, File->DataSize, DestP ) ;
+						}
 						
 						// メモリの解放
-						free( temp ) ;
+						if( temp != NULL ) free( temp ) ;
 					}
 					else
 					{
@@ -872,6 +881,15 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						// 転送処理開始
 						{
 							u64 MoveSize, WriteSize ;
+							void *Buffer ;
+
+							// バッファを確保する( ファイルより大きくは確保しない )
+							Buffer = malloc( ( size_t )( File->DataSize > DXA_BUFFERSIZE_VER6 ? DXA_BUFFERSIZE_VER6 : File->DataSize ) ) ;
+							if( Buffer == NULL )
+							{
+								fclose( DestP ) ;
+								return -1 ;
+							}
 							
 							WriteSize = 0 ;
 							while( WriteSize < File->DataSize )
@@ -879,22 +897,23 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE_VER6 ? DXA_BUFFERSIZE_VER6 : File->DataSize - WriteSize ;
 
 								// ファイルの反転読み込み
-								KeyConvFileRead( Buffer, MoveSize, ArcP, Key, File->DataSize + WriteSize ) ;
+								if( KeyConvMapRead( Buffer, MoveSize, ArcMap, DataPos + WriteSize, Key, File->DataSize + WriteSize ) < 0 )
+									break ;
 
 								// 書き出し
 								fwrite64( Buffer, MoveSize, DestP ) ;
 								
 								WriteSize += MoveSize ;
 							}
+
+							// バッファを開放する
+							free( Buffer ) ;
 						}
 					}
 				}
 				
 				// ファイルを閉じる
-				fclose( DestP ) ;
-
-				// バッファを開放する
-				free( Buffer ) ;
+				if( DestP != NULL ) fclose( DestP ) ;
 
 				// ファイルのタイムスタンプを設定する
 				{
@@ -1760,16 +1779,15 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	u8 *HeadBuffer = NULL ;
 	DARC_HEAD_VER6 Head ;
 	u8 *FileP, *NameP, *DirP ;
-	FILE *ArcP = NULL ;
+	FILE_MAP ArcMap ;
 	TCHAR OldDir[MAX_PATH] ;
 	u8 Key[DXA_KEYSTR_LENGTH_VER6] ;
 
 	// 鍵文字列の作成
 	KeyCreate( KeyString, Key ) ;
 
-	// アーカイブファイルを開く
-	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
-	if( ArcP == NULL ) return -1 ;
+	// アーカイブファイルをメモリにマップする
+	if( OpenFileMap( ArchiveName, &ArcMap ) < 0 ) return -1 ;
 
 	// 出力先のディレクトリにカレントディレクトリを変更する
 	GetCurrentDirectory( MAX_PATH, OldDir ) ;
@@ -1777,7 +1795,7 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 
 	// ヘッダを解析する
 	{
-		KeyConvFileRead( &Head, sizeof( DARC_HEAD_VER6 ), ArcP, Key, 0 ) ;
+		if( KeyConvMapRead( &Head, sizeof( DARC_HEAD_VER6 ), &ArcMap, 0, Key, 0 ) < 0 ) goto ERR ;
 
 		// ＩＤの検査
 		if( Head.Head != DXA_HEAD_VER6 )
@@ -1791,8 +1809,7 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 		if( HeadBuffer == NULL ) goto ERR ;
 		
 		// ヘッダパックをメモリに読み込む
-		_fseeki64( ArcP, Head.FileNameTableStartAddress, SEEK_SET ) ;
-		KeyConvFileRead( HeadBuffer, Head.HeadSize, ArcP, Key, 0 ) ;
+		if( KeyConvMapRead( HeadBuffer, Head.HeadSize, &ArcMap, Head.FileNameTableStartAddress, Key, 0 ) < 0 ) goto ERR ;
 		
 		// 各アドレスをセットする
 		NameP = HeadBuffer ;
@@ -1801,10 +1818,10 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	}
 
 	// アーカイブの展開を開始する
-	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER6 * )DirP, ArcP, Key ) ;
+	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER6 * )DirP, &ArcMap, Key ) ;
 	
 	// ファイルを閉じる
-	fclose( ArcP ) ;
+	CloseFileMap( &ArcMap ) ;
 	
 	// ヘッダを読み込んでいたメモリを解放する
 	free( HeadBuffer ) ;
@@ -1817,7 +1834,7 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 
 ERR :
 	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
-	if( ArcP != NULL ) fclose( ArcP ) ;
+	CloseFileMap( &ArcMap ) ;
 
 	// カレントディレクトリを元に戻す
 	SetCurrentDirectory( OldDir ) ;
@@ -15,6 +15,7 @@
 // include --------------------------------------
 #include <stdio.h>
 #include <tchar.h>
+#include "FileLib.h"
 
 // define ---------------------------------------
 
@@ -202,6 +203,7 @@ public:
 	static void KeyConv(void* Data, s64 Size, s64 Position, unsigned char* Key);	// 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEYSTR_LENGTH の長さがなければならない )
 	static void KeyConvFileWrite(void* Data, s64 Size, FILE* fp, unsigned char* Key, s64 Position = -1);	// データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEYSTR_LENGTH の長さがなければならない )
 	static void KeyConvFileRead(void* Data, s64 Size, FILE* fp, unsigned char* Key, s64 Position = -1);	// ファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEYSTR_LENGTH の長さがなければならない )
+	static int KeyConvMapRead(void* Data, s64 Size, const FILE_MAP* Map, u64 Address, unsigned char* Key, s64 Position);	// マップしたファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( 0:成功  -1:範囲外 )
 	static DATE_RESULT DateCmp(DARC_FILETIME_VER6* date1, DARC_FILETIME_VER6* date2);		// どちらが新しいかを比較する
 	static int Encode(void* Src, u32 SrcSize, void* Dest);						// データを圧縮する( 戻り値:圧縮後のデータサイズ )
 	static int Decode(void* Src, void* Dest);									// データを解凍する( 戻り値:解凍後のデータサイズ )
@@ -246,7 +248,7 @@ protected:
 	} SEARCHDATA;
 
 	static int DirectoryEncode(TCHAR* DirectoryName, u8* NameP, u8* DirP, u8* FileP, DARC_DIRECTORY_VER6* ParentDir, SIZESAVE* Size, int DataNumber, FILE* DestP, void* TempBuffer, bool Press, unsigned char* Key);	// 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
-	static int DirectoryDecode(u8* NameP, u8* DirP, u8* FileP, DARC_HEAD_VER6* Head, DARC_DIRECTORY_VER6* Dir, FILE* ArcP, unsigned char* Key);											// 指定のディレクトリデータにあるファイルを展開する
+	static int DirectoryDecode(u8* NameP, u8* DirP, u8* FileP, DARC_HEAD_VER6* Head, DARC_DIRECTORY_VER6* Dir, const FILE_MAP* ArcMap, unsigned char* Key);											// 指定のディレクトリデータにあるファイルを展開する
 	static int StrICmp(const TCHAR* Str1, const TCHAR* Str2);							// 比較対照の文字列中の大文字を小文字として扱い比較する( 0:等しい  1:違う )
 	static int ConvSearchData(SEARCHDATA* Dest, const TCHAR* Src, int* Length);		// 文字列を検索用のデータに変換( ヌル文字か \ があったら終了 )
 	static int AddFileNameData(const TCHAR* FileName, u8* FileNameTable);				// ファイル名データを追加する( 戻り値は使用したデータバイト数 )
@@ -694,6 +694,69 @@ extern int SaveFileMem( const TCHAR *Path, void *Data, size_t Size )
 	return 0 ;
 }
 
+// ファイルを読み込み専用でメモリにマップする( 0:成功  -1:失敗 )
+extern int OpenFileMap( const TCHAR *Path, FILE_MAP *FileMap )
+{
+	HANDLE FileHandle = INVALID_HANDLE_VALUE ;
+	HANDLE MapHandle = NULL ;
+	LARGE_INTEGER Size ;
+	void *Data ;
+
+	memset( FileMap, 0, sizeof( FILE_MAP ) ) ;
+
+	FileHandle = CreateFile( Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL ) ;
+	if( FileHandle == INVALID_HANDLE_VALUE ) goto ERR ;
+
+	// サイズが０のファイルはマップできない
+	if( GetFileSizeEx( FileHandle, &Size ) == FALSE || Size.QuadPart == 0 ) goto ERR ;
+
+	// 32bit 環境ではアドレス空間に収まらない場合がある
+	if( ( u64 )Size.QuadPart > ( u64 )( ( size_t )-1 ) ) goto ERR ;
+
+	MapHandle = CreateFileMapping( FileHandle, NULL, PAGE_READONLY, 0, 0, NULL ) ;
+	if( MapHandle == NULL ) goto ERR ;
+
+	Data = MapViewOfFile( MapHandle, FILE_MAP_READ, 0, 0, 0 ) ;
+	if( Data == NULL ) goto ERR ;
+
+	// セット
+	FileMap->FileHandle = FileHandle ;
+	FileMap->MapHandle  = MapHandle ;
+	FileMap->Data       = ( const u8 * )Data ;
+	FileMap->Size       = ( u64 )Size.QuadPart ;
+
+	// 終了
+	return 0 ;
+
+ERR :
+	if( MapHandle != NULL ) CloseHandle( MapHandle ) ;
+	if( FileHandle != INVALID_HANDLE_VALUE ) CloseHandle( FileHandle ) ;
+
+	return -1 ;
+}
+
+// マップしたファイルを閉じる
+extern int CloseFileMap( FILE_MAP *FileMap )
+{
+	if( FileMap->Data != NULL ) UnmapViewOfFile( FileMap->Data ) ;
+	if( FileMap->MapHandle != NULL ) CloseHandle( FileMap->MapHandle ) ;
+	if( FileMap->FileHandle != NULL ) CloseHandle( FileMap->FileHandle ) ;
+
+	memset( FileMap, 0, sizeof( FILE_MAP ) ) ;
+
+	return 0 ;
+}
+
+// マップしたファイルからデータをコピーする( 0:成功  -1:範囲外 )
+extern int ReadFileMap( const FILE_MAP *FileMap, void *Buffer, u64 Position, u64 Size )
+{
+	if( FileMap->Data == NULL || Position > FileMap->Size || Size > FileMap->Size - Position ) return -1 ;
+
+	memcpy( Buffer, FileMap->Data + Position, ( size_t )Size ) ;
+
+	return 0 ;
+}
+
 
 // 指定のディレクトリを作成する、中間のディレクトリも存在しない場合は作成する
 // 最後尾に '\' があっても無視する
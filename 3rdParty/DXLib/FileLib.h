@@ -47,6 +47,15 @@ typedef struct tagFILE_INFOLIST
 	FILE_INFO  *List ;			// ディレクトリ内のファイルの情報を格納した配列へのポインタ
 } FILE_INFOLIST ;
 
+// 読み込み専用でメモリにマップしたファイル
+typedef struct tagFILE_MAP
+{
+	void *FileHandle ;			// ファイルのハンドル
+	void *MapHandle ;			// ファイルマッピングオブジェクトのハンドル
+	const u8 *Data ;			// マップしたファイルの先頭アドレス
+	u64 Size ;					// ファイルのサイズ
+} FILE_MAP ;
+
 // data -----------------------------------------
 
 // function proto type --------------------------
@@ -65,6 +74,10 @@ extern int LoadFileMem( const TCHAR *Path, void **DataBuf, size_t *Size ) ;		//
 extern int LoadFileMem( const TCHAR *Path, void *DataBuf,  size_t *Size ) ;		// ファイルの内容をメモリに読み込む( 0:成功  -1:失敗 )
 extern int SaveFileMem( const TCHAR *Path, void *Data,     size_t  Size ) ;		// メモリの内容をファイルに書き出す 
 
+extern int OpenFileMap( const TCHAR *Path, FILE_MAP *FileMap ) ;								// ファイルを読み込み専用でメモリにマップする( 0:成功  -1:失敗 )
+extern int CloseFileMap( FILE_MAP *FileMap ) ;													// マップしたファイルを閉じる
+extern int ReadFileMap( const FILE_MAP *FileMap, void *Buffer, u64 Position, u64 Size ) ;		// マップしたファイルからデータをコピーする( 0:成功  -1:範囲外 )
+
 // 指定のディレクトリを作成する、中間のディレクトリも存在しない場合は作成する
 // 最後尾に '\' があっても無視する
 // ドライブ名の後に '\' がない場合は正常に動作しない
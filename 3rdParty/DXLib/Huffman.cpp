@@ -14,6 +14,12 @@
 #include <stdio.h>
 #include <malloc.h>
 #include <string.h>
+#include <algorithm>
+
+// define ---------------------------------------
+
+#define HUFFMAN_TABLE_BITS		(11)		// 展開用テーブルで一度に解凍するビット数
+#define HUFFMAN_TABLE_SYMBOLS	(3)			// 展開用テーブルの一要素で解凍する最大の数値の数
 
 // data type ------------------------------------
 
@@ -29,6 +35,15 @@ struct HUFFMAN_NODE
     int ChildNode[2] ;            // このデータが結合させた２要素の要素配列インデックス( 結合データではない場合はどちらも -1 )
 } ;
 
+// 展開用テーブルの要素、HUFFMAN_TABLE_BITS ビットのビット列で始まる数値を纏めて解凍する
+struct HUFFMAN_DECODE_ENTRY
+{
+	u8 Symbol[ HUFFMAN_TABLE_SYMBOLS ] ;	// ビット列に収まる数値
+	u8 SymbolNum ;							// ビット列に収まる数値の数( 0 の場合は最初の数値のビット列が HUFFMAN_TABLE_BITS より長い )
+	u8 BitNum ;								// Symbol のビット列のビット数の合計
+	u16 Node ;								// SymbolNum が 0 の場合に HUFFMAN_TABLE_BITS ビット辿った先の結合データ
+} ;
+
 // ビット単位入出力用データ構造体
 struct BIT_STREAM
 {
@@ -55,6 +70,9 @@ static void BitStream_Write( BIT_STREAM *BitStream, u8 BitNum, u64 OutputData )
 static u64  BitStream_Read(  BIT_STREAM *BitStream, u8 BitNum ) ;						// ビット単位の数値の読み込みを行う
 static u8   BitStream_GetBitNum( u64 Data ) ;											// 指定の数値のビット数を取得する
 static u64  BitStream_GetBytes( BIT_STREAM *BitStream ) ;								// ビット単位の入出力データのサイズ( バイト数 )を取得する
+static void Huffman_BuildTree( const u16 *Weight, u16 ( *Child )[ 2 ] ) ;				// 出現数から圧縮時と同じ結合データを構築する
+static void Huffman_BuildDecodeTable( const u16 ( *Child )[ 2 ], HUFFMAN_DECODE_ENTRY *Table ) ;	// 結合データから展開用テーブルを作成する
+static void Huffman_FillBitBuffer( u64 *BitBuffer, u32 *BitCount, const u8 **Data, const u8 *DataEnd ) ;	// ビットバッファに 56 ビット以上のビットデータを補充する
 
 // code -----------------------------------------
 
@@ -127,6 +145,143 @@ u64 BitStream_GetBytes( BIT_STREAM *BitStream )
 	return BitStream->Bytes + ( BitStream->Bits != 0 ? 1 : 0 ) ;
 }
 
+// 出現数から圧縮時と同じ結合データを構築する
+//
+// 圧縮時は残っている要素の中から出現数が一番少ない要素と二番目に少ない要素を総当たりで探して結合する、
+// 出現数が同じ場合は要素配列のインデックスが小さい方が選ばれる。
+// 結合データは出現数の少ない順に作られ、数値データより後ろのインデックスに作られるので、
+// 出現数とインデックス順に並べた数値データと作った順の結合データの先頭を比べるだけで同じ順番で選べる
+void Huffman_BuildTree( const u16 *Weight, u16 ( *Child )[ 2 ] )
+{
+	u32 SortKey[ 256 ] ;
+	u64 NodeWeight[ 256 + 255 ] ;
+	int LeafIndex, NodeIndex, NodeNum, MinNode[ 2 ] ;
+	int i, j ;
+
+	// 数値データを出現数とインデックスの順に並べる
+	for( i = 0 ; i < 256 ; i ++ )
+	{
+		SortKey[ i ] = ( ( u32 )Weight[ i ] << 8 ) | i ;
+		NodeWeight[ i ] = Weight[ i ] ;
+	}
+	std::sort( SortKey, SortKey + 256 ) ;
+
+	// 一番目と二番目に出現数の少ない要素を繋いで新しい結合データを作成する
+	LeafIndex = 0 ;
+	NodeIndex = 256 ;
+	for( NodeNum = 256 ; NodeNum < 256 + 255 ; NodeNum ++ )
+	{
+		for( j = 0 ; j < 2 ; j ++ )
+		{
+			if( LeafIndex < 256 && ( NodeIndex == NodeNum || NodeWeight[ SortKey[ LeafIndex ] & 0xff ] <= NodeWeight[ NodeIndex ] ) )
+			{
+				MinNode[ j ] = SortKey[ LeafIndex ] & 0xff ;
+				LeafIndex ++ ;
+			}
+			else
+			{
+				MinNode[ j ] = NodeIndex ;
+				NodeIndex ++ ;
+			}
+		}
+
+		NodeWeight[ NodeNum ] = NodeWeight[ MinNode[ 0 ] ] + NodeWeight[ MinNode[ 1 ] ] ;
+		Child[ NodeNum - 256 ][ 0 ] = ( u16 )MinNode[ 0 ] ;
+		Child[ NodeNum - 256 ][ 1 ] = ( u16 )MinNode[ 1 ] ;
+	}
+}
+
+// 結合データから展開用テーブルを作成する
+void Huffman_BuildDecodeTable( const u16 ( *Child )[ 2 ], HUFFMAN_DECODE_ENTRY *Table )
+{
+	u16 TableNode[ 1 << HUFFMAN_TABLE_BITS ] ;
+	u8 TableBitNum[ 1 << HUFFMAN_TABLE_BITS ] ;
+	int StackNode[ HUFFMAN_TABLE_BITS + 1 ], StackBitNum[ HUFFMAN_TABLE_BITS + 1 ], StackBits[ HUFFMAN_TABLE_BITS + 1 ] ;
+	int StackNum, NodeIndex, BitNum, Bits ;
+	int i, j ;
+
+	// 天辺から HUFFMAN_TABLE_BITS ビットまで辿って、各ビット列で最初に辿り着く数値データか
+	// HUFFMAN_TABLE_BITS ビット目の結合データを求める
+	StackNode[ 0 ]   = 256 + 254 ;
+	StackBitNum[ 0 ] = 0 ;
+	StackBits[ 0 ]   = 0 ;
+	StackNum         = 1 ;
+	while( StackNum > 0 )
+	{
+		StackNum -- ;
+		NodeIndex = StackNode[ StackNum ] ;
+		BitNum    = StackBitNum[ StackNum ] ;
+		Bits      = StackBits[ StackNum ] ;
+
+		if( NodeIndex > 255 && BitNum < HUFFMAN_TABLE_BITS )
+		{
+			for( j = 0 ; j < 2 ; j ++ )
+			{
+				StackNode[ StackNum ]   = Child[ NodeIndex - 256 ][ j ] ;
+				StackBitNum[ StackNum ] = BitNum + 1 ;
+				StackBits[ StackNum ]   = Bits | ( j << BitNum ) ;
+				StackNum ++ ;
+			}
+			continue ;
+		}
+
+		// 残りのビットがどんな値でも同じ要素になる
+		for( i = Bits ; i < ( 1 << HUFFMAN_TABLE_BITS ) ; i += 1 << BitNum )
+		{
+			TableNode[ i ]   = ( u16 )NodeIndex ;
+			TableBitNum[ i ] = ( u8 )BitNum ;
+		}
+	}
+
+	// ビット列に収まるだけ続けて数値を解凍できるようにする
+	for( i = 0 ; i < ( 1 << HUFFMAN_TABLE_BITS ) ; i ++ )
+	{
+		HUFFMAN_DECODE_ENTRY *Entry = &Table[ i ] ;
+
+		Entry->SymbolNum = 0 ;
+		Entry->BitNum    = 0 ;
+		Entry->Node      = TableNode[ i ] ;
+		memset( Entry->Symbol, 0, sizeof( Entry->Symbol ) ) ;
+
+		// 上位の使っていないビットは 0 なので、残りのビット数に収まる数値だけ使える
+		while( Entry->SymbolNum < HUFFMAN_TABLE_SYMBOLS )
+		{
+			j = i >> Entry->BitNum ;
+			if( TableNode[ j ] > 255 || Entry->BitNum + TableBitNum[ j ] > HUFFMAN_TABLE_BITS ) break ;
+
+			Entry->Symbol[ Entry->SymbolNum ] = ( u8 )TableNode[ j ] ;
+			Entry->SymbolNum ++ ;
+			Entry->BitNum += TableBitNum[ j ] ;
+		}
+	}
+}
+
+// ビットバッファに 56 ビット以上のビットデータを補充する( データの終端より後ろは 0 として扱う )
+void Huffman_FillBitBuffer( u64 *BitBuffer, u32 *BitCount, const u8 **Data, const u8 *DataEnd )
+{
+	u64 Bits ;
+
+	// ８バイト読める場合は纏めて読み込み、使い切ったバイトの分だけ進める
+	if( DataEnd - *Data >= 8 )
+	{
+		memcpy( &Bits, *Data, sizeof( Bits ) ) ;
+		*BitBuffer |= Bits << *BitCount ;
+		*Data      += ( 63 - *BitCount ) >> 3 ;
+		*BitCount  |= 56 ;
+		return ;
+	}
+
+	while( *BitCount <= 56 )
+	{
+		if( *Data < DataEnd )
+		{
+			*BitBuffer |= ( u64 )**Data << *BitCount ;
+			( *Data ) ++ ;
+		}
+		*BitCount += 8 ;
+	}
+}
+
 // データを圧縮
 //
 // 戻り値:圧縮後のサイズ  0 はエラー  Dest に NULL を入れると圧縮データ格納に必要なサイズが返る
@@ -500,10 +655,11 @@ u64 Huffman_Encode( void *Src, u64 SrcSize, void *Dest )
 // 戻り値:解凍後のサイズ  0 はエラー  Dest に NULL を入れると解凍データ格納に必要なサイズが返る
 u64 Huffman_Decode( void *Press, void *Dest )
 {
-    // 結合データと数値データ、０～２５５までが数値データ
-    HUFFMAN_NODE Node[256 + 255] ;
+    // 結合データの子、Child[ 結合データのインデックス - 256 ][ ビット ]
+    u16 Child[ 255 ][ 2 ] ;
+	HUFFMAN_DECODE_ENTRY Table[ 1 << HUFFMAN_TABLE_BITS ] ;
 
-    u64 PressSizeCounter, DestSizeCounter, DestSize ;
+    u64 DestSizeCounter, DestSize ;
     unsigned char *PressPoint, *DestPoint ;
 	u64 OriginalSize ;
 	u64 PressSize ;
@@ -550,324 +706,82 @@ u64 Huffman_Decode( void *Press, void *Dest )
     // 解凍後のデータのサイズを取得する
     DestSize = OriginalSize ;
 
-    // 各数値の結合データを構築する
-    {
-        int NodeIndex, MinNode1, MinNode2 ;
-        int NodeNum, DataNum ;
-
-        // 数値データを初期化する
-        for( i = 0 ; i < 256 + 255 ; i ++ )
-        {
-            Node[i].Weight = Weight[i] ;    // 出現数は保存しておいたデータからコピー
-            Node[i].ChildNode[0] = -1 ;    // 数値データが終点なので -1 をセットする
-            Node[i].ChildNode[1] = -1 ;    // 数値データが終点なので -1 をセットする
-            Node[i].ParentNode = -1 ;      // まだどの要素とも結合されていないので -1 をセットする
-        }
-
-        // 出現数の少ない数値データ or 結合データを繋いで
-        // 新しい結合データを作成、全ての要素を繋いで残り１個になるまで繰り返す
-        // (圧縮時と同じコードです)
-        DataNum = 256 ; // 残り要素数
-        NodeNum = 256 ; // 次に新しく作る結合データの要素配列のインデックス
-        while( DataNum > 1 )
-        {
-            // 出現数値の低い要素二つを探す
-            {
-                MinNode1 = -1 ;
-                MinNode2 = -1 ;
-                
-                // 残っている要素全てを調べるまでループ
-                NodeIndex = 0 ;
-                for( i = 0 ; i < DataNum ; NodeIndex ++ )
-                {
-                    // もう既に何処かの要素と結合されている場合は対象外
-                    if( Node[NodeIndex].ParentNode != -1 ) continue ;
-                    
-                    i ++ ;
-                    
-                    // まだ有効な要素をセットしていないか、より出現数値の
-                    // 少ない要素が見つかったら更新
-                    if( MinNode1 == -1 || Node[MinNode1].Weight > Node[NodeIndex].Weight )
-                    {
-                        // 今まで一番出現数値が少なかったと思われた
-                        // 要素は二番目に降格
-                        MinNode2 = MinNode1 ;
-
-                        // 新しい一番の要素の要素配列のインデックスを保存
-                        MinNode1 = NodeIndex ;
-                    }
-                    else
-                    {
-                        // 一番よりは出現数値が多くても、二番目よりは出現数値が
-                        // 少ないかもしれないので一応チェック(又は二番目に出現数値の
-                        // 少ない要素がセットされていなかった場合もセット)
-                        if( MinNode2 == -1 || Node[MinNode2].Weight > Node[NodeIndex].Weight )
-                        {
-                            MinNode2 = NodeIndex ;
-                        }
-                    }
-                }
-            }
-            
-            // 二つの要素を繋いで新しい要素(結合データ)を作る
-            Node[NodeNum].ParentNode = -1 ;  // 新しいデータは当然まだ何処とも繋がっていないので -1 
-            Node[NodeNum].Weight = Node[MinNode1].Weight + Node[MinNode2].Weight ;    // 出現数値は二つの数値を足したものをセットする
-            Node[NodeNum].ChildNode[0] = MinNode1 ;    // この結合部で 0 を選んだら出現数値が一番少ない要素に繋がる
-            Node[NodeNum].ChildNode[1] = MinNode2 ;    // この結合部で 1 を選んだら出現数値が二番目に少ない要素に繋がる
-
-            // 結合された要素二つに、自分達に何の値が割り当てられたかをセットする
-            Node[MinNode1].Index = 0 ;    // 一番出現数値が少ない要素は 0 番
-            Node[MinNode2].Index = 1 ;    // 二番目に出現数値が少ない要素は 1 番
-
-            // 結合された要素二つに、自分達を結合した結合データの要素配列インデックスをセットする
-            Node[MinNode1].ParentNode = NodeNum ;
-            Node[MinNode2].ParentNode = NodeNum ;
-
-            // 要素の数を一個増やす
-            NodeNum ++ ;
-
-            // 残り要素の数は、一つ要素が新しく追加された代わりに
-            // 二つの要素が結合されて検索の対象から外れたので
-            // 結果 1 - 2 で -1 
-            DataNum -- ;
-        }
-
-        // 各数値の圧縮時のビット列を割り出す
-        {
-            unsigned char TempBitArray[32] ;
-            int TempBitIndex, TempBitCount, BitIndex, BitCount ;
-        
-            // 数値データと結合データの数だけ繰り返す
-            for( i = 0 ; i < 256 + 254 ; i ++ )
-            {
-                // 数値データから結合データを上へ上へと辿ってビット数を数える
-                {
-                    // ビット数を初期化しておく
-                    Node[i].BitNum = 0 ;
-                    
-                    // 一時的に数値データから遡っていったときのビット列を保存する処理の準備
-                    TempBitIndex = 0 ;
-                    TempBitCount = 0 ;
-                    TempBitArray[TempBitIndex] = 0 ;
-                    
-                    // 何処かと結合されている限りカウントし続ける(天辺は何処とも結合されていないので終点だと分かる)
-                    for( NodeIndex = ( int )i ; Node[NodeIndex].ParentNode != -1 ; NodeIndex = Node[NodeIndex].ParentNode )
-                    {
-                        // 配列要素一つに入るビットデータは８個なので、同じ配列要素に
-                        // 既に８個保存していたら次の配列要素に保存先を変更する
-                        if( TempBitCount == 8 )
-                        {
-                            TempBitCount = 0 ;
-                            TempBitIndex ++ ;
-                            TempBitArray[TempBitIndex] = 0 ;
-                        }
-                        
-                        // 新しく書き込む情報で今までのデータを上書きしてしまわないように１ビット左にシフトする
-                        TempBitArray[TempBitIndex] <<= 1 ;
-
-                        // 結合データに割り振られたインデックスを最下位ビット(一番右側のビット)に書き込む
-                        TempBitArray[TempBitIndex] |= (unsigned char)Node[NodeIndex].Index ;
-
-                        // 保存したビット数を増やす
-                        TempBitCount ++ ;
-
-                        // ビット数を増やす
-                        Node[i].BitNum ++ ;
-                    }
-                }
-				
-                // TempBitArray に溜まったデータは数値データから結合データを天辺に向かって
-                // 上へ上へと遡っていった時のビット列なので、逆さまにしないと圧縮後のビット
-                // 配列として使えない(展開時に天辺の結合データから数値データまで辿ることが
-                // 出来ない)ので、順序を逆さまにしたものを数値データ内のビット列バッファに保存する
-                {
-                    BitCount = 0 ;
-                    BitIndex = 0 ;
-                    
-                    // 最初のバッファを初期化しておく
-                    // (全部 論理和(or)演算 で書き込むので、最初から１になっている
-                    // ビットに０を書き込んでも１のままになってしまうため)
-                    Node[i].BitArray[BitIndex] = 0 ;
-                    
-                    // 一時的に保存しておいたビット列の最初まで遡る
-                    while( TempBitIndex >= 0 )
-                    {
-                        // 書き込んだビット数が一つの配列要素に入る８ビットに
-                        // 達してしまったら次の配列要素に移る
-                        if( BitCount == 8 )
-                        {
-                            BitCount = 0 ;
-                            BitIndex ++ ;
-                            Node[i].BitArray[BitIndex] = 0 ;
-                        }
-
-                        // まだ何も書き込まれていないビットアドレスに１ビット書き込む
-                        Node[i].BitArray[BitIndex] |= (unsigned char)( ( TempBitArray[TempBitIndex] & 1 ) << BitCount ) ;
-						
-                        // 書き込み終わったビットはもういらないので次のビットを
-                        // 書き込めるように１ビット右にシフトする
-                        TempBitArray[TempBitIndex] >>= 1 ;
-                        
-                        // １ビット書き込んだので残りビット数を１個減らす
-                        TempBitCount -- ;
-                        
-                        // もし現在書き込み元となっている配列要素に書き込んでいない
-                        // ビット情報が無くなったら次の配列要素に移る
-                        if( TempBitCount == 0 )
-                        {
-                            TempBitIndex -- ;
-                            TempBitCount = 8 ;
-                        }
-                        
-                        // 書き込んだビット数を増やす
-                        BitCount ++ ;
-                    }
-                }
-            }
-		}
-    }
-
-    // 解凍処理
-    {
-        unsigned char *PressData ;
-        int PressBitCounter, PressBitData, Index, NodeIndex ;
-		int NodeIndexTable[ 512 ] ;
-		int j ;
+	// 圧縮時と同じ結合データを構築して展開用テーブルを作成する
+	Huffman_BuildTree( Weight, Child ) ;
+	Huffman_BuildDecodeTable( Child, Table ) ;
 
-		// 各ビット配列がどのノードに繋がるかのテーブルを作成する
+	// 解凍処理
+	{
+		const u8 *PressData, *PressEnd ;
+		const HUFFMAN_DECODE_ENTRY *Entry ;
+		u64 BitBuffer ;
+		u32 BitCount ;
+		int NodeIndex ;
+
+		// 圧縮データ本体の先頭アドレスをセット
+		// (圧縮データ本体は元のサイズ、圧縮後のサイズ、各数値の出現数等を
+		// 格納するデータ領域の後にある)
+		PressData = PressPoint + HeadSize ;
+		PressEnd  = PressData + PressSize ;
+
+		// ビットデータは最下位ビットから順に使う
+		BitBuffer = 0 ;
+		BitCount  = 0 ;
+
+		// 圧縮前のデータサイズになるまで解凍処理を繰り返す
+		DestSizeCounter = 0 ;
+		while( DestSizeCounter < DestSize )
 		{
-			u16 BitMask[ 9 ] ;
-
-			for( i = 0 ; i < 9 ; i ++ )
+			if( BitCount < HUFFMAN_TABLE_BITS )
 			{
-				BitMask[ i ] = ( u16 )( ( 1 << ( i + 1 ) ) - 1 ) ;
+				Huffman_FillBitBuffer( &BitBuffer, &BitCount, &PressData, PressEnd ) ;
 			}
 
-			for( i = 0 ; i < 512 ; i ++ )
+			// テーブルで解凍できる数値を全て出力する
+			Entry = &Table[ BitBuffer & ( ( 1 << HUFFMAN_TABLE_BITS ) - 1 ) ] ;
+			if( Entry->SymbolNum != 0 )
 			{
-				NodeIndexTable[ i ] = -1 ;
-
-				// ビット列に適合したノードを探す
-				for( j = 0 ; j < 256 + 254 ; j ++ )
+				if( DestSize - DestSizeCounter >= HUFFMAN_TABLE_SYMBOLS )
 				{
-					u16 BitArray01 ;
-
-					if( Node[ j ].BitNum > 9 )
-					{
-						continue ;
-					}
-
-					BitArray01 = ( u16 )Node[ j ].BitArray[ 0 ] | ( Node[ j ].BitArray[ 1 ] << 8 ) ;
-					if( ( i & BitMask[ Node[ j ].BitNum - 1 ] ) == ( BitArray01 & BitMask[ Node[ j ].BitNum - 1 ] ) )
+					DestPoint[ DestSizeCounter     ] = Entry->Symbol[ 0 ] ;
+					DestPoint[ DestSizeCounter + 1 ] = Entry->Symbol[ 1 ] ;
+					DestPoint[ DestSizeCounter + 2 ] = Entry->Symbol[ 2 ] ;
+					DestSizeCounter += Entry->SymbolNum ;
+				}
+				else
+				{
+					for( i = 0 ; i < Entry->SymbolNum && DestSizeCounter < DestSize ; i ++ )
 					{
-						NodeIndexTable[ i ] = j ;
-						break ;
+						DestPoint[ DestSizeCounter ] = Entry->Symbol[ i ] ;
+						DestSizeCounter ++ ;
 					}
 				}
-			}
-		}
-
-        // 圧縮データ本体の先頭アドレスをセット
-        // (圧縮データ本体は元のサイズ、圧縮後のサイズ、各数値の出現数等を
-        // 格納するデータ領域の後にある)
-        PressData = PressPoint + HeadSize ;
 
-        // 解凍したデータの格納アドレスを初期化
-        DestSizeCounter = 0 ;
-        
-        // 圧縮データの参照アドレスを初期化
-        PressSizeCounter = 0 ;
-        
-        // 圧縮ビットデータのカウンタを初期化
-        PressBitCounter = 0 ;
-        
-        // 圧縮データの１バイト目をセット
-        PressBitData = PressData[PressSizeCounter] ;
+				BitBuffer >>= Entry->BitNum ;
+				BitCount   -= Entry->BitNum ;
+				continue ;
+			}
 
-        // 圧縮前のデータサイズになるまで解凍処理を繰り返す
-        for( DestSizeCounter = 0 ; DestSizeCounter < DestSize ; DestSizeCounter ++ )
-        {
-            // ビット列から数値データを検索する
-            {
-				// 最後の17byte分のデータは天辺から探す( 最後の次のバイトを読み出そうとしてメモリの不正なアクセスになる可能性があるため )
-				if( DestSizeCounter >= DestSize - 17 )
+			// ビット列がテーブルより長い場合は残りを１ビットずつ辿る
+			BitBuffer >>= HUFFMAN_TABLE_BITS ;
+			BitCount   -= HUFFMAN_TABLE_BITS ;
+			for( NodeIndex = Entry->Node ; NodeIndex > 255 ; )
+			{
+				if( BitCount == 0 )
 				{
-					// 結合データの天辺は一番最後の結合データが格納される５１０番目(０番から数える)
-					// 天辺から順に下に降りていく
-					NodeIndex = 510 ;
+					Huffman_FillBitBuffer( &BitBuffer, &BitCount, &PressData, PressEnd ) ;
 				}
-				else
-				{
-					// それ以外の場合はテーブルを使用する
-
-                    // もし PressBitData に格納されている全ての
-                    // ビットデータを使い切ってしまった場合は次の
-                    // ビットデータをセットする
-                    if( PressBitCounter == 8 )
-                    {
-                        PressSizeCounter ++ ;
-                        PressBitData = PressData[PressSizeCounter] ;
-                        PressBitCounter = 0 ;
-                    }
-
-					// 圧縮データを9bit分用意する
-					PressBitData = ( PressBitData | ( PressData[ PressSizeCounter + 1 ] << ( 8 - PressBitCounter ) ) ) & 0x1ff ;
 
-					// テーブルから最初の結合データを探す
-					NodeIndex = NodeIndexTable[ PressBitData ] ;
-
-					// 使った分圧縮データのアドレスを進める
-					PressBitCounter += Node[ NodeIndex ].BitNum ;
-					if( PressBitCounter >= 16 )
-					{
-						PressSizeCounter += 2 ;
-						PressBitCounter -= 16 ;
-						PressBitData = PressData[PressSizeCounter] >> PressBitCounter ;
-					}
-					else
-					if( PressBitCounter >= 8 )
-					{
-						PressSizeCounter ++ ;
-						PressBitCounter -= 8 ;
-						PressBitData = PressData[PressSizeCounter] >> PressBitCounter ;
-					}
-					else
-					{
-						PressBitData >>= Node[ NodeIndex ].BitNum ;
-					}
-				}
-                
-                // 数値データに辿り着くまで結合データを下りていく
-                while( NodeIndex > 255 )
-                {
-                    // もし PressBitData に格納されている全ての
-                    // ビットデータを使い切ってしまった場合は次の
-                    // ビットデータをセットする
-                    if( PressBitCounter == 8 )
-                    {
-                        PressSizeCounter ++ ;
-                        PressBitData = PressData[PressSizeCounter] ;
-                        PressBitCounter = 0 ;
-                    }
-                    
-                    // １ビット取得する
-                    Index = PressBitData & 1 ;
-                    
-                    // 使用した１ビット分だけ右にシフトする
-                    PressBitData >>= 1 ;
-                    
-                    // 使用したビット数を一個増やす
-                    PressBitCounter ++ ;
-                    
-                    // 次の要素(結合データか数値データかはまだ分からない)に移る
-                    NodeIndex = Node[NodeIndex].ChildNode[Index] ;
-                }
-            }
+				NodeIndex = Child[ NodeIndex - 256 ][ BitBuffer & 1 ] ;
+				BitBuffer >>= 1 ;
+				BitCount -- ;
+			}
 
-            // 辿り着いた数値データを出力
-            DestPoint[DestSizeCounter] = (unsigned char)NodeIndex ;
-        }
-    }
+			// 辿り着いた数値データを出力
+			DestPoint[ DestSizeCounter ] = ( u8 )NodeIndex ;
+			DestSizeCounter ++ ;
+		}
+	}
 
     // 解凍後のサイズを返す
     return OriginalSize ;
@@ -0,0 +1,163 @@
+﻿/*
+ *  File: KeyXor.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
+// XOR kernels for the archive key streams
+// Both DXArchive::KeyConv and wolfCrypt boil down to pData[i] ^= pStream[i] ^ mask over runs of a precomputed stream,
+// the 7 byte key is expanded to a page that is a multiple of its period and the wolfCrypt key table already is a 256 byte page
+// whose bytes only change by the constant mask of the higher counters
+namespace keyXor
+{
+// Size of the expanded repeating key, 8 * 56 so every vector width and the 7 byte period fit into it without a remainder
+static constexpr std::size_t KEY_PAGE_SIZE = 448;
+
+// --- SIMD Implementations ---
+
+inline void xorStreamPlain(uint8_t *pData, const uint8_t *pStream, const std::size_t size, const uint8_t mask)
+{
+	for (std::size_t i = 0; i < size; i++)
+		pData[i] ^= pStream[i] ^ mask;
+}
+
+inline void xorStreamSSE2(uint8_t *pData, const uint8_t *pStream, const std::size_t size, const uint8_t mask)
+{
+	constexpr std::size_t simd_width = 16;
+
+	const __m128i vMask = _mm_set1_epi8(static_cast<char>(mask));
+	std::size_t i       = 0;
+
+	for (; i + simd_width <= size; i += simd_width)
+	{
+		__m128i data   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pData + i));
+		__m128i stream = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pStream + i));
+		data           = _mm_xor_si128(data, _mm_xor_si128(stream, vMask));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pData + i), data);
+	}
+
+	// Fallback for remaining bytes
+	xorStreamPlain(pData + i, pStream + i, size - i, mask);
+}
+
+inline void xorStreamAVX2(uint8_t *pData, const uint8_t *pStream, const std::size_t size, const uint8_t mask)
+{
+	constexpr std::size_t simd_width = 32;
+
+	const __m256i vMask = _mm256_set1_epi8(static_cast<char>(mask));
+	std::size_t i       = 0;
+
+	for (; i + simd_width <= size; i += simd_width)
+	{
+		__m256i data   = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pData + i));
+		__m256i stream = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pStream + i));
+		data           = _mm256_xor_si256(data, _mm256_xor_si256(stream, vMask));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(pData + i), data);
+	}
+
+	// Fallback for remaining bytes
+	xorStreamSSE2(pData + i, pStream + i, size - i, mask);
+}
+
+inline void xorStreamAVX512(uint8_t *pData, const uint8_t *pStream, const std::size_t size, const uint8_t mask)
+{
+	constexpr std::size_t simd_width = 64;
+
+	const __m512i vMask = _mm512_set1_epi8(static_cast<char>(mask));
+	std::size_t i       = 0;
+
+	for (; i + simd_width <= size; i += simd_width)
+	{
+		__m512i data   = _mm512_loadu_si512(pData + i);
+		__m512i stream = _mm512_loadu_si512(pStream + i);
+		data           = _mm512_xor_si512(data, _mm512_xor_si512(stream, vMask));
+		_mm512_storeu_si512(pData + i, data);
+	}
+
+	// Fallback for remaining bytes
+	xorStreamAVX2(pData + i, pStream + i, size - i, mask);
+}
+
+// --- Dispatcher ---
+
+using XorStreamFunction = void (*)(uint8_t *, const uint8_t *, const std::size_t, const uint8_t);
+
+inline XorStreamFunction selectXorStreamFunc(const simd::CpuFeatures &features)
+{
+	if (features.avx512f && features.avx512bw)
+		return xorStreamAVX512;
+	else if (features.avx2)
+		return xorStreamAVX2;
+	else if (features.sse2)
+		return xorStreamSSE2;
+	else
+		return xorStreamPlain;
+}
+
+// The features are only detected once, the function is called from several decoder threads
+inline XorStreamFunction xorStreamFunc()
+{
+	static const XorStreamFunction func = selectXorStreamFunc(simd::detectCpuFeatures());
+	return func;
+}
+
+// pData[i] ^= pStream[i] ^ mask
+inline void xorStream(uint8_t *pData, const uint8_t *pStream, const std::size_t size, const uint8_t mask = 0)
+{
+	if (size < 16)
+		xorStreamPlain(pData, pStream, size, mask);
+	else
+		xorStreamFunc()(pData, pStream, size, mask);
+}
+
+// pData[i] ^= pKey[(phase + i) % keySize], keySize has to be at most KEY_PAGE_SIZE
+inline void xorRepeatKey(uint8_t *pData, const uint64_t &size, const uint8_t *pKey, const std::size_t &keySize, const std::size_t &phase)
+{
+	uint8_t page[KEY_PAGE_SIZE];
+
+	const std::size_t pageSize = KEY_PAGE_SIZE / keySize * keySize;
+	const std::size_t fillSize = size < pageSize ? static_cast<std::size_t>(size) : pageSize;
+
+	// Expand the key starting at the phase of the first byte, the page length is a multiple of the key size
+	// so every page starts at the same phase
+	for (std::size_t i = 0, j = phase % keySize; i < fillSize; i++)
+	{
+		page[i] = pKey[j];
+		if (++j == keySize) j = 0;
+	}
+
+	for (uint64_t done = 0; done < size; done += pageSize)
+	{
+		const std::size_t run = size - done < pageSize ? static_cast<std::size_t>(size - done) : pageSize;
+		xorStream(pData + done, page, run);
+	}
+}
+
+} // namespace keyXor
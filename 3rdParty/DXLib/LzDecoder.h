@@ -0,0 +1,329 @@
+/*
+ *  File: LzDecoder.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
+// Decoder for the LZ format of DXArchive::Encode / lzEncoder::encode
+// Runs of literals are located with a vector compare against the key code and copied as a whole, matches are copied
+// 16 bytes at a time and short distances repeat their pattern instead of copying byte by byte.
+// Copies may write up to 16 bytes past the end of a run, this is only done while that stays inside of the declared
+// output size, the last bytes are copied exactly. Every code is checked against the source and destination size, so
+// broken data ends the decoding with an error instead of reading or writing outside of the buffers
+namespace lzDecoder
+{
+static constexpr uint32_t MIN_MATCH   = 4; // Shortest match the format can store
+static constexpr uint32_t HEADER_SIZE = 9; // Source size, encoded size and key code
+static constexpr uint32_t WILD_COPY   = 16;
+static constexpr uint32_t SHORT_MATCH = 64; // Longer matches are copied with memcpy / memset, which beats 16 byte steps
+
+// --- SIMD Implementations ---
+
+// First occurrence of keyCode in [pCur, pEnd), pEnd if there is none
+inline const uint8_t *findKeyPlain(const uint8_t *pCur, const uint8_t *pEnd, const uint8_t keyCode)
+{
+	const uint64_t pattern = 0x0101010101010101ull * keyCode;
+
+	for (; pEnd - pCur >= 8; pCur += 8)
+	{
+		uint64_t value;
+		std::memcpy(&value, pCur, sizeof(value));
+
+		// Sets the high bit of the first byte that equals the key code, bytes after it can be wrong
+		value ^= pattern;
+		const uint64_t zero = (value - 0x0101010101010101ull) & ~value & 0x8080808080808080ull;
+		if (zero != 0)
+			return pCur + (std::countr_zero(zero) >> 3);
+	}
+
+	while (pCur < pEnd && *pCur != keyCode)
+		pCur++;
+
+	return pCur;
+}
+
+inline const uint8_t *findKeySSE2(const uint8_t *pCur, const uint8_t *pEnd, const uint8_t keyCode)
+{
+	constexpr uint32_t simd_width = 16;
+
+	const __m128i key = _mm_set1_epi8(static_cast<char>(keyCode));
+
+	for (; pEnd - pCur >= simd_width; pCur += simd_width)
+	{
+		const __m128i data  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCur));
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, key)));
+
+		if (mask != 0)
+			return pCur + std::countr_zero(mask);
+	}
+
+	// Fallback for remaining bytes
+	return findKeyPlain(pCur, pEnd, keyCode);
+}
+
+inline const uint8_t *findKeyAVX2(const uint8_t *pCur, const uint8_t *pEnd, const uint8_t keyCode)
+{
+	constexpr uint32_t simd_width = 32;
+
+	const __m256i key = _mm256_set1_epi8(static_cast<char>(keyCode));
+
+	for (; pEnd - pCur >= simd_width; pCur += simd_width)
+	{
+		const __m256i data  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur));
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, key)));
+
+		if (mask != 0)
+			return pCur + std::countr_zero(mask);
+	}
+
+	// Fallback for remaining bytes
+	return findKeySSE2(pCur, pEnd, keyCode);
+}
+
+// --- Copy Helpers ---
+
+inline void copy16(uint8_t *pDest, const uint8_t *pSrc)
+{
+	std::memcpy(pDest, pSrc, WILD_COPY);
+}
+
+// Copies size bytes in steps of 16, writes up to 15 bytes more
+inline void wildCopy16(uint8_t *pDest, const uint8_t *pSrc, const uint32_t &size)
+{
+	for (uint32_t i = 0; i < size; i += WILD_COPY)
+		copy16(pDest + i, pSrc + i);
+}
+
+// Copies a match with a distance shorter than 16 bytes, writes up to 16 bytes more
+inline void wildCopyOverlap(uint8_t *pDest, const uint32_t &distance, const uint32_t &size)
+{
+	const uint8_t *pSrc = pDest - distance;
+
+	if (distance == 1)
+	{
+		std::memset(pDest, *pSrc, size);
+		return;
+	}
+
+	if (distance <= 8)
+	{
+		// 16 bytes of the repeated pattern, each store continues it at a multiple of the distance
+		uint8_t pattern[WILD_COPY];
+		for (uint32_t i = 0; i < WILD_COPY; i++)
+			pattern[i] = pSrc[i % distance];
+
+		const uint32_t step = WILD_COPY - WILD_COPY % distance;
+		for (uint32_t i = 0; i < size; i += step)
+			std::memcpy(pDest + i, pattern, WILD_COPY);
+
+		return;
+	}
+
+	// The source of an 8 byte block is always written before it is read
+	for (uint32_t i = 0; i < size; i += 8)
+		std::memcpy(pDest + i, pSrc + i, 8);
+}
+
+// Exact copy for long matches and the end of the output
+inline void copyMatch(uint8_t *pDest, const uint32_t &distance, uint32_t size)
+{
+	if (distance == 1)
+	{
+		std::memset(pDest, pDest[-1], size);
+		return;
+	}
+
+	if (distance >= size)
+	{
+		std::memcpy(pDest, pDest - distance, size);
+		return;
+	}
+
+	// Each copy doubles the part of the pattern that is available
+	uint32_t num = distance;
+	while (size > num)
+	{
+		std::memcpy(pDest, pDest - num, num);
+		pDest += num;
+		size -= num;
+		num += num;
+	}
+
+	std::memcpy(pDest, pDest - num, size);
+}
+
+// --- Decoder ---
+
+using FindKeyFunction = const uint8_t *(*)(const uint8_t *, const uint8_t *, const uint8_t);
+
+// Returns the decoded size or -1 if the data is broken, pDest has to hold the size stored in the header
+template<FindKeyFunction FindKey>
+int32_t decodeImpl(const uint8_t *pSrc, uint8_t *pDest)
+{
+	uint32_t destSize, srcSize;
+	std::memcpy(&destSize, pSrc, sizeof(uint32_t));
+	std::memcpy(&srcSize, pSrc + 4, sizeof(uint32_t));
+
+	if (srcSize < HEADER_SIZE || destSize > INT32_MAX)
+		return -1;
+
+	const uint8_t keyCode = pSrc[8];
+	const uint8_t *sp     = pSrc + HEADER_SIZE;
+	const uint8_t *srcEnd = pSrc + srcSize;
+	uint8_t *dp           = pDest;
+	uint8_t *destEnd      = pDest + destSize;
+
+	while (sp < srcEnd)
+	{
+		// Literals up to the next key code
+		if (*sp != keyCode)
+		{
+			// Single literals between matches are the most common run
+			if (srcEnd - sp >= 2 && sp[1] == keyCode)
+			{
+				if (dp == destEnd)
+					return -1;
+
+				*dp++ = *sp++;
+				continue;
+			}
+
+			const uint32_t run = static_cast<uint32_t>(FindKey(sp, srcEnd, keyCode) - sp);
+			if (run > static_cast<uint32_t>(destEnd - dp))
+				return -1;
+
+			const uint32_t wildSize = (run + WILD_COPY - 1) & ~(WILD_COPY - 1);
+			if (wildSize <= static_cast<uint32_t>(srcEnd - sp) && wildSize <= static_cast<uint32_t>(destEnd - dp))
+				wildCopy16(dp, sp, run);
+			else
+				std::memcpy(dp, sp, run);
+
+			sp += run;
+			dp += run;
+			continue;
+		}
+
+		if (srcEnd - sp < 2)
+			return -1;
+
+		// The key code twice is the key code as literal
+		if (sp[1] == keyCode)
+		{
+			if (dp == destEnd)
+				return -1;
+
+			*dp++ = keyCode;
+			sp += 2;
+			continue;
+		}
+
+		// Codes from the key code on are stored + 1
+		uint32_t code = sp[1];
+		if (code > keyCode) code--;
+		sp += 2;
+
+		const uint32_t lenBytes  = (code >> 2) & 1;
+		const uint32_t distBytes = (code & 3) + 1;
+
+		// A distance of four bytes is never written
+		if (distBytes > 3 || static_cast<uint32_t>(srcEnd - sp) < lenBytes + distBytes)
+			return -1;
+
+		uint32_t length = code >> 3;
+		if (lenBytes)
+			length |= *sp++ << 5;
+		length += MIN_MATCH;
+
+		uint32_t distance;
+		if (srcEnd - sp >= 4)
+		{
+			std::memcpy(&distance, sp, sizeof(distance));
+			distance &= 0xFFFFFFFFu >> (32 - distBytes * 8);
+		}
+		else
+		{
+			distance = sp[0];
+			if (distBytes > 1) distance |= sp[1] << 8;
+			if (distBytes > 2) distance |= sp[2] << 16;
+		}
+		distance++;
+		sp += distBytes;
+
+		if (distance > static_cast<uint32_t>(dp - pDest) || length > static_cast<uint32_t>(destEnd - dp))
+			return -1;
+
+		// Long matches and matches near the end are copied exactly, everything else may overshoot by one store
+		if (length > SHORT_MATCH || static_cast<uint32_t>(destEnd - dp) < length + WILD_COPY)
+			copyMatch(dp, distance, length);
+		else if (distance >= WILD_COPY)
+			wildCopy16(dp, dp - distance, length);
+		else
+			wildCopyOverlap(dp, distance, length);
+
+		dp += length;
+	}
+
+	if (dp != destEnd)
+		return -1;
+
+	return static_cast<int32_t>(destSize);
+}
+
+// --- Dispatcher ---
+
+using DecodeFunction = int32_t (*)(const uint8_t *, uint8_t *);
+
+inline DecodeFunction selectDecodeFunc(const simd::CpuFeatures &features)
+{
+	if (features.avx2)
+		return decodeImpl<findKeyAVX2>;
+	else if (features.sse2)
+		return decodeImpl<findKeySSE2>;
+	else
+		return decodeImpl<findKeyPlain>;
+}
+
+// The features are only detected once, the function is called from several decoder threads
+inline DecodeFunction decodeFunc()
+{
+	static const DecodeFunction func = selectDecodeFunc(simd::detectCpuFeatures());
+	return func;
+}
+
+// Decodes pSrc to pDest, returns the decoded size or -1 if the data is broken.
+// pDest has to hold the size stored in the header, the source the encoded size stored in it
+inline int32_t decode(const void *pSrc, void *pDest)
+{
+	return decodeFunc()(static_cast<const uint8_t *>(pSrc), static_cast<uint8_t *>(pDest));
+}
+
+} // namespace lzDecoder
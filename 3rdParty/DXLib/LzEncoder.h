@@ -0,0 +1,405 @@
+﻿/*
+ *  File: LzEncoder.h
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <vector>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
+// Hash chain match finder for the LZ format of DXArchive::Encode / DXArchive::Decode
+// The list encoder of DXArchive searches up to 64 entries of a list keyed by the next three bytes and compares
+// four bytes at a time, this one keeps a chain per hash of the next four bytes, rejects most candidates with a
+// single byte compare and extends the remaining ones 16 / 32 bytes at a time.
+// The output uses the same key code, match codes and end of data rules, so DXArchive::Decode reads it unchanged
+namespace lzEncoder
+{
+static constexpr uint32_t MIN_MATCH    = 4;                  // Shortest match the format can store
+static constexpr uint32_t MAX_MATCH    = 0x1fff + MIN_MATCH; // Longest match, 13 bit length
+static constexpr uint32_t MAX_DISTANCE = (1 << 24) - 1;      // Farthest match, 24 bit distance
+static constexpr uint32_t HEADER_SIZE  = 9;                  // Source size, encoded size and key code
+
+static constexpr int LEVEL_FAST    = 1;
+static constexpr int LEVEL_DEFAULT = 2;
+static constexpr int LEVEL_MAX     = 4;
+
+struct LevelParams
+{
+	uint32_t chainDepth; // Candidates checked per position
+	uint32_t goodLength; // The next position is only searched with a quarter of the depth if the match is this long
+	uint32_t lazyLength; // Shorter matches are only taken if the next position has no better one, 0 = never check
+	uint32_t niceLength; // A match of this length ends the search
+	uint32_t windowBits; // Size of the chain window, matches can't be farther away
+	uint32_t hashBits;   // Size of the hash table
+};
+
+static constexpr LevelParams LEVELS[LEVEL_MAX] = {
+	{ 8, 8, 0, 32, 20, 16 },
+	{ 32, 16, 32, 128, 22, 17 },
+	{ 128, 32, 128, 512, 23, 17 },
+	{ 1024, 64, 1024, MAX_MATCH, 24, 18 },
+};
+
+// --- SIMD Implementations ---
+
+// Length of the common prefix of pA and pB, at most maxLen
+inline uint32_t matchLengthPlain(const uint8_t *pA, const uint8_t *pB, const uint32_t maxLen)
+{
+	uint32_t len = 0;
+
+	for (; len + 8 <= maxLen; len += 8)
+	{
+		uint64_t a, b;
+		std::memcpy(&a, pA + len, sizeof(a));
+		std::memcpy(&b, pB + len, sizeof(b));
+
+		const uint64_t diff = a ^ b;
+		if (diff != 0)
+			return len + (std::countr_zero(diff) >> 3);
+	}
+
+	while (len < maxLen && pA[len] == pB[len])
+		len++;
+
+	return len;
+}
+
+inline uint32_t matchLengthSSE2(const uint8_t *pA, const uint8_t *pB, const uint32_t maxLen)
+{
+	constexpr uint32_t simd_width = 16;
+
+	uint32_t len = 0;
+
+	for (; len + simd_width <= maxLen; len += simd_width)
+	{
+		const __m128i a     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pA + len));
+		const __m128i b     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pB + len));
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+
+		if (mask != 0xFFFF)
+			return len + std::countr_zero(~mask);
+	}
+
+	// Fallback for remaining bytes
+	return len + matchLengthPlain(pA + len, pB + len, maxLen - len);
+}
+
+inline uint32_t matchLengthAVX2(const uint8_t *pA, const uint8_t *pB, const uint32_t maxLen)
+{
+	constexpr uint32_t simd_width = 32;
+
+	uint32_t len = 0;
+
+	for (; len + simd_width <= maxLen; len += simd_width)
+	{
+		const __m256i a     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pA + len));
+		const __m256i b     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pB + len));
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+
+		if (mask != 0xFFFFFFFF)
+			return len + std::countr_zero(~mask);
+	}
+
+	// Fallback for remaining bytes
+	return len + matchLengthSSE2(pA + len, pB + len, maxLen - len);
+}
+
+// --- Dispatcher ---
+
+using MatchLengthFunction = uint32_t (*)(const uint8_t *, const uint8_t *, const uint32_t);
+
+inline MatchLengthFunction selectMatchLengthFunc(const simd::CpuFeatures &features)
+{
+	if (features.avx2)
+		return matchLengthAVX2;
+	else if (features.sse2)
+		return matchLengthSSE2;
+	else
+		return matchLengthPlain;
+}
+
+// The features are only detected once, the function is called from several encoder threads
+inline MatchLengthFunction matchLengthFunc()
+{
+	static const MatchLengthFunction func = selectMatchLengthFunc(simd::detectCpuFeatures());
+	return func;
+}
+
+// --- Encoder ---
+
+class Encoder
+{
+public:
+	Encoder(const uint8_t *pSrc, const uint32_t &srcSize, const int &level) :
+		m_pSrc(pSrc),
+		m_srcSize(srcSize),
+		m_params(LEVELS[(level < LEVEL_FAST ? LEVEL_FAST : (level > LEVEL_MAX ? LEVEL_MAX : level)) - 1]),
+		m_matchLength(matchLengthFunc())
+	{
+		// Small inputs don't need the full tables, the window covers the whole input as long as it fits
+		uint32_t windowBits = 8;
+		while (windowBits < m_params.windowBits && (1u << windowBits) < srcSize)
+			windowBits++;
+
+		m_hashBits   = windowBits < m_params.hashBits ? windowBits : m_params.hashBits;
+		m_windowMask = (1u << windowBits) - 1;
+		m_maxDist    = m_windowMask < MAX_DISTANCE ? m_windowMask : MAX_DISTANCE;
+		m_hashEnd    = srcSize >= MIN_MATCH ? srcSize - MIN_MATCH + 1 : 0;
+
+		m_head.assign(static_cast<std::size_t>(1) << m_hashBits, NO_POS);
+		m_chain.resize(static_cast<std::size_t>(m_windowMask) + 1);
+	}
+
+	// Writes the compressed data to pDest, which can be nullptr to only get the size.
+	// The output is at most 2 * srcSize + HEADER_SIZE bytes, like the one of the list encoder
+	uint32_t Encode(uint8_t *pDest)
+	{
+		m_pDest   = pDest ? pDest + HEADER_SIZE : nullptr;
+		m_size    = 0;
+		m_keyCode = findKeyCode();
+
+		uint32_t pos = 0;
+
+		while (pos < m_srcSize)
+		{
+			// The last bytes are always stored as they are, same as the list encoder
+			if (pos + MIN_MATCH >= m_srcSize)
+			{
+				putLiteral(pos++);
+				continue;
+			}
+
+			Match match = findMatch(pos, m_params.chainDepth);
+			insertUpTo(pos + 1);
+
+			if (match.bonus < 0)
+			{
+				putLiteral(pos++);
+				continue;
+			}
+
+			// Keep a literal if the match at the next position saves more
+			while (match.length < m_params.lazyLength && pos + 1 + MIN_MATCH < m_srcSize)
+			{
+				const Match next = findMatch(pos + 1, match.length < m_params.goodLength ? m_params.chainDepth : m_params.chainDepth >> 2);
+				if (next.bonus <= match.bonus + (m_pSrc[pos] == m_keyCode ? 1 : 0))
+					break;
+
+				putLiteral(pos++);
+				insertUpTo(pos + 1);
+				match = next;
+			}
+
+			putMatch(match);
+			pos += match.length;
+			insertUpTo(pos);
+		}
+
+		if (pDest)
+		{
+			const uint32_t totalSize = m_size + HEADER_SIZE;
+			std::memcpy(pDest, &m_srcSize, sizeof(uint32_t));
+			std::memcpy(pDest + 4, &totalSize, sizeof(uint32_t));
+			pDest[8] = m_keyCode;
+		}
+
+		return m_size + HEADER_SIZE;
+	}
+
+private:
+	struct Match
+	{
+		uint32_t length;
+		uint32_t distance;
+		int32_t bonus; // Bytes saved compared to literals, same rating as the list encoder
+	};
+
+	static uint32_t read32(const uint8_t *p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash(const uint32_t &pos) const
+	{
+		return (read32(m_pSrc + pos) * 2654435761u) >> (32 - m_hashBits);
+	}
+
+	// Least frequent byte, on a tie the highest one like the list encoder
+	uint8_t findKeyCode() const
+	{
+		uint32_t table[256] = {};
+
+		for (uint32_t i = 0; i < m_srcSize; i++)
+			table[m_pSrc[i]]++;
+
+		uint8_t keyCode = 0;
+		for (uint32_t i = 1; i < 256; i++)
+		{
+			if (table[i] <= table[keyCode])
+				keyCode = static_cast<uint8_t>(i);
+		}
+
+		return keyCode;
+	}
+
+	// Adds all positions before end to the chains, every position is added once
+	void insertUpTo(const uint32_t &end)
+	{
+		const uint32_t last = end < m_hashEnd ? end : m_hashEnd;
+
+		for (; m_nextInsert < last; m_nextInsert++)
+		{
+			const uint32_t h                     = hash(m_nextInsert);
+			m_chain[m_nextInsert & m_windowMask] = m_head[h];
+			m_head[h]                            = m_nextInsert;
+		}
+	}
+
+	Match findMatch(const uint32_t &pos, uint32_t depth) const
+	{
+		Match best = { 0, 0, -1 };
+
+		const uint32_t maxLen = m_srcSize - pos < MAX_MATCH ? m_srcSize - pos : MAX_MATCH;
+		const uint8_t *pCur   = m_pSrc + pos;
+		const uint32_t cur4   = read32(pCur);
+
+		uint32_t cand = m_head[hash(pos)];
+
+		// The chain is ordered by distance, a farther match only rates better if it is longer, so a
+		// candidate has to match at the current best length before it is compared as a whole
+		for (; cand != NO_POS && depth != 0; cand = m_chain[cand & m_windowMask], depth--)
+		{
+			const uint32_t distance = pos - cand;
+			if (distance > m_maxDist)
+				break;
+
+			const uint8_t *pCand = m_pSrc + cand;
+			if (pCand[best.length] != pCur[best.length] || read32(pCand) != cur4)
+				continue;
+
+			const uint32_t length = MIN_MATCH + m_matchLength(pCand + MIN_MATCH, pCur + MIN_MATCH, maxLen - MIN_MATCH);
+			const int32_t bonus   = static_cast<int32_t>(length) - (3 + lengthSize(length) + distanceSize(distance));
+
+			if (bonus > best.bonus)
+			{
+				best = { length, distance, bonus };
+
+				if (length >= m_params.niceLength || length == maxLen)
+					break;
+			}
+		}
+
+		return best;
+	}
+
+	static int32_t lengthSize(const uint32_t &length)
+	{
+		return length - MIN_MATCH < 0x20 ? 0 : 1;
+	}
+
+	static int32_t distanceSize(const uint32_t &distance)
+	{
+		return distance < 0x100 ? 0 : (distance < 0x10000 ? 1 : 2);
+	}
+
+	void putByte(const uint8_t &value)
+	{
+		if (m_pDest)
+			m_pDest[m_size] = value;
+
+		m_size++;
+	}
+
+	// The key code itself is stored twice
+	void putLiteral(const uint32_t &pos)
+	{
+		putByte(m_pSrc[pos]);
+
+		if (m_pSrc[pos] == m_keyCode)
+			putByte(m_keyCode);
+	}
+
+	void putMatch(const Match &match)
+	{
+		const uint32_t length   = match.length - MIN_MATCH;
+		const uint32_t distance = match.distance - 1;
+		const int32_t lenSize   = lengthSize(match.length);
+		const int32_t distSize  = distanceSize(match.distance);
+
+		// Codes from the key code on are stored + 1, so the key code twice stays a literal
+		uint8_t code = static_cast<uint8_t>(((length & 0x1f) << 3) | (lenSize << 2) | distSize);
+		if (code >= m_keyCode)
+			code++;
+
+		putByte(m_keyCode);
+		putByte(code);
+
+		if (lenSize == 1)
+			putByte(static_cast<uint8_t>(length >> 5));
+
+		putByte(static_cast<uint8_t>(distance));
+		if (distSize > 0)
+			putByte(static_cast<uint8_t>(distance >> 8));
+		if (distSize > 1)
+			putByte(static_cast<uint8_t>(distance >> 16));
+	}
+
+private:
+	static constexpr uint32_t NO_POS = 0xFFFFFFFF;
+
+	const uint8_t *m_pSrc;
+	uint32_t m_srcSize;
+	LevelParams m_params;
+	MatchLengthFunction m_matchLength;
+
+	uint32_t m_hashBits   = 0;
+	uint32_t m_windowMask = 0;
+	uint32_t m_maxDist    = 0;
+	uint32_t m_hashEnd    = 0; // Positions from here on have less than MIN_MATCH bytes left
+	uint32_t m_nextInsert = 0;
+
+	std::vector<uint32_t> m_head  = {}; // Latest position per hash
+	std::vector<uint32_t> m_chain = {}; // Previous position with the same hash, per position in the window
+
+	uint8_t *m_pDest  = nullptr;
+	uint32_t m_size   = 0;
+	uint8_t m_keyCode = 0;
+};
+
+// Compresses src to pDest in the format of DXArchive::Decode, returns the compressed size including the header
+inline uint32_t encode(const void *pSrc, const uint32_t &srcSize, void *pDest, const int &level = LEVEL_DEFAULT)
+{
+	Encoder encoder(static_cast<const uint8_t *>(pSrc), srcSize, level);
+	return encoder.Encode(static_cast<uint8_t *>(pDest));
+}
+
+} // namespace lzEncoder
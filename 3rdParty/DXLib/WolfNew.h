@@ -35,6 +35,9 @@
 #include <string>
 #include <vector>
 
+#include "AesCtr.h"
+#include "KeyXor.h"
+
 inline bool isV35(const uint16_t &cryptVersion)
 {
 	return (cryptVersion >= 0x15E && cryptVersion < 0x3E8) || cryptVersion >= 0x3FC;
@@ -51,15 +54,21 @@ inline void wolfCrypt(const uint8_t *pKey, uint8_t *pData, const int64_t &start,
 	uint32_t v2Cnt = start / 256 % 256;
 	int32_t v3Cnt  = start / 0x10000 % 256;
 
+	// Within a run of v1Cnt the key stream is the 256 byte key page XORed with the constant bytes of the higher counters
 	if (isV35(cryptVersion))
 	{
 		uint8_t moddedKey[512];
 		for (uint32_t i = 0; i < 512; i++)
 			moddedKey[i] = pKey[i % 256] ^ (7 * i);
 
-		for (uint64_t i = 0; i < length; i++)
+		for (uint64_t i = 0; i < length;)
 		{
-			pData[i] ^= moddedKey[v1Cnt++] ^ moddedKey[v2Cnt + 256];
+			const uint32_t run = static_cast<uint32_t>(std::min<uint64_t>(256 - v1Cnt, length - i));
+
+			keyXor::xorStream(pData + i, moddedKey + v1Cnt, run, moddedKey[v2Cnt + 256]);
+
+			i += run;
+			v1Cnt += run;
 
 			if (v1Cnt == 256)
 			{
@@ -70,9 +79,14 @@ inline void wolfCrypt(const uint8_t *pKey, uint8_t *pData, const int64_t &start,
 	}
 	else
 	{
-		for (uint64_t i = 0; i < length; i++)
+		for (uint64_t i = 0; i < length;)
 		{
-			pData[i] ^= pKey[v1Cnt++] ^ pKey[v2Cnt + 256] ^ pKey[v3Cnt + 512];
+			const uint32_t run = static_cast<uint32_t>(std::min<uint64_t>(256 - v1Cnt, length - i));
+
+			keyXor::xorStream(pData + i, pKey + v1Cnt, run, pKey[v2Cnt + 256] ^ pKey[v3Cnt + 512]);
+
+			i += run;
+			v1Cnt += run;
 
 			if (v1Cnt == 256)
 			{
@@ -100,9 +114,10 @@ inline void calcSalt(const char *pStr, uint8_t *pSalt)
 		pSalt[i] = (i / len) + pStr[i % len];
 }
 
+// The state is per thread so archives can be decoded in parallel, srand/rand used below are per thread in the MSVC CRT as well
 inline uint32_t xorshift32(const uint32_t &seed = 0)
 {
-	static uint32_t state = 0;
+	static thread_local uint32_t state = 0;
 
 	if (seed != 0)
 		state = seed;
@@ -545,33 +560,27 @@ inline void cipher(uint8_t *pState, const uint8_t *pRoundKey)
 // AES_CTR_xcrypt
 inline void aesCtrXCrypt(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
 {
-	uint8_t state[AES_BLOCKLEN];
-	uint8_t *pIv = pKey + AES_KEY_EXP_SIZE;
-	int32_t bi   = AES_BLOCKLEN;
-
-	for (std::size_t i = 0; i < size; i++, bi++)
-	{
-		if (bi == AES_BLOCKLEN)
-		{
-			std::memcpy(state, pIv, AES_BLOCKLEN);
+	aesCtr::xcrypt(pData, pKey, pKey + AES_KEY_EXP_SIZE, size);
+}
 
-			cipher(state, pKey);
+// AES_CTR_xcrypt for data at the given byte offset of the key stream, unlike aesCtrXCrypt the IV in pKey is not changed
+// so any part of the data can be decrypted independently
+inline void aesCtrXCryptAt(uint8_t *pData, const uint8_t *pKey, const uint64_t &offset, const std::size_t &size)
+{
+	uint8_t iv[AES_BLOCKLEN];
+	uint64_t blocks = offset / AES_BLOCKLEN;
 
-			for (bi = AES_BLOCKLEN - 1; bi >= 0; bi--)
-			{
-				if (pIv[bi] == 0xFF)
-				{
-					pIv[bi] = 0;
-					continue;
-				}
-				pIv[bi]++;
-				break;
-			}
-			bi = 0;
-		}
+	std::memcpy(iv, pKey + AES_KEY_EXP_SIZE, AES_BLOCKLEN);
 
-		pData[i] ^= state[bi];
+	// Add the block index to the big endian counter
+	for (int32_t i = AES_BLOCKLEN - 1; i >= 0 && blocks != 0; i--)
+	{
+		const uint64_t sum = iv[i] + (blocks & 0xFF);
+		iv[i]              = static_cast<uint8_t>(sum);
+		blocks             = (blocks >> 8) + (sum >> 8);
 	}
+
+	aesCtr::xcrypt(pData, pKey, iv, size, offset % AES_BLOCKLEN);
 }
 
 ////// AES CTR Crypt
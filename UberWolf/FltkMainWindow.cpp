@@ -320,6 +320,7 @@ void FltkMainWindow::initializeTranslateTab()
 
     // WolfTL选项
     m_skipGameDatCheck = std::make_unique<Fl_Check_Button>(content_x, content_y, 200, 25, "Skip Game.dat processing");
+    m_incrementalPatchCheck = std::make_unique<Fl_Check_Button>(content_x + 220, content_y, 220, 25, "Only patch changed files");
 
     content_y += 35;
 
@@ -130,6 +130,7 @@ private:
     std::unique_ptr<Fl_Button> m_applyTranslationBtn;   // 应用翻译按钮
     std::unique_ptr<Fl_Button> m_openTranslationBtn;    // 打开翻译文件夹按钮
     std::unique_ptr<Fl_Check_Button> m_skipGameDatCheck; // 跳过GameDat选项
+    std::unique_ptr<Fl_Check_Button> m_incrementalPatchCheck; // 只应用有变化的翻译文件
     std::unique_ptr<Fl_Output> m_translationStatsOutput; // 翻译统计信息
 
     // === 打包标签页组件 ===
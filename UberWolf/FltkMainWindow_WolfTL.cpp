@@ -195,6 +195,11 @@ void FltkMainWindow::onApplyTranslation()
                 }, new std::pair<FltkMainWindow*, std::pair<int, std::string>>(this, {progress, msg}));
             });
 
+            // 只重新生成源数据或翻译文件有变化的文件
+            if (m_incrementalPatchCheck) {
+                wolfTL.SetIncremental(m_incrementalPatchCheck->value());
+            }
+
             // 执行应用翻译操作
             // inPlace = false 表示不覆盖原文件，而是创建新的翻译版本
             bool result = wolfTL.ApplyTranslations(false);
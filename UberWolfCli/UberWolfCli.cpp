@@ -76,6 +76,9 @@ int main(int argc, char* argv[])
 	bool decWolfX = false;
 	app.add_flag("-x,--wolfx", decWolfX, "Decrypt WolfX files if present");
 
+	uint32_t threads = 0;
+	app.add_option("-j,--jobs", threads, "Number of archives unpacked in parallel (0 = number of CPU cores)")->type_name("N");
+
 	std::string packVersion = "";
 	app.add_option("-p,--pack", packVersion, buildPackInfo())->type_name("VER_IDX");
 
@@ -91,6 +94,7 @@ int main(int argc, char* argv[])
 	}
 
 	uwl.Configure(override, unprotect, decWolfX);
+	uwl.SetThreadCount(threads);
 
 	// Check if the first argument is an executable
 	if (fs::exists(files.front()) && fs::is_regular_file(files.front()) && fs::path(files.front()).extension() == ".exe")
@@ -0,0 +1,231 @@
+/*
+ *  File: PatchManifest.cpp
+ *  Copyright (c) 2025 vagmr
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "PatchManifest.h"
+#include "UberLog.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace
+{
+// Bump when the layout of the manifest or the hash changes, older manifests are ignored
+constexpr int MANIFEST_VERSION = 1;
+
+// Files changed less than this before the run are not trusted to keep their hash
+constexpr std::chrono::seconds RECENT_CHANGE(2);
+
+constexpr uint64_t HASH_OFFSET = 0xCBF29CE484222325ull;
+constexpr uint64_t HASH_PRIME  = 0x100000001B3ull;
+
+// FNV-1a over 64 bit words, the hash only has to detect changes
+uint64_t hashBytes(uint64_t hash, const char* pData, const std::size_t size)
+{
+    std::size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, pData + i, sizeof(word));
+        hash = (hash ^ word) * HASH_PRIME;
+    }
+
+    for (; i < size; i++)
+        hash = (hash ^ static_cast<uint8_t>(pData[i])) * HASH_PRIME;
+
+    return hash;
+}
+
+uint64_t hashString(const std::string& str, const uint64_t& hash = HASH_OFFSET)
+{
+    return hashBytes(hash, str.data(), str.size());
+}
+} // namespace
+
+PatchManifest::PatchManifest(const tString& manifestFile, const tString& outputPath)
+    : m_manifestFile(manifestFile)
+    , m_outputPath(fileKey(outputPath))
+{
+}
+
+void PatchManifest::Load()
+{
+    m_files.clear();
+    m_units.clear();
+
+    if (!fs::exists(m_manifestFile) || fs::file_size(m_manifestFile) == 0)
+        return;
+
+    try
+    {
+        std::ifstream in(m_manifestFile);
+        const nlohmann::ordered_json data = nlohmann::ordered_json::parse(in);
+
+        // A manifest of another output folder or version says nothing about the current outputs
+        if (data.value("version", 0) != MANIFEST_VERSION || data.value("output", "") != m_outputPath)
+            return;
+
+        for (const auto& [file, entry] : data["files"].items())
+            m_files[file] = { entry["size"].get<uint64_t>(), entry["mtime"].get<int64_t>(), std::stoull(entry["hash"].get<std::string>(), nullptr, 16) };
+
+        for (const auto& [unit, entry] : data["units"].items())
+            m_units[unit] = { entry["inputs"].get<std::string>(), entry["outputs"].get<std::vector<std::string>>() };
+    }
+    catch (const std::exception& e)
+    {
+        ERROR_LOG << "[PatchManifest] Failed to load the patch manifest, patching everything: " << e.what() << std::endl;
+        m_files.clear();
+        m_units.clear();
+    }
+}
+
+bool PatchManifest::Save() const
+{
+    try
+    {
+        nlohmann::ordered_json data = {
+            { "version", MANIFEST_VERSION },
+            { "output", m_outputPath },
+            { "files", nlohmann::ordered_json::object() },
+            { "units", nlohmann::ordered_json::object() }
+        };
+
+        for (const auto& [file, entry] : m_files)
+            data["files"][file] = { { "size", entry.size }, { "mtime", entry.mtime }, { "hash", std::format("{:016x}", entry.hash) } };
+
+        for (const auto& [unit, entry] : m_units)
+            data["units"][unit] = { { "inputs", entry.inputHash }, { "outputs", entry.outputs } };
+
+        std::ofstream out(m_manifestFile);
+        out << data.dump(4);
+
+        return out.good();
+    }
+    catch (const std::exception& e)
+    {
+        ERROR_LOG << "[PatchManifest] Failed to save the patch manifest: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::string PatchManifest::HashInputs(const std::vector<fs::path>& files)
+{
+    uint64_t hash = HASH_OFFSET;
+
+    for (const fs::path& file : files)
+    {
+        hash = hashString(fileKey(file), hash);
+
+        if (fs::exists(file))
+        {
+            FileEntry& entry = fingerprint(file);
+            hash             = hashBytes(hash, reinterpret_cast<const char*>(&entry.hash), sizeof(entry.hash));
+
+            // A file which is changed again within the timestamp resolution keeps its size and time,
+            // so recently changed files are hashed again on the next run
+            if (fs::file_time_type::clock::now() - fs::file_time_type(fs::file_time_type::duration(entry.mtime)) < RECENT_CHANGE)
+                entry.mtime = 0;
+        }
+        else
+            hash = hashString("<missing>", hash);
+    }
+
+    return std::format("{:016x}", hash);
+}
+
+bool PatchManifest::IsUpToDate(const std::string& unit, const std::string& inputHash, const std::vector<fs::path>& outputs) const
+{
+    const auto it = m_units.find(unit);
+    if (it == m_units.end() || it->second.inputHash != inputHash)
+        return false;
+
+    for (const fs::path& output : outputs)
+    {
+        const auto fileIt = m_files.find(fileKey(output));
+        if (fileIt == m_files.end() || !fs::exists(output))
+            return false;
+
+        // Outputs which were changed or replaced since they were written are created again
+        if (fs::file_size(output) != fileIt->second.size || fs::last_write_time(output).time_since_epoch().count() != fileIt->second.mtime)
+            return false;
+    }
+
+    return true;
+}
+
+void PatchManifest::Update(const std::string& unit, const std::string& inputHash, const std::vector<fs::path>& outputs)
+{
+    UnitEntry entry = { inputHash, {} };
+
+    for (const fs::path& output : outputs)
+    {
+        fingerprint(output);
+        entry.outputs.push_back(fileKey(output));
+    }
+
+    m_units[unit] = std::move(entry);
+}
+
+PatchManifest::FileEntry& PatchManifest::fingerprint(const fs::path& file)
+{
+    const uint64_t size  = fs::file_size(file);
+    const int64_t mtime  = fs::last_write_time(file).time_since_epoch().count();
+    FileEntry& entry     = m_files[fileKey(file)];
+
+    if (entry.size != size || entry.mtime != mtime || entry.hash == 0)
+        entry = { size, mtime, hashFile(file) };
+
+    return entry;
+}
+
+std::string PatchManifest::fileKey(const fs::path& file)
+{
+    const std::u8string key = fs::absolute(file).lexically_normal().generic_u8string();
+    return std::string(key.begin(), key.end());
+}
+
+uint64_t PatchManifest::hashFile(const fs::path& file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Failed to open " + fileKey(file));
+
+    // The chunk size is a multiple of the word size, so the hash does not depend on it
+    std::vector<char> buffer(1 << 20);
+    uint64_t hash = HASH_OFFSET;
+
+    while (in)
+    {
+        in.read(buffer.data(), buffer.size());
+        hash = hashBytes(hash, buffer.data(), static_cast<std::size_t>(in.gcount()));
+    }
+
+    return hash;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Types.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief PatchManifest - Content hashes of the inputs and outputs of the last patch run
+ *
+ * A unit is one output file group (a map, a database, the common events or Game.dat)
+ * together with the files it is created from (the source data and its patch JSONs).
+ * A unit is up to date if the hash of its inputs did not change and its outputs were
+ * not touched since they were written. File hashes are only recalculated if the size
+ * or the modification time of a file changed.
+ */
+class PatchManifest
+{
+public:
+    /**
+     * @brief Constructor
+     * @param manifestFile Path of the manifest JSON
+     * @param outputPath Folder the patched data is written to, a manifest for another folder is ignored
+     */
+    PatchManifest(const tString& manifestFile, const tString& outputPath);
+
+    /**
+     * @brief Load the manifest, a missing or broken manifest leaves it empty
+     */
+    void Load();
+
+    /**
+     * @brief Write the manifest
+     * @return true if successful, false otherwise
+     */
+    bool Save() const;
+
+    /**
+     * @brief Combined hash of a list of files, missing files are part of the hash
+     * @param files Input files of a unit
+     * @return Hash as hex string
+     */
+    std::string HashInputs(const std::vector<fs::path>& files);
+
+    /**
+     * @brief Check if a unit has to be processed again
+     * @param unit Name of the unit
+     * @param inputHash Current hash of the inputs of the unit
+     * @param outputs Output files of the unit
+     * @return true if the inputs are unchanged and all outputs are as written
+     */
+    bool IsUpToDate(const std::string& unit, const std::string& inputHash, const std::vector<fs::path>& outputs) const;
+
+    /**
+     * @brief Record a processed unit
+     * @param unit Name of the unit
+     * @param inputHash Hash of the inputs of the unit
+     * @param outputs Output files of the unit, they have to exist
+     */
+    void Update(const std::string& unit, const std::string& inputHash, const std::vector<fs::path>& outputs);
+
+private:
+    struct FileEntry
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;
+    };
+
+    struct UnitEntry
+    {
+        std::string inputHash;
+        std::vector<std::string> outputs;
+    };
+
+    /**
+     * @brief Fingerprint of a file, the hash is reused if size and modification time are unchanged
+     */
+    FileEntry& fingerprint(const fs::path& file);
+
+    static std::string fileKey(const fs::path& file);
+    static uint64_t hashFile(const fs::path& file);
+
+private:
+    fs::path m_manifestFile;                    ///< Path of the manifest JSON
+    std::string m_outputPath;                   ///< Folder the patched data is written to
+    std::map<std::string, FileEntry> m_files;   ///< Fingerprints by file path
+    std::map<std::string, UnitEntry> m_units;   ///< Processed units by name
+};
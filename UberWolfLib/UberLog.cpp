@@ -48,4 +48,39 @@ void UberLog::log(T& msg)
 }
 */
 
-std::mutex UberLog::s_mtx = std::mutex();
\ No newline at end of file
+std::mutex UberLog::s_mtx = std::mutex();
+
+thread_local UberLogCapture* UberLogCapture::s_pCurrent = nullptr;
+
+UberLogCapture::UberLogCapture() :
+	m_entries(),
+	m_pPrev(s_pCurrent)
+{
+	s_pCurrent = this;
+}
+
+UberLogCapture::~UberLogCapture()
+{
+	s_pCurrent = m_pPrev;
+}
+
+void UberLogCapture::Flush()
+{
+	if (m_entries.empty()) return;
+
+	// Nested captures pass their messages on to the outer one
+	if (m_pPrev)
+	{
+		for (const auto& [pLog, msg] : m_entries)
+			m_pPrev->Add(pLog, msg);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(UberLog::s_mtx);
+
+		for (const auto& [pLog, msg] : m_entries)
+			pLog->write(msg);
+	}
+
+	m_entries.clear();
+}
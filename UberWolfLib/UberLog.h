@@ -28,6 +28,8 @@
 
 #include <format>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 #include "Types.h"
 
@@ -36,8 +38,46 @@ namespace uberLog
 extern LogCallbacks s_logCallbacks;
 }
 
+class UberLog;
+
+// Collects the log messages of the current thread while it is alive, Flush() writes them as one block.
+// Used to keep the messages of work running in parallel together and in order.
+class UberLogCapture
+{
+public:
+	UberLogCapture();
+	~UberLogCapture();
+
+	UberLogCapture(const UberLogCapture&)            = delete;
+	UberLogCapture& operator=(const UberLogCapture&) = delete;
+
+	void Add(UberLog* pLog, const tString& msg)
+	{
+		m_entries.push_back({ pLog, msg });
+	}
+
+	void Flush();
+
+	void Discard()
+	{
+		m_entries.clear();
+	}
+
+	static UberLogCapture* Current()
+	{
+		return s_pCurrent;
+	}
+
+private:
+	std::vector<std::pair<UberLog*, tString>> m_entries;
+	UberLogCapture* m_pPrev;
+	static thread_local UberLogCapture* s_pCurrent;
+};
+
 class UberLog
 {
+	friend class UberLogCapture;
+
 public:
 	using SType = tOstream&(tOstream&);
 
@@ -49,15 +89,26 @@ public:
 	template<typename T>
 	void log(T& msg)
 	{
-		std::lock_guard<std::mutex> lock(s_mtx);
-		m_oStream << msg.str();
-
-		for (auto& callback : uberLog::s_logCallbacks)
-			callback(msg.str(), false);
+		if (UberLogCapture* pCapture = UberLogCapture::Current())
+			pCapture->Add(this, msg.str());
+		else
+		{
+			std::lock_guard<std::mutex> lock(s_mtx);
+			write(msg.str());
+		}
 
 		msg.flush();
 	}
 
+private:
+	void write(const tString& msg)
+	{
+		m_oStream << msg;
+
+		for (auto& callback : uberLog::s_logCallbacks)
+			callback(msg, false);
+	}
+
 private:
 	tOstream& m_oStream;
 	static std::mutex s_mtx;
@@ -33,11 +33,15 @@
 #include "WolfUtils.h"
 #include "resource.h"
 
+#include <algorithm>
+#include <atomic>
 #include <eh.h>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -203,13 +207,108 @@ UWLExitCode UberWolfLib::UnpackData()
 
 UWLExitCode UberWolfLib::UnpackDataVec(const tStrings& paths)
 {
+	UnpackResults results;
+	return UnpackDataVec(paths, results);
+}
+
+UWLExitCode UberWolfLib::UnpackDataVec(const tStrings& paths, UnpackResults& results)
+{
+	struct UnpackJob
+	{
+		std::size_t idx;
+		uintmax_t size;
+	};
+
+	std::vector<UnpackJob> jobs;
+
+	results.clear();
+
 	for (const tString& p : paths)
 	{
-		if (IsWolfExtension(fs::path(p).extension()))
+		if (!IsWolfExtension(fs::path(p).extension())) continue;
+
+		std::error_code ec;
+		const uintmax_t size = fs::file_size(p, ec);
+
+		jobs.push_back({ results.size(), (ec ? 0 : size) });
+		results.push_back({ p, UWLExitCode::SUCCESS });
+	}
+
+	const std::size_t threadCount = std::min<std::size_t>(getThreadCount(), jobs.size());
+
+	if (threadCount <= 1)
+	{
+		for (auto& [path, uec] : results)
+			uec = unpackArchive(path);
+	}
+	else
+	{
+		// Largest archives first, otherwise a big archive picked up last keeps the run going while the other threads are idle
+		std::stable_sort(jobs.begin(), jobs.end(), [](const UnpackJob& a, const UnpackJob& b) { return a.size > b.size; });
+
+		// Without a mode the crypt has to be detected first, use the smallest archive for this,
+		// the workers then start with the detected mode (or key)
+		if (!m_wolfDec.IsModeSet())
 		{
-			UWLExitCode uec = unpackArchive(p);
-			if (uec != UWLExitCode::SUCCESS) return uec;
+			const std::size_t idx = jobs.back().idx;
+			jobs.pop_back();
+
+			results[idx].second = unpackArchive(results[idx].first);
 		}
+
+		std::atomic<std::size_t> nextJob = 0;
+		std::vector<std::size_t> retryJobs;
+		std::mutex retryMtx;
+		std::vector<std::thread> workers;
+
+		for (std::size_t t = 0; t < threadCount; t++)
+		{
+			workers.emplace_back([&]() {
+				// Each worker gets its own copy, WolfDec stores the detected mode
+				WolfDec wolfDec = m_wolfDec;
+
+				// Split the cores between the archives unpacked at the same time
+				wolfDec.SetDecodeThreads(std::max<uint32_t>(1, std::thread::hardware_concurrency() / static_cast<uint32_t>(threadCount)));
+
+				for (std::size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+				{
+					const std::size_t idx = jobs[j].idx;
+					UberLogCapture capture;
+					bool success = false;
+
+					try
+					{
+						success = unpackArchiveParallel(wolfDec, results[idx].first);
+					}
+					catch (const std::exception&)
+					{
+						success = false;
+					}
+
+					if (success)
+						capture.Flush();
+					else
+					{
+						std::lock_guard<std::mutex> lock(retryMtx);
+						retryJobs.push_back(idx);
+					}
+				}
+			});
+		}
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		// Failed archives might need the key detection, which changes the shared state, so they are retried one after another
+		std::sort(retryJobs.begin(), retryJobs.end());
+
+		for (const std::size_t& idx : retryJobs)
+			results[idx].second = unpackArchive(results[idx].first);
+	}
+
+	for (const auto& [path, uec] : results)
+	{
+		if (uec != UWLExitCode::SUCCESS) return uec;
 	}
 
 	return UWLExitCode::SUCCESS;
@@ -381,6 +480,42 @@ UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& q
 	return result ? UWLExitCode::SUCCESS : UWLExitCode::KEY_MISSING;
 }
 
+// Unpacks the archive with the given WolfDec without touching the shared state, returns false if the archive
+// has to be unpacked by unpackArchive (which can also detect the key) instead
+bool UberWolfLib::unpackArchiveParallel(WolfDec& wolfDec, const tString& archivePath) const
+{
+	if (archivePath.empty() || !fs::exists(archivePath) || !wolfDec)
+		return false;
+
+	const tString fileName = fs::path(archivePath).filename();
+
+	if (!wolfDec.IsValidFile(archivePath))
+		return true;
+
+	if (!m_config.override && wolfDec.IsAlreadyUnpacked(archivePath))
+	{
+		INFO_LOG << vFormat(LOCALIZE("unpacked_msg"), fileName) << std::endl;
+		return true;
+	}
+
+	INFO_LOG << vFormat(LOCALIZE("unpacking_msg"), fileName);
+
+	if (!wolfDec.UnpackArchive(archivePath, m_config.override))
+		return false;
+
+	INFO_LOG << LOCALIZE("done_msg") << std::endl;
+
+	return true;
+}
+
+uint32_t UberWolfLib::getThreadCount() const
+{
+	if (m_config.threads != 0)
+		return m_config.threads;
+
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
 bool UberWolfLib::findDataFolder()
 {
 	m_dataAsFile = false;
@@ -499,13 +634,7 @@ bool UberWolfLib::findGameFromArchive(const tString& archivePath)
 
 // 静态变量定义 - 避免重复定义问题
 #include "WolfRPG/FileCoder.h"
-#include "WolfRPG/Command.h"
 
 // FileCoder静态变量定义
-bool FileCoder::s_isUTF8 = false;
-uint32_t FileCoder::s_projKey = static_cast<uint32_t>(-1);
 bool FileCoder::s_createBackup = false;
 
-// Command命名空间中的Command类的静态变量定义
-bool Command::Command::s_v35 = false;
-
@@ -26,6 +26,9 @@
 
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include "Types.h"
 #include "WolfDec.h"
 #include "WolfPro.h"
@@ -47,14 +50,17 @@ enum class UWLExitCode
 	UNKNOWN_ERROR = 999
 };
 
+using UnpackResults = std::vector<std::pair<tString, UWLExitCode>>;
+
 class UberWolfLib
 {
 	inline static const tString UWL_VERSION = _T("0.5.0");
 	struct Config
 	{
-		bool override  = false;
-		bool unprotect = false;
-		bool decWolfX  = false;
+		bool override    = false;
+		bool unprotect   = false;
+		bool decWolfX    = false;
+		uint32_t threads = 0; // Number of archives unpacked at the same time, 0 = number of CPU cores
 	};
 
 public:
@@ -73,6 +79,11 @@ public:
 		m_config.decWolfX  = decWolfX;
 	}
 
+	void SetThreadCount(const uint32_t& threads)
+	{
+		m_config.threads = threads;
+	}
+
 	bool InitGame(const tString& gameExePath);
 
 	UWLExitCode PackData(const int32_t& encIdx);
@@ -81,6 +92,7 @@ public:
 
 	UWLExitCode UnpackData();
 	UWLExitCode UnpackDataVec(const tStrings& paths);
+	UWLExitCode UnpackDataVec(const tStrings& paths, UnpackResults& results);
 	UWLExitCode UnpackArchive(const tString& archivePath);
 
 	UWLExitCode FindDxArcKey(const bool& quiet = false);
@@ -111,6 +123,8 @@ public:
 private:
 	UWLExitCode packData(const tString& dataPath);
 	UWLExitCode unpackArchive(const tString& archivePath, const bool& quiet = false, const bool& secondRun = false);
+	bool unpackArchiveParallel(WolfDec& wolfDec, const tString& archivePath) const;
+	uint32_t getThreadCount() const;
 	bool findDataFolder();
 	UWLExitCode findDxArcKeyFile(const bool& quiet = false);
 	void updateConfig(const bool& useOldDxArc, const Key& key);
@@ -29,6 +29,7 @@
 #include "WolfDec.h"
 
 #include <DXLib/DXArchive.h>
+#include <DXLib/DXArchiveDecoder.h>
 #include <DXLib/DXArchiveVer5.h>
 #include <DXLib/DXArchiveVer6.h>
 #include <DXLib/FileLib.h>
@@ -42,6 +43,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <windows.h>
 
@@ -215,12 +217,23 @@ bool WolfDec::UnpackArchive(const tString& filePath, const bool& override)
 			return false;
 	}
 
-	// Always run the unpacking in a subprocess
+	const CryptMode curMode = (m_mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(m_mode) : m_additionalModes.at(m_mode - DEFAULT_CRYPT_MODES.size()));
+
+	// The current DX archive format can be decoded in-process, it reports invalid data instead of crashing
+	if (isInProcessMode(curMode))
+	{
+		const bool success = unpackInProcess(filePath, curMode);
+
+		if (m_isSubProcess)
+			ExitProcess(!success);
+
+		return success;
+	}
+
+	// The old archive formats change the current directory and crash on a wrong key, so they still run in a subprocess
 	if (!m_isSubProcess)
 		return runProcess(filePath, m_mode, override);
 
-	const CryptMode curMode = (m_mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(m_mode) : m_additionalModes.at(m_mode - DEFAULT_CRYPT_MODES.size()));
-
 	fs::current_path(directoryPath);
 	fs::create_directory(fileName);
 	fs::current_path(fileName);
@@ -371,7 +384,7 @@ bool WolfDec::detectMode(const tString& filePath, const bool& override)
 	{
 		for (uint32_t i = 0; i < DEFAULT_CRYPT_MODES.size(); i++)
 		{
-			success = runProcess(filePath, i, override);
+			success = tryMode(filePath, i, override);
 			if (success)
 			{
 				m_mode = i;
@@ -381,7 +394,7 @@ bool WolfDec::detectMode(const tString& filePath, const bool& override)
 
 		for (uint32_t i = 0; i < m_additionalModes.size(); i++)
 		{
-			success = runProcess(filePath, static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + i), override);
+			success = tryMode(filePath, static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + i), override);
 			if (success)
 			{
 				m_mode = static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + i);
@@ -390,11 +403,54 @@ bool WolfDec::detectMode(const tString& filePath, const bool& override)
 		}
 	}
 	else
-		success = runProcess(filePath, m_mode);
+		success = tryMode(filePath, m_mode);
 
 	return success;
 }
 
+bool WolfDec::tryMode(const tString& filePath, const uint32_t& mode, const bool& override) const
+{
+	const CryptMode& curMode = (mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(mode) : m_additionalModes.at(mode - DEFAULT_CRYPT_MODES.size()));
+
+	if (isInProcessMode(curMode))
+		return unpackInProcess(filePath, curMode);
+
+	return runProcess(filePath, mode, override);
+}
+
+bool WolfDec::unpackInProcess(const tString& filePath, const CryptMode& mode) const
+{
+	const fs::path fp = fs::path(filePath);
+
+	const tString directoryPath = fp.parent_path();
+	const tString fileName      = fp.stem();
+	const tString outDir        = directoryPath + TEXT("/") + fileName;
+
+	DXArchiveDecoder decoder;
+	decoder.SetThreadNum(m_decodeThreads == 0 ? std::thread::hardware_concurrency() : m_decodeThreads);
+
+	const DXArchiveDecoder::DECODE_RESULT result = decoder.DecodeArchive(filePath.c_str(), outDir.c_str(), mode.key.data());
+
+	if (result != DXArchiveDecoder::DECODE_RESULT_OK)
+	{
+		std::error_code ec;
+		fs::remove_all(outDir, ec);
+
+		// A wrong key is the expected result while detecting the mode, only report the other errors
+		if (result != DXArchiveDecoder::DECODE_RESULT_TABLE_ERROR && result != DXArchiveDecoder::DECODE_RESULT_HEADER_ERROR)
+			ERROR_LOG << std::format(TEXT("Failed to unpack {}: {}"), filePath, DXArchiveDecoder::GetResultString(result)) << std::endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+bool WolfDec::isInProcessMode(const CryptMode& mode)
+{
+	return mode.decFunc == &DXArchive::DecodeArchive;
+}
+
 bool WolfDec::runProcess(const tString& filePath, const uint32_t& mode, const bool& override) const
 {
 	STARTUPINFO si;
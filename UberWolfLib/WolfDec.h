@@ -106,6 +106,12 @@ public:
 		m_mode = mode;
 	}
 
+	// Number of threads used to extract the files of one archive, 0 = number of CPU cores
+	void SetDecodeThreads(const uint32_t& threads)
+	{
+		m_decodeThreads = threads;
+	}
+
 	bool IsValidFile(const tString& filePath) const;
 
 	bool IsAlreadyUnpacked(const tString& filePath) const;
@@ -131,14 +137,19 @@ private:
 	void loadConfig();
 	bool detectCrypt(const tString& filePath);
 	bool detectMode(const tString& filePath, const bool& override = false);
+	bool tryMode(const tString& filePath, const uint32_t& mode, const bool& override = false) const;
+	bool unpackInProcess(const tString& filePath, const CryptMode& mode) const;
 	bool runProcess(const tString& filePath, const uint32_t& mode, const bool& override = false) const;
 
+	static bool isInProcessMode(const CryptMode& mode);
+
 	uint16_t getCryptVersion(const tString& filePath) const;
 
 private:
 	uint32_t m_mode              = -1;
 	CryptModes m_additionalModes = {};
 	std::wstring m_progName;
-	bool m_isSubProcess = false;
-	bool m_valid        = false;
+	uint32_t m_decodeThreads = 0;
+	bool m_isSubProcess      = false;
+	bool m_valid             = false;
 };
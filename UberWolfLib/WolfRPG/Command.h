@@ -75,12 +75,19 @@ arg[0] >= 3000000 && arg[0] < 4000000
 #pragma once
 
 #include "FileCoder.h"
+#include "JsonWriter.h"
 #include "RouteCommand.h"
 #include "WolfRPGUtils.h"
 
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <memory>
 #include <nlohmann\json.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace Command
 {
@@ -161,301 +168,694 @@ enum class CommandType
 	Invalid            = -1
 };
 
-class Command
+inline const tString GetClassString(const CommandType& cid)
 {
-public:
-	Command(const CommandType& cid = CommandType::Default, const uInts& args = uInts(), const tStrings& stringArgs = tStrings(), const uint8_t& indent = -1) :
-		m_cid(cid),
-		m_args(args),
-		m_stringArgs(stringArgs),
-		m_indent(indent)
+	switch (cid)
 	{
+		case CommandType::Blank:
+			return L"Blank";
+		case CommandType::Checkpoint:
+			return L"Checkpoint";
+		case CommandType::Message:
+			return L"Message";
+		case CommandType::Choices:
+			return L"Choices";
+		case CommandType::Comment:
+			return L"Comment";
+		case CommandType::ForceStopMessage:
+			return L"ForceStopMessage";
+		case CommandType::DebugMessage:
+			return L"DebugMessage";
+		case CommandType::ClearDebugText:
+			return L"ClearDebugText";
+		case CommandType::VariableCondition:
+			return L"VariableCondition";
+		case CommandType::StringCondition:
+			return L"StringCondition";
+		case CommandType::SetVariable:
+			return L"SetVariable";
+		case CommandType::SetString:
+			return L"SetString";
+		case CommandType::InputKey:
+			return L"InputKey";
+		case CommandType::SetVariableEx:
+			return L"SetVariableEx";
+		case CommandType::AutoInput:
+			return L"AutoInput";
+		case CommandType::BanInput:
+			return L"BanInput";
+		case CommandType::Teleport:
+			return L"Teleport";
+		case CommandType::Sound:
+			return L"Sound";
+		case CommandType::Picture:
+			return L"Picture";
+		case CommandType::ChangeColor:
+			return L"ChangeColor";
+		case CommandType::SetTransition:
+			return L"SetTransition";
+		case CommandType::PrepareTransition:
+			return L"PrepareTransition";
+		case CommandType::ExecuteTransition:
+			return L"ExecuteTransition";
+		case CommandType::StartLoop:
+			return L"StartLoop";
+		case CommandType::BreakLoop:
+			return L"BreakLoop";
+		case CommandType::BreakEvent:
+			return L"BreakEvent";
+		case CommandType::EraseEvent:
+			return L"EraseEvent";
+		case CommandType::ReturnToTitle:
+			return L"ReturnToTitle";
+		case CommandType::EndGame:
+			return L"EndGame";
+		case CommandType::StartLoop2:
+			return L"StartLoop";
+		case CommandType::StopNonPic:
+			return L"StopNonPic";
+		case CommandType::ResumeNonPic:
+			return L"ResumeNonPic";
+		case CommandType::LoopTimes:
+			return L"LoopTimes";
+		case CommandType::Wait:
+			return L"Wait";
+		case CommandType::Move:
+			return L"Move";
+		case CommandType::WaitForMove:
+			return L"WaitForMove";
+		case CommandType::CommonEvent:
+			return L"CommonEvent";
+		case CommandType::CommonEventReserve:
+			return L"CommonEventReserve";
+		case CommandType::SetLabel:
+			return L"SetLabel";
+		case CommandType::JumpLabel:
+			return L"JumpLabel";
+		case CommandType::SaveLoad:
+			return L"SaveLoad";
+		case CommandType::LoadGame:
+			return L"LoadGame";
+		case CommandType::SaveGame:
+			return L"SaveGame";
+		case CommandType::MoveDuringEventOn:
+			return L"MoveDuringEventOn";
+		case CommandType::MoveDuringEventOff:
+			return L"MoveDuringEventOff";
+		case CommandType::Chip:
+			return L"Chip";
+		case CommandType::ChipSet:
+			return L"ChipSet";
+		case CommandType::Database:
+			return L"Database";
+		case CommandType::ImportDatabase:
+			return L"ImportDatabase";
+		case CommandType::Party:
+			return L"Party";
+		case CommandType::MapEffect:
+			return L"MapEffect";
+		case CommandType::ScrollScreen:
+			return L"ScrollScreen";
+		case CommandType::Effect:
+			return L"Effect";
+		case CommandType::CommonEventByName:
+			return L"CommonEventByName";
+		case CommandType::ChoiceCase:
+			return L"ChoiceCase";
+		case CommandType::SpecialChoiceCase:
+			return L"SpecialChoiceCase";
+		case CommandType::ElseCase:
+			return L"ElseCase";
+		case CommandType::CancelCase:
+			return L"CancelCase";
+		case CommandType::LoopEnd:
+			return L"LoopEnd";
+		case CommandType::BranchEnd:
+			return L"BranchEnd";
+		case CommandType::Default:
+			return L"Command";
+		default:
+			return L"Command";
 	}
+}
 
-	bool Valid() const
+// Route data of a move command
+struct MoveData
+{
+	std::array<uint8_t, 5> unknown = {};
+	uint8_t flags                  = 0;
+	RouteCommands route            = {};
+};
+
+// Fixed size part of a command, the arguments are ranges in the int and string pools of the store
+struct CommandHeader
+{
+	static constexpr uint32_t NO_MOVE = static_cast<uint32_t>(-1);
+
+	CommandType cid        = CommandType::Default;
+	uint32_t argsOffset    = 0;
+	uint32_t stringsOffset = 0;
+	uint32_t moveIndex     = NO_MOVE;
+	uint16_t argsCount     = 0;
+	uint16_t stringsCount  = 0;
+	uint8_t indent         = 0;
+};
+
+// Owns the commands of a whole Map or CommonEvents file
+// Instead of one heap object per command all commands share a header array and contiguous int and string pools
+class CommandStore
+{
+	struct StringRef
 	{
-		return (m_cid != CommandType::Invalid);
-	}
+		uint32_t offset = 0;
+		uint32_t length = 0;
+	};
 
-	static std::shared_ptr<Command> Init(FileCoder& coder);
+public:
+	CommandStore() = default;
 
-	void DumpData(FileCoder& coder) const
+	// Reads one command and returns its index
+	uint32_t Read(FileCoder& coder)
 	{
-		coder.WriteByte((uint8_t)m_args.size() + 1);
-		coder.WriteInt(static_cast<uint32_t>(m_cid));
-		for (uint32_t arg : m_args)
-			coder.WriteInt(arg);
-		coder.WriteByte(m_indent);
-		coder.WriteByte((uint8_t)m_stringArgs.size());
-		for (tString arg : m_stringArgs)
-			coder.WriteString(arg);
+		CommandHeader header;
+
+		// The count is stored plus one, a stored 0 wraps around just like the original 8 bit counter
+		const uint8_t argsCount = coder.ReadByte() - 1;
+		header.cid              = static_cast<CommandType>(coder.ReadInt());
+		header.argsOffset       = static_cast<uint32_t>(m_ints.size());
+		header.argsCount        = argsCount;
+
+		coder.ReadInts(m_ints, argsCount);
+
+		header.indent        = coder.ReadByte();
+		header.stringsCount  = coder.ReadByte();
+		header.stringsOffset = static_cast<uint32_t>(m_strings.size());
+
+		for (uint16_t i = 0; i < header.stringsCount; i++)
+			addString(coder.ReadString());
+
+		const uint8_t terminator = coder.ReadByte();
+		if (terminator != TERMINATOR && terminator != MOVE_TERMINATOR)
+			throw WolfRPGException(ERROR_TAG + "Unexpected command terminator: " + std::to_string(terminator));
+
+		if (terminator == MOVE_TERMINATOR || header.cid == CommandType::Move)
+		{
+			MoveData move;
+			coder.Read(move.unknown);
+			move.flags   = coder.ReadByte();
+
+			uint32_t routeCount = coder.ReadInt();
+			for (uint32_t i = 0; i < routeCount; i++)
+			{
+				RouteCommand rc;
+				if (!rc.Init(coder))
+					throw WolfRPGException(ERROR_TAG + "RouteCommand initialization failed");
+
+				move.route.push_back(std::move(rc));
+			}
+
+			header.moveIndex = static_cast<uint32_t>(m_moves.size());
+			m_moves.push_back(std::move(move));
+		}
+
+		if (coder.Context().v35)
+		{
+			uint8_t unknown = coder.ReadByte();
+
+			if (unknown != 0x0)
+				throw WolfRPGException(ERROR_TAG + "Unexpected command unknown byte: " + std::to_string(unknown));
+		}
+
+		m_headers.push_back(header);
+
+		return static_cast<uint32_t>(m_headers.size() - 1);
 	}
 
-	void Dump(FileCoder& coder) const
+	// Skips one command without storing it
+	static void Skip(FileCoder& coder)
+	{
+		const uint8_t argsCount = coder.ReadByte() - 1;
+		const CommandType cid   = static_cast<CommandType>(coder.ReadInt());
+		coder.Skip(argsCount * 4);
+
+		coder.Skip(1); // Indent
+		const uint8_t stringsCount = coder.ReadByte();
+
+		for (uint8_t i = 0; i < stringsCount; i++)
+			coder.SkipString();
+
+		const uint8_t terminator = coder.ReadByte();
+		if (terminator != TERMINATOR && terminator != MOVE_TERMINATOR)
+			throw WolfRPGException(ERROR_TAG + "Unexpected command terminator: " + std::to_string(terminator));
+
+		if (terminator == MOVE_TERMINATOR || cid == CommandType::Move)
+		{
+			coder.Skip(std::tuple_size_v<decltype(MoveData::unknown)> + 1);
+
+			const uint32_t routeCount = coder.ReadInt();
+			for (uint32_t i = 0; i < routeCount; i++)
+				RouteCommand::Skip(coder);
+		}
+
+		if (coder.Context().v35)
+		{
+			uint8_t unknown = coder.ReadByte();
+
+			if (unknown != 0x0)
+				throw WolfRPGException(ERROR_TAG + "Unexpected command unknown byte: " + std::to_string(unknown));
+		}
+	}
+
+	void Dump(FileCoder& coder, const uint32_t& index) const
 	{
-		DumpData(coder);
-		DumpTerminator(coder);
+		const CommandHeader& header = m_headers[index];
+
+		coder.WriteByte(static_cast<uint8_t>(header.argsCount + 1));
+		coder.WriteInt(static_cast<uint32_t>(header.cid));
+		for (const uint32_t& arg : Args(index))
+			coder.WriteInt(arg);
+		coder.WriteByte(header.indent);
+		coder.WriteByte(static_cast<uint8_t>(header.stringsCount));
+		for (uint16_t i = 0; i < header.stringsCount; i++)
+			coder.WriteString(tString(String(index, i)));
+
+		if (header.moveIndex != CommandHeader::NO_MOVE)
+		{
+			const MoveData& move = m_moves[header.moveIndex];
+
+			coder.WriteByte(MOVE_TERMINATOR);
+			coder.Write(move.unknown);
+
+			coder.WriteByte(move.flags);
+			coder.WriteInt(static_cast<uint32_t>(move.route.size()));
+			for (const RouteCommand& cmd : move.route)
+				cmd.Dump(coder);
+		}
+		else
+			coder.WriteByte(TERMINATOR);
 
 		// v3.5 has a final 0x0 terminator, no idea if this changes in the future, but for now it is fixed at 0x0
-		if (s_v35)
+		if (coder.Context().v35)
 			coder.WriteByte(0);
 	}
 
-	virtual nlohmann::ordered_json ToJson() const
+	// Commands without strings and arguments have nothing to translate and are not written, returns false for them.
+	// listIndex is the position of the command in its list, it is needed to patch the command again
+	bool ToJson(JsonWriter& writer, const uint32_t& index, const std::size_t& listIndex) const
 	{
-		if (m_stringArgs.empty() && m_args.empty())
-			return nlohmann::ordered_json();
+		const CommandHeader& header = m_headers[index];
+
+		if (header.stringsCount == 0 && header.argsCount == 0)
+			return false;
 
-		nlohmann::ordered_json json;
-		json["code"]    = static_cast<int32_t>(m_cid);
-		json["codeStr"] = ToUTF8(GetClassString());
+		writer.BeginObject();
+		writer.Write("code", static_cast<int32_t>(header.cid));
+		writer.Write("codeStr", GetClassString(header.cid));
 
-		if (!m_stringArgs.empty())
+		if (header.stringsCount != 0)
 		{
-			json["stringArgs"] = nlohmann::ordered_json::array();
+			writer.Key("stringArgs");
+			writer.BeginArray();
 
-			for (const tString& arg : m_stringArgs)
-				json["stringArgs"].push_back(ToUTF8(arg));
+			for (uint16_t i = 0; i < header.stringsCount; i++)
+				writer.Value(tString(String(index, i)));
+
+			writer.EndArray();
 		}
 
-		if (!m_args.empty())
+		if (header.argsCount != 0)
 		{
-			json["intArgs"] = nlohmann::ordered_json::array();
+			writer.Key("intArgs");
+			writer.BeginArray();
+
+			for (const uint32_t& arg : Args(index))
+				writer.Value(arg);
 
-			for (const uint32_t& arg : m_args)
-				json["intArgs"].push_back(arg);
+			writer.EndArray();
 		}
 
-		return json;
+		writer.Write("index", listIndex);
+		writer.EndObject();
+
+		return true;
 	}
 
-	virtual void Patch(const nlohmann::ordered_json& j)
+	// Replaced arguments are appended to the pools, the old ones stay unused until the store is destroyed
+	void Patch(const uint32_t& index, const nlohmann::ordered_json& j)
 	{
 		CHECK_JSON_KEY(j, "code", "command");
 
+		CommandHeader& header = m_headers[index];
+
 		if (j.contains("stringArgs"))
 		{
-			m_stringArgs.clear();
+			checkCount(j["stringArgs"].size());
+
+			header.stringsOffset = static_cast<uint32_t>(m_strings.size());
+			header.stringsCount  = static_cast<uint16_t>(j["stringArgs"].size());
+
 			for (const auto& arg : j["stringArgs"])
-				m_stringArgs.push_back(ToUTF16(arg));
+				addString(ToUTF16(arg));
 		}
 
 		if (j.contains("intArgs"))
 		{
-			m_args.clear();
+			checkCount(j["intArgs"].size());
+
+			header.argsOffset = static_cast<uint32_t>(m_ints.size());
+			header.argsCount  = static_cast<uint16_t>(j["intArgs"].size());
+
 			for (const auto& arg : j["intArgs"])
-				m_args.push_back(arg);
+				m_ints.push_back(arg);
 		}
 	}
 
-	bool IsUpdatable() const
+	const CommandHeader& Header(const uint32_t& index) const
+	{
+		return m_headers[index];
+	}
+
+	std::span<const uint32_t> Args(const uint32_t& index) const
+	{
+		const CommandHeader& header = m_headers[index];
+		return std::span<const uint32_t>(m_ints.data() + header.argsOffset, header.argsCount);
+	}
+
+	std::wstring_view String(const uint32_t& index, const std::size_t& stringIndex) const
+	{
+		const StringRef& ref = m_strings[m_headers[index].stringsOffset + stringIndex];
+		return std::wstring_view(m_chars.data() + ref.offset, ref.length);
+	}
+
+	const MoveData* Move(const uint32_t& index) const
+	{
+		const CommandHeader& header = m_headers[index];
+		return (header.moveIndex == CommandHeader::NO_MOVE) ? nullptr : &m_moves[header.moveIndex];
+	}
+
+	std::size_t Size() const
+	{
+		return m_headers.size();
+	}
+
+	// Removes all commands but keeps the allocated pools
+	void Clear()
+	{
+		m_headers.clear();
+		m_ints.clear();
+		m_strings.clear();
+		m_chars.clear();
+		m_moves.clear();
+	}
+
+private:
+	void addString(const tString& str)
+	{
+		m_strings.push_back({ static_cast<uint32_t>(m_chars.size()), static_cast<uint32_t>(str.size()) });
+		m_chars.append(str);
+	}
+
+	static void checkCount(const std::size_t& count)
+	{
+		if (count > UINT16_MAX)
+			throw WolfRPGException(ERROR_TAG + "Too many command arguments: " + std::to_string(count));
+	}
+
+private:
+	std::vector<CommandHeader> m_headers = {};
+	std::vector<uint32_t> m_ints         = {};
+	std::vector<StringRef> m_strings     = {};
+	tString m_chars                      = TEXT("");
+	std::vector<MoveData> m_moves        = {};
+
+	static constexpr uint8_t TERMINATOR      = 0x0;
+	static constexpr uint8_t MOVE_TERMINATOR = 0x1;
+};
+
+using CommandStorePtr = std::shared_ptr<CommandStore>;
+
+// Lightweight read-only handle of one command in a store
+class CommandView
+{
+public:
+	CommandView(const CommandStore* pStore, const uint32_t& index) :
+		m_pStore(pStore),
+		m_index(index)
+	{
+	}
+
+	bool Valid() const
+	{
+		return (GetType() != CommandType::Invalid);
+	}
+
+	CommandType GetType() const
+	{
+		return m_pStore->Header(m_index).cid;
+	}
+
+	uint8_t GetIndent() const
+	{
+		return m_pStore->Header(m_index).indent;
+	}
+
+	std::span<const uint32_t> GetArgs() const
+	{
+		return m_pStore->Args(m_index);
+	}
+
+	std::size_t GetStringCount() const
+	{
+		return m_pStore->Header(m_index).stringsCount;
+	}
+
+	std::wstring_view GetStringArg(const std::size_t& index) const
+	{
+		if (index >= GetStringCount())
+			throw WolfRPGException(ERROR_TAGW + L"String argument " + std::to_wstring(index) + L" out of range");
+
+		return m_pStore->String(m_index, index);
+	}
+
+	tStrings Texts() const
+	{
+		tStrings strs;
+		for (std::size_t i = 0; i < GetStringCount(); i++)
+			strs.push_back(tString(m_pStore->String(m_index, i)));
+
+		return strs;
+	}
+
+	tString Text() const
 	{
-		return (!m_stringArgs.empty());
+		if (GetStringCount() == 0) return L"";
+		return tString(m_pStore->String(m_index, 0));
 	}
 
-	const CommandType GetType() const
+	bool IsUpdatable() const
 	{
-		return m_cid;
+		return (GetStringCount() != 0);
 	}
 
 	const tString GetClassString() const
 	{
-		switch (m_cid)
+		return ::Command::GetClassString(GetType());
+	}
+
+	bool ToJson(JsonWriter& writer, const std::size_t& listIndex) const
+	{
+		return m_pStore->ToJson(writer, m_index, listIndex);
+	}
+
+protected:
+	const CommandStore* m_pStore;
+	uint32_t m_index;
+};
+
+// The commands of a page or common event, a range in the store of the owning file
+class CommandList
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator(const CommandStore* pStore, const uint32_t& index) :
+			m_pStore(pStore),
+			m_index(index)
 		{
-			case CommandType::Blank:
-				return L"Blank";
-			case CommandType::Checkpoint:
-				return L"Checkpoint";
-			case CommandType::Message:
-				return L"Message";
-			case CommandType::Choices:
-				return L"Choices";
-			case CommandType::Comment:
-				return L"Comment";
-			case CommandType::ForceStopMessage:
-				return L"ForceStopMessage";
-			case CommandType::DebugMessage:
-				return L"DebugMessage";
-			case CommandType::ClearDebugText:
-				return L"ClearDebugText";
-			case CommandType::VariableCondition:
-				return L"VariableCondition";
-			case CommandType::StringCondition:
-				return L"StringCondition";
-			case CommandType::SetVariable:
-				return L"SetVariable";
-			case CommandType::SetString:
-				return L"SetString";
-			case CommandType::InputKey:
-				return L"InputKey";
-			case CommandType::SetVariableEx:
-				return L"SetVariableEx";
-			case CommandType::AutoInput:
-				return L"AutoInput";
-			case CommandType::BanInput:
-				return L"BanInput";
-			case CommandType::Teleport:
-				return L"Teleport";
-			case CommandType::Sound:
-				return L"Sound";
-			case CommandType::Picture:
-				return L"Picture";
-			case CommandType::ChangeColor:
-				return L"ChangeColor";
-			case CommandType::SetTransition:
-				return L"SetTransition";
-			case CommandType::PrepareTransition:
-				return L"PrepareTransition";
-			case CommandType::ExecuteTransition:
-				return L"ExecuteTransition";
-			case CommandType::StartLoop:
-				return L"StartLoop";
-			case CommandType::BreakLoop:
-				return L"BreakLoop";
-			case CommandType::BreakEvent:
-				return L"BreakEvent";
-			case CommandType::EraseEvent:
-				return L"EraseEvent";
-			case CommandType::ReturnToTitle:
-				return L"ReturnToTitle";
-			case CommandType::EndGame:
-				return L"EndGame";
-			case CommandType::StartLoop2:
-				return L"StartLoop";
-			case CommandType::StopNonPic:
-				return L"StopNonPic";
-			case CommandType::ResumeNonPic:
-				return L"ResumeNonPic";
-			case CommandType::LoopTimes:
-				return L"LoopTimes";
-			case CommandType::Wait:
-				return L"Wait";
-			case CommandType::Move:
-				return L"Move";
-			case CommandType::WaitForMove:
-				return L"WaitForMove";
-			case CommandType::CommonEvent:
-				return L"CommonEvent";
-			case CommandType::CommonEventReserve:
-				return L"CommonEventReserve";
-			case CommandType::SetLabel:
-				return L"SetLabel";
-			case CommandType::JumpLabel:
-				return L"JumpLabel";
-			case CommandType::SaveLoad:
-				return L"SaveLoad";
-			case CommandType::LoadGame:
-				return L"LoadGame";
-			case CommandType::SaveGame:
-				return L"SaveGame";
-			case CommandType::MoveDuringEventOn:
-				return L"MoveDuringEventOn";
-			case CommandType::MoveDuringEventOff:
-				return L"MoveDuringEventOff";
-			case CommandType::Chip:
-				return L"Chip";
-			case CommandType::ChipSet:
-				return L"ChipSet";
-			case CommandType::Database:
-				return L"Database";
-			case CommandType::ImportDatabase:
-				return L"ImportDatabase";
-			case CommandType::Party:
-				return L"Party";
-			case CommandType::MapEffect:
-				return L"MapEffect";
-			case CommandType::ScrollScreen:
-				return L"ScrollScreen";
-			case CommandType::Effect:
-				return L"Effect";
-			case CommandType::CommonEventByName:
-				return L"CommonEventByName";
-			case CommandType::ChoiceCase:
-				return L"ChoiceCase";
-			case CommandType::SpecialChoiceCase:
-				return L"SpecialChoiceCase";
-			case CommandType::ElseCase:
-				return L"ElseCase";
-			case CommandType::CancelCase:
-				return L"CancelCase";
-			case CommandType::LoopEnd:
-				return L"LoopEnd";
-			case CommandType::BranchEnd:
-				return L"BranchEnd";
-			case CommandType::Default:
-				return L"Command";
-			default:
-				return L"Command";
 		}
+
+		CommandView operator*() const
+		{
+			return CommandView(m_pStore, m_index);
+		}
+
+		Iterator& operator++()
+		{
+			m_index++;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return m_index != other.m_index;
+		}
+
+	private:
+		const CommandStore* m_pStore;
+		uint32_t m_index;
+	};
+
+public:
+	CommandList() = default;
+
+	CommandList(const CommandStorePtr& store, const uint32_t& first, const uint32_t& count) :
+		m_store(store),
+		m_first(first),
+		m_count(count)
+	{
 	}
 
-	virtual const tString Text() const
+	std::size_t size() const
 	{
-		if (m_stringArgs.empty()) return L"";
-		return m_stringArgs.at(0);
+		return m_count;
 	}
 
-	virtual void SetText(const tString& value, const uint32_t& index)
+	bool empty() const
 	{
-		if (m_stringArgs.size() <= index)
-			throw WolfRPGException(ERROR_TAGW + L"setText(" + value + L", " + std::to_wstring(index) + L") out of range");
+		return (m_count == 0);
+	}
 
-		m_stringArgs[index] = value;
+	CommandView operator[](const std::size_t& index) const
+	{
+		return CommandView(m_store.get(), m_first + static_cast<uint32_t>(index));
 	}
 
-	virtual const tStrings& Texts() const
+	Iterator begin() const
 	{
-		return m_stringArgs;
+		return Iterator(m_store.get(), m_first);
 	}
 
-	virtual const PictureType Type() const
+	Iterator end() const
 	{
-		return PictureType::invalid;
+		return Iterator(m_store.get(), m_first + m_count);
 	}
 
-	virtual const uint8_t Num() const
+	void Dump(FileCoder& coder) const
 	{
-		return 0xFF;
+		for (uint32_t i = 0; i < m_count; i++)
+			m_store->Dump(coder, m_first + i);
 	}
 
-	virtual const tString Filename() const
+	void Patch(const std::size_t& index, const nlohmann::ordered_json& j)
+	{
+		m_store->Patch(m_first + static_cast<uint32_t>(index), j);
+	}
+
+private:
+	CommandStorePtr m_store = nullptr;
+	uint32_t m_first        = 0;
+	uint32_t m_count        = 0;
+};
+
+// Reads count commands into the store and returns them as a list
+inline CommandList ReadCommands(FileCoder& coder, const CommandStorePtr& store, const uint32_t& count)
+{
+	const uint32_t first = static_cast<uint32_t>(store->Size());
+
+	for (uint32_t i = 0; i < count; i++)
 	{
-		return L"";
+		const uint32_t index = store->Read(coder);
+
+		if (!CommandView(store.get(), index).Valid())
+			throw WolfRPGException(ERROR_TAG + "Command initialization failed");
 	}
 
-	virtual void SetFilename([[maybe_unused]] const tString& value)
+	return CommandList(store, first, count);
+}
+
+// Set of command types reported by a CommandScanner, an empty filter matches every command
+class CommandFilter
+{
+public:
+	CommandFilter() = default;
+
+	CommandFilter(std::initializer_list<CommandType> types) :
+		m_types(types)
 	{
 	}
 
-	virtual void DumpTerminator(FileCoder& coder) const
+	bool Contains(const CommandType& type) const
 	{
-		coder.WriteByte(TERMINATOR);
+		return m_types.empty() || (std::find(m_types.begin(), m_types.end(), type) != m_types.end());
 	}
 
-	static bool s_v35;
+private:
+	std::vector<CommandType> m_types = {};
+};
 
-protected:
-	uInts m_args;
-	CommandType m_cid;
-	tStrings m_stringArgs;
-	uint8_t m_indent;
+// Streams commands to a callback without building the object tree of the file.
+// Only commands matching the filter are decoded, all others are skipped including the conversion of their strings.
+// The view passed to the callback is only valid during the call
+class CommandScanner
+{
+public:
+	using Callback = std::function<void(const CommandView&)>;
+
+public:
+	CommandScanner(const CommandFilter& filter, const Callback& callback) :
+		m_filter(filter),
+		m_callback(callback)
+	{
+	}
+
+	void Scan(FileCoder& coder, const uint32_t& count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			// Peek at the type, it follows the argument count
+			coder.Skip(1);
+			const CommandType cid = static_cast<CommandType>(coder.ReadInt());
+			coder.Seek(-5);
+
+			if (cid == CommandType::Invalid)
+				throw WolfRPGException(ERROR_TAG + "Command initialization failed");
+
+			if (!m_filter.Contains(cid))
+			{
+				CommandStore::Skip(coder);
+				continue;
+			}
+
+			m_store.Clear();
+			const uint32_t index = m_store.Read(coder);
+			m_callback(CommandView(&m_store, index));
+		}
+	}
 
-	static const uint8_t TERMINATOR = 0x0;
+private:
+	CommandFilter m_filter;
+	Callback m_callback;
+	CommandStore m_store = {};
 };
 
 namespace CommandSpecialClasses
 {
-class Picture : public Command
+class Picture : public CommandView
 {
 public:
-	Picture(const CommandType& cid, const uInts& args, const tStrings& stringArgs, const uint8_t& indent) :
-		Command(cid, args, stringArgs, indent)
+	explicit Picture(const CommandView& view) :
+		CommandView(view)
 	{
 	}
 
-	virtual const PictureType Type() const
+	const PictureType Type() const
 	{
-		uint8_t t = (m_args[0] >> 4) & 0x07;
+		const std::span<const uint32_t> args = GetArgs();
+		if (args.empty())
+			return PictureType::invalid;
+
+		uint8_t t = (args[0] >> 4) & 0x07;
 		switch (t)
 		{
 			case 0:
@@ -473,93 +873,29 @@ public:
 		}
 	}
 
-	virtual const uint8_t Num() const
+	const uint8_t Num() const
 	{
-		return static_cast<uint8_t>(m_args[1]);
-	}
-
-	virtual const tString Text() const
-	{
-		if (Type() != PictureType::text)
-			throw WolfRPGException(ERROR_TAG + "Picture type \"" + std::to_string(static_cast<int32_t>(Type())) + "\" has no text");
-
-		if (m_stringArgs.empty())
-			return L"";
-
-		return m_stringArgs.at(0);
+		return static_cast<uint8_t>(GetArgs()[1]);
 	}
 
-	virtual void SetText(const tString& value)
+	const tString Text() const
 	{
 		if (Type() != PictureType::text)
 			throw WolfRPGException(ERROR_TAG + "Picture type \"" + std::to_string(static_cast<int32_t>(Type())) + "\" has no text");
 
-		if (m_stringArgs.empty())
-			m_stringArgs.push_back(value);
-		else
-			m_stringArgs[0] = value;
-	}
-
-	virtual const tString Filename() const
-	{
-		if (Type() != PictureType::file && Type() != PictureType::windowFile)
-			throw WolfRPGException(ERROR_TAG + "Picture type \"" + std::to_string(static_cast<int32_t>(Type())) + "\" has no text");
-
-		return m_stringArgs[0];
+		return CommandView::Text();
 	}
 
-	virtual void SetFilename(const tString& value)
+	const tString Filename() const
 	{
 		if (Type() != PictureType::file && Type() != PictureType::windowFile)
 			throw WolfRPGException(ERROR_TAG + "Picture type \"" + std::to_string(static_cast<int32_t>(Type())) + "\" has no text");
 
-		m_stringArgs[0] = value;
-	}
-};
-
-class Move : public Command
-{
-public:
-	Move(const CommandType& cid, const uInts& args, const tStrings& stringArgs, const uint8_t& indent, FileCoder& coder) :
-		Command(cid, args, stringArgs, indent)
-	{
-		// Read unknown data
-		for (uint32_t i = 0; i < 5; i++)
-			m_unknown.push_back(coder.ReadByte());
-		// Read known data
-		m_flags = coder.ReadByte();
-
-		// Read route
-		uint32_t routeCount = coder.ReadInt();
-		for (uint32_t i = 0; i < routeCount; i++)
-		{
-			RouteCommand rc;
-			if (!rc.Init(coder))
-				throw WolfRPGException(ERROR_TAG + "RouteCommand initialization failed");
-
-			m_route.push_back(rc);
-		}
-	}
-
-	virtual void DumpTerminator(FileCoder& coder) const
-	{
-		coder.WriteByte(1);
-		for (uint8_t byte : m_unknown)
-			coder.WriteByte(byte);
-
-		coder.WriteByte(m_flags);
-		coder.WriteInt(static_cast<uint32_t>(m_route.size()));
-		for (RouteCommand cmd : m_route)
-			cmd.Dump(coder);
+		return tString(GetStringArg(0));
 	}
-
-private:
-	Bytes m_unknown       = {};
-	uint8_t m_flags       = 0;
-	RouteCommands m_route = {};
 };
 
-class ProFeature : public Command
+class ProFeature : public CommandView
 {
 public:
 	enum class Type
@@ -590,52 +926,51 @@ public:
 		9 - Vibrate gamepad
 	*/
 public:
-	ProFeature(const CommandType& cid, const uInts& args, const tStrings& stringArgs, const uint8_t& indent) :
-		Command(cid, args, stringArgs, indent)
+	explicit ProFeature(const CommandView& view) :
+		CommandView(view)
 	{
 	}
 
 	const Type GetProFeatureType() const
 	{
-		if (m_args.empty())
+		if (GetArgs().empty())
 			return Type::Invalid;
-		return static_cast<Type>(m_args[0]);
+		return static_cast<Type>(GetArgs()[0]);
 	}
 
 	const tString GetWolfxFolder() const
 	{
-		if (m_stringArgs.empty())
+		if (GetStringCount() == 0)
 			return L"";
-		return m_stringArgs.at(0);
+		return tString(GetStringArg(0));
 	}
 
 	const tString GetWolfxKey() const
 	{
-		if (m_stringArgs.size() < 2)
+		if (GetStringCount() < 2)
 			return L"";
-		return m_stringArgs.at(1);
+		return tString(GetStringArg(1));
 	}
-
-private:
 };
 
-class SetString : public Command
+class SetString : public CommandView
 {
 public:
-	SetString(const CommandType& cid, const uInts& args, const tStrings& stringArgs, const uint8_t& indent) :
-		Command(cid, args, stringArgs, indent)
+	explicit SetString(const CommandView& view) :
+		CommandView(view)
 	{
 	}
 
 	const uint32_t GetID() const
 	{
-		if (m_args.empty())
+		const std::span<const uint32_t> args = GetArgs();
+		if (args.empty())
 			return 0;
 
-		if (m_args[0] >= 3000000 && m_args[0] < 4000000)
-			return (m_args[0] % 1000000);
+		if (args[0] >= 3000000 && args[0] < 4000000)
+			return (args[0] % 1000000);
 
-		return m_args[0];
+		return args[0];
 	}
 
 	tString GetTString() const
@@ -649,127 +984,63 @@ public:
 	}
 };
 
-class SetVariable : public Command
+class SetVariable : public CommandView
 {
 public:
-	SetVariable(const CommandType& cid, const uInts& args, const tStrings& stringArgs, const uint8_t& indent) :
-		Command(cid, args, stringArgs, indent)
+	explicit SetVariable(const CommandView& view) :
+		CommandView(view)
 	{
 	}
 
 	const uint32_t GetID() const
 	{
-		if (m_args.empty())
+		const std::span<const uint32_t> args = GetArgs();
+		if (args.empty())
 			return 0;
-		if (m_args[0] >= 2000000 && m_args[0] < 3000000)
-			return m_args[0] - 2000000;
+		if (args[0] >= 2000000 && args[0] < 3000000)
+			return args[0] - 2000000;
 
-		return m_args[0];
+		return args[0];
 	}
 
 	const uint32_t GetValue() const
 	{
-		if (m_args.size() < 2)
+		const std::span<const uint32_t> args = GetArgs();
+		if (args.size() < 2)
 			return 0;
 
 		// TODO: Account for actual arithmetic operations using args[2] and args[3]
-		return m_args[1];
+		return args[1];
 	}
 };
 
 }; // namespace CommandSpecialClasses
 
-namespace CommandShPtr
-{
-using Command     = std::shared_ptr<Command>;
-using Move        = std::shared_ptr<CommandSpecialClasses::Move>;
-using Picture     = std::shared_ptr<CommandSpecialClasses::Picture>;
-using ProFeature  = std::shared_ptr<CommandSpecialClasses::ProFeature>;
-using SetString   = std::shared_ptr<CommandSpecialClasses::SetString>;
-using SetVariable = std::shared_ptr<CommandSpecialClasses::SetVariable>;
-} // namespace CommandShPtr
-
-inline CommandShPtr::Command Command::Command::Init(FileCoder& coder)
-{
-	CommandShPtr::Command cmd = nullptr;
-	uint8_t argsCount         = coder.ReadByte() - 1;
-	CommandType cid           = static_cast<CommandType>(coder.ReadInt());
-	uInts args;
-
-	for (uint8_t i = 0; i < argsCount; i++)
-		args.push_back(coder.ReadInt());
-
-	uint8_t indent = coder.ReadByte();
-	argsCount      = coder.ReadByte();
-
-	tStrings stringArgs;
-
-	for (uint8_t i = 0; i < argsCount; i++)
-		stringArgs.push_back(coder.ReadString());
-
-	uint8_t terminator = coder.ReadByte();
-	if (terminator == 0x01)
-		cmd = std::make_shared<CommandSpecialClasses::Move>(cid, args, stringArgs, indent, coder);
-	else if (terminator != TERMINATOR)
-		throw WolfRPGException(ERROR_TAG + "Unexpected command terminator: " + std::to_string(terminator));
-	else
-	{
-		switch (cid)
-		{
-			case CommandType::Picture:
-				cmd = std::make_shared<CommandSpecialClasses::Picture>(cid, args, stringArgs, indent);
-				break;
-			case CommandType::Move:
-				cmd = std::make_shared<CommandSpecialClasses::Move>(cid, args, stringArgs, indent, coder);
-				break;
-			case CommandType::ProFeature:
-				cmd = std::make_shared<CommandSpecialClasses::ProFeature>(cid, args, stringArgs, indent);
-				break;
-			case CommandType::SetString:
-				cmd = std::make_shared<CommandSpecialClasses::SetString>(cid, args, stringArgs, indent);
-				break;
-			case CommandType::SetVariable:
-				cmd = std::make_shared<CommandSpecialClasses::SetVariable>(cid, args, stringArgs, indent);
-				break;
-			default:
-				cmd = std::make_shared<Command>(cid, args, stringArgs, indent);
-				break;
-		}
-	}
-
-	if (s_v35)
-	{
-		uint8_t unknown = coder.ReadByte();
-
-		if (unknown != 0x0)
-			throw WolfRPGException(ERROR_TAG + "Unexpected command unknown byte: " + std::to_string(unknown));
-	}
-
-	return cmd;
-}
-
-static const tStrings stringsOfCommand(const CommandShPtr::Command& command)
+static const tStrings stringsOfCommand(const CommandView& command)
 {
 	tStrings strs = tStrings();
-	if (!command->Valid()) return strs;
+	if (!command.Valid()) return strs;
 
-	switch (command->GetType())
+	switch (command.GetType())
 	{
 		case CommandType::Message:
 		case CommandType::SetString:
 		case CommandType::Database:
-			strs.push_back(command->Text());
+			strs.push_back(command.Text());
 			break;
 		case CommandType::Choices:
 		case CommandType::StringCondition:
-			return command->Texts();
+			return command.Texts();
 		case CommandType::Picture:
-			if (command->Type() == PictureType::text)
-				strs.push_back(command->Text());
+		{
+			const CommandSpecialClasses::Picture picture(command);
+			if (picture.Type() == PictureType::text)
+				strs.push_back(picture.Text());
 			break;
+		}
 		case CommandType::CommonEventByName:
 			for (size_t i = 1; i <= 3; i++)
-				strs.push_back(command->Texts().at(i));
+				strs.push_back(tString(command.GetStringArg(i)));
 			break;
 		default:
 			break;
@@ -778,5 +1049,5 @@ static const tStrings stringsOfCommand(const CommandShPtr::Command& command)
 	return strs;
 }
 
-using Commands = std::vector<CommandShPtr::Command>;
+using Commands = CommandList;
 } // namespace Command
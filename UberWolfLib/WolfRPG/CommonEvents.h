@@ -46,12 +46,76 @@ public:
 	{
 	}
 
-	explicit CommonEvent(FileCoder& coder, const uint32_t& id) :
+	explicit CommonEvent(FileCoder& coder, const uint32_t& id, const Command::CommandStorePtr& commandStore) :
 		m_id(id),
 		m_valid(false),
 		m_unknown10Valid(false)
 	{
-		m_valid = init(coder);
+		m_valid = init(coder, commandStore);
+	}
+
+	// Walks a common event like init, but only passes the commands to the scanner
+	static void Scan(FileCoder& coder, Command::CommandScanner& scanner)
+	{
+		uint8_t indicator = coder.ReadByte();
+		if (indicator != 0x8E)
+			throw WolfRPGException(ERROR_TAG + "CommonEvent header indicator not 0x8E (got " + Dec2Hex(indicator) + ")");
+
+		coder.Skip(4 + 4 + std::tuple_size_v<decltype(m_unknown2)>);
+		coder.SkipString();
+
+		uint32_t commandCnt = coder.ReadInt();
+		scanner.Scan(coder, commandCnt);
+
+		coder.SkipString();
+		coder.SkipString();
+
+		indicator = coder.ReadByte();
+		if (indicator != 0x8F)
+			throw WolfRPGException(ERROR_TAG + "CommonEvent data indicator not 0x8F (got " + Dec2Hex(indicator) + ")");
+
+		uint32_t count = coder.ReadInt();
+		for (uint32_t i = 0; i < count; i++)
+			coder.SkipString();
+
+		coder.Skip(coder.ReadInt());
+
+		count = coder.ReadInt();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t strCount = coder.ReadInt();
+			for (uint32_t j = 0; j < strCount; j++)
+				coder.SkipString();
+		}
+
+		count = coder.ReadInt();
+		for (uint32_t i = 0; i < count; i++)
+			coder.Skip(coder.ReadInt() * 4);
+
+		coder.Skip(std::tuple_size_v<decltype(m_unknown7)>);
+		for (std::size_t i = 0; i < std::tuple_size_v<decltype(m_unknown8)>; i++)
+			coder.SkipString();
+
+		indicator = coder.ReadByte();
+		if (indicator != 0x91)
+			throw WolfRPGException(ERROR_TAG + "CommonEvent data indicator not 0x91 (got " + Dec2Hex(indicator) + ")");
+
+		coder.SkipString();
+
+		indicator = coder.ReadByte();
+		if (indicator != 0x92)
+		{
+			if (indicator == 0x91) return;
+
+			throw WolfRPGException(ERROR_TAG + "CommonEvent data indicator not 0x92 or 0x91 (got " + Dec2Hex(indicator) + ")");
+		}
+
+		coder.SkipString();
+		coder.Skip(4);
+
+		indicator = coder.ReadByte();
+		if (indicator != 0x92)
+			throw WolfRPGException(ERROR_TAG + "CommonEvent data indicator not 0x92 (got " + Dec2Hex(indicator) + ")");
 	}
 
 	void Dump(FileCoder& coder) const
@@ -63,8 +127,7 @@ public:
 		coder.WriteString(m_name);
 		coder.WriteInt(m_commands.size());
 
-		for (const Command::CommandShPtr::Command& cmd : m_commands)
-			cmd->Dump(coder);
+		m_commands.Dump(coder);
 
 		coder.WriteString(m_unknown11);
 		coder.WriteString(m_description);
@@ -112,58 +175,75 @@ public:
 			coder.WriteByte(0x91);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-
-		j["id"]          = m_intId;
-		j["name"]        = ToUTF8(m_name);
-		j["description"] = ToUTF8(m_description);
-		j["commands"]    = nlohmann::ordered_json::array();
+		writer.BeginObject();
+		writer.Write("id", m_intId);
+		writer.Write("name", m_name);
+		writer.Write("description", m_description);
+		writer.Key("commands");
+		writer.BeginArray();
 
 		for (std::size_t i = 0; i < m_commands.size(); i++)
-		{
-			nlohmann::ordered_json cmdJ = m_commands[i]->ToJson();
+			m_commands[i].ToJson(writer, i);
 
-			if (!cmdJ.empty())
-			{
-				cmdJ["index"] = i;
-				j["commands"].push_back(cmdJ);
-			}
-		}
-
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
-	void Patch(const nlohmann::ordered_json& j)
+	// The commands are patched while the list is read, only one command is kept as JSON at a time
+	void Patch(JsonReader& reader)
 	{
-		CHECK_JSON_KEY(j, "id", "CommonEvent");
+		bool hasId          = false;
+		bool hasName        = false;
+		bool hasDescription = false;
+		bool hasCommands    = false;
 
-		const uint32_t id = j["id"].get<uint32_t>();
+		reader.ForEachKey([&](const std::string& key) {
+			if (key == "id")
+			{
+				const uint32_t id = reader.ReadValue().get<uint32_t>();
 
-		if (id != m_intId)
-			throw WolfRPGException(ERROR_TAG + "ID mismatch in patch (expected " + std::to_string(m_intId) + ", got " + std::to_string(id) + ")");
+				if (id != m_intId)
+					throw WolfRPGException(ERROR_TAG + "ID mismatch in patch (expected " + std::to_string(m_intId) + ", got " + std::to_string(id) + ")");
 
-		CHECK_JSON_KEY(j, "name", "CommonEvent");
-		CHECK_JSON_KEY(j, "description", "CommonEvent");
-		CHECK_JSON_KEY(j, "commands", "CommonEvent");
+				hasId = true;
+			}
+			else if (key == "name")
+			{
+				m_name  = ToUTF16(reader.ReadValue().get<std::string>());
+				hasName = true;
+			}
+			else if (key == "description")
+			{
+				m_description  = ToUTF16(reader.ReadValue().get<std::string>());
+				hasDescription = true;
+			}
+			else if (key == "commands")
+			{
+				reader.ForEachElement([&](const std::size_t& cmdIdx) {
+					const nlohmann::ordered_json cmdJ = reader.ReadValue();
+					CHECK_JSON_KEY(cmdJ, "index", std::format("CommonEvent::commands[{}]", cmdIdx));
 
-		m_name        = ToUTF16(j["name"].get<std::string>());
-		m_description = ToUTF16(j["description"].get<std::string>());
+					const uint32_t index = cmdJ["index"].get<uint32_t>();
+					if (index >= m_commands.size())
+						throw WolfRPGException(ERROR_TAG + "Index out of range: " + std::to_string(index) + " >= " + std::to_string(m_commands.size()));
 
-		uint32_t cmdIdx = 0;
+					m_commands.Patch(index, cmdJ);
+				});
 
-		for (const auto& cmdJ : j["commands"])
-		{
-			CHECK_JSON_KEY(cmdJ, "index", std::format("CommonEvent::commands[{}]", cmdIdx));
-			cmdIdx++;
+				hasCommands = true;
+			}
+			else
+				return false;
 
-			const uint32_t index = cmdJ["index"].get<uint32_t>();
-			if (index >= m_commands.size())
-				throw WolfRPGException(ERROR_TAG + "Index out of range: " + std::to_string(index) + " >= " + std::to_string(m_commands.size()));
+			return true;
+		});
 
-			m_commands[index]->Patch(cmdJ);
-		}
+		CHECK_JSON_KEY_FOUND(hasId, "id", "CommonEvent");
+		CHECK_JSON_KEY_FOUND(hasName, "name", "CommonEvent");
+		CHECK_JSON_KEY_FOUND(hasDescription, "description", "CommonEvent");
+		CHECK_JSON_KEY_FOUND(hasCommands, "commands", "CommonEvent");
 	}
 
 	const bool& IsValid() const
@@ -187,7 +267,7 @@ public:
 	}
 
 private:
-	bool init(FileCoder& coder)
+	bool init(FileCoder& coder, const Command::CommandStorePtr& commandStore)
 	{
 		uint8_t indicator = coder.ReadByte();
 		if (indicator != 0x8E)
@@ -196,19 +276,11 @@ private:
 		m_intId = coder.ReadInt();
 
 		m_unknown1 = coder.ReadInt();
-		m_unknown2 = coder.Read(7);
-		m_name     = coder.ReadString();
+		coder.Read(m_unknown2);
+		m_name = coder.ReadString();
 
 		uint32_t commandCnt = coder.ReadInt();
-		for (uint32_t i = 0; i < commandCnt; i++)
-		{
-			Command::CommandShPtr::Command command = Command::Command::Init(coder);
-
-			if (!command->Valid())
-				throw WolfRPGException(ERROR_TAG + "Command initialization failed");
-
-			m_commands.push_back(command);
-		}
+		m_commands          = Command::ReadCommands(coder, commandStore, commandCnt);
 
 		m_unknown11   = coder.ReadString();
 		m_description = coder.ReadString();
@@ -217,31 +289,18 @@ private:
 		if (indicator != 0x8F)
 			throw WolfRPGException(ERROR_TAG + "CommonEvent data indicator not 0x8F (got " + Dec2Hex(indicator) + ")");
 
-		m_unknown3.resize(coder.ReadInt());
-		for (tString& str : m_unknown3)
-			str = coder.ReadString();
-
-		m_unknown4.resize(coder.ReadInt());
-		for (uint8_t& byte : m_unknown4)
-			byte = coder.ReadByte();
+		m_unknown3 = coder.ReadStringArray();
+		m_unknown4 = coder.ReadByteArray();
 
 		m_unknown5.resize(coder.ReadInt());
 		for (tStrings& strs : m_unknown5)
-		{
-			strs = tStrings(coder.ReadInt());
-			for (tString& str : strs)
-				str = coder.ReadString();
-		}
+			strs = coder.ReadStringArray();
 
 		m_unknown6.resize(coder.ReadInt());
 		for (uInts& uints : m_unknown6)
-		{
-			uints = uInts(coder.ReadInt());
-			for (uint32_t& uint : uints)
-				uint = coder.ReadInt();
-		}
+			uints = coder.ReadIntArray();
 
-		m_unknown7 = coder.Read(0x1D);
+		coder.Read(m_unknown7);
 		for (tString& str : m_unknown8)
 			str = coder.ReadString();
 
@@ -273,23 +332,23 @@ private:
 private:
 	bool m_valid = false;
 
-	uint32_t m_id                       = 0;
-	uint32_t m_intId                    = 0;
-	uint32_t m_unknown1                 = 0;
-	Bytes m_unknown2                    = {};
-	tString m_name                      = TEXT("");
-	Command::Commands m_commands        = {};
-	tString m_unknown11                 = TEXT("");
-	tString m_description               = TEXT("");
-	std::vector<tString> m_unknown3     = {};
-	std::vector<uint8_t> m_unknown4     = {};
-	std::vector<tStrings> m_unknown5    = {};
-	std::vector<uInts> m_unknown6       = {};
-	Bytes m_unknown7                    = {};
-	std::array<tString, 100> m_unknown8 = {};
-	tString m_unknown9                  = TEXT("");
-	tString m_unknown10                 = TEXT("");
-	uint32_t m_unknown12                = 0;
+	uint32_t m_id                        = 0;
+	uint32_t m_intId                     = 0;
+	uint32_t m_unknown1                  = 0;
+	std::array<uint8_t, 7> m_unknown2    = {};
+	tString m_name                       = TEXT("");
+	Command::Commands m_commands         = {};
+	tString m_unknown11                  = TEXT("");
+	tString m_description                = TEXT("");
+	std::vector<tString> m_unknown3      = {};
+	std::vector<uint8_t> m_unknown4      = {};
+	std::vector<tStrings> m_unknown5     = {};
+	std::vector<uInts> m_unknown6        = {};
+	std::array<uint8_t, 0x1D> m_unknown7 = {};
+	std::array<tString, 100> m_unknown8  = {};
+	tString m_unknown9                   = TEXT("");
+	tString m_unknown10                  = TEXT("");
+	uint32_t m_unknown12                 = 0;
 
 	bool m_unknown10Valid = false;
 };
@@ -303,8 +362,8 @@ public:
 	{
 	}
 
-	explicit CommonEvents(const tString& fileName) :
-		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::CommonEvent, SEED_INDICES),
+	explicit CommonEvents(const tString& fileName, const WolfContextPtr& context = nullptr) :
+		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::CommonEvent, SEED_INDICES, context),
 		m_valid(false)
 	{
 		if (!fileName.empty())
@@ -315,42 +374,70 @@ public:
 	{
 		for (const CommonEvent& ev : m_events)
 		{
-			nlohmann::ordered_json j = ev.ToJson();
-
 			// Get the file name without the extension
 			const tString comEvName  = std::format(TEXT("{}_{}"), ev.GetID(), EscapePath(ev.GetName()));
 			const tString outputFile = outputFolder + L"/" + comEvName + L".json";
 
 			std::ofstream out(outputFile);
-			out << j.dump(4);
+			JsonWriter writer(out);
+			ev.ToJson(writer);
 
 			out.close();
 		}
 	}
 
+	// The events and the commands in the shared store are restored from a snapshot if a patch file is missing
+	// or broken, so a failed patch leaves all common events unchanged
 	void Patch(const tString& patchFolder)
 	{
-		for (CommonEvent& ev : m_events)
-		{
-			const tString comEvName = std::format(TEXT("{}_{}"), ev.GetID(), EscapePath(ev.GetName()));
-			const tString patchFile = patchFolder + L"/" + comEvName + L".json";
-
-			if (!std::filesystem::exists(patchFile))
-				throw WolfRPGException(ERROR_TAGW + L"Patch file not found: " + patchFile);
-
-			std::ifstream in(patchFile);
-			nlohmann::ordered_json j;
-			in >> j;
-			in.close();
+		CommonEvent::CommonEvents events = m_events;
+		Command::CommandStore commands   = *m_commandStore;
 
-			ev.Patch(j);
+		try
+		{
+			patchEvents(patchFolder);
+		}
+		catch (...)
+		{
+			m_events        = std::move(events);
+			*m_commandStore = std::move(commands);
+			throw;
 		}
 	}
+
 	const CommonEvent::CommonEvents& GetEvents() const
 	{
 		return m_events;
 	}
 
+	// Opens the file the same way as Load, so the context picks up the state the file sets (e.g. the project key), nothing is parsed
+	static void ScanContext(const tString& fileName, const WolfContextPtr& context)
+	{
+		scanFile(fileName, MAGIC_NUMBER, WolfFileType::CommonEvent, SEED_INDICES, context, [](FileCoder&) {});
+	}
+
+	// Streams the commands of all common events to the scanner without loading them
+	static void ScanCommands(const tString& fileName, Command::CommandScanner& scanner, const WolfContextPtr& context = nullptr)
+	{
+		scanFile(fileName, MAGIC_NUMBER, WolfFileType::CommonEvent, SEED_INDICES, context ? context : std::make_shared<WolfContext>(), [&scanner](FileCoder& coder) {
+			const uint8_t version = coder.ReadByte();
+
+			if (version == 0x93 || version == 0xCC)
+			{
+				coder.Context().v35 = true;
+				coder.Unpack(true);
+			}
+
+			uint32_t eventCnt = coder.ReadInt();
+			for (uint32_t i = 0; i < eventCnt; i++)
+				CommonEvent::Scan(coder, scanner);
+
+			uint8_t terminator = coder.ReadByte();
+			if (terminator < 0x89)
+				throw WolfRPGException(ERROR_TAG + "CommonEvent data terminator smaller than 0x89 (got " + Dec2Hex(terminator) + ")");
+		});
+	}
+
 	const bool& IsValid() const
 	{
 		return m_valid;
@@ -363,7 +450,7 @@ protected:
 
 		if (m_version == 0x93 || m_version == 0xCC)
 		{
-			Command::Command::s_v35 = true;
+			coder.Context().v35 = true;
 
 			m_v35 = true;
 			coder.Unpack(true);
@@ -372,8 +459,11 @@ protected:
 		uint32_t eventCnt = coder.ReadInt();
 		m_events          = CommonEvent::CommonEvents(eventCnt);
 
+		// All commands of the common events share one store
+		m_commandStore = std::make_shared<Command::CommandStore>();
+
 		for (uint32_t i = 0; i < eventCnt; i++)
-			m_events[i] = CommonEvent(coder, i);
+			m_events[i] = CommonEvent(coder, i, m_commandStore);
 
 		m_terminator = coder.ReadByte();
 		if (m_terminator < 0x89)
@@ -390,15 +480,15 @@ protected:
 		FileCoder* pCoder = &coder;
 		// For v3.5 we need to compress the actual data before writing it to the file.
 		// Therefore, we create a temporary buffer-based file coder to write the data to.
-		FileCoder bufCoder = FileCoder(FileCoder::Mode::WRITE, m_fileType);
+		FileCoder bufCoder = FileCoder(coder.GetContext(), FileCoder::Mode::WRITE, m_fileType);
 
 		pCoder->Write(MAGIC_NUMBER);
 		pCoder->WriteByte(m_version);
 
 		if (m_v35)
 		{
-			Command::Command::s_v35 = true;
-			pCoder                  = &bufCoder;
+			coder.Context().v35 = true;
+			pCoder              = &bufCoder;
 		}
 
 		pCoder->WriteInt(m_events.size());
@@ -414,20 +504,41 @@ protected:
 		}
 	}
 
-	nlohmann::ordered_json toJson() const
+	void toJson(JsonWriter& writer) const
 	{
-		return nlohmann::ordered_json();
+		writer.Null();
 	}
 
-	void patch([[maybe_unused]] const nlohmann::ordered_json& j)
+	void patch([[maybe_unused]] JsonReader& reader)
 	{
 	}
 
+private:
+	void patchEvents(const tString& patchFolder)
+	{
+		for (CommonEvent& ev : m_events)
+		{
+			const tString comEvName = std::format(TEXT("{}_{}"), ev.GetID(), EscapePath(ev.GetName()));
+			const tString patchFile = patchFolder + L"/" + comEvName + L".json";
+
+			if (!std::filesystem::exists(patchFile))
+				throw WolfRPGException(ERROR_TAGW + L"Patch file not found: " + patchFile);
+
+			std::ifstream in(patchFile);
+			JsonReader reader(in);
+			ev.Patch(reader);
+
+			in.close();
+		}
+	}
+
 private:
 	bool m_valid = false;
 
 	CommonEvent::CommonEvents m_events = {};
 
+	Command::CommandStorePtr m_commandStore = nullptr;
+
 	BYTE m_version    = 0;
 	BYTE m_terminator = 0;
 
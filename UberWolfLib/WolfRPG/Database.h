@@ -27,6 +27,8 @@
 #pragma once
 
 #include "FileCoder.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
 
 #include <format>
 #include <fstream>
@@ -48,20 +50,23 @@ public:
 		coder.WriteString(m_name);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["name"] = ToUTF8(m_name);
+		writer.BeginObject();
+		writer.Write("name", m_name);
 
 		if (!m_stringArgs.empty())
 		{
-			j["stringArgs"] = nlohmann::ordered_json::array();
+			writer.Key("stringArgs");
+			writer.BeginArray();
 
 			for (const tString& stringArg : m_stringArgs)
-				j["stringArgs"].push_back(ToUTF8(stringArg));
+				writer.Value(stringArg);
+
+			writer.EndArray();
 		}
 
-		return j;
+		writer.EndObject();
 	}
 
 	void Patch(const nlohmann::ordered_json& j)
@@ -192,29 +197,31 @@ public:
 		coder.WriteString(m_name);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["name"] = ToUTF8(m_name);
-		j["data"] = nlohmann::json::array();
-
-		if (m_stringValues.empty() && m_intValues.empty())
-			return j;
+		writer.BeginObject();
+		writer.Write("name", m_name);
+		writer.Key("data");
+		writer.BeginArray();
 
-		for (const Field& field : *m_pFields)
+		if (!m_stringValues.empty() || !m_intValues.empty())
 		{
-			nlohmann::ordered_json fieldData;
-			fieldData["name"] = ToUTF8(field.GetName());
+			for (const Field& field : *m_pFields)
+			{
+				writer.BeginObject();
+				writer.Write("name", field.GetName());
 
-			if (field.IsString())
-				fieldData["value"] = ToUTF8(m_stringValues[field.Index()]);
-			else
-				fieldData["value"] = m_intValues[field.Index()];
+				if (field.IsString())
+					writer.Write("value", m_stringValues[field.Index()]);
+				else
+					writer.Write("value", m_intValues[field.Index()]);
 
-			j["data"].push_back(fieldData);
+				writer.EndObject();
+			}
 		}
 
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
 	void Patch(const nlohmann::ordered_json& j)
@@ -249,6 +256,13 @@ public:
 		}
 	}
 
+	// Points the row at the fields of the type that owns it, rows which were not read yet stay unbound
+	void BindFields(Fields& fields)
+	{
+		if (m_pFields)
+			m_pFields = &fields;
+	}
+
 	void ReadDat(FileCoder& coder, Fields& fields, const uint32_t& fieldsSize)
 	{
 		m_pFields       = &fields;
@@ -263,9 +277,9 @@ public:
 				intCnt++;
 		}
 
-		for (uint32_t i = 0; i < intCnt; i++)
-			m_intValues.push_back(coder.ReadInt());
+		coder.ReadInts(m_intValues, intCnt);
 
+		m_stringValues.reserve(m_stringValues.size() + strCnt);
 		for (uint32_t i = 0; i < strCnt; i++)
 			m_stringValues.push_back(coder.ReadString());
 	}
@@ -324,29 +338,56 @@ public:
 
 		index = coder.ReadInt();
 		for (uint32_t i = 0; i < index; i++)
-		{
-			tStrings stringArgs;
-			uint32_t argsCnt = coder.ReadInt();
-			for (uint32_t j = 0; j < argsCnt; j++)
-				stringArgs.push_back(coder.ReadString());
-			m_fields[i].SetStringArgs(stringArgs);
-		}
+			m_fields[i].SetStringArgs(coder.ReadStringArray());
 
 		index = coder.ReadInt();
 		for (uint32_t i = 0; i < index; i++)
-		{
-			uInts args;
-			uint32_t argsCnt = coder.ReadInt();
-			for (uint32_t j = 0; j < argsCnt; j++)
-				args.push_back(coder.ReadInt());
-			m_fields[i].SetArgs(args);
-		}
+			m_fields[i].SetArgs(coder.ReadIntArray());
 
 		index = coder.ReadInt();
 		for (uint32_t i = 0; i < index; i++)
 			m_fields[i].SetDefaultValue(coder.ReadInt());
 	}
 
+	// The data rows point at m_fields, so a copied or moved type points its rows at its own fields
+	Type(const Type& other)
+	{
+		*this = other;
+	}
+
+	Type(Type&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	Type& operator=(const Type& other)
+	{
+		m_name              = other.m_name;
+		m_description       = other.m_description;
+		m_fields            = other.m_fields;
+		m_fieldsSize        = other.m_fieldsSize;
+		m_data              = other.m_data;
+		m_unknown1          = other.m_unknown1;
+		m_fieldTypeListSize = other.m_fieldTypeListSize;
+
+		bindFields();
+		return *this;
+	}
+
+	Type& operator=(Type&& other) noexcept
+	{
+		m_name              = std::move(other.m_name);
+		m_description       = std::move(other.m_description);
+		m_fields            = std::move(other.m_fields);
+		m_fieldsSize        = other.m_fieldsSize;
+		m_data              = std::move(other.m_data);
+		m_unknown1          = other.m_unknown1;
+		m_fieldTypeListSize = other.m_fieldTypeListSize;
+
+		bindFields();
+		return *this;
+	}
+
 	void DumpProject(FileCoder& coder) const
 	{
 		coder.WriteString(m_name);
@@ -427,44 +468,69 @@ public:
 			datum.DumpDat(coder);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["name"]        = ToUTF8(m_name);
-		j["description"] = ToUTF8(m_description);
-		j["fields"]      = nlohmann::json::array();
-		j["data"]        = nlohmann::json::array();
+		writer.BeginObject();
+		writer.Write("name", m_name);
+		writer.Write("description", m_description);
+
+		writer.Key("fields");
+		writer.BeginArray();
 
 		for (const Field& field : m_fields)
-			j["fields"].push_back(field.ToJson());
+			field.ToJson(writer);
+
+		writer.EndArray();
+
+		writer.Key("data");
+		writer.BeginArray();
 
 		for (const Data& data : m_data)
-			j["data"].push_back(data.ToJson());
+			data.ToJson(writer);
 
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
-	void Patch(const nlohmann::ordered_json& j)
+	// Fields and data rows are patched while they are read, only one of them is kept as JSON at a time
+	void Patch(JsonReader& reader)
 	{
-		CHECK_JSON_KEY(j, "name", "types");
-		CHECK_JSON_KEY(j, "description", "types");
-		CHECK_JSON_KEY(j, "fields", "types");
-		CHECK_JSON_KEY(j, "data", "types");
-
-		m_name        = ToUTF16(j["name"].get<std::string>());
-		m_description = ToUTF16(j["description"].get<std::string>());
-
-		if (m_fields.size() != j["fields"].size())
-			throw WolfRPGException(ERROR_TAG + "Count mismatch for object 'fields' expected: " + std::to_string(m_fields.size()) + " - got: " + std::to_string(j["fields"].size()));
+		bool hasName        = false;
+		bool hasDescription = false;
+		bool hasFields      = false;
+		bool hasData        = false;
 
-		for (std::size_t i = 0; i < m_fields.size(); i++)
-			m_fields[i].Patch(j["fields"][i]);
+		reader.ForEachKey([&](const std::string& key) {
+			if (key == "name")
+			{
+				m_name  = ToUTF16(reader.ReadValue().get<std::string>());
+				hasName = true;
+			}
+			else if (key == "description")
+			{
+				m_description  = ToUTF16(reader.ReadValue().get<std::string>());
+				hasDescription = true;
+			}
+			else if (key == "fields")
+			{
+				patchAll(reader, m_fields, "fields");
+				hasFields = true;
+			}
+			else if (key == "data")
+			{
+				patchAll(reader, m_data, "data");
+				hasData = true;
+			}
+			else
+				return false;
 
-		if (m_data.size() != j["data"].size())
-			throw WolfRPGException(ERROR_TAG + "Count mismatch for object 'data' expected: " + std::to_string(m_data.size()) + " - got: " + std::to_string(j["data"].size()));
+			return true;
+		});
 
-		for (std::size_t i = 0; i < m_data.size(); i++)
-			m_data[i].Patch(j["data"][i]);
+		CHECK_JSON_KEY_FOUND(hasName, "name", "types");
+		CHECK_JSON_KEY_FOUND(hasDescription, "description", "types");
+		CHECK_JSON_KEY_FOUND(hasFields, "fields", "types");
+		CHECK_JSON_KEY_FOUND(hasData, "data", "types");
 	}
 
 	const Datas& GetData() const
@@ -478,6 +544,27 @@ public:
 	}
 
 private:
+	void bindFields()
+	{
+		for (Data& datum : m_data)
+			datum.BindFields(m_fields);
+	}
+
+	// Patches the elements in the order of the array, the number of elements has to match
+	template<typename T>
+	static void patchAll(JsonReader& reader, std::vector<T>& items, const std::string& name)
+	{
+		const std::size_t count = reader.ForEachElement([&](const std::size_t& i) {
+			if (i < items.size())
+				items[i].Patch(reader.ReadValue());
+			else
+				reader.Skip();
+		});
+
+		if (count != items.size())
+			throw WolfRPGException(ERROR_TAG + BuildCountError(name, items.size(), count));
+	}
+
 private:
 	tString m_name               = TEXT("");
 	tString m_description        = TEXT("");
@@ -496,7 +583,8 @@ using Types = std::vector<Type>;
 class Database
 {
 public:
-	Database(const tString& projectFileName, const tString& datFileName) :
+	Database(const tString& projectFileName, const tString& datFileName, const WolfContextPtr& context = nullptr) :
+		m_context(context ? context : std::make_shared<WolfContext>()),
 		m_projectFileName(projectFileName),
 		m_datFileName(datFileName)
 	{
@@ -507,21 +595,21 @@ public:
 	{
 		{
 			const tString fileName = ::GetFileName(m_projectFileName);
-			g_activeFile           = fileName;
+			m_context->activeFile  = fileName;
 
 			tString outputFN = outputDir + L"/" + fileName;
-			FileCoder coder(outputFN, FileCoder::Mode::WRITE, WolfFileType::Project);
+			FileCoder coder(m_context, outputFN, FileCoder::Mode::WRITE, WolfFileType::Project);
 			coder.WriteInt(m_types.size());
 			for (const Type& type : m_types)
 				type.DumpProject(coder);
 		}
 
 		const tString fileName = ::GetFileName(m_datFileName);
-		g_activeFile           = fileName;
+		m_context->activeFile  = fileName;
 
 		tString outputFN = outputDir + L"/" + fileName;
-		FileCoder coder(outputFN, FileCoder::Mode::WRITE, WolfFileType::DataBase, DAT_SEED_INDICES);
-		FileCoder bufCoder(FileCoder::Mode::WRITE, WolfFileType::DataBase);
+		FileCoder coder(m_context, outputFN, FileCoder::Mode::WRITE, WolfFileType::DataBase, DAT_SEED_INDICES);
+		FileCoder bufCoder(m_context, FileCoder::Mode::WRITE, WolfFileType::DataBase);
 		FileCoder* pCoder = &coder;
 
 		coder.Write(DAT_MAGIC_NUMBER);
@@ -546,18 +634,22 @@ public:
 	void ToJson(const tString& outputFolder) const
 	{
 		const tString fileName = ::GetFileNameNoExt(m_datFileName);
-		g_activeFile           = fileName;
-
-		nlohmann::ordered_json j;
-		j["types"] = nlohmann::json::array();
-
-		for (const Type& type : m_types)
-			j["types"].push_back(type.ToJson());
+		m_context->activeFile  = fileName;
 
 		const tString outputFile = outputFolder + L"/" + fileName + L".json";
 
 		std::ofstream out(outputFile);
-		out << j.dump(4);
+		JsonWriter writer(out);
+
+		writer.BeginObject();
+		writer.Key("types");
+		writer.BeginArray();
+
+		for (const Type& type : m_types)
+			type.ToJson(writer);
+
+		writer.EndArray();
+		writer.EndObject();
 
 		out.close();
 	}
@@ -565,24 +657,43 @@ public:
 	void Patch(const tString& patchFolder)
 	{
 		const tString fileName = ::GetFileNameNoExt(m_datFileName);
-		g_activeFile           = fileName;
+		m_context->activeFile  = fileName;
 
 		const tString patchFile = patchFolder + L"/" + fileName + L".json";
 		if (!std::filesystem::exists(patchFile))
 			throw WolfRPGException(ERROR_TAGW + L"Patch file not found: " + patchFile);
 
-		nlohmann::ordered_json j;
 		std::ifstream in(patchFile);
-		in >> j;
-		in.close();
+		JsonReader reader(in);
+
+		// The types are patched in a copy which replaces them once the whole patch passed the checks,
+		// so a broken patch leaves the database unchanged
+		Types types   = m_types;
+		bool hasTypes = false;
+
+		reader.ForEachKey([&](const std::string& key) {
+			if (key != "types")
+				return false;
+
+			const std::size_t count = reader.ForEachElement([&](const std::size_t& i) {
+				if (i < types.size())
+					types[i].Patch(reader);
+				else
+					reader.Skip();
+			});
 
-		CHECK_JSON_KEY(j, "types", "Database");
+			if (count != types.size())
+				throw WolfRPGException(ERROR_TAG + BuildCountError("types", types.size(), count));
 
-		if (m_types.size() != j["types"].size())
-			throw WolfRPGException(ERROR_TAG + "Count mismatch for object 'types' expected: " + std::to_string(m_types.size()) + " - got: " + std::to_string(j["types"].size()));
+			hasTypes = true;
+			return true;
+		});
 
-		for (std::size_t i = 0; i < m_types.size(); i++)
-			m_types[i].Patch(j["types"][i]);
+		in.close();
+
+		CHECK_JSON_KEY_FOUND(hasTypes, "types", "Database");
+
+		m_types = std::move(types);
 	}
 
 	const Types& GetTypes() const
@@ -595,11 +706,22 @@ public:
 		return m_valid;
 	}
 
+	const WolfContextPtr& GetContext() const
+	{
+		return m_context;
+	}
+
+	// Continue with a private copy of the context, objects which do not share a context can be processed in parallel
+	void DetachContext()
+	{
+		m_context = std::make_shared<WolfContext>(*m_context);
+	}
+
 private:
 	bool init()
 	{
-		g_activeFile = ::GetFileName(m_datFileName);
-		FileCoder coder(m_datFileName, FileCoder::Mode::READ, WolfFileType::DataBase, DAT_SEED_INDICES);
+		m_context->activeFile = ::GetFileName(m_datFileName);
+		FileCoder coder(m_context, m_datFileName, FileCoder::Mode::READ, WolfFileType::DataBase, DAT_SEED_INDICES);
 		if (coder.IsEncrypted())
 			m_cryptHeader = coder.GetCryptHeader();
 		else
@@ -609,8 +731,8 @@ private:
 
 		// Process the project file
 		{
-			g_activeFile = ::GetFileName(m_projectFileName);
-			FileCoder coder(m_projectFileName, FileCoder::Mode::READ, WolfFileType::Project);
+			m_context->activeFile = ::GetFileName(m_projectFileName);
+			FileCoder coder(m_context, m_projectFileName, FileCoder::Mode::READ, WolfFileType::Project);
 			uint32_t typeCnt = coder.ReadInt();
 			for (uint32_t i = 0; i < typeCnt; i++)
 				m_types.push_back(Type(coder));
@@ -619,8 +741,8 @@ private:
 				throw WolfRPGException(ERROR_TAGW + L"Database [" + m_projectFileName + L"] has more data than expected");
 		}
 
-		g_activeFile     = ::GetFileName(m_datFileName);
-		uint32_t typeCnt = coder.ReadInt();
+		m_context->activeFile = ::GetFileName(m_datFileName);
+		uint32_t typeCnt      = coder.ReadInt();
 		if (typeCnt != m_types.size())
 		{
 			throw WolfRPGException(ERROR_TAGW + L"Database [" + m_datFileName + L"] project and dat type count mismatch expected: " + std::to_wstring(m_types.size()) + L"  - got: " + std::to_wstring(typeCnt));
@@ -648,6 +770,7 @@ private:
 	}
 
 private:
+	WolfContextPtr m_context;
 	Types m_types       = {};
 	Bytes m_cryptHeader = {};
 
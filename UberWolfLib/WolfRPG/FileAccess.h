@@ -28,8 +28,10 @@
 #include <windows.h>
 
 #include <codecvt>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -207,16 +209,35 @@ public:
 
 	void ReadBytes(LPVOID pBuffer, const DWORD& size)
 	{
-		if (!m_init)
-			throw(FileWalkerException("FileWalker not initialized"));
-
-		if (m_offset + size > m_size)
-			throw(FileWalkerException("ReadBytes: Attempted to read past end of file"));
+		checkRead(size, "ReadBytes");
 
 		std::memcpy(pBuffer, m_pData + m_offset, size);
 		m_offset += size;
 	}
 
+	// Returns a view of the next size bytes without copying them, the view is only valid as long as the data is
+	std::span<const BYTE> ReadSpan(const DWORD& size)
+	{
+		checkRead(size, "ReadSpan");
+
+		const std::span<const BYTE> data(m_pData + m_offset, size);
+		m_offset += size;
+		return data;
+	}
+
+	// Appends count elements to the buffer with a single bounds check and copy
+	template<typename T>
+	void ReadAppend(std::vector<T>& buffer, const DWORD& count)
+	{
+		const uint64_t size = static_cast<uint64_t>(count) * sizeof(T);
+		checkRead(size, "ReadAppend");
+
+		const std::size_t oldSize = buffer.size();
+		buffer.resize(oldSize + count);
+		std::memcpy(buffer.data() + oldSize, m_pData + m_offset, static_cast<std::size_t>(size));
+		m_offset += static_cast<DWORD>(size);
+	}
+
 	template<typename T>
 	void ReadVec(std::vector<T>& buffer, const DWORD& dwordCnt = -1)
 	{
@@ -305,13 +326,23 @@ private:
 		m_offset = 0;
 	}
 
+	void checkRead(const uint64_t& size, const char* func) const
+	{
+		if (!m_init)
+			throw(FileWalkerException("FileWalker not initialized"));
+
+		// Compare against the remaining size, so a large size can not wrap around
+		if (m_offset > m_size || size > m_size - m_offset)
+			throw(FileWalkerException(std::string(func) + ": Attempted to read past end of file"));
+	}
+
 	template<typename T>
 	T read()
 	{
 		if (!m_init)
 			throw(FileWalkerException("FileWalker not initialized"));
 
-		if (m_offset + sizeof(T) > m_size)
+		if (m_offset > m_size || sizeof(T) > m_size - m_offset)
 			throw(FileWalkerException("read: End of file reached"));
 
 		T value = *(reinterpret_cast<T*>(m_pData + m_offset));
@@ -27,6 +27,7 @@
 #pragma once
 
 #include "FileAccess.h"
+#include "TextConv.h"
 #include "Types.h"
 #include "WolfRPGException.h"
 #include "WolfRPGUtils.h"
@@ -34,15 +35,30 @@
 #include "../Wolf35Unprotect.hpp"
 
 #include <DXLib/WolfNew.h>
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <lz4/lz4.h>
+#include <memory>
+#include <span>
 #include <string>
 
 // TODO:
 // - Create Wrapper class for reader / writer to have mode independent access object
-// - Remove static headers
+
+// State of one load which is carried from file to file, e.g. the string encoding detected from the magic number
+// Every FileCoder works on the context of the object it reads or writes, so independent loads can run in parallel
+struct WolfContext
+{
+	bool isUTF8        = false;                      // Strings are stored as UTF-8 instead of Shift-JIS
+	uint32_t projKey   = static_cast<uint32_t>(-1); // Key of the .project files, set by the first encrypted data file
+	bool v35           = false;                      // Commands are followed by the v3.5 terminator byte
+	tString activeFile = L"";                        // File currently being processed, used for error messages
+};
+
+using WolfContextPtr = std::shared_ptr<WolfContext>;
 
 class MagicNumber
 {
@@ -113,7 +129,8 @@ public:
 	// Disable Copy/Move constructor
 	DISABLE_COPY_MOVE(FileCoder)
 
-	FileCoder(const tString& fileName, const Mode& mode, const WolfFileType& fileType, const uInts& seedIndices = uInts(), const Bytes& cryptHeader = Bytes()) :
+	FileCoder(const WolfContextPtr& context, const tString& fileName, const Mode& mode, const WolfFileType& fileType, const uInts& seedIndices = uInts(), const Bytes& cryptHeader = Bytes()) :
+		m_context(context),
 		m_cryptHeader(cryptHeader),
 		m_mode(mode),
 		m_seedIndices(seedIndices),
@@ -143,7 +160,8 @@ public:
 		}
 	}
 
-	FileCoder(const Bytes& buffer, const Mode& mode, const WolfFileType& fileType, const uInts& seedIndices = uInts(), const Bytes& cryptHeader = Bytes()) :
+	FileCoder(const WolfContextPtr& context, const Bytes& buffer, const Mode& mode, const WolfFileType& fileType, const uInts& seedIndices = uInts(), const Bytes& cryptHeader = Bytes()) :
+		m_context(context),
 		m_cryptHeader(cryptHeader),
 		m_mode(mode),
 		m_seedIndices(seedIndices),
@@ -159,7 +177,8 @@ public:
 		load();
 	}
 
-	FileCoder(const Mode& mode, const WolfFileType& fileType) :
+	FileCoder(const WolfContextPtr& context, const Mode& mode, const WolfFileType& fileType) :
+		m_context(context),
 		m_mode(mode),
 		m_fileType(fileType)
 	{
@@ -225,6 +244,16 @@ public:
 		return !m_cryptHeader.empty();
 	}
 
+	WolfContext& Context() const
+	{
+		return *m_context;
+	}
+
+	const WolfContextPtr& GetContext() const
+	{
+		return m_context;
+	}
+
 	void Seek(const int32_t& pos)
 	{
 		if (m_mode == Mode::READ)
@@ -244,19 +273,20 @@ public:
 
 	Bytes Read(const size_t& size = -1)
 	{
-		Bytes data;
-
-		if (size != -1)
-			data.resize(size);
-		else
-		{
-			DWORD remainingSize = m_reader.GetSize() - m_reader.GetOffset();
-			data.resize(remainingSize);
-		}
+		const std::span<const uint8_t> data = ReadSpan((size != -1) ? size : (m_reader.GetSize() - m_reader.GetOffset()));
+		return Bytes(data.begin(), data.end());
+	}
 
-		m_reader.ReadBytesVec(data);
+	template<std::size_t N>
+	void Read(std::array<uint8_t, N>& data)
+	{
+		m_reader.ReadBytesArr(data);
+	}
 
-		return data;
+	// View into the data of the coder, only valid until the coder is destroyed or its data is replaced
+	std::span<const uint8_t> ReadSpan(const size_t& size)
+	{
+		return m_reader.ReadSpan(static_cast<DWORD>(size));
 	}
 
 	uint8_t ReadByte()
@@ -276,35 +306,40 @@ public:
 		if (size == 0)
 			throw WolfRPGException(ERROR_TAG + "Zero length string encountered.");
 
-		Bytes data = Read(size);
+		const std::span<const uint8_t> data = ReadSpan(size);
 
-		if (s_isUTF8)
-		{
-			std::string str = std::string(reinterpret_cast<const char*>(data.data()), data.size() - ((data.back() == 0x0) ? 1 : 0));
-			return ToUTF16(str);
-		}
+		if (m_context->isUTF8)
+			return textConv::Utf8ToUtf16(std::string_view(reinterpret_cast<const char*>(data.data()), data.size() - ((data.back() == 0x0) ? 1 : 0)));
 		else
 			return sjis2utf8(data);
 	}
 
-	Bytes ReadByteArray()
+	// Skips a string without converting it
+	void SkipString()
 	{
 		uint32_t size = ReadInt();
-		Bytes data;
 
-		for (uint32_t i = 0; i < size; i++)
-			data.push_back(ReadByte());
+		if (size == 0)
+			throw WolfRPGException(ERROR_TAG + "Zero length string encountered.");
 
-		return data;
+		Skip(size);
+	}
+
+	Bytes ReadByteArray()
+	{
+		return Read(ReadInt());
+	}
+
+	// Appends count ints to data
+	void ReadInts(uInts& data, const uint32_t& count)
+	{
+		m_reader.ReadAppend(data, count);
 	}
 
 	uInts ReadIntArray()
 	{
-		uint32_t size = ReadInt();
 		uInts data;
-
-		for (uint32_t i = 0; i < size; i++)
-			data.push_back(ReadInt());
+		ReadInts(data, ReadInt());
 
 		return data;
 	}
@@ -314,6 +349,9 @@ public:
 		uint32_t size = ReadInt();
 		tStrings data;
 
+		// Every string takes at least 5 bytes, so a broken size fails on reading instead of on reserving
+		data.reserve(std::min<std::size_t>(size, (m_reader.GetSize() - m_reader.GetOffset()) / 5));
+
 		for (uint32_t i = 0; i < size; i++)
 			data.push_back(ReadString());
 
@@ -322,7 +360,7 @@ public:
 
 	bool Verify(const Bytes& vData)
 	{
-		Bytes data = Read(vData.size());
+		const std::span<const uint8_t> data = ReadSpan(vData.size());
 		if (std::equal(vData.begin(), vData.end(), data.begin()))
 			return true;
 
@@ -334,7 +372,7 @@ public:
 		Bytes data = Read(magicNumber.Size());
 		if (magicNumber == data)
 		{
-			s_isUTF8 = magicNumber.IsUTF8(data);
+			m_context->isUTF8 = magicNumber.IsUTF8(data);
 			return true;
 		}
 
@@ -343,7 +381,7 @@ public:
 
 	void SetUTF8(const bool& isUTF8)
 	{
-		s_isUTF8 = isUTF8;
+		m_context->isUTF8 = isUTF8;
 	}
 
 	void Skip(const DWORD& size)
@@ -356,9 +394,15 @@ public:
 		m_writer.WriteBytesVec(data);
 	}
 
+	template<std::size_t N>
+	void Write(const std::array<uint8_t, N>& data)
+	{
+		m_writer.WriteBytesArr(data);
+	}
+
 	void Write(const MagicNumber& mn)
 	{
-		if (s_isUTF8)
+		if (m_context->isUTF8)
 			Write(mn.GetUTF8Data());
 		else
 			Write(mn.GetData());
@@ -386,7 +430,7 @@ public:
 	{
 		Bytes str;
 
-		if (s_isUTF8)
+		if (m_context->isUTF8)
 		{
 			std::string s = ToUTF8(wstr);
 			str           = Bytes(s.begin(), s.end());
@@ -425,14 +469,14 @@ public:
 		m_writer.Write(coder.m_writer.GetBuffer());
 	}
 
-	static bool IsUTF8()
+	bool IsUTF8() const
 	{
-		return s_isUTF8;
+		return m_context->isUTF8;
 	}
 
-	static std::size_t CalcStringSize(const tString& str)
+	std::size_t CalcStringSize(const tString& str) const
 	{
-		if (s_isUTF8)
+		if (m_context->isUTF8)
 			return ToUTF8(str).size() + 1;
 		else
 			return utf82sjis(str).size();
@@ -458,33 +502,23 @@ private:
 
 	void cryptProj(Bytes& data)
 	{
-		srand(s_projKey);
+		srand(m_context->projKey);
 
 		for (uint8_t& byte : data)
 			byte ^= static_cast<uint8_t>(rand());
 	}
 
-	static tString sjis2utf8(const Bytes& sjis)
+	static tString sjis2utf8(const std::span<const uint8_t>& sjis)
 	{
-		const LPCCH pSJIS = reinterpret_cast<const LPCCH>(sjis.data());
-		int sjisSize      = MultiByteToWideChar(932, 0, pSJIS, -1, NULL, 0);
-
-		WCHAR* pUTF8 = new WCHAR[sjisSize + 1]();
-		MultiByteToWideChar(932, 0, pSJIS, -1, pUTF8, sjisSize);
-		tString utf8(pUTF8);
-		delete[] pUTF8;
-		return utf8;
+		// Convert up to the terminating 0, the data is not necessarily terminated
+		const void* pEnd = std::memchr(sjis.data(), 0, sjis.size());
+		return textConv::SjisToUtf16(sjis.data(), pEnd ? (reinterpret_cast<const uint8_t*>(pEnd) - sjis.data()) : sjis.size());
 	}
 
 	static Bytes utf82sjis(const tString& utf8)
 	{
 		// Empty strings are length 1 with terminating 0
-		if (utf8.empty()) return Bytes(1, 0);
-
-		int utf8Size = WideCharToMultiByte(932, 0, &utf8[0], (int)utf8.size(), NULL, 0, NULL, NULL);
-		Bytes sjis(utf8Size + 1, 0);
-		WideCharToMultiByte(932, 0, &utf8[0], (int)utf8.size(), reinterpret_cast<const LPSTR>(sjis.data()), utf8Size, NULL, NULL);
-		return sjis;
+		return textConv::Utf16ToSjis(utf8);
 	}
 
 	void decryptV3_3()
@@ -497,7 +531,7 @@ private:
 		m_reader.InitData(data);
 		m_reader.Skip(143);
 
-		s_projKey = m_cryptHeader[0x14];
+		m_context->projKey = m_cryptHeader[0x14];
 	}
 
 	void decryptV3_5()
@@ -509,14 +543,14 @@ private:
 
 		m_reader.InitData(data);
 		// ¯\_(ツ)_/¯
-		s_projKey = 0;
+		m_context->projKey = 0;
 	}
 
 	void load()
 	{
 		if (m_fileType == WolfFileType::Project)
 		{
-			if (s_projKey != -1)
+			if (m_context->projKey != -1)
 			{
 				Bytes data = Read();
 				cryptProj(data);
@@ -593,14 +627,15 @@ private:
 			uint32_t keySize = m_reader.ReadUInt32();
 			int8_t projKey   = m_reader.ReadInt8();
 
-			if (s_projKey == -1)
-				s_projKey = projKey;
+			if (m_context->projKey == -1)
+				m_context->projKey = projKey;
 
 			m_reader.Skip(keySize - 1);
 		}
 	}
 
 private:
+	WolfContextPtr m_context;
 	Bytes m_cryptHeader = {};
 	Mode m_mode;
 	uInts m_seedIndices = {};
@@ -609,7 +644,5 @@ private:
 	FileReader m_reader = {};
 	FileWriter m_writer = {};
 
-	static bool s_isUTF8;
-	static uint32_t s_projKey;
 	static bool s_createBackup;
 };
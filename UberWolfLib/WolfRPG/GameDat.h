@@ -38,8 +38,8 @@
 class GameDat : public WolfDataBase
 {
 public:
-	explicit GameDat(const tString& fileName = L"") :
-		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::GameDat, SEED_INDICES)
+	explicit GameDat(const tString& fileName = L"", const WolfContextPtr& context = nullptr) :
+		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::GameDat, SEED_INDICES, context)
 	{
 		if (!fileName.empty())
 			Load(fileName);
@@ -52,6 +52,12 @@ public:
 		Load(buffer);
 	}
 
+	// Opens the file the same way as Load, so the context picks up the state the file sets (e.g. the project key), nothing is parsed
+	static void ScanContext(const tString& fileName, const WolfContextPtr& context)
+	{
+		scanFile(fileName, MAGIC_NUMBER, WolfFileType::GameDat, SEED_INDICES, context, [](FileCoder&) {});
+	}
+
 	const tString& GetTitle() const
 	{
 		return m_title;
@@ -156,67 +162,77 @@ protected:
 		if (m_stringCount > 13)
 			coder.WriteString(m_unknownString14);
 
-		coder.WriteInt(calcNewSize());
+		coder.WriteInt(calcNewSize(coder));
 		coder.Write(m_unknown2);
 	}
 
-	nlohmann::ordered_json toJson() const
+	void toJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-
-		j["Title"]     = ToUTF8(m_title);
-		j["TitlePlus"] = ToUTF8(m_titlePlus);
+		writer.BeginObject();
+		writer.Write("Title", m_title);
+		writer.Write("TitlePlus", m_titlePlus);
 
 		if (m_stringCount > 9)
 		{
-			j["StartUpMsg"] = ToUTF8(m_startUpMsg);
-			j["TitleMsg"]   = ToUTF8(m_titleMsg);
+			writer.Write("StartUpMsg", m_startUpMsg);
+			writer.Write("TitleMsg", m_titleMsg);
 		}
 
-		return j;
+		writer.EndObject();
 	}
 
-	void patch(const nlohmann::ordered_json& j)
+	void patch(JsonReader& reader)
 	{
-		m_title     = ToUTF16(j["Title"]);
-		m_titlePlus = ToUTF16(j["TitlePlus"]);
+		// Game.dat only has a few strings, so the patch is read as a whole
+		const nlohmann::ordered_json j = reader.ReadValue();
+
+		// All strings are converted before any is set, so a broken patch leaves Game.dat unchanged
+		tString title      = ToUTF16(j["Title"]);
+		tString titlePlus  = ToUTF16(j["TitlePlus"]);
+		tString startUpMsg = m_startUpMsg;
+		tString titleMsg   = m_titleMsg;
 
 		if (m_stringCount > 9)
 		{
-			m_startUpMsg = ToUTF16(j["StartUpMsg"]);
-			m_titleMsg   = ToUTF16(j["TitleMsg"]);
+			startUpMsg = ToUTF16(j["StartUpMsg"]);
+			titleMsg   = ToUTF16(j["TitleMsg"]);
 		}
+
+		m_title      = std::move(title);
+		m_titlePlus  = std::move(titlePlus);
+		m_startUpMsg = std::move(startUpMsg);
+		m_titleMsg   = std::move(titleMsg);
 	}
 
 private:
-	std::size_t calcNewSize() const
+	std::size_t calcNewSize(const FileCoder& coder) const
 	{
 		std::size_t size = 0;
 		size += MAGIC_NUMBER.Size();
 		size += m_unknown1.size() + 4;
 		size += sizeof(m_stringCount);
-		size += FileCoder::CalcStringSize(m_title) + 4;
-		size += FileCoder::CalcStringSize(MAGIC_STRING) + 4;
+		size += coder.CalcStringSize(m_title) + 4;
+		size += coder.CalcStringSize(MAGIC_STRING) + 4;
 		size += m_decryptKey.size() + 4;
-		size += FileCoder::CalcStringSize(m_font) + 4;
+		size += coder.CalcStringSize(m_font) + 4;
 
 		for (const tString& font : m_subFonts)
-			size += FileCoder::CalcStringSize(font) + 4;
+			size += coder.CalcStringSize(font) + 4;
 
-		size += FileCoder::CalcStringSize(m_defaultPCGraphic) + 4;
+		size += coder.CalcStringSize(m_defaultPCGraphic) + 4;
 
-		if (m_stringCount >= 9) size += FileCoder::CalcStringSize(m_titlePlus) + 4;
+		if (m_stringCount >= 9) size += coder.CalcStringSize(m_titlePlus) + 4;
 
 		if (m_stringCount > 9)
 		{
-			size += FileCoder::CalcStringSize(m_roadImg) + 4;
-			size += FileCoder::CalcStringSize(m_gaugeImg) + 4;
-			size += FileCoder::CalcStringSize(m_startUpMsg) + 4;
-			size += FileCoder::CalcStringSize(m_titleMsg) + 4;
+			size += coder.CalcStringSize(m_roadImg) + 4;
+			size += coder.CalcStringSize(m_gaugeImg) + 4;
+			size += coder.CalcStringSize(m_startUpMsg) + 4;
+			size += coder.CalcStringSize(m_titleMsg) + 4;
 		}
 
 		if (m_stringCount > 13)
-			size += FileCoder::CalcStringSize(m_unknownString14) + 4;
+			size += coder.CalcStringSize(m_unknownString14) + 4;
 
 		size += sizeof(m_fileSize);
 
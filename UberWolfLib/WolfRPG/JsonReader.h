@@ -0,0 +1,498 @@
+/*
+ *  File: JsonReader.h
+ *  Copyright (c) 2024 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "WolfRPGException.h"
+#include "WolfRPGUtils.h"
+
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <istream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Pull parser for the patch files, the patch code walks the document in order and only builds
+// nlohmann::ordered_json values for the small parts it reads as a whole (e.g. single commands).
+// Like operator>> of nlohmann::json a leading UTF-8 BOM is skipped and data after the root value is ignored
+class JsonReader
+{
+public:
+	explicit JsonReader(std::istream& in) :
+		m_in(in)
+	{
+		if (peek() == 0xEF)
+		{
+			for (const uint8_t& c : BOM)
+			{
+				if (get() != c)
+					throw error("Invalid byte order mark");
+			}
+		}
+	}
+
+	void BeginObject()
+	{
+		expect('{');
+		m_first.push_back(true);
+	}
+
+	// Reads the next key of the current object, returns false and leaves the object at its end.
+	// The value of the key has to be read or skipped before the next call
+	bool NextKey(std::string& key)
+	{
+		if (!nextItem('}'))
+			return false;
+
+		if (skipWhitespace() != '"')
+			throw error("Expected object key");
+
+		key = readString();
+		expect(':');
+
+		return true;
+	}
+
+	void BeginArray()
+	{
+		expect('[');
+		m_first.push_back(true);
+	}
+
+	// Returns false and leaves the array at its end, otherwise the next element has to be read or skipped
+	bool NextElement()
+	{
+		return nextItem(']');
+	}
+
+	// Reads the next value as a whole
+	nlohmann::ordered_json ReadValue()
+	{
+		switch (skipWhitespace())
+		{
+			case '{':
+			{
+				nlohmann::ordered_json obj = nlohmann::ordered_json::object();
+				std::string key;
+
+				BeginObject();
+				while (NextKey(key))
+					obj[key] = ReadValue();
+
+				return obj;
+			}
+			case '[':
+			{
+				nlohmann::ordered_json arr = nlohmann::ordered_json::array();
+
+				BeginArray();
+				while (NextElement())
+					arr.push_back(ReadValue());
+
+				return arr;
+			}
+			case '"':
+				return readString();
+			case 't':
+				readLiteral("true");
+				return true;
+			case 'f':
+				readLiteral("false");
+				return false;
+			case 'n':
+				readLiteral("null");
+				return nullptr;
+			default:
+				return readNumber();
+		}
+	}
+
+	// Skips the next value without keeping anything of it
+	void Skip()
+	{
+		switch (skipWhitespace())
+		{
+			case '{':
+			{
+				std::string key;
+
+				BeginObject();
+				while (NextKey(key))
+					Skip();
+
+				break;
+			}
+			case '[':
+				BeginArray();
+				while (NextElement())
+					Skip();
+
+				break;
+			case '"':
+				readString();
+				break;
+			default:
+				ReadValue();
+				break;
+		}
+	}
+
+	// Calls func(key) for every key of the next object, func reads the value and returns true or
+	// returns false to skip it
+	template<typename Func>
+	void ForEachKey(const Func& func)
+	{
+		std::string key;
+
+		BeginObject();
+		while (NextKey(key))
+		{
+			if (!func(key))
+				Skip();
+		}
+	}
+
+	// Calls func(index) for every element of the next array, func has to read or skip the element.
+	// Returns the number of elements
+	template<typename Func>
+	std::size_t ForEachElement(const Func& func)
+	{
+		std::size_t count = 0;
+
+		BeginArray();
+		while (NextElement())
+			func(count++);
+
+		return count;
+	}
+
+private:
+	WolfRPGException error(const std::string& msg) const
+	{
+		return WolfRPGException(ERROR_TAG + std::format("JSON parse error at byte {}: {}", m_offset, msg));
+	}
+
+	int peek()
+	{
+		if (m_pos == m_buffer.size())
+		{
+			m_buffer.resize(BUFFER_SIZE);
+			m_in.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_buffer.resize(static_cast<std::size_t>(m_in.gcount()));
+			m_pos = 0;
+
+			if (m_buffer.empty())
+				return END_OF_INPUT;
+		}
+
+		return static_cast<uint8_t>(m_buffer[m_pos]);
+	}
+
+	int get()
+	{
+		const int c = peek();
+		if (c == END_OF_INPUT)
+			throw error("Unexpected end of input");
+
+		m_pos++;
+		m_offset++;
+
+		return c;
+	}
+
+	int skipWhitespace()
+	{
+		int c = peek();
+
+		while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+		{
+			get();
+			c = peek();
+		}
+
+		return c;
+	}
+
+	void expect(const char& c)
+	{
+		const int next = skipWhitespace();
+
+		if (next == END_OF_INPUT)
+			throw error("Unexpected end of input");
+
+		if (next != c)
+			throw error(std::format("Expected '{}'", c));
+
+		get();
+	}
+
+	bool nextItem(const char& close)
+	{
+		if (skipWhitespace() == close)
+		{
+			get();
+			m_first.pop_back();
+			return false;
+		}
+
+		if (!m_first.back())
+			expect(',');
+
+		m_first.back() = false;
+
+		return true;
+	}
+
+	void readLiteral(const std::string_view& literal)
+	{
+		for (const char& c : literal)
+		{
+			if (get() != c)
+				throw error(std::format("Invalid literal, expected {}", literal));
+		}
+	}
+
+	nlohmann::ordered_json readNumber()
+	{
+		std::string num;
+
+		auto digits = [&]() {
+			const std::size_t start = num.size();
+
+			while (peek() >= '0' && peek() <= '9')
+				num += static_cast<char>(get());
+
+			if (num.size() == start)
+				throw error("Invalid number");
+		};
+
+		if (peek() == '-')
+			num += static_cast<char>(get());
+
+		const std::size_t intStart = num.size();
+		digits();
+
+		if (num[intStart] == '0' && num.size() - intStart > 1)
+			throw error("Invalid number, leading zero");
+
+		bool isFloat = false;
+
+		if (peek() == '.')
+		{
+			num += static_cast<char>(get());
+			digits();
+			isFloat = true;
+		}
+
+		if (peek() == 'e' || peek() == 'E')
+		{
+			num += static_cast<char>(get());
+
+			if (peek() == '+' || peek() == '-')
+				num += static_cast<char>(get());
+
+			digits();
+			isFloat = true;
+		}
+
+		const char* pBegin = num.data();
+		const char* pEnd   = num.data() + num.size();
+
+		// Integers are stored like nlohmann::json does, out of range integers become floats
+		if (!isFloat)
+		{
+			if (num[0] == '-')
+			{
+				int64_t value;
+				if (std::from_chars(pBegin, pEnd, value).ec == std::errc())
+					return value;
+			}
+			else
+			{
+				uint64_t value;
+				if (std::from_chars(pBegin, pEnd, value).ec == std::errc())
+					return value;
+			}
+		}
+
+		double value;
+		if (std::from_chars(pBegin, pEnd, value).ec != std::errc())
+			throw error("Number out of range: " + num);
+
+		return value;
+	}
+
+	std::string readString()
+	{
+		expect('"');
+
+		std::string str;
+
+		while (true)
+		{
+			// Copy everything up to the next quote, escape or buffer end at once
+			const std::size_t start = m_pos;
+			while (m_pos < m_buffer.size())
+			{
+				const uint8_t c = static_cast<uint8_t>(m_buffer[m_pos]);
+				if (c == '"' || c == '\\' || c < 0x20) break;
+				m_pos++;
+			}
+
+			str.append(m_buffer, start, m_pos - start);
+			m_offset += m_pos - start;
+
+			// Refill the buffer and continue the string
+			if (m_pos == m_buffer.size())
+			{
+				if (peek() == END_OF_INPUT)
+					throw error("Unexpected end of input");
+
+				continue;
+			}
+
+			const int c = get();
+
+			if (c == '"')
+				return str;
+
+			if (c != '\\')
+				throw error("Invalid control character in string");
+
+			switch (get())
+			{
+				case '"':
+					str += '"';
+					break;
+				case '\\':
+					str += '\\';
+					break;
+				case '/':
+					str += '/';
+					break;
+				case 'b':
+					str += '\b';
+					break;
+				case 'f':
+					str += '\f';
+					break;
+				case 'n':
+					str += '\n';
+					break;
+				case 'r':
+					str += '\r';
+					break;
+				case 't':
+					str += '\t';
+					break;
+				case 'u':
+					appendCodepoint(str, readCodepoint());
+					break;
+				default:
+					throw error("Invalid escape sequence");
+			}
+		}
+	}
+
+	uint32_t readHex4()
+	{
+		uint32_t value = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			const int c = get();
+			value <<= 4;
+
+			if (c >= '0' && c <= '9')
+				value |= c - '0';
+			else if (c >= 'a' && c <= 'f')
+				value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F')
+				value |= c - 'A' + 10;
+			else
+				throw error("Invalid \\u escape");
+		}
+
+		return value;
+	}
+
+	uint32_t readCodepoint()
+	{
+		const uint32_t high = readHex4();
+
+		if (high >= 0xDC00 && high <= 0xDFFF)
+			throw error("Unpaired low surrogate");
+
+		if (high < 0xD800 || high > 0xDBFF)
+			return high;
+
+		if (get() != '\\' || get() != 'u')
+			throw error("Unpaired high surrogate");
+
+		const uint32_t low = readHex4();
+		if (low < 0xDC00 || low > 0xDFFF)
+			throw error("Unpaired high surrogate");
+
+		return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+	}
+
+	static void appendCodepoint(std::string& str, const uint32_t& cp)
+	{
+		if (cp < 0x80)
+			str += static_cast<char>(cp);
+		else if (cp < 0x800)
+		{
+			str += static_cast<char>(0xC0 | (cp >> 6));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000)
+		{
+			str += static_cast<char>(0xE0 | (cp >> 12));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else
+		{
+			str += static_cast<char>(0xF0 | (cp >> 18));
+			str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			str += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+private:
+	std::istream& m_in;
+	std::string m_buffer      = {};
+	std::size_t m_pos         = 0;
+	std::size_t m_offset      = 0; // Position in the document for error messages
+	std::vector<bool> m_first = {}; // Per open object / array if the next item is the first one
+
+	static constexpr std::size_t BUFFER_SIZE = 1 << 16;
+	static constexpr int END_OF_INPUT        = -1;
+	static constexpr uint8_t BOM[]           = { 0xEF, 0xBB, 0xBF };
+};
@@ -0,0 +1,265 @@
+/*
+ *  File: JsonWriter.h
+ *  Copyright (c) 2024 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "Types.h"
+#include "WolfRPGException.h"
+#include "WolfRPGUtils.h"
+
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes JSON directly to a stream while the data is traversed, the output is identical to
+// nlohmann::ordered_json::dump(4) of the same document, so no DOM has to be built for the dumps.
+// Only the current nesting is kept, so the memory does not depend on the size of the document
+class JsonWriter
+{
+public:
+	explicit JsonWriter(std::ostream& out, const uint32_t& indent = 4) :
+		m_out(out),
+		m_indent(indent)
+	{
+	}
+
+	// Writes what is still buffered, e.g. when the writer is dropped in the middle of a document
+	~JsonWriter()
+	{
+		try
+		{
+			Flush();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void BeginObject()
+	{
+		beginValue();
+		m_buffer += '{';
+		m_scopes.push_back({ false, 0 });
+	}
+
+	void EndObject()
+	{
+		endScope(false, '}');
+	}
+
+	void BeginArray()
+	{
+		beginValue();
+		m_buffer += '[';
+		m_scopes.push_back({ true, 0 });
+	}
+
+	void EndArray()
+	{
+		endScope(true, ']');
+	}
+
+	// The next value written is the value of this key
+	void Key(const std::string_view& key)
+	{
+		if (m_scopes.empty() || m_scopes.back().isArray || m_hasKey)
+			throw WolfRPGException(ERROR_TAG + "JSON key outside of an object");
+
+		beginElement();
+		writeString(key);
+		m_buffer += ": ";
+		m_hasKey = true;
+	}
+
+	// Strings have to be valid UTF-8, like everything ToUTF8 returns
+	void Value(const std::string_view& str)
+	{
+		beginValue();
+		writeString(str);
+		endValue();
+	}
+
+	void Value(const char* pStr)
+	{
+		Value(std::string_view(pStr));
+	}
+
+	void Value(const tString& str)
+	{
+		Value(ToUTF8(str));
+	}
+
+	template<std::integral T>
+		requires(!std::same_as<T, bool>)
+	void Value(const T& value)
+	{
+		beginValue();
+
+		char buf[24];
+		const std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), value);
+		m_buffer.append(buf, res.ptr);
+		endValue();
+	}
+
+	void Null()
+	{
+		beginValue();
+		m_buffer += "null";
+		endValue();
+	}
+
+	// Key and value in one call
+	template<typename T>
+	void Write(const std::string_view& key, const T& value)
+	{
+		Key(key);
+		Value(value);
+	}
+
+	void Flush()
+	{
+		m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+		m_buffer.clear();
+	}
+
+private:
+	struct Scope
+	{
+		bool isArray;
+		std::size_t count;
+	};
+
+	void beginValue()
+	{
+		if (m_scopes.empty())
+			return;
+
+		if (m_scopes.back().isArray)
+			beginElement();
+		else if (!m_hasKey)
+			throw WolfRPGException(ERROR_TAG + "JSON object value without a key");
+
+		m_hasKey = false;
+	}
+
+	// A top-level scalar is a complete document, so it is written right away
+	void endValue()
+	{
+		if (m_scopes.empty())
+			Flush();
+	}
+
+	void beginElement()
+	{
+		Scope& scope = m_scopes.back();
+
+		m_buffer += (scope.count++ == 0 ? "\n" : ",\n");
+		m_buffer.append(m_scopes.size() * m_indent, ' ');
+	}
+
+	void endScope(const bool& isArray, const char& close)
+	{
+		if (m_scopes.empty() || m_scopes.back().isArray != isArray || m_hasKey)
+			throw WolfRPGException(ERROR_TAG + "Unbalanced JSON " + (isArray ? "array" : "object"));
+
+		// Empty containers are written as {} / [] like dump does
+		if (m_scopes.back().count != 0)
+		{
+			m_buffer += '\n';
+			m_buffer.append((m_scopes.size() - 1) * m_indent, ' ');
+		}
+
+		m_buffer += close;
+		m_scopes.pop_back();
+
+		if (m_scopes.empty() || m_buffer.size() >= FLUSH_SIZE)
+			Flush();
+	}
+
+	// Same escaping as nlohmann::json with ensure_ascii disabled
+	void writeString(const std::string_view& str)
+	{
+		m_buffer += '"';
+
+		std::size_t start = 0;
+		for (std::size_t i = 0; i < str.size(); i++)
+		{
+			const uint8_t c = static_cast<uint8_t>(str[i]);
+			if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+			m_buffer.append(str, start, i - start);
+			start = i + 1;
+
+			switch (c)
+			{
+				case '\b':
+					m_buffer += "\\b";
+					break;
+				case '\t':
+					m_buffer += "\\t";
+					break;
+				case '\n':
+					m_buffer += "\\n";
+					break;
+				case '\f':
+					m_buffer += "\\f";
+					break;
+				case '\r':
+					m_buffer += "\\r";
+					break;
+				case '"':
+					m_buffer += "\\\"";
+					break;
+				case '\\':
+					m_buffer += "\\\\";
+					break;
+				default:
+					m_buffer += "\\u00";
+					m_buffer += HEX_DIGITS[c >> 4];
+					m_buffer += HEX_DIGITS[c & 0xF];
+					break;
+			}
+		}
+
+		m_buffer.append(str, start, str.size() - start);
+		m_buffer += '"';
+	}
+
+private:
+	std::ostream& m_out;
+	uint32_t m_indent;
+
+	std::string m_buffer        = {};
+	std::vector<Scope> m_scopes = {};
+	bool m_hasKey               = false;
+
+	static constexpr std::size_t FLUSH_SIZE = 1 << 16;
+	static constexpr char HEX_DIGITS[]      = "0123456789abcdef";
+};
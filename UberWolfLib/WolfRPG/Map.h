@@ -31,6 +31,7 @@
 #include "WolfDataBase.h"
 #include "WolfRPGUtils.h"
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <nlohmann/json.hpp>
@@ -38,10 +39,14 @@
 
 class Page
 {
+public:
+	using Conditions = std::array<uint8_t, 1 + 4 + 4 * 4 + 4 * 4>;
+	using Movement   = std::array<uint8_t, 4>;
+
 public:
 	Page() = default;
 
-	bool Init(FileCoder& coder, uint32_t id)
+	bool Init(FileCoder& coder, uint32_t id, const Command::CommandStorePtr& commandStore)
 	{
 		m_id       = id;
 		m_unknown1 = coder.ReadInt();
@@ -52,8 +57,8 @@ public:
 		m_graphicOpacity    = coder.ReadByte();
 		m_graphicRenderMode = coder.ReadByte();
 
-		m_conditions = coder.Read(1 + 4 + 4 * 4 + 4 * 4);
-		m_movement   = coder.Read(4);
+		coder.Read(m_conditions);
+		coder.Read(m_movement);
 
 		m_flags = coder.ReadByte();
 
@@ -66,18 +71,11 @@ public:
 			if (!rc.Init(coder))
 				throw WolfRPGException(ERROR_TAG + "RouteCommand initialization failed");
 
-			m_route.push_back(rc);
+			m_route.push_back(std::move(rc));
 		}
 
 		uint32_t commandCount = coder.ReadInt();
-		for (uint32_t i = 0; i < commandCount; i++)
-		{
-			Command::CommandShPtr::Command command = Command::Command::Init(coder);
-			if (!command->Valid())
-				throw WolfRPGException(ERROR_TAG + "Command initialization failed");
-
-			m_commands.push_back(command);
-		}
+		m_commands            = Command::ReadCommands(coder, commandStore, commandCount);
 
 		m_features = coder.ReadInt();
 
@@ -95,6 +93,31 @@ public:
 		return true;
 	}
 
+	// Walks a page like Init, but only passes the commands to the scanner
+	static void Scan(FileCoder& coder, Command::CommandScanner& scanner)
+	{
+		coder.Skip(4);
+		coder.SkipString();
+		coder.Skip(4 + std::tuple_size_v<Conditions> + std::tuple_size_v<Movement> + 1 + 1);
+
+		uint32_t routeCount = coder.ReadInt();
+		for (uint32_t i = 0; i < routeCount; i++)
+			RouteCommand::Skip(coder);
+
+		uint32_t commandCount = coder.ReadInt();
+		scanner.Scan(coder, commandCount);
+
+		uint32_t features = coder.ReadInt();
+		coder.Skip(3);
+
+		if (features > 3)
+			coder.Skip(1);
+
+		uint8_t terminator = coder.ReadByte();
+		if (terminator != 0x7A)
+			throw WolfRPGException(ERROR_TAG + "Page terminator not 0x7A (found: " + Dec2Hex(terminator) + ")");
+	}
+
 	void Dump(FileCoder& coder) const
 	{
 		coder.WriteInt(m_unknown1);
@@ -111,8 +134,7 @@ public:
 		for (RouteCommand cmd : m_route)
 			cmd.Dump(coder);
 		coder.WriteInt(static_cast<uint32_t>(m_commands.size()));
-		for (const Command::CommandShPtr::Command& cmd : m_commands)
-			cmd->Dump(coder);
+		m_commands.Dump(coder);
 		coder.WriteInt(m_features);
 		coder.WriteByte(m_shadowGraphicNum);
 		coder.WriteByte(m_collisionWidth);
@@ -124,49 +146,59 @@ public:
 		coder.WriteByte(0x7A);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["id"]   = m_id;
-		j["list"] = nlohmann::ordered_json::array();
+		writer.BeginObject();
+		writer.Write("id", m_id);
+		writer.Key("list");
+		writer.BeginArray();
 
 		for (std::size_t i = 0; i < m_commands.size(); i++)
-		{
-			nlohmann::ordered_json cmdJ = m_commands[i]->ToJson();
-
-			if (!cmdJ.empty())
-			{
-				cmdJ["index"] = i;
-				j["list"].push_back(cmdJ);
-			}
-		}
+			m_commands[i].ToJson(writer, i);
 
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
-	void Patch(const nlohmann::ordered_json& j)
+	// The commands are patched while the list is read, only one command is kept as JSON at a time
+	void Patch(JsonReader& reader)
 	{
-		CHECK_JSON_KEY(j, "list", "pages");
-		CHECK_JSON_KEY(j, "id", "pages");
+		bool hasId   = false;
+		bool hasList = false;
 
-		const uint32_t id = j["id"].get<uint32_t>();
+		reader.ForEachKey([&](const std::string& key) {
+			if (key == "id")
+			{
+				const uint32_t id = reader.ReadValue().get<uint32_t>();
 
-		if (id != m_id)
-			throw WolfRPGException(ERROR_TAG + "Page ID mismatch: " + std::to_string(m_id) + " != " + std::to_string(id));
+				if (id != m_id)
+					throw WolfRPGException(ERROR_TAG + "Page ID mismatch: " + std::to_string(m_id) + " != " + std::to_string(id));
 
-		uint32_t cmdIdx = 0;
+				hasId = true;
+			}
+			else if (key == "list")
+			{
+				reader.ForEachElement([&](const std::size_t& cmdIdx) {
+					const nlohmann::ordered_json cmdJ = reader.ReadValue();
+					CHECK_JSON_KEY(cmdJ, "index", std::format("pages::list[{}]", cmdIdx));
 
-		for (const auto& cmdJ : j["list"])
-		{
-			CHECK_JSON_KEY(cmdJ, "index", std::format("pages::list[{}]", cmdIdx));
-			cmdIdx++;
+					const uint32_t index = cmdJ["index"].get<uint32_t>();
+					if (index >= m_commands.size())
+						throw WolfRPGException(ERROR_TAG + "Index out of range: " + std::to_string(index) + " >= " + std::to_string(m_commands.size()));
 
-			const uint32_t index = cmdJ["index"].get<uint32_t>();
-			if (index >= m_commands.size())
-				throw WolfRPGException(ERROR_TAG + "Index out of range: " + std::to_string(index) + " >= " + std::to_string(m_commands.size()));
+					m_commands.Patch(index, cmdJ);
+				});
 
-			m_commands[index]->Patch(cmdJ);
-		}
+				hasList = true;
+			}
+			else
+				return false;
+
+			return true;
+		});
+
+		CHECK_JSON_KEY_FOUND(hasList, "list", "pages");
+		CHECK_JSON_KEY_FOUND(hasId, "id", "pages");
 	}
 
 	const uint32_t& GetID() const
@@ -199,12 +231,12 @@ public:
 		return m_graphicRenderMode;
 	}
 
-	const Bytes& GetConditions() const
+	const Conditions& GetConditions() const
 	{
 		return m_conditions;
 	}
 
-	const Bytes& GetMovement() const
+	const Movement& GetMovement() const
 	{
 		return m_movement;
 	}
@@ -252,8 +284,8 @@ private:
 	uint8_t m_graphicFrame       = 0;
 	uint8_t m_graphicOpacity     = 0;
 	uint8_t m_graphicRenderMode  = 0;
-	Bytes m_conditions           = {};
-	Bytes m_movement             = {};
+	Conditions m_conditions      = {};
+	Movement m_movement          = {};
 	uint8_t m_flags              = 0;
 	uint8_t m_routeFlags         = 0;
 	RouteCommands m_route        = {};
@@ -272,7 +304,7 @@ class Event
 public:
 	Event() = default;
 
-	bool Init(FileCoder& coder)
+	bool Init(FileCoder& coder, const Command::CommandStorePtr& commandStore)
 	{
 		VERIFY_MAGIC(coder, MAGIC_NUMBER1);
 
@@ -289,10 +321,10 @@ public:
 		while ((indicator = coder.ReadByte()) == 0x79)
 		{
 			Page page;
-			if (!page.Init(coder, pageID))
+			if (!page.Init(coder, pageID, commandStore))
 				throw WolfRPGException(ERROR_TAG + "Page initialization failed");
 
-			m_pages.push_back(page);
+			m_pages.push_back(std::move(page));
 			pageID++;
 		}
 
@@ -307,6 +339,29 @@ public:
 		return m_valid;
 	}
 
+	static void Scan(FileCoder& coder, Command::CommandScanner& scanner)
+	{
+		coder.Skip(4 + 4);
+		coder.SkipString();
+		coder.Skip(4 + 4);
+		uint32_t pageCount = coder.ReadInt();
+		coder.Skip(4);
+
+		uint8_t indicator  = 0x0;
+		uint32_t pagesRead = 0;
+		while ((indicator = coder.ReadByte()) == 0x79)
+		{
+			Page::Scan(coder, scanner);
+			pagesRead++;
+		}
+
+		if (pagesRead != pageCount)
+			throw WolfRPGException(ERROR_TAG + "Expected " + std::to_string(pageCount) + " Pages, but read: " + std::to_string(pagesRead) + " Pages");
+
+		if (indicator != 0x70)
+			throw WolfRPGException(ERROR_TAG + "Unexpected event indicator: " + Dec2Hex(indicator) + " expected 0x70");
+	}
+
 	void Dump(FileCoder& coder) const
 	{
 		coder.Write(MAGIC_NUMBER1);
@@ -326,31 +381,59 @@ public:
 		coder.WriteByte(0x70);
 	}
 
-	nlohmann::ordered_json ToJson() const
+	void ToJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["id"]    = m_id;
-		j["name"]  = ToUTF8(m_name);
-		j["pages"] = nlohmann::ordered_json::array();
+		writer.BeginObject();
+		writer.Write("id", m_id);
+		writer.Write("name", m_name);
+		writer.Key("pages");
+		writer.BeginArray();
 
 		for (const Page& page : m_pages)
-			j["pages"].push_back(page.ToJson());
+			page.ToJson(writer);
 
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
-	void Patch(const nlohmann::ordered_json& j)
+	void Patch(JsonReader& reader)
 	{
-		CHECK_JSON_KEY(j, "pages", "events");
-		CHECK_JSON_KEY(j, "id", "events");
+		bool hasId    = false;
+		bool hasPages = false;
 
-		const uint32_t id = j["id"].get<uint32_t>();
+		reader.ForEachKey([&](const std::string& key) {
+			if (key == "id")
+			{
+				const uint32_t id = reader.ReadValue().get<uint32_t>();
 
-		if (id != m_id)
-			throw WolfRPGException(ERROR_TAG + "Event ID mismatch: " + std::to_string(m_id) + " != " + std::to_string(id));
+				if (id != m_id)
+					throw WolfRPGException(ERROR_TAG + "Event ID mismatch: " + std::to_string(m_id) + " != " + std::to_string(id));
 
-		for (std::size_t i = 0; i < m_pages.size(); i++)
-			m_pages[i].Patch(j["pages"][i]);
+				hasId = true;
+			}
+			else if (key == "pages")
+			{
+				// Additional pages in the patch are ignored
+				const std::size_t count = reader.ForEachElement([&](const std::size_t& i) {
+					if (i < m_pages.size())
+						m_pages[i].Patch(reader);
+					else
+						reader.Skip();
+				});
+
+				if (count < m_pages.size())
+					throw WolfRPGException(ERROR_TAG + BuildCountError("pages", m_pages.size(), count));
+
+				hasPages = true;
+			}
+			else
+				return false;
+
+			return true;
+		});
+
+		CHECK_JSON_KEY_FOUND(hasPages, "pages", "events");
+		CHECK_JSON_KEY_FOUND(hasId, "id", "events");
 	}
 
 	const uint32_t& GetID() const
@@ -400,8 +483,8 @@ using Events = std::vector<Event>;
 class Map : public WolfDataBase
 {
 public:
-	explicit Map(const tString& fileName = L"") :
-		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::Map)
+	explicit Map(const tString& fileName = L"", const WolfContextPtr& context = nullptr) :
+		WolfDataBase(fileName, MAGIC_NUMBER, WolfFileType::Map, {}, context)
 	{
 		if (!fileName.empty())
 			Load(fileName);
@@ -412,6 +495,57 @@ public:
 		return m_events;
 	}
 
+	// Streams the commands of a map file to the scanner without loading the map
+	static void ScanCommands(const tString& fileName, Command::CommandScanner& scanner, const WolfContextPtr& context = nullptr)
+	{
+		scanFile(fileName, MAGIC_NUMBER, WolfFileType::Map, {}, context ? context : std::make_shared<WolfContext>(), [&scanner](FileCoder& coder) {
+			const uint32_t version = coder.ReadInt();
+			coder.Skip(1);
+			coder.SkipString();
+
+			coder.Skip(4);
+			const uint32_t width  = coder.ReadInt();
+			const uint32_t height = coder.ReadInt();
+
+			uint32_t eventCount = coder.ReadInt();
+
+			if (version >= 0x67)
+			{
+				coder.Skip(4 + 4);
+
+				coder.Context().v35 = true;
+			}
+
+			bool readTiles = true;
+
+			if (coder.IsUTF8())
+			{
+				int32_t v = coder.ReadInt();
+				if (v == -1)
+					readTiles = false;
+				else
+					coder.Seek(-4);
+			}
+
+			if (readTiles)
+				coder.Skip(width * height * 3 * 4);
+
+			uint8_t indicator   = 0x0;
+			uint32_t eventsRead = 0;
+			while ((indicator = coder.ReadByte()) == EVENT_INDICATOR)
+			{
+				Event::Scan(coder, scanner);
+				eventsRead++;
+			}
+
+			if (eventsRead != eventCount)
+				throw WolfRPGException(ERROR_TAG + "Expected " + std::to_string(eventCount) + " Events, but read: " + std::to_string(eventsRead) + " Events");
+
+			if (indicator != TERMINATOR)
+				throw WolfRPGException(ERROR_TAG + "Unexpected event indicator: " + Dec2Hex(indicator) + " expected 0x66");
+		});
+	}
+
 protected:
 	bool load(FileCoder& coder)
 	{
@@ -430,12 +564,12 @@ protected:
 			m_unknown4 = coder.ReadInt();
 			m_unknown5 = coder.ReadInt();
 
-			Command::Command::s_v35 = true;
+			coder.Context().v35 = true;
 		}
 
 		bool readTiles = true;
 
-		if (FileCoder::IsUTF8())
+		if (coder.IsUTF8())
 		{
 			int32_t v = coder.ReadInt();
 			if (v == -1)
@@ -447,14 +581,17 @@ protected:
 		if (readTiles)
 			m_tiles = coder.Read(m_width * m_height * 3 * 4);
 
+		// All commands of the map share one store
+		m_commandStore = std::make_shared<Command::CommandStore>();
+
 		uint8_t indicator = 0x0;
 		while ((indicator = coder.ReadByte()) == EVENT_INDICATOR)
 		{
 			Event ev;
-			if (!ev.Init(coder))
+			if (!ev.Init(coder, m_commandStore))
 				throw WolfRPGException(ERROR_TAG + "Event initialization failed");
 
-			m_events.push_back(ev);
+			m_events.push_back(std::move(ev));
 		}
 
 		if (m_events.size() != eventCount)
@@ -474,7 +611,7 @@ protected:
 		FileCoder* pCoder = &coder;
 		// For v3.5 we need to compress the actual data before writing it to the file.
 		// Therefore, we create a temporary buffer-based file coder to write the data to.
-		FileCoder bufCoder = FileCoder(FileCoder::Mode::WRITE, m_fileType);
+		FileCoder bufCoder = FileCoder(coder.GetContext(), FileCoder::Mode::WRITE, m_fileType);
 
 		coder.Write(MAGIC_NUMBER);
 
@@ -485,7 +622,7 @@ protected:
 		if (m_version >= 0x65)
 		{
 			if (m_version >= 0x67)
-				Command::Command::s_v35 = true;
+				coder.Context().v35 = true;
 
 			pCoder = &bufCoder;
 		}
@@ -503,7 +640,7 @@ protected:
 			pCoder->WriteInt(m_unknown5);
 		}
 
-		if (FileCoder::IsUTF8() && m_tiles.empty())
+		if (coder.IsUTF8() && m_tiles.empty())
 			pCoder->WriteInt(0xFFFFFFFF);
 		else
 			pCoder->Write(m_tiles);
@@ -523,21 +660,63 @@ protected:
 		}
 	}
 
-	nlohmann::ordered_json toJson() const
+	void toJson(JsonWriter& writer) const
 	{
-		nlohmann::ordered_json j;
-		j["events"] = nlohmann::ordered_json::array();
+		writer.BeginObject();
+		writer.Key("events");
+		writer.BeginArray();
 
 		for (const Event& ev : m_events)
-			j["events"].push_back(ev.ToJson());
+			ev.ToJson(writer);
 
-		return j;
+		writer.EndArray();
+		writer.EndObject();
 	}
 
-	void patch(const nlohmann::ordered_json& j)
+	// The counts and IDs are only checked while the patch is read, so the events and the commands in the
+	// shared store are restored from a snapshot if a check fails, a broken patch leaves the map unchanged
+	void patch(JsonReader& reader)
 	{
-		for (std::size_t i = 0; i < m_events.size(); i++)
-			m_events[i].Patch(j["events"][i]);
+		Events events                  = m_events;
+		Command::CommandStore commands = *m_commandStore;
+
+		try
+		{
+			patchEvents(reader);
+		}
+		catch (...)
+		{
+			m_events        = std::move(events);
+			*m_commandStore = std::move(commands);
+			throw;
+		}
+	}
+
+private:
+	void patchEvents(JsonReader& reader)
+	{
+		bool hasEvents = false;
+
+		reader.ForEachKey([&](const std::string& key) {
+			if (key != "events")
+				return false;
+
+			// Additional events in the patch are ignored
+			const std::size_t count = reader.ForEachElement([&](const std::size_t& i) {
+				if (i < m_events.size())
+					m_events[i].Patch(reader);
+				else
+					reader.Skip();
+			});
+
+			if (count < m_events.size())
+				throw WolfRPGException(ERROR_TAG + BuildCountError("events", m_events.size(), count));
+
+			hasEvents = true;
+			return true;
+		});
+
+		CHECK_JSON_KEY_FOUND(hasEvents, "events", "Map");
 	}
 
 private:
@@ -553,6 +732,8 @@ private:
 	Bytes m_tiles        = {};
 	Events m_events      = {};
 
+	Command::CommandStorePtr m_commandStore = nullptr;
+
 	inline static const MagicNumber MAGIC_NUMBER{ { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 													0x57, 0x4F, 0x4C, 0x46, 0x4D, 0x00, 0x00, 0x00, 0x00, 0x00 },
 												  16 };
@@ -15,6 +15,8 @@
 #include <string>
 #include <vector>
 
+#include <DXLib/AesCtr.h>
+
 
 inline uint32_t xorshift32(const uint32_t &seed = 0)
 {
@@ -191,33 +193,7 @@ inline void cipher(uint8_t *pState, const uint8_t *pRoundKey)
 // AES_CTR_xcrypt
 inline void aesCtrXCrypt(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
 {
-	uint8_t state[AES_BLOCKLEN];
-	uint8_t *pIv = pKey + AES_KEY_EXP_SIZE;
-	int32_t bi   = AES_BLOCKLEN;
-
-	for (std::size_t i = 0; i < size; i++, bi++)
-	{
-		if (bi == AES_BLOCKLEN)
-		{
-			std::memcpy(state, pIv, AES_BLOCKLEN);
-
-			cipher(state, pKey);
-
-			for (bi = AES_BLOCKLEN - 1; bi >= 0; bi--)
-			{
-				if (pIv[bi] == 0xFF)
-				{
-					pIv[bi] = 0;
-					continue;
-				}
-				pIv[bi]++;
-				break;
-			}
-			bi = 0;
-		}
-
-		pData[i] ^= state[bi];
-	}
+	aesCtr::xcrypt(pData, pKey, pKey + AES_KEY_EXP_SIZE, size);
 }
 
 ////// AES CTR Crypt
@@ -39,14 +39,21 @@ public:
 		m_id              = coder.ReadByte();
 		uint32_t argCount = coder.ReadByte();
 
-		for (uint32_t i = 0; i < argCount; i++)
-			m_args.push_back(coder.ReadInt());
+		coder.ReadInts(m_args, argCount);
 
 		VERIFY_MAGIC(coder, TERMINATOR);
 
 		return true;
 	}
 
+	static void Skip(FileCoder& coder)
+	{
+		coder.Skip(1);
+		coder.Skip(coder.ReadByte() * 4);
+
+		VERIFY_MAGIC(coder, TERMINATOR);
+	}
+
 	void Dump(FileCoder& coder) const
 	{
 		coder.WriteByte(m_id);
@@ -0,0 +1,437 @@
+/*
+ *  File: TextConv.h
+ *  Copyright (c) 2024 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "Types.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define TEXT_CONV_SSE2
+#endif
+
+// Defined in DXLib/CharCode.cpp, the header is not included because DataType.h defines the short type names as macros
+extern const unsigned short* GetShiftJISToUTF16Table();
+
+// Table driven Shift-JIS (code page 932) and UTF-8 conversion from / to UTF-16.
+// Runs of ASCII are converted 16 bytes at a time and the result is written directly into the returned string.
+namespace textConv
+{
+namespace detail
+{
+// Character used by the code page 932 conversion for byte sequences without a mapping
+static constexpr wchar_t SJIS_DEFAULT_CHAR = 0x30FB;
+
+inline bool IsSjisLeadByte(const uint8_t byte)
+{
+	return static_cast<uint8_t>((byte ^ 0x20) - 0xA1) < 0x3C;
+}
+
+inline bool IsSurrogate(const uint32_t c)
+{
+	return (c & 0xFFFFF800) == 0xD800;
+}
+
+struct SjisTables
+{
+	using Table = std::array<uint16_t, 0x10000>;
+
+	SjisTables() :
+		pToUtf16(std::make_unique<Table>()),
+		pFromUtf16(std::make_unique<Table>())
+	{
+		Table& toUtf16   = *pToUtf16;
+		Table& fromUtf16 = *pFromUtf16;
+
+		const unsigned short* pDXTable = GetShiftJISToUTF16Table();
+		std::copy(pDXTable, pDXTable + toUtf16.size(), toUtf16.begin());
+		fromUtf16.fill(0);
+
+#ifdef _WIN32
+		// Ask the API for every character, this keeps its choice between duplicate codes and its best fit mappings
+		for (uint32_t c = 1; c < 0x10000; c++)
+		{
+			if (IsSurrogate(c)) continue;
+
+			const wchar_t src = static_cast<wchar_t>(c);
+			char dst[4]       = { 0 };
+			const int size    = WideCharToMultiByte(932, 0, &src, 1, dst, sizeof(dst), NULL, NULL);
+
+			if (size == 1)
+				fromUtf16[c] = static_cast<uint8_t>(dst[0]);
+			else if (size == 2)
+				fromUtf16[c] = static_cast<uint16_t>(static_cast<uint8_t>(dst[0]) << 8 | static_cast<uint8_t>(dst[1]));
+		}
+#else
+		// The compressed table lacks the single bytes which the API maps to the private use area
+		toUtf16[0xA0] = 0xF8F0;
+		toUtf16[0xFD] = 0xF8F1;
+		toUtf16[0xFE] = 0xF8F2;
+		toUtf16[0xFF] = 0xF8F3;
+
+		// Invert the decode table, for characters with several codes the lowest one is used,
+		// except for the NEC selected IBM extensions (0xED40 - 0xEEFC) which lose against the IBM extensions (0xFA40 - 0xFC4B)
+		for (uint32_t code = 1; code < 0x10000; code++)
+		{
+			const uint16_t c = toUtf16[code];
+			if (c == 0) continue;
+
+			uint16_t& cur = fromUtf16[c];
+			if (cur == 0 || (cur >= 0xED00 && cur < 0xEF00 && code >= 0xFA00))
+				cur = static_cast<uint16_t>(code);
+		}
+#endif
+	}
+
+	std::unique_ptr<Table> pToUtf16;
+	std::unique_ptr<Table> pFromUtf16;
+};
+
+inline const SjisTables& GetSjisTables()
+{
+	// The first call sets up the tables, the initialization of the static is thread safe
+	static const SjisTables tables;
+	return tables;
+}
+
+// Converts the leading run of ASCII bytes and returns its length, pDst has to have room for size characters
+template<typename CharT>
+inline std::size_t WidenAscii(const uint8_t* pSrc, const std::size_t size, CharT* pDst)
+{
+	std::size_t i = 0;
+
+#ifdef TEXT_CONV_SSE2
+	if constexpr (sizeof(CharT) == 2)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_unpacklo_epi8(bytes, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+
+			// The bytes up to the first one with the high bit set are already stored
+			const uint32_t highBits = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+			if (highBits != 0)
+				return i + std::countr_zero(highBits);
+		}
+	}
+#endif
+
+	for (; i < size && pSrc[i] < 0x80; i++)
+		pDst[i] = static_cast<CharT>(pSrc[i]);
+
+	return i;
+}
+
+// Converts the leading run of ASCII characters and returns its length, pDst has to have room for size bytes
+template<typename CharT>
+inline std::size_t NarrowAscii(const CharT* pSrc, const std::size_t size, uint8_t* pDst)
+{
+	std::size_t i = 0;
+
+#ifdef TEXT_CONV_SSE2
+	if constexpr (sizeof(CharT) == 2)
+	{
+		const __m128i highMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+		const __m128i zero     = _mm_setzero_si128();
+
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+			const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 8));
+
+			// Leave the block with a non ASCII character to the scalar loop
+			const __m128i high = _mm_and_si128(_mm_or_si128(lo, hi), highMask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) break;
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+#endif
+
+	for (; i < size && static_cast<uint32_t>(pSrc[i]) < 0x80; i++)
+		pDst[i] = static_cast<uint8_t>(pSrc[i]);
+
+	return i;
+}
+
+#ifdef _WIN32
+inline tString SjisToUtf16Api(const uint8_t* pData, const std::size_t size)
+{
+	const LPCCH pSJIS = reinterpret_cast<LPCCH>(pData);
+	const int utfSize = MultiByteToWideChar(932, 0, pSJIS, static_cast<int>(size), NULL, 0);
+
+	tString utf(utfSize, 0);
+	MultiByteToWideChar(932, 0, pSJIS, static_cast<int>(size), utf.data(), utfSize);
+	return utf;
+}
+
+inline Bytes Utf16ToSjisApi(const wchar_t* pData, const std::size_t size)
+{
+	const int sjisSize = WideCharToMultiByte(932, 0, pData, static_cast<int>(size), NULL, 0, NULL, NULL);
+
+	Bytes sjis(sjisSize + 1, 0);
+	WideCharToMultiByte(932, 0, pData, static_cast<int>(size), reinterpret_cast<LPSTR>(sjis.data()), sjisSize, NULL, NULL);
+	return sjis;
+}
+#endif
+} // namespace detail
+
+// Converts Shift-JIS to UTF-16, byte sequences without a mapping give the same result as MultiByteToWideChar(932, 0, ...)
+inline tString SjisToUtf16(const uint8_t* pData, const std::size_t size)
+{
+	const detail::SjisTables::Table& table = *detail::GetSjisTables().pToUtf16;
+
+	// Every character takes at least one byte
+	tString utf(size, 0);
+	wchar_t* pOut = utf.data();
+	std::size_t i = 0;
+
+	while (i < size)
+	{
+		const std::size_t ascii = detail::WidenAscii(pData + i, size - i, pOut);
+		i += ascii;
+		pOut += ascii;
+
+		if (i == size) break;
+
+		uint32_t code = pData[i++];
+		if (detail::IsSjisLeadByte(static_cast<uint8_t>(code)) && i < size)
+			code = code << 8 | pData[i++];
+
+		wchar_t c = static_cast<wchar_t>(table[code]);
+		if (c == 0)
+		{
+#ifdef _WIN32
+			// Leave the rare invalid sequences to the API to keep its exact handling of them
+			return detail::SjisToUtf16Api(pData, size);
+#else
+			c = detail::SJIS_DEFAULT_CHAR;
+#endif
+		}
+
+		*pOut++ = c;
+	}
+
+	utf.resize(pOut - utf.data());
+	return utf;
+}
+
+// Converts UTF-16 to Shift-JIS, the result is terminated by a 0 which is part of its size
+inline Bytes Utf16ToSjis(const wchar_t* pData, const std::size_t size)
+{
+	const detail::SjisTables::Table& table = *detail::GetSjisTables().pFromUtf16;
+
+	// Every character takes at most two bytes
+	Bytes sjis(size * 2 + 1, 0);
+	uint8_t* pOut = sjis.data();
+	std::size_t i = 0;
+
+	while (i < size)
+	{
+		const std::size_t ascii = detail::NarrowAscii(pData + i, size - i, pOut);
+		i += ascii;
+		pOut += ascii;
+
+		if (i == size) break;
+
+		const uint32_t c = static_cast<uint32_t>(pData[i++]);
+		uint16_t code    = (c < 0x10000) ? table[c] : 0;
+
+		if (code == 0)
+		{
+#ifdef _WIN32
+			// Surrogates are the only characters without a table entry, they are converted by the API
+			return detail::Utf16ToSjisApi(pData, size);
+#else
+			// A surrogate pair is one character
+			if (c >= 0xD800 && c < 0xDC00 && i < size && (static_cast<uint32_t>(pData[i]) & 0xFC00) == 0xDC00)
+				i++;
+
+			code = '?';
+#endif
+		}
+
+		if (code > 0xFF)
+			*pOut++ = static_cast<uint8_t>(code >> 8);
+
+		*pOut++ = static_cast<uint8_t>(code);
+	}
+
+	sjis.resize(pOut - sjis.data() + 1);
+	return sjis;
+}
+
+inline Bytes Utf16ToSjis(const tString& str)
+{
+	return Utf16ToSjis(str.data(), str.size());
+}
+
+// Converts UTF-8 to UTF-16, throws std::range_error for invalid UTF-8
+inline tString Utf8ToUtf16(const std::string_view& str)
+{
+	const uint8_t* pData   = reinterpret_cast<const uint8_t*>(str.data());
+	const std::size_t size = str.size();
+
+	// Every UTF-16 unit takes at least one byte
+	tString utf(size, 0);
+	wchar_t* pOut = utf.data();
+	std::size_t i = 0;
+
+	while (i < size)
+	{
+		const std::size_t ascii = detail::WidenAscii(pData + i, size - i, pOut);
+		i += ascii;
+		pOut += ascii;
+
+		if (i == size) break;
+
+		const uint8_t lead = pData[i];
+		uint32_t c;
+		std::size_t len;
+		uint8_t min = 0x80;
+		uint8_t max = 0xBF;
+
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			c   = lead & 0x1F;
+			len = 2;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			c   = lead & 0x0F;
+			len = 3;
+			// No overlong encodings and no surrogates
+			if (lead == 0xE0) min = 0xA0;
+			if (lead == 0xED) max = 0x9F;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			c   = lead & 0x07;
+			len = 4;
+			// No overlong encodings and nothing above 0x10FFFF
+			if (lead == 0xF0) min = 0x90;
+			if (lead == 0xF4) max = 0x8F;
+		}
+		else
+			throw std::range_error("bad conversion");
+
+		if (size - i < len || pData[i + 1] < min || pData[i + 1] > max)
+			throw std::range_error("bad conversion");
+
+		for (std::size_t j = 1; j < len; j++)
+		{
+			const uint8_t next = pData[i + j];
+			if ((next & 0xC0) != 0x80)
+				throw std::range_error("bad conversion");
+
+			c = c << 6 | (next & 0x3F);
+		}
+
+		i += len;
+
+		if constexpr (sizeof(wchar_t) == 2)
+		{
+			if (c > 0xFFFF)
+			{
+				c -= 0x10000;
+				*pOut++ = static_cast<wchar_t>(0xD800 | (c >> 10));
+				c       = 0xDC00 | (c & 0x3FF);
+			}
+		}
+
+		*pOut++ = static_cast<wchar_t>(c);
+	}
+
+	utf.resize(pOut - utf.data());
+	return utf;
+}
+
+// Converts UTF-16 to UTF-8, throws std::range_error for unpaired surrogates
+inline std::string Utf16ToUtf8(const std::wstring_view& str)
+{
+	const std::size_t size = str.size();
+
+	// Every UTF-16 unit takes at most three bytes, a surrogate pair takes four, a UTF-32 unit takes four
+	constexpr std::size_t MAX_UNIT_BYTES = (sizeof(wchar_t) == 2) ? 3 : 4;
+
+	std::string utf(size * MAX_UNIT_BYTES, 0);
+	uint8_t* pOut = reinterpret_cast<uint8_t*>(utf.data());
+	std::size_t i = 0;
+
+	while (i < size)
+	{
+		const std::size_t ascii = detail::NarrowAscii(str.data() + i, size - i, pOut);
+		i += ascii;
+		pOut += ascii;
+
+		if (i == size) break;
+
+		uint32_t c = static_cast<uint32_t>(str[i++]);
+
+		if (detail::IsSurrogate(c))
+		{
+			if (c >= 0xDC00 || i == size || (static_cast<uint32_t>(str[i]) & 0xFC00) != 0xDC00)
+				throw std::range_error("bad conversion");
+
+			c = 0x10000 + ((c & 0x3FF) << 10 | (static_cast<uint32_t>(str[i++]) & 0x3FF));
+		}
+		else if (c > 0x10FFFF)
+			throw std::range_error("bad conversion");
+
+		if (c < 0x800)
+			*pOut++ = static_cast<uint8_t>(0xC0 | (c >> 6));
+		else
+		{
+			if (c < 0x10000)
+				*pOut++ = static_cast<uint8_t>(0xE0 | (c >> 12));
+			else
+			{
+				*pOut++ = static_cast<uint8_t>(0xF0 | (c >> 18));
+				*pOut++ = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3F));
+			}
+
+			*pOut++ = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+		}
+
+		*pOut++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+	}
+
+	utf.resize(reinterpret_cast<char*>(pOut) - utf.data());
+	return utf;
+}
+} // namespace textConv
@@ -31,12 +31,15 @@
 #include <nlohmann\json.hpp>
 
 #include "FileCoder.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
 #include "Types.h"
 
 class WolfDataBase
 {
 public:
-	WolfDataBase(const tString& fileName, const MagicNumber& magic, const WolfFileType& fileType, const uInts& seedIndices = {}) :
+	WolfDataBase(const tString& fileName, const MagicNumber& magic, const WolfFileType& fileType, const uInts& seedIndices = {}, const WolfContextPtr& context = nullptr) :
+		m_context(context ? context : std::make_shared<WolfContext>()),
 		m_fileName(fileName),
 		m_magic(magic),
 		m_fileType(fileType),
@@ -53,12 +56,12 @@ public:
 		if (m_fileName.empty())
 			throw WolfRPGException(ERROR_TAG + "Trying to load with empty filename");
 
-		g_activeFile = ::GetFileName(m_fileName);
+		m_context->activeFile = ::GetFileName(m_fileName);
 
-		// Reset the static variable for Command
-		Command::Command::s_v35 = false;
+		// Reset the command version of the context
+		m_context->v35 = false;
 
-		FileCoder coder(m_fileName, FileCoder::Mode::READ, m_fileType, m_seedIndices);
+		FileCoder coder(m_context, m_fileName, FileCoder::Mode::READ, m_fileType, m_seedIndices);
 
 		if (coder.IsEncrypted())
 		{
@@ -76,7 +79,7 @@ public:
 		if (buffer.empty())
 			throw WolfRPGException(ERROR_TAG + "Trying to load with empty buffer");
 
-		FileCoder coder(buffer, FileCoder::Mode::READ, m_fileType, m_seedIndices);
+		FileCoder coder(m_context, buffer, FileCoder::Mode::READ, m_fileType, m_seedIndices);
 
 		if (coder.IsEncrypted())
 		{
@@ -91,25 +94,26 @@ public:
 
 	void Dump(const tString& outputDir) const
 	{
-		// Reset the static variable for Command
-		Command::Command::s_v35 = false;
+		// Reset the command version of the context
+		m_context->v35 = false;
 
 		const tString fileName = ::GetFileName(m_fileName);
-		g_activeFile           = fileName;
+		m_context->activeFile  = fileName;
 		tString outputFN       = outputDir + L"/" + fileName;
-		FileCoder coder(outputFN, FileCoder::Mode::WRITE, m_fileType, m_seedIndices);
+		FileCoder coder(m_context, outputFN, FileCoder::Mode::WRITE, m_fileType, m_seedIndices);
 		dump(coder);
 	}
 
 	virtual void ToJson(const tString& outputFolder) const
 	{
 		const tString fileName = ::GetFileNameNoExt(m_fileName);
-		g_activeFile           = fileName;
+		m_context->activeFile  = fileName;
 
 		const tString outputFile = std::format(TEXT("{}/{}.json"), outputFolder, fileName);
 
 		std::ofstream out(outputFile);
-		out << toJson().dump(4);
+		JsonWriter writer(out);
+		toJson(writer);
 
 		out.close();
 	}
@@ -117,18 +121,17 @@ public:
 	virtual void Patch(const tString& patchFolder)
 	{
 		const tString fileName = ::GetFileNameNoExt(m_fileName);
-		g_activeFile           = fileName;
+		m_context->activeFile  = fileName;
 
 		const tString patchFile = patchFolder + L"/" + fileName + L".json";
 		if (!std::filesystem::exists(patchFile))
 			throw WolfRPGException(ERROR_TAGW + L"Patch file not found: " + patchFile);
 
-		nlohmann::ordered_json j;
 		std::ifstream in(patchFile);
-		in >> j;
-		in.close();
+		JsonReader reader(in);
+		patch(reader);
 
-		patch(j);
+		in.close();
 	}
 
 	const tString& FileName() const
@@ -136,13 +139,42 @@ public:
 		return m_fileName;
 	}
 
+	const WolfContextPtr& GetContext() const
+	{
+		return m_context;
+	}
+
+	// Continue with a private copy of the context, objects which do not share a context can be processed in parallel
+	void DetachContext()
+	{
+		m_context = std::make_shared<WolfContext>(*m_context);
+	}
+
 protected:
+	// Opens a file the same way as Load and passes the coder to func, nothing of the file is kept
+	template<typename Func>
+	static void scanFile(const tString& fileName, const MagicNumber& magic, const WolfFileType& fileType, const uInts& seedIndices, const WolfContextPtr& context, const Func& func)
+	{
+		context->activeFile = ::GetFileName(fileName);
+		context->v35        = false;
+
+		FileCoder coder(context, fileName, FileCoder::Mode::READ, fileType, seedIndices);
+
+		if (coder.IsEncrypted())
+			coder.SetUTF8(magic.IsUTF8(coder.GetCryptHeader()));
+		else
+			VERIFY_MAGIC(coder, magic);
+
+		func(coder);
+	}
+
 	virtual bool load(FileCoder& coder)                 = 0;
 	virtual void dump(FileCoder& coder) const           = 0;
-	virtual nlohmann::ordered_json toJson() const       = 0;
-	virtual void patch(const nlohmann::ordered_json& j) = 0;
+	virtual void toJson(JsonWriter& writer) const       = 0;
+	virtual void patch(JsonReader& reader)              = 0;
 
 protected:
+	WolfContextPtr m_context;
 	tString m_fileName;
 	MagicNumber m_magic;
 	WolfFileType m_fileType;
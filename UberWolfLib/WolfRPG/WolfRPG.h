@@ -32,29 +32,48 @@
 #include "Map.h"
 #include "Types.h"
 
+#include <atomic>
+#include <exception>
 #include <filesystem>
+#include <list>
+#include <mutex>
+#include <thread>
 
 class WolfRPG
 {
 public:
-	explicit WolfRPG(const tString& dataPath, const bool& skipGD = false) :
+	// In lazy mode the constructor only indexes the map and database files, every part of the game
+	// data is parsed the first time it is accessed. The getters parse and release the data on demand,
+	// so a WolfRPG object must only be used by one thread at a time, even through const references.
+	// Use PrepareParallelAccess to process the parsed objects on several threads
+	explicit WolfRPG(const tString& dataPath, const bool& skipGD = false, const uint32_t& mapThreads = 0, const bool& lazy = false) :
 		m_dataPath(dataPath),
-		m_skipGD(skipGD)
+		m_skipGD(skipGD),
+		m_mapThreads(mapThreads),
+		m_lazy(lazy)
 	{
 		try
 		{
-			loadGameDat();
-			loadCommonEvents();
-			loadDatabases();
-			loadMaps();
+			if (m_lazy)
+			{
+				indexDatabases();
+				indexMaps();
+			}
+			else
+			{
+				loadGameDat();
+				loadCommonEvents();
+				indexDatabases();
+				loadDatabases();
+				indexMaps();
+				loadMaps();
+			}
 
 			m_valid = true;
 		}
 		catch (WolfRPGException& e)
 		{
-			std::wcerr << std::endl
-					   << "Error while processing: " << g_activeFile << std::endl
-					   << e.what() << std::endl;
+			printError(e);
 		}
 	}
 
@@ -67,10 +86,23 @@ public:
 		return m_valid;
 	}
 
+	const bool& Lazy() const
+	{
+		return m_lazy;
+	}
+
 	void Save2File(const tString& outputPath) const
 	{
 		checkValid();
 
+		// Everything is written, so parse whatever was not accessed yet
+		lazyLoad([this]() {
+			loadGameDat();
+			loadCommonEvents();
+			loadDatabases();
+			loadMaps();
+		});
+
 		tString basicDataDir = outputPath + L"/BasicData/";
 		tString mapDataDir   = outputPath + L"/MapData/";
 
@@ -104,51 +136,156 @@ public:
 	GameDat& GetGameDat()
 	{
 		checkValid();
+		lazyLoad([this]() { loadGameDat(); });
 		return m_gameDat;
 	}
 
 	const GameDat& GetGameDat() const
 	{
 		checkValid();
+		lazyLoad([this]() { loadGameDat(); });
 		return m_gameDat;
 	}
 
+	// The returned maps are pinned, the map cache limit does not release them until ReleaseMaps is called
 	Maps& GetMaps()
 	{
 		checkValid();
+		lazyLoad([this]() { loadMaps(); });
+		m_mapsPinned = true;
 		return m_maps;
 	}
 
 	const Maps& GetMaps() const
 	{
 		checkValid();
+		lazyLoad([this]() { loadMaps(); });
+		m_mapsPinned = true;
 		return m_maps;
 	}
 
+	std::size_t GetMapCount() const
+	{
+		checkValid();
+		return m_mapFiles.size();
+	}
+
+	// The .mps files in the order of GetMaps()
+	const std::vector<std::filesystem::path>& GetMapFiles() const
+	{
+		checkValid();
+		return m_mapFiles;
+	}
+
+	// Returns a single map and only parses this one in lazy mode, if a map cache limit is set
+	// the least recently used maps beyond the limit are released again, which empties the maps
+	// returned by earlier calls (unless GetMaps pinned them)
+	Map& GetMap(const std::size_t& index)
+	{
+		return m_maps[checkedMapIndex(index)];
+	}
+
+	const Map& GetMap(const std::size_t& index) const
+	{
+		return m_maps[checkedMapIndex(index)];
+	}
+
 	CommonEvents& GetCommonEvents()
 	{
 		checkValid();
+		lazyLoad([this]() { loadCommonEvents(); });
 		return m_commonEvents;
 	}
 
 	const CommonEvents& GetCommonEvents() const
 	{
 		checkValid();
+		lazyLoad([this]() { loadCommonEvents(); });
 		return m_commonEvents;
 	}
 
 	Databases& GetDatabases()
 	{
 		checkValid();
+		lazyLoad([this]() { loadDatabases(); });
 		return m_databases;
 	}
 
 	const Databases& GetDatabases() const
 	{
 		checkValid();
+		lazyLoad([this]() { loadDatabases(); });
 		return m_databases;
 	}
 
+	std::size_t GetDatabaseCount() const
+	{
+		checkValid();
+		return m_databaseFiles.size();
+	}
+
+	// The .project / .dat file pairs in the order of GetDatabases()
+	const std::vector<std::pair<tString, tString>>& GetDatabaseFiles() const
+	{
+		checkValid();
+		return m_databaseFiles;
+	}
+
+	// Parses everything which was not accessed yet and gives Game.dat, the common events and every database a copy
+	// of the shared load context (the maps already have their own). Afterwards every object can be exported, patched
+	// and written on its own thread. The copies are all taken from the final state, like a serial Save2File sees it
+	void PrepareParallelAccess()
+	{
+		checkValid();
+
+		lazyLoad([this]() {
+			loadGameDat();
+			loadCommonEvents();
+			loadDatabases();
+			loadMaps();
+		});
+
+		if (!m_skipGD)
+			m_gameDat.DetachContext();
+
+		m_commonEvents.DetachContext();
+
+		for (Database& db : m_databases)
+			db.DetachContext();
+	}
+
+	// Maximum number of maps kept in memory when they are accessed through GetMap, 0 keeps all of them.
+	// GetMaps and Save2File always load every map, GetMaps also suspends the limit until ReleaseMaps
+	void SetMapCacheLimit(const std::size_t& limit)
+	{
+		m_mapCacheLimit = limit;
+
+		if (m_lazy)
+			evictMaps();
+	}
+
+	// Release the parsed maps / databases, they are parsed again on the next access.
+	// Only possible in lazy mode, unsaved changes of the released objects are lost and
+	// references returned by GetMaps / GetMap or GetDatabases must not be used anymore
+	void ReleaseMaps()
+	{
+		if (!m_lazy) return;
+
+		for (const std::size_t& index : m_mapLru)
+			releaseMap(index);
+
+		m_mapLru.clear();
+		m_mapsPinned = false;
+	}
+
+	void ReleaseDatabases()
+	{
+		if (!m_lazy) return;
+
+		m_databases.clear();
+		m_databasesLoaded = false;
+	}
+
 private:
 	void checkValid() const
 	{
@@ -156,56 +293,236 @@ private:
 			throw WolfRPGException(ERROR_TAGW + L"Invalid WolfRPG object");
 	}
 
-	void loadGameDat()
+	std::size_t checkedMapIndex(const std::size_t& index) const
+	{
+		checkValid();
+
+		if (index >= m_mapFiles.size())
+			throw WolfRPGException(ERROR_TAGW + L"Map index out of range: " + std::to_wstring(index));
+
+		lazyLoad([this, index]() { loadMaps({ index }, false); });
+
+		if (m_lazy)
+			touchMap(index);
+
+		return index;
+	}
+
+	void printError(const WolfRPGException& e) const
+	{
+		std::wcerr << std::endl
+				   << "Error while processing: " << m_context->activeFile << std::endl
+				   << e.what() << std::endl;
+	}
+
+	// Errors while parsing on access are reported the same way as errors in the constructor
+	template<typename Func>
+	void lazyLoad(const Func& func) const
 	{
-		if (m_skipGD) return;
+		if (!m_lazy) return;
+
+		try
+		{
+			func();
+		}
+		catch (WolfRPGException& e)
+		{
+			printError(e);
+			throw;
+		}
+	}
+
+	void loadGameDat() const
+	{
+		if (m_skipGD || m_gameDatLoaded) return;
 
 		std::cout << "Loading Game.dat ... " << std::flush;
 
-		m_gameDat = GameDat(m_dataPath + L"/BasicData/Game.dat");
+		m_gameDat = GameDat(m_dataPath + L"/BasicData/Game.dat", m_context);
 
 		std::cout << "Done" << std::endl;
+
+		m_gameDatLoaded = true;
 	}
 
-	void loadMaps()
+	void indexMaps()
 	{
+		m_mapFiles.clear();
+
 		if (!std::filesystem::exists(m_dataPath + L"/MapData/"))
 		{
 			std::cout << "MapData directory not found. Skipping Maps ..." << std::endl;
 			return;
 		}
 
-		std::cout << "Loading Maps ... " << std::flush;
-
-		size_t prevLength = 0;
 		for (std::filesystem::directory_entry p : std::filesystem::directory_iterator(m_dataPath + L"/MapData/"))
 		{
 			if (p.path().extension() == ".mps")
+				m_mapFiles.push_back(p.path());
+		}
+
+		m_maps      = Maps(m_mapFiles.size());
+		m_mapLoaded = std::vector<bool>(m_mapFiles.size(), false);
+	}
+
+	void loadMaps() const
+	{
+		std::vector<std::size_t> indices;
+		for (std::size_t i = 0; i < m_mapFiles.size(); i++)
+		{
+			if (!m_mapLoaded[i])
+				indices.push_back(i);
+		}
+
+		if (indices.empty()) return;
+
+		loadMaps(indices, true);
+
+		// Maps accessed as a whole are all recently used
+		if (m_lazy)
+		{
+			for (const std::size_t& index : indices)
+				m_mapLru.push_back(index);
+		}
+	}
+
+	void loadMaps(const std::vector<std::size_t>& indices, const bool& verbose) const
+	{
+		std::vector<std::size_t> toLoad;
+		for (const std::size_t& index : indices)
+		{
+			if (!m_mapLoaded[index])
+				toLoad.push_back(index);
+		}
+
+		if (toLoad.empty()) return;
+
+		if (verbose)
+			std::cout << "Loading Maps ... " << std::flush;
+
+		// Every map is loaded with its own copy of the context, so the maps can be loaded in parallel
+		// and m_maps keeps the directory order of the serial load
+		std::vector<WolfContextPtr> contexts(toLoad.size());
+		std::vector<std::exception_ptr> errors(toLoad.size());
+
+		std::atomic<std::size_t> nextMap = 0;
+		std::mutex printMutex;
+		size_t prevLength = 0;
+
+		auto worker = [&]() {
+			for (std::size_t i = nextMap++; i < toLoad.size(); i = nextMap++)
+			{
+				const std::filesystem::path& mapFile = m_mapFiles[toLoad[i]];
+
+				if (verbose)
+				{
+					std::lock_guard<std::mutex> lock(printMutex);
+					std::wcout << "\rLoading Map: " << mapFile.filename() << std::setfill(TCHAR(' ')) << std::setw(prevLength) << "" << std::flush;
+					prevLength = tString(mapFile.filename()).length();
+				}
+
+				contexts[i] = std::make_shared<WolfContext>(*m_context);
+
+				try
+				{
+					m_maps[toLoad[i]] = Map(tString(mapFile), contexts[i]);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			}
+		};
+
+		uint32_t threadCount = (m_mapThreads != 0 ? m_mapThreads : std::max(1u, std::thread::hardware_concurrency()));
+		threadCount          = static_cast<uint32_t>(std::min<std::size_t>(threadCount, toLoad.size()));
+
+		if (threadCount <= 1)
+			worker();
+		else
+		{
+			std::vector<std::thread> workers;
+			for (uint32_t i = 0; i < threadCount; i++)
+				workers.emplace_back(worker);
+
+			for (std::thread& w : workers)
+				w.join();
+		}
+
+		// Report the first failed map in directory order, like the serial load would
+		for (std::size_t i = 0; i < toLoad.size(); i++)
+		{
+			if (errors[i])
 			{
-				std::wcout << "\rLoading Map: " << p.path().filename() << std::setfill(TCHAR(' ')) << std::setw(prevLength) << "" << std::flush;
-				prevLength = tString(p.path().filename()).length();
-				tString file(p.path());
-				m_maps.push_back(Map(file));
+				// The failed maps stay unloaded, so a later access tries again
+				for (std::size_t j = 0; j < toLoad.size(); j++)
+				{
+					if (!errors[j])
+						m_mapLoaded[toLoad[j]] = true;
+				}
+
+				m_context->activeFile = contexts[i]->activeFile;
+				std::rethrow_exception(errors[i]);
 			}
 		}
 
-		std::cout << "\rLoading Maps ... Done" << std::setfill(' ') << std::setw(prevLength) << "" << std::endl;
+		for (const std::size_t& index : toLoad)
+			m_mapLoaded[index] = true;
+
+		if (verbose)
+			std::cout << "\rLoading Maps ... Done" << std::setfill(' ') << std::setw(prevLength) << "" << std::endl;
+	}
+
+	void touchMap(const std::size_t& index) const
+	{
+		m_mapLru.remove(index);
+		m_mapLru.push_back(index);
+
+		evictMaps();
+	}
+
+	void evictMaps() const
+	{
+		// References returned by GetMaps must keep seeing the loaded maps
+		if (m_mapCacheLimit == 0 || m_mapsPinned) return;
+
+		while (m_mapLru.size() > m_mapCacheLimit)
+		{
+			releaseMap(m_mapLru.front());
+			m_mapLru.pop_front();
+		}
+	}
+
+	// The vector entry is kept, so references into m_maps stay valid but see an empty map,
+	// this is why maps pinned by GetMaps are never released by the cache limit
+	void releaseMap(const std::size_t& index) const
+	{
+		m_maps[index]      = Map();
+		m_mapLoaded[index] = false;
 	}
 
-	void loadCommonEvents()
+	void loadCommonEvents() const
 	{
+		if (m_commonEventsLoaded) return;
+
 		std::cout << "Loading CommonEvents ... " << std::flush;
 
-		m_commonEvents = CommonEvents(m_dataPath + L"/BasicData/CommonEvent.dat");
+		m_commonEvents = CommonEvents(m_dataPath + L"/BasicData/CommonEvent.dat", m_context);
 
 		std::cout << "Done" << std::endl;
+
+		m_commonEventsLoaded = true;
 	}
 
-	void loadDatabases()
+	void indexDatabases()
 	{
-		std::cout << "Loading Databases ... " << std::flush;
+		m_databaseFiles.clear();
 
-		for (std::filesystem::directory_entry p : std::filesystem::directory_iterator(m_dataPath + L"/BasicData/"))
+		const tString basicDataDir = m_dataPath + L"/BasicData/";
+		if (!std::filesystem::exists(basicDataDir))
+			throw WolfRPGException(ERROR_TAGW + L"BasicData directory not found: " + basicDataDir);
+
+		for (std::filesystem::directory_entry p : std::filesystem::directory_iterator(basicDataDir))
 		{
 			std::filesystem::path pp = p.path();
 			if (pp.extension() == ".project" && pp.filename() != "SysDataBaseBasic.project")
@@ -213,9 +530,55 @@ private:
 				tString projectFile(p.path());
 				pp.replace_extension(".dat");
 				tString datFile(pp);
-				m_databases.push_back(Database(projectFile, datFile));
+				m_databaseFiles.push_back({ projectFile, datFile });
 			}
 		}
+	}
+
+	// The project key the databases are loaded with in eager mode, i.e. the one left in the context by Game.dat and
+	// CommonEvent.dat. Only their headers are read, so the result does not depend on what was accessed before
+	uint32_t databaseProjectKey() const
+	{
+		if (m_databaseProjKeyScanned) return m_databaseProjKey;
+
+		WolfContextPtr context = std::make_shared<WolfContext>();
+
+		try
+		{
+			if (!m_skipGD)
+				GameDat::ScanContext(m_dataPath + L"/BasicData/Game.dat", context);
+
+			CommonEvents::ScanContext(m_dataPath + L"/BasicData/CommonEvent.dat", context);
+		}
+		catch (...)
+		{
+			m_context->activeFile = context->activeFile;
+			throw;
+		}
+
+		m_databaseProjKey        = context->projKey;
+		m_databaseProjKeyScanned = true;
+
+		return m_databaseProjKey;
+	}
+
+	void loadDatabases() const
+	{
+		if (m_databasesLoaded) return;
+
+		// In lazy mode the context holds whatever the files accessed so far left in it, the databases have to
+		// start from the same project key as in eager mode, where they are loaded right after the common events
+		if (m_lazy)
+			m_context->projKey = databaseProjectKey();
+
+		std::cout << "Loading Databases ... " << std::flush;
+
+		Databases databases;
+		for (const auto& [projectFile, datFile] : m_databaseFiles)
+			databases.push_back(Database(projectFile, datFile, m_context));
+
+		m_databases       = std::move(databases);
+		m_databasesLoaded = true;
 
 		std::cout << "Done" << std::endl;
 	}
@@ -235,11 +598,32 @@ private:
 private:
 	tString m_dataPath;
 	bool m_skipGD;
+	uint32_t m_mapThreads;
+	bool m_lazy;
+
+	std::vector<std::filesystem::path> m_mapFiles;
+	std::vector<std::pair<tString, tString>> m_databaseFiles;
+
+	WolfContextPtr m_context = std::make_shared<WolfContext>();
+
+	// Parsed on first access in lazy mode, by the constructor otherwise. Changed by const getters without
+	// synchronization, see the constructor
+	mutable GameDat m_gameDat;
+	mutable Maps m_maps;
+	mutable CommonEvents m_commonEvents;
+	mutable Databases m_databases;
+
+	mutable bool m_gameDatLoaded      = false;
+	mutable std::vector<bool> m_mapLoaded;
+	mutable bool m_commonEventsLoaded = false;
+	mutable bool m_databasesLoaded    = false;
+
+	mutable uint32_t m_databaseProjKey     = static_cast<uint32_t>(-1);
+	mutable bool m_databaseProjKeyScanned = false;
 
-	GameDat m_gameDat;
-	Maps m_maps;
-	CommonEvents m_commonEvents;
-	Databases m_databases;
+	std::size_t m_mapCacheLimit = 0;
+	mutable std::list<std::size_t> m_mapLru;
+	mutable bool m_mapsPinned = false;
 
 	bool m_valid = false;
 };
@@ -26,14 +26,13 @@
 
 #pragma once
 
+#include "TextConv.h"
 #include "Types.h"
 
-#include <codecvt>
 #include <filesystem>
 #include <format>
 #include <iomanip>
 #include <iostream>
-#include <locale>
 #include <regex>
 #include <source_location>
 #include <sstream>
@@ -69,6 +68,11 @@ inline std::string BuildJsonError(const std::string& key, const std::string& obj
 	return std::format("Key '{}' for object '{}' not found in patch", key, obj);
 }
 
+inline std::string BuildCountError(const std::string& obj, const std::size_t& expected, const std::size_t& got)
+{
+	return std::format("Count mismatch for object '{}' expected: {} - got: {}", obj, expected, got);
+}
+
 #define ERROR_TAG  BuildErrorTag(std::source_location::current())
 #define ERROR_TAGW BuildErrorTagW(std::source_location::current())
 
@@ -77,6 +81,12 @@ inline std::string BuildJsonError(const std::string& key, const std::string& obj
 		if (!JSON.contains(KEY)) throw WolfRPGException(ERROR_TAG + BuildJsonError(KEY, OBJ)); \
 	while (0)
 
+// Same error as CHECK_JSON_KEY for objects which are read with the JsonReader, FOUND tells if the key was read
+#define CHECK_JSON_KEY_FOUND(FOUND, KEY, OBJ)                                       \
+	do                                                                              \
+		if (!(FOUND)) throw WolfRPGException(ERROR_TAG + BuildJsonError(KEY, OBJ)); \
+	while (0)
+
 #define VERIFY_MAGIC(CODER, MAGIC) \
 	if (!CODER.Verify(MAGIC)) throw WolfRPGException(ERROR_TAG + "MAGIC invalid");
 
@@ -117,14 +127,12 @@ inline const tString GetFileNameNoExt(const tString& file)
 
 inline std::wstring ToUTF16(const std::string& utf8String)
 {
-	static std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.from_bytes(utf8String);
+	return textConv::Utf8ToUtf16(utf8String);
 }
 
 inline std::string ToUTF8(const std::wstring& utf16String)
 {
-	static std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.to_bytes(utf16String);
+	return textConv::Utf16ToUtf8(utf16String);
 }
 
 inline void CreateBackup(const tString& file)
@@ -183,5 +191,3 @@ inline bool FilenameAnyOf(const std::filesystem::path& path, const std::vector<s
 	}
 	return false;
 }
-
-inline tString g_activeFile = L"";
\ No newline at end of file
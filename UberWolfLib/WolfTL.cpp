@@ -27,13 +27,34 @@
 #include "WolfTL.h"
 #include "WolfRPG/WolfRPGUtils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <format>
+#include <thread>
+
+namespace
+{
+// Manifest names are UTF-8, like the paths in the manifest
+std::string unitName(const tString& folder, const fs::path& file)
+{
+    const std::u8string name = (fs::path(folder) / file.filename()).generic_u8string();
+    return std::string(name.begin(), name.end());
+}
+
+// The patch JSON of a map or database, named like WolfDataBase::Patch expects it
+fs::path patchFile(const tString& patchFolder, const fs::path& dataFile)
+{
+    fs::path file = fs::path(patchFolder) / dataFile.stem();
+    file += TEXT(".json");
+    return file;
+}
+} // namespace
 
 WolfTL::WolfTL(const tString& dataPath, const tString& outputPath, const bool& skipGameDat)
     : m_dataPath(dataPath)
     , m_outputPath(outputPath)
-    , m_wolf(dataPath, skipGameDat)
+    , m_wolf(dataPath, skipGameDat, 0, true)
     , m_skipGameDat(skipGameDat)
     , m_progressCallback(nullptr)
 {
@@ -51,17 +72,17 @@ bool WolfTL::ExtractToJson()
     {
         updateProgress(0, TEXT("Starting JSON extraction..."));
 
-        // Extract each component with progress updates
-        if (!extractMapsToJson()) return false;
-        updateProgress(25, TEXT("Maps extracted"));
+        // Parse everything first, afterwards every file is exported by its own task
+        m_wolf.PrepareParallelAccess();
 
-        if (!extractDatabasesToJson()) return false;
-        updateProgress(50, TEXT("Databases extracted"));
+        std::vector<FileTask> tasks;
+        if (!extractMapsToJson(tasks)) return false;
+        if (!extractDatabasesToJson(tasks)) return false;
+        if (!extractCommonEventsToJson(tasks)) return false;
+        if (!extractGameDatToJson(tasks)) return false;
 
-        if (!extractCommonEventsToJson()) return false;
-        updateProgress(75, TEXT("Common events extracted"));
+        if (!runFileTasks(tasks, TEXT("Extracted"), TEXT("Failed to extract "))) return false;
 
-        if (!extractGameDatToJson()) return false;
         updateProgress(100, TEXT("JSON extraction completed"));
 
         return true;
@@ -96,22 +117,22 @@ bool WolfTL::ApplyTranslations(bool inPlace)
     {
         updateProgress(0, TEXT("Starting translation application..."));
 
-        // Apply translations for each component
-        if (!applyMapTranslations(m_outputPath)) return false;
-        updateProgress(25, TEXT("Map translations applied"));
+        tString outputPath = inPlace ? m_dataPath : (m_outputPath + PATCHED_DATA);
 
-        if (!applyDatabaseTranslations(m_outputPath)) return false;
-        updateProgress(50, TEXT("Database translations applied"));
+        if (m_incremental)
+            return applyTranslationsIncremental(outputPath, inPlace);
 
-        if (!applyCommonEventTranslations(m_outputPath)) return false;
-        updateProgress(75, TEXT("Common event translations applied"));
+        // Parse everything first, afterwards every file is patched and written by its own task
+        m_wolf.PrepareParallelAccess();
 
-        if (!applyGameDatTranslations(m_outputPath)) return false;
-        updateProgress(90, TEXT("Game data translations applied"));
+        std::vector<FileTask> tasks;
+        if (!applyMapTranslations(m_outputPath, outputPath, tasks)) return false;
+        if (!applyDatabaseTranslations(m_outputPath, outputPath, tasks)) return false;
+        if (!applyCommonEventTranslations(m_outputPath, outputPath, tasks)) return false;
+        if (!applyGameDatTranslations(m_outputPath, outputPath, tasks)) return false;
+
+        if (!runFileTasks(tasks, TEXT("Patched"), TEXT("Failed to apply translations to "))) return false;
 
-        // Save the patched data
-        tString outputPath = inPlace ? m_dataPath : (m_outputPath + PATCHED_DATA);
-        m_wolf.Save2File(outputPath);
         updateProgress(100, TEXT("Translation application completed"));
 
         return true;
@@ -133,8 +154,8 @@ std::map<tString, size_t> WolfTL::GetTranslationStats() const
 
     try
     {
-        stats[TEXT("Maps")] = m_wolf.GetMaps().size();
-        stats[TEXT("Databases")] = m_wolf.GetDatabases().size();
+        stats[TEXT("Maps")] = m_wolf.GetMapCount();
+        stats[TEXT("Databases")] = m_wolf.GetDatabaseCount();
         stats[TEXT("CommonEvents")] = 1; // Always 1 CommonEvents file
         stats[TEXT("GameDat")] = m_skipGameDat ? 0 : 1;
     }
@@ -146,7 +167,7 @@ std::map<tString, size_t> WolfTL::GetTranslationStats() const
     return stats;
 }
 
-bool WolfTL::extractMapsToJson()
+bool WolfTL::extractMapsToJson(std::vector<FileTask>& tasks)
 {
     try
     {
@@ -156,7 +177,7 @@ bool WolfTL::extractMapsToJson()
         fs::create_directories(mapOutput);
 
         for (const Map& map : m_wolf.GetMaps())
-            map.ToJson(mapOutput);
+            tasks.push_back({ fs::path(map.FileName()).filename().wstring(), [&map, mapOutput]() { map.ToJson(mapOutput); } });
 
         return true;
     }
@@ -168,7 +189,7 @@ bool WolfTL::extractMapsToJson()
     }
 }
 
-bool WolfTL::extractDatabasesToJson()
+bool WolfTL::extractDatabasesToJson(std::vector<FileTask>& tasks)
 {
     try
     {
@@ -177,8 +198,12 @@ bool WolfTL::extractDatabasesToJson()
         // Make sure the output folder exists
         fs::create_directories(dbOutput);
 
-        for (const Database& db : m_wolf.GetDatabases())
-            db.ToJson(dbOutput);
+        const Databases& databases = m_wolf.GetDatabases();
+        for (std::size_t i = 0; i < databases.size(); i++)
+        {
+            const Database& db = databases[i];
+            tasks.push_back({ fs::path(m_wolf.GetDatabaseFiles()[i].second).filename().wstring(), [&db, dbOutput]() { db.ToJson(dbOutput); } });
+        }
 
         return true;
     }
@@ -190,7 +215,7 @@ bool WolfTL::extractDatabasesToJson()
     }
 }
 
-bool WolfTL::extractCommonEventsToJson()
+bool WolfTL::extractCommonEventsToJson(std::vector<FileTask>& tasks)
 {
     try
     {
@@ -199,7 +224,8 @@ bool WolfTL::extractCommonEventsToJson()
         // Make sure the output folder exists
         fs::create_directories(comOutput);
 
-        m_wolf.GetCommonEvents().ToJson(comOutput);
+        const CommonEvents& commonEvents = m_wolf.GetCommonEvents();
+        tasks.push_back({ TEXT("CommonEvent.dat"), [&commonEvents, comOutput]() { commonEvents.ToJson(comOutput); } });
 
         return true;
     }
@@ -211,7 +237,7 @@ bool WolfTL::extractCommonEventsToJson()
     }
 }
 
-bool WolfTL::extractGameDatToJson()
+bool WolfTL::extractGameDatToJson(std::vector<FileTask>& tasks)
 {
     if (m_skipGameDat) return true;
 
@@ -219,7 +245,8 @@ bool WolfTL::extractGameDatToJson()
     {
         const tString gameDatOutput = std::format(TEXT("{}/{}"), m_outputPath, OUTPUT_DIR);
 
-        m_wolf.GetGameDat().ToJson(gameDatOutput);
+        const GameDat& gameDat = m_wolf.GetGameDat();
+        tasks.push_back({ TEXT("Game.dat"), [&gameDat, gameDatOutput]() { gameDat.ToJson(gameDatOutput); } });
 
         return true;
     }
@@ -231,21 +258,29 @@ bool WolfTL::extractGameDatToJson()
     }
 }
 
-bool WolfTL::applyMapTranslations(const tString& patchFolder)
+bool WolfTL::applyMapTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks)
 {
     try
     {
-        const tString mapPatch = std::format(TEXT("{}/{}"), patchFolder, MAP_OUTPUT);
+        const tString mapPatch   = std::format(TEXT("{}/{}"), patchFolder, MAP_OUTPUT);
+        const tString mapDataDir = outputPath + TEXT("/MapData/");
+
+        // Not an error if no map patches exist, the maps are still written
+        const bool patchMaps = fs::exists(mapPatch);
+
+        Maps& maps = m_wolf.GetMaps();
+        if (!maps.empty())
+            fs::create_directories(mapDataDir);
 
-        // Check if the patch folder exists
-        if (!fs::exists(mapPatch))
+        for (Map& map : maps)
         {
-            // Not an error if no map patches exist
-            return true;
-        }
+            tasks.push_back({ fs::path(map.FileName()).filename().wstring(), [&map, patchMaps, mapPatch, mapDataDir]() {
+                if (patchMaps)
+                    map.Patch(mapPatch);
 
-        for (Map& map : m_wolf.GetMaps())
-            map.Patch(mapPatch);
+                map.Dump(mapDataDir);
+            } });
+        }
 
         return true;
     }
@@ -257,21 +292,29 @@ bool WolfTL::applyMapTranslations(const tString& patchFolder)
     }
 }
 
-bool WolfTL::applyDatabaseTranslations(const tString& patchFolder)
+bool WolfTL::applyDatabaseTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks)
 {
     try
     {
-        const tString dbPatch = std::format(TEXT("{}/{}"), patchFolder, DB_OUTPUT);
+        const tString dbPatch      = std::format(TEXT("{}/{}"), patchFolder, DB_OUTPUT);
+        const tString basicDataDir = outputPath + TEXT("/BasicData/");
+
+        // Not an error if no database patches exist, the databases are still written
+        const bool patchDbs = fs::exists(dbPatch);
+
+        fs::create_directories(basicDataDir);
 
-        // Check if the patch folder exists
-        if (!fs::exists(dbPatch))
+        Databases& databases = m_wolf.GetDatabases();
+        for (std::size_t i = 0; i < databases.size(); i++)
         {
-            // Not an error if no database patches exist
-            return true;
-        }
+            Database& db = databases[i];
+            tasks.push_back({ fs::path(m_wolf.GetDatabaseFiles()[i].second).filename().wstring(), [&db, patchDbs, dbPatch, basicDataDir]() {
+                if (patchDbs)
+                    db.Patch(dbPatch);
 
-        for (Database& db : m_wolf.GetDatabases())
-            db.Patch(dbPatch);
+                db.Dump(basicDataDir);
+            } });
+        }
 
         return true;
     }
@@ -283,20 +326,25 @@ bool WolfTL::applyDatabaseTranslations(const tString& patchFolder)
     }
 }
 
-bool WolfTL::applyCommonEventTranslations(const tString& patchFolder)
+bool WolfTL::applyCommonEventTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks)
 {
     try
     {
-        const tString comPatch = std::format(TEXT("{}/{}"), patchFolder, COM_OUTPUT);
+        const tString comPatch     = std::format(TEXT("{}/{}"), patchFolder, COM_OUTPUT);
+        const tString basicDataDir = outputPath + TEXT("/BasicData/");
 
-        // Check if the patch folder exists
-        if (!fs::exists(comPatch))
-        {
-            // Not an error if no common event patches exist
-            return true;
-        }
+        // Not an error if no common event patches exist, the common events are still written
+        const bool patchCom = fs::exists(comPatch);
+
+        fs::create_directories(basicDataDir);
+
+        CommonEvents& commonEvents = m_wolf.GetCommonEvents();
+        tasks.push_back({ TEXT("CommonEvent.dat"), [&commonEvents, patchCom, comPatch, basicDataDir]() {
+            if (patchCom)
+                commonEvents.Patch(comPatch);
 
-        m_wolf.GetCommonEvents().Patch(comPatch);
+            commonEvents.Dump(basicDataDir);
+        } });
 
         return true;
     }
@@ -308,15 +356,22 @@ bool WolfTL::applyCommonEventTranslations(const tString& patchFolder)
     }
 }
 
-bool WolfTL::applyGameDatTranslations(const tString& patchFolder)
+bool WolfTL::applyGameDatTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks)
 {
     if (m_skipGameDat) return true;
 
     try
     {
         const tString gameDatPatch = std::format(TEXT("{}/{}"), patchFolder, OUTPUT_DIR);
+        const tString basicDataDir = outputPath + TEXT("/BasicData/");
 
-        m_wolf.GetGameDat().Patch(gameDatPatch);
+        fs::create_directories(basicDataDir);
+
+        GameDat& gameDat = m_wolf.GetGameDat();
+        tasks.push_back({ TEXT("Game.dat"), [&gameDat, gameDatPatch, basicDataDir]() {
+            gameDat.Patch(gameDatPatch);
+            gameDat.Dump(basicDataDir);
+        } });
 
         return true;
     }
@@ -328,8 +383,240 @@ bool WolfTL::applyGameDatTranslations(const tString& patchFolder)
     }
 }
 
+bool WolfTL::runFileTasks(const std::vector<FileTask>& tasks, const tString& doneMessage, const tString& errorMessage)
+{
+    std::vector<std::exception_ptr> errors(tasks.size());
+    std::atomic<std::size_t> nextTask = 0;
+    std::atomic<std::size_t> doneTasks = 0;
+    std::atomic<bool> failed = false;
+
+    auto worker = [&]() {
+        // After a failure the remaining tasks are not started, like the serial loop would stop
+        for (std::size_t i = nextTask++; i < tasks.size() && !failed; i = nextTask++)
+        {
+            try
+            {
+                tasks[i].run();
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+                failed    = true;
+                continue;
+            }
+
+            const std::size_t done = ++doneTasks;
+            updateProgress(static_cast<int>(done * 99 / tasks.size()), std::format(TEXT("{} {} ({}/{})"), doneMessage, tasks[i].fileName, done, tasks.size()));
+        }
+    };
+
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount          = static_cast<uint32_t>(std::min<std::size_t>(threadCount, tasks.size()));
+
+    if (threadCount <= 1)
+        worker();
+    else
+    {
+        std::vector<std::thread> workers;
+        for (uint32_t i = 0; i < threadCount; i++)
+            workers.emplace_back(worker);
+
+        for (std::thread& w : workers)
+            w.join();
+    }
+
+    // Report the first failed file in task order
+    for (std::size_t i = 0; i < tasks.size(); i++)
+    {
+        if (!errors[i]) continue;
+
+        try
+        {
+            std::rethrow_exception(errors[i]);
+        }
+        catch (const std::exception& e)
+        {
+            std::string errorMsg = e.what();
+            setError(errorMessage + tasks[i].fileName + TEXT(": ") + tString(errorMsg.begin(), errorMsg.end()));
+        }
+        catch (...)
+        {
+            setError(errorMessage + tasks[i].fileName);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+bool WolfTL::applyTranslationsIncremental(const tString& outputPath, bool inPlace)
+{
+    PatchManifest manifest(m_outputPath + MANIFEST, outputPath);
+    manifest.Load();
+
+    const std::vector<PatchUnit> units = collectPatchUnits(outputPath);
+    std::size_t patched = 0;
+
+    for (std::size_t i = 0; i < units.size(); i++)
+    {
+        const PatchUnit& unit       = units[i];
+        const tString fileName      = unit.outputs.front().filename().wstring();
+        const std::string inputHash = manifest.HashInputs(unit.inputs);
+
+        if (!manifest.IsUpToDate(unit.name, inputHash, unit.outputs))
+        {
+            try
+            {
+                unit.apply();
+            }
+            catch (const std::exception& e)
+            {
+                // Keep the units which were already written
+                manifest.Save();
+
+                std::string errorMsg = e.what();
+                setError(TEXT("Failed to apply translations to ") + fileName + TEXT(": ") + tString(errorMsg.begin(), errorMsg.end()));
+                return false;
+            }
+
+            // Patching in-place replaced the source data, so the next run compares against the patched files
+            manifest.Update(unit.name, inPlace ? manifest.HashInputs(unit.inputs) : inputHash, unit.outputs);
+            patched++;
+        }
+
+        updateProgress(static_cast<int>((i + 1) * 99 / units.size()), std::format(TEXT("Checked {}"), fileName));
+    }
+
+    if (!manifest.Save())
+    {
+        setError(TEXT("Failed to save the patch manifest: ") + m_outputPath + MANIFEST);
+        return false;
+    }
+
+    updateProgress(100, std::format(TEXT("Translation application completed, {} of {} files patched"), patched, units.size()));
+
+    return true;
+}
+
+std::vector<WolfTL::PatchUnit> WolfTL::collectPatchUnits(const tString& outputPath)
+{
+    std::vector<PatchUnit> units;
+
+    const tString mapPatch     = std::format(TEXT("{}/{}"), m_outputPath, MAP_OUTPUT);
+    const tString dbPatch      = std::format(TEXT("{}/{}"), m_outputPath, DB_OUTPUT);
+    const tString comPatch     = std::format(TEXT("{}/{}"), m_outputPath, COM_OUTPUT);
+    const tString gameDatPatch = std::format(TEXT("{}/{}"), m_outputPath, OUTPUT_DIR);
+    const tString basicDataDir = outputPath + TEXT("/BasicData/");
+    const tString mapDataDir   = outputPath + TEXT("/MapData/");
+
+    // Like in the full patch run, missing patch folders only skip the patching, the data is still written
+    const std::vector<fs::path>& mapFiles = m_wolf.GetMapFiles();
+    const bool patchMaps                  = fs::exists(mapPatch);
+
+    for (std::size_t i = 0; i < mapFiles.size(); i++)
+    {
+        PatchUnit unit = { unitName(TEXT("MapData"), mapFiles[i]), { mapFiles[i] }, { fs::path(mapDataDir) / mapFiles[i].filename() } };
+
+        if (patchMaps)
+            unit.inputs.push_back(patchFile(mapPatch, mapFiles[i]));
+
+        unit.apply = [this, i, patchMaps, mapPatch, mapDataDir]() {
+            Map& map = m_wolf.GetMap(i);
+
+            if (patchMaps)
+                map.Patch(mapPatch);
+
+            fs::create_directories(mapDataDir);
+            map.Dump(mapDataDir);
+        };
+
+        units.push_back(std::move(unit));
+    }
+
+    const std::vector<std::pair<tString, tString>>& dbFiles = m_wolf.GetDatabaseFiles();
+    const bool patchDbs                                      = fs::exists(dbPatch);
+
+    for (std::size_t i = 0; i < dbFiles.size(); i++)
+    {
+        const fs::path projectFile = dbFiles[i].first;
+        const fs::path datFile     = dbFiles[i].second;
+
+        PatchUnit unit = { unitName(TEXT("BasicData"), datFile), { projectFile, datFile }, { fs::path(basicDataDir) / datFile.filename(), fs::path(basicDataDir) / projectFile.filename() } };
+
+        if (patchDbs)
+            unit.inputs.push_back(patchFile(dbPatch, datFile));
+
+        unit.apply = [this, i, patchDbs, dbPatch, basicDataDir]() {
+            Database& db = m_wolf.GetDatabases()[i];
+
+            if (patchDbs)
+                db.Patch(dbPatch);
+
+            fs::create_directories(basicDataDir);
+            db.Dump(basicDataDir);
+        };
+
+        units.push_back(std::move(unit));
+    }
+
+    {
+        const fs::path comFile = m_dataPath + TEXT("/BasicData/CommonEvent.dat");
+        const bool patchCom    = fs::exists(comPatch);
+
+        PatchUnit unit = { unitName(TEXT("BasicData"), comFile), { comFile }, { fs::path(basicDataDir) / comFile.filename() } };
+
+        // Every common event has its own patch JSON
+        if (patchCom)
+        {
+            std::vector<fs::path> patchFiles;
+            for (const fs::directory_entry& entry : fs::directory_iterator(comPatch))
+            {
+                if (entry.path().extension() == TEXT(".json"))
+                    patchFiles.push_back(entry.path());
+            }
+
+            std::sort(patchFiles.begin(), patchFiles.end());
+            unit.inputs.insert(unit.inputs.end(), patchFiles.begin(), patchFiles.end());
+        }
+
+        unit.apply = [this, patchCom, comPatch, basicDataDir]() {
+            CommonEvents& commonEvents = m_wolf.GetCommonEvents();
+
+            if (patchCom)
+                commonEvents.Patch(comPatch);
+
+            fs::create_directories(basicDataDir);
+            commonEvents.Dump(basicDataDir);
+        };
+
+        units.push_back(std::move(unit));
+    }
+
+    if (!m_skipGameDat)
+    {
+        const fs::path gameDatFile = m_dataPath + TEXT("/BasicData/Game.dat");
+
+        PatchUnit unit = { unitName(TEXT("BasicData"), gameDatFile), { gameDatFile, patchFile(gameDatPatch, gameDatFile) }, { fs::path(basicDataDir) / gameDatFile.filename() } };
+
+        unit.apply = [this, gameDatPatch, basicDataDir]() {
+            GameDat& gameDat = m_wolf.GetGameDat();
+            gameDat.Patch(gameDatPatch);
+
+            fs::create_directories(basicDataDir);
+            gameDat.Dump(basicDataDir);
+        };
+
+        units.push_back(std::move(unit));
+    }
+
+    return units;
+}
+
 void WolfTL::updateProgress(int progress, const tString& message)
 {
+    std::lock_guard<std::mutex> lock(m_progressMutex);
+
     if (m_progressCallback)
         m_progressCallback(progress, message);
 }
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "WolfRPG/WolfRPG.h"
+#include "PatchManifest.h"
 #include "Types.h"
 
 #include <filesystem>
 #include <functional>
+#include <mutex>
 
 namespace fs = std::filesystem;
 
@@ -30,14 +32,14 @@ public:
     };
 
     /**
-     * @brief Progress callback function type
+     * @brief Progress callback function type, called from the worker threads but never concurrently
      * @param current Current progress (0-100)
      * @param message Status message
      */
     using ProgressCallback = std::function<void(int current, const tString& message)>;
 
     /**
-     * @brief Constructor
+     * @brief Constructor, the game data is only parsed when it is needed
      * @param dataPath Path to the Wolf RPG game data folder
      * @param outputPath Path for output (JSON files or patched data)
      * @param skipGameDat Whether to skip Game.dat processing
@@ -61,6 +63,12 @@ public:
      */
     void SetProgressCallback(ProgressCallback callback) { m_progressCallback = callback; }
 
+    /**
+     * @brief Only re-patch the files whose source data or patch JSONs changed since the last run
+     * @param incremental Whether to patch incrementally, the state is kept in the patch folder
+     */
+    void SetIncremental(bool incremental) { m_incremental = incremental; }
+
     /**
      * @brief Extract translatable data to JSON files
      * @return true if successful, false otherwise
@@ -93,50 +101,105 @@ private:
     inline static const tString DB_OUTPUT    = OUTPUT_DIR + TEXT("db/");
     inline static const tString COM_OUTPUT   = OUTPUT_DIR + TEXT("common/");
     inline static const tString PATCHED_DATA = TEXT("/patched/data/");
+    inline static const tString MANIFEST     = TEXT("/patch_manifest.json");
+
+    /**
+     * @brief Files an incremental patch run checks and writes for one map, database, etc.
+     */
+    struct PatchUnit
+    {
+        std::string name;                   ///< Name in the manifest
+        std::vector<fs::path> inputs;       ///< Source data and patch JSONs
+        std::vector<fs::path> outputs;      ///< Patched data files
+        std::function<void()> apply;        ///< Loads, patches and writes the unit
+    };
+
+    /**
+     * @brief Work on a single output file, independent of all other tasks
+     */
+    struct FileTask
+    {
+        tString fileName;           ///< File name for progress and error messages
+        std::function<void()> run;  ///< Exports or patches and writes the file
+    };
 
     /**
-     * @brief Extract maps to JSON
+     * @brief Queue the JSON export of every map
+     * @param tasks Task list to append to
      */
-    bool extractMapsToJson();
+    bool extractMapsToJson(std::vector<FileTask>& tasks);
 
     /**
-     * @brief Extract databases to JSON
+     * @brief Queue the JSON export of every database
+     * @param tasks Task list to append to
      */
-    bool extractDatabasesToJson();
+    bool extractDatabasesToJson(std::vector<FileTask>& tasks);
 
     /**
-     * @brief Extract common events to JSON
+     * @brief Queue the JSON export of the common events
+     * @param tasks Task list to append to
      */
-    bool extractCommonEventsToJson();
+    bool extractCommonEventsToJson(std::vector<FileTask>& tasks);
 
     /**
-     * @brief Extract game data to JSON
+     * @brief Queue the JSON export of the game data
+     * @param tasks Task list to append to
      */
-    bool extractGameDatToJson();
+    bool extractGameDatToJson(std::vector<FileTask>& tasks);
 
     /**
-     * @brief Apply map translations
+     * @brief Queue patching and writing every map
      * @param patchFolder Folder containing translation patches
+     * @param outputPath Folder the patched data is written to
+     * @param tasks Task list to append to
      */
-    bool applyMapTranslations(const tString& patchFolder);
+    bool applyMapTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks);
 
     /**
-     * @brief Apply database translations
+     * @brief Queue patching and writing every database
      * @param patchFolder Folder containing translation patches
+     * @param outputPath Folder the patched data is written to
+     * @param tasks Task list to append to
      */
-    bool applyDatabaseTranslations(const tString& patchFolder);
+    bool applyDatabaseTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks);
 
     /**
-     * @brief Apply common event translations
+     * @brief Queue patching and writing the common events
      * @param patchFolder Folder containing translation patches
+     * @param outputPath Folder the patched data is written to
+     * @param tasks Task list to append to
      */
-    bool applyCommonEventTranslations(const tString& patchFolder);
+    bool applyCommonEventTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks);
 
     /**
-     * @brief Apply game data translations
+     * @brief Queue patching and writing the game data
      * @param patchFolder Folder containing translation patches
+     * @param outputPath Folder the patched data is written to
+     * @param tasks Task list to append to
+     */
+    bool applyGameDatTranslations(const tString& patchFolder, const tString& outputPath, std::vector<FileTask>& tasks);
+
+    /**
+     * @brief Run the tasks on a thread pool and report the progress per finished file
+     * @param tasks Tasks to run, the objects they work on must not share a context
+     * @param doneMessage Progress message prefix for a finished file
+     * @param errorMessage Error message prefix for a failed file
+     * @return true if all tasks succeeded, otherwise the error of the first failed task is set
+     */
+    bool runFileTasks(const std::vector<FileTask>& tasks, const tString& doneMessage, const tString& errorMessage);
+
+    /**
+     * @brief Apply the translations of the units whose inputs changed since the last run
+     * @param outputPath Folder the patched data is written to
+     * @param inPlace Whether the output folder is the game data folder
+     */
+    bool applyTranslationsIncremental(const tString& outputPath, bool inPlace);
+
+    /**
+     * @brief Collect the patch units of all maps, databases, common events and game data
+     * @param outputPath Folder the patched data is written to
      */
-    bool applyGameDatTranslations(const tString& patchFolder);
+    std::vector<PatchUnit> collectPatchUnits(const tString& outputPath);
 
     /**
      * @brief Update progress and call callback if set
@@ -156,7 +219,9 @@ private:
     tString m_outputPath;       ///< Path for output
     WolfRPG m_wolf;             ///< Wolf RPG data handler
     bool m_skipGameDat;         ///< Whether to skip Game.dat
+    bool m_incremental = false; ///< Whether to only patch changed files
     
     ProgressCallback m_progressCallback;  ///< Progress callback
+    std::mutex m_progressMutex;            ///< Serializes progress callbacks of the worker threads
     tString m_lastError;                   ///< Last error message
 };
@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "DataManip.hpp"
+#include "KeyCache.hpp"
 #include "Types.hpp"
 #include "Utils.hpp"
 
@@ -73,4 +74,10 @@ inline bool crackWolfXFiles(const WolfXFiles &wolfXFiles, const WolfXDecryptColl
 	return detail::crack::crackWolfXFiles(wolfXFiles, decryptCollection);
 }
 
+// Returns the files which could not be decrypted, keyCache is looked up first and receives the parameters of every decrypted file
+inline WolfXFiles crackWolfXFiles(const WolfXFiles &wolfXFiles, const WolfXDecryptCollection &decryptCollection, KeyCache &keyCache, const bool &verbose = true)
+{
+	return detail::crack::crackWolfXFiles(wolfXFiles, decryptCollection, &keyCache, verbose);
+}
+
 } // namespace wolfx
\ No newline at end of file
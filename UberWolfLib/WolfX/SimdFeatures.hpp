@@ -41,6 +41,7 @@ struct CpuFeatures
 	bool ssse3    = false;
 	bool sse4_1   = false;
 	bool sse4_2   = false;
+	bool aes      = false;
 	bool avx      = false;
 	bool avx2     = false;
 	bool avx512f  = false;
@@ -58,6 +59,7 @@ struct CpuFeatures
 		out << "SSSE3:     " << yesno(ssse3) << std::endl;
 		out << "SSE4.1:    " << yesno(sse4_1) << std::endl;
 		out << "SSE4.2:    " << yesno(sse4_2) << std::endl;
+		out << "AES-NI:    " << yesno(aes) << std::endl;
 		out << "AVX:       " << yesno(avx) << std::endl;
 		out << "AVX2:      " << yesno(avx2) << std::endl;
 		out << "AVX-512F:  " << yesno(avx512f) << std::endl;
@@ -106,6 +108,7 @@ inline CpuFeatures detectCpuFeatures()
 	features.ssse3  = ecx.test(9);
 	features.sse4_1 = ecx.test(19);
 	features.sse4_2 = ecx.test(20);
+	features.aes    = ecx.test(25);
 
 	bool osxsave       = ecx.test(27);
 	bool avx_supported = ecx.test(28);
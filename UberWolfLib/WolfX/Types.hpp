@@ -94,6 +94,7 @@ struct WolfXFile
 {
 	std::wstring filePath;
 	std::size_t fileSize;
+	std::string folder = ""; // Folder of the file relative to the data folder, used as key of the key cache
 };
 
 using WolfXFiles = std::vector<WolfXFile>;
@@ -118,6 +119,9 @@ struct DecryptResult
 	uint32_t dataOffset  = 0;
 	std::string magicStr = "";
 	uint32_t magicInt    = 0;
+
+	uint32_t magicStrIndex = 0;
+	uint32_t intIndex      = 0;
 };
 
 } // namespace wolfx
\ No newline at end of file
@@ -39,4 +39,9 @@ inline bool validateChecksum(const std::vector<uint8_t> &data, const std::array<
 {
 	return detail::validate::validateChecksum(data, realChecksum, verbose);
 }
+
+inline bool validateChecksumSampled(const WolfXData &encData, const DecryptBlob &decryptBlob, const std::size_t &dataOffset, const bool &verbose = false)
+{
+	return detail::validate::validateChecksumSampled(encData, decryptBlob, dataOffset, verbose);
+}
 } // namespace wolfx::validate
\ No newline at end of file
@@ -28,5 +28,6 @@
 
 #include "Benchmark.hpp"
 #include "Crack.hpp"
+#include "KeyCache.hpp"
 #include "Types.hpp"
 #include "Utils.hpp"
@@ -26,16 +26,21 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <bit>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../Types.hpp"
 
 #include "DataManipDetail.hpp"
 #include "GeneratorDetail.hpp"
+#include "KeyCacheDetail.hpp"
 #include "UtilsDetail.hpp"
 #include "ValidateDetail.hpp"
 
@@ -54,14 +59,15 @@ inline bool tryDecryptP3(DecryptBlob decryptBlob, const DecryptParams &params, D
 		decryptBlob[i] ^= params.xorBytes[i % 2] ^ magicChar ^ intMod[i & 3] ^ modVal[i % 3];
 	}
 
-	dataManip::xorBufferBlob(params.encData, decryptBlob, decryptResult.decData);
-
 	// --- Validate the decrypted data ---
-	std::array<uint8_t, 5> checksum = {};
+	// Only the bytes used by the checksum are decrypted, the whole file is only decrypted for the matching candidate
+	if (!validate::validateChecksumSampled(params.encData, decryptBlob, params.dataOffset))
+		return false;
 
-	std::memcpy(checksum.data(), decryptResult.decData.data() + 15, 5);
+	dataManip::xorBufferBlob(params.encData, decryptBlob, decryptResult.decData);
+	decryptResult.intIndex = params.intIndex;
 
-	return validate::validateChecksum(decryptResult.decData.data() + params.dataOffset, decryptResult.decData.size() - params.dataOffset, checksum);
+	return true;
 }
 
 inline bool tryDecryptP2(const DecryptBlob &decryptBlob, DecryptParams &params, const WolfXDecryptCollection &wolfXMagic, DecryptResult &decryptResult)
@@ -120,6 +126,7 @@ inline bool tryDecryptP1(const WolfXData &encData, const WolfXKeyData &decryptKe
 	const std::vector<uint8_t> xorBytes = { decryptResult.decData[10], decryptResult.decData[11] };
 
 	const uint16_t magicStrIndex = utils::combineBytes<2>(xorBytes);
+	decryptResult.magicStrIndex  = magicStrIndex;
 
 	if (decryptResult.success)
 	{
@@ -149,7 +156,161 @@ inline bool tryDecryptP1(const WolfXData &encData, const WolfXKeyData &decryptKe
 	return tryDecryptP2(decryptBlob, params, wolfXMagic, decryptResult);
 }
 
-inline bool crackWolfX(const WolfXFile &file, const WolfXDecryptCollection &decryptCollection, DecryptResult &decryptResult)
+// --- Parallel candidate search ---
+
+// A decryption key together with the results of the first decryption step, which all of its candidates share
+struct KeyCandidates
+{
+	const WolfXDecryptKey *pDecryptKey         = nullptr;
+	DecryptBlob decryptBlob                    = {};
+	std::array<uint8_t, 5> headerBytes         = {};
+	std::vector<uint8_t> xorBytes              = {};
+	uint32_t dataOffset                        = 0;
+	uint32_t magicStrIndex                     = 0;
+	std::vector<const std::string *> magicStrs = {};
+};
+
+// Same steps as tryDecryptP1 up to the point where the magic string candidates are tried
+inline bool prepareKeyCandidates(const WolfXData &encData, const WolfXDecryptKey &decryptKey, const WolfXDecryptCollection &wolfXMagic, KeyCandidates &keyCandidates)
+{
+	static const std::string EMPTY_MAGIC_STR = "";
+
+	const StaticBlob staticBlob = generator::generateWolfxStaticBlob(decryptKey.keyData);
+
+	const uint32_t dataOffset = 512 + staticBlob[0] + staticBlob[1];
+
+	if (dataOffset >= encData.size())
+		return false;
+
+	uint32_t headerInt = utils::combineBytes<4>(encData, 5);
+
+	uint32_t fnvHash = generator::fnv1(staticBlob);
+	uint32_t seed    = fnvHash ^ headerInt;
+
+	keyCandidates.pDecryptKey = &decryptKey;
+	keyCandidates.dataOffset  = dataOffset;
+	keyCandidates.decryptBlob = generator::generateWolfxDecryptBlob(seed, staticBlob, encData.size());
+
+	for (uint32_t i = 0; i < 5; i++)
+		keyCandidates.headerBytes[i] = encData[10 + i] ^ keyCandidates.decryptBlob[i];
+
+	keyCandidates.xorBytes = { keyCandidates.headerBytes[0], keyCandidates.headerBytes[1] };
+
+	const uint16_t magicStrIndex = utils::combineBytes<2>(keyCandidates.xorBytes);
+	keyCandidates.magicStrIndex  = magicStrIndex;
+
+	if (magicStrIndex < 10000)
+	{
+		if (wolfXMagic.stringValues.count(magicStrIndex) == 0)
+			return false;
+
+		for (const auto &strVal : wolfXMagic.stringValues.at(magicStrIndex))
+			keyCandidates.magicStrs.push_back(&strVal);
+	}
+	else
+		keyCandidates.magicStrs.push_back(&EMPTY_MAGIC_STR);
+
+	return true;
+}
+
+// Tries one magic string of a key, decryptResult.decData has to be sized to the file and contain its first 10 bytes
+inline bool tryCandidate(const KeyCandidates &keyCandidates, const std::string &magicStr, const WolfXData &encData, const WolfXDecryptCollection &wolfXMagic, DecryptResult &decryptResult)
+{
+	std::copy(keyCandidates.headerBytes.begin(), keyCandidates.headerBytes.end(), decryptResult.decData.begin() + 10);
+
+	decryptResult.success       = false;
+	decryptResult.dataOffset    = keyCandidates.dataOffset;
+	decryptResult.magicStrIndex = keyCandidates.magicStrIndex;
+
+	DecryptParams params = { encData, magicStr, keyCandidates.xorBytes, keyCandidates.dataOffset };
+
+	if (!tryDecryptP2(keyCandidates.decryptBlob, params, wolfXMagic, decryptResult))
+		return false;
+
+	decryptResult.decryptKey = *keyCandidates.pDecryptKey;
+	decryptResult.magicStr   = magicStr;
+	decryptResult.magicInt   = params.magicInt;
+	decryptResult.success    = true;
+
+	return true;
+}
+
+// Searches all keys and magic strings for the file, the candidates are split across threadCount threads
+// Candidates are numbered in the order of the serial search and the lowest matching one wins, so the result
+// does not depend on the number of threads, every thread stops as soon as only higher numbered candidates are left
+inline bool searchCandidates(const WolfXData &encData, const WolfXDecryptCollection &wolfXMagic, DecryptResult &decryptResult, const uint32_t &threadCount)
+{
+	std::vector<KeyCandidates> keyCandidates(wolfXMagic.decryptKeys.size());
+	std::vector<std::pair<std::size_t, std::size_t>> tasks;
+
+	for (std::size_t k = 0; k < wolfXMagic.decryptKeys.size(); k++)
+	{
+		if (!prepareKeyCandidates(encData, wolfXMagic.decryptKeys[k], wolfXMagic, keyCandidates[k]))
+			continue;
+
+		for (std::size_t s = 0; s < keyCandidates[k].magicStrs.size(); s++)
+			tasks.emplace_back(k, s);
+	}
+
+	if (tasks.empty())
+		return false;
+
+	std::atomic<std::size_t> nextTask  = 0;
+	std::atomic<std::size_t> foundTask = tasks.size();
+	std::mutex resultMutex;
+
+	auto worker = [&]() {
+		// Every thread works on its own buffer, only the matching one is moved to the result
+		DecryptResult localResult;
+		localResult.decData = WolfXData(encData.size());
+		std::copy(encData.begin(), encData.begin() + 10, localResult.decData.begin());
+
+		for (std::size_t t = nextTask++; t < foundTask.load(); t = nextTask++)
+		{
+			const KeyCandidates &candidates = keyCandidates[tasks[t].first];
+
+			if (!tryCandidate(candidates, *candidates.magicStrs[tasks[t].second], encData, wolfXMagic, localResult))
+				continue;
+
+			std::lock_guard<std::mutex> lock(resultMutex);
+			if (t < foundTask.load())
+			{
+				foundTask     = t;
+				decryptResult = std::move(localResult);
+			}
+			break;
+		}
+	};
+
+	const std::size_t workerCount = std::min<std::size_t>(std::max<uint32_t>(threadCount, 1), tasks.size());
+
+	if (workerCount == 1)
+		worker();
+	else
+	{
+		std::vector<std::thread> workers;
+		for (std::size_t i = 0; i < workerCount; i++)
+			workers.emplace_back(worker);
+
+		for (std::thread &w : workers)
+			w.join();
+	}
+
+	return foundTask.load() < tasks.size();
+}
+
+// Writes a message to std::cerr, crackWolfXFiles calls crackWolfX from several threads whose messages would interleave otherwise
+inline void printError(const std::string &message)
+{
+	static std::mutex mutex;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cerr << message << std::endl;
+}
+
+// Decrypts the file, the parameters cached for its folder and the ones in decryptResult (if it holds a successful result) are
+// tried first, followed by a search of the cached index pairs and finally a search of the whole collection
+inline bool crackWolfX(const WolfXFile &file, const WolfXDecryptCollection &decryptCollection, DecryptResult &decryptResult, const uint32_t &threadCount, keyCache::KeyCache *pKeyCache = nullptr, const bool &verbose = true)
 {
 	static const std::array<uint8_t, 5> WOLFX_MAGIC = { 0x57, 0x4F, 0x4C, 0x46, 0x58 }; // "WOLFX"
 
@@ -159,36 +320,56 @@ inline bool crackWolfX(const WolfXFile &file, const WolfXDecryptCollection &decr
 
 	if (encData.size() < 15 || std::memcmp(encData.data(), WOLFX_MAGIC.data(), 5) != 0)
 	{
-		std::cerr << "Invalid WOLFX file" << std::endl;
+		printError("Invalid WOLFX file");
 		return false;
 	}
 
-	// decryptResult.success = false;
 	decryptResult.decData = WolfXData(encData.size());
 	// Copy the first 10 bytes of the encrypted data to the decrypted data
 	std::copy(encData.begin(), encData.begin() + 10, decryptResult.decData.begin());
 
-	if (decryptResult.success)
-	{
-		if (!detail::crack::tryDecryptP1(encData, decryptResult.decryptKey.keyData, decryptCollection, decryptResult))
-			return false;
-	}
+	bool found = false;
 
-	for (const auto &decryptInfo : decryptCollection.decryptKeys)
+	if (pKeyCache)
 	{
-		if (detail::crack::tryDecryptP1(encData, decryptInfo.keyData, decryptCollection, decryptResult))
+		DecryptResult cachedResult;
+		cachedResult.decData = std::move(decryptResult.decData);
+
+		if (pKeyCache->findFolder(file.folder, cachedResult) && tryDecryptP1(encData, cachedResult.decryptKey.keyData, decryptCollection, cachedResult))
 		{
-			decryptResult.decryptKey = decryptInfo;
-			break;
+			decryptResult = std::move(cachedResult);
+			found         = true;
 		}
+		else
+			decryptResult.decData = std::move(cachedResult.decData);
 	}
 
-	if (!decryptResult.success)
+	// Files of the same game usually share the key, magic string and magic int
+	if (!found && decryptResult.success)
+		found = tryDecryptP1(encData, decryptResult.decryptKey.keyData, decryptCollection, decryptResult);
+
+	if (!found && pKeyCache)
 	{
-		std::cerr << "Failed to decrypt the file" << std::endl;
+		decryptResult.success = false;
+		found                 = searchCandidates(encData, *pKeyCache->collection(), decryptResult, threadCount);
+	}
+
+	if (!found)
+	{
+		decryptResult.success = false;
+		found                 = searchCandidates(encData, decryptCollection, decryptResult, threadCount);
+	}
+
+	if (!found)
+	{
+		if (verbose)
+			printError("Failed to decrypt the file");
 		return false;
 	}
 
+	if (pKeyCache)
+		pKeyCache->add(file.folder, decryptResult);
+
 	// --- Write output file ---
 	std::wstring outputFilename = file.filePath.substr(0, file.filePath.find_last_of('.'));
 
@@ -197,28 +378,96 @@ inline bool crackWolfX(const WolfXFile &file, const WolfXDecryptCollection &decr
 	return true;
 }
 
-inline bool crackWolfXFiles(const WolfXFiles &wolfXFiles, const WolfXDecryptCollection &decryptCollection, const uint32_t retries = 0)
+inline bool crackWolfX(const WolfXFile &file, const WolfXDecryptCollection &decryptCollection, DecryptResult &decryptResult)
 {
-	if (retries >= 5)
-	{
-		std::cerr << "Max retries reached, aborting" << std::endl;
+	return crackWolfX(file, decryptCollection, decryptResult, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Decrypts the files on a pool of threads and returns the files which could not be decrypted
+// The first file that can be decrypted is searched with all threads, its parameters are then tried first for the other files,
+// which are spread across the threads with every thread keeping its own result and buffers
+// With a key cache the files are processed folder by folder, so the parameters of a folder are found once and reused
+inline WolfXFiles crackWolfXFiles(const WolfXFiles &wolfXFiles, const WolfXDecryptCollection &decryptCollection, keyCache::KeyCache *pKeyCache, const bool &verbose = true)
+{
+	const uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	WolfXFiles files = wolfXFiles;
+
+	if (pKeyCache)
+		std::stable_sort(files.begin(), files.end(), [](const WolfXFile &a, const WolfXFile &b) { return a.folder < b.folder; });
+
+	std::vector<uint8_t> failed(files.size(), false);
+	DecryptResult sharedResult;
+	std::size_t nextFile = 0;
+
+	auto tryFile = [&](const std::size_t &idx, DecryptResult &decryptResult, const uint32_t &searchThreads) {
+		try
+		{
+			if (crackWolfX(files[idx], decryptCollection, decryptResult, searchThreads, pKeyCache, verbose))
+				return true;
+		}
+		catch (const std::exception &e)
+		{
+			printError(e.what());
+		}
+
+		failed[idx] = true;
 		return false;
+	};
+
+	for (; nextFile < files.size(); nextFile++)
+	{
+		if (tryFile(nextFile, sharedResult, threadCount))
+		{
+			nextFile++;
+			break;
+		}
 	}
 
-	DecryptResult decryptResult;
+	sharedResult.decData.clear();
+
+	std::atomic<std::size_t> nextJob = nextFile;
+
+	auto worker = [&]() {
+		DecryptResult decryptResult;
+
+		for (std::size_t i = nextJob++; i < files.size(); i = nextJob++)
+		{
+			// Fall back to the shared parameters if the last file of this thread needed a search that failed
+			if (!decryptResult.success)
+				decryptResult = sharedResult;
+
+			tryFile(i, decryptResult, 1);
+		}
+	};
 
-	WolfXFiles retryFiles;
+	const std::size_t workerCount = std::min<std::size_t>(threadCount, files.size() - nextFile);
 
-	for (const auto &file : wolfXFiles)
+	std::vector<std::thread> workers;
+	for (std::size_t i = 0; i < workerCount; i++)
+		workers.emplace_back(worker);
+
+	for (std::thread &w : workers)
+		w.join();
+
+	WolfXFiles failedFiles;
+	for (std::size_t i = 0; i < files.size(); i++)
 	{
-		if (!crackWolfX(file, decryptCollection, decryptResult))
-			retryFiles.push_back(file);
+		if (failed[i])
+			failedFiles.push_back(files[i]);
 	}
 
-	if (!retryFiles.empty())
+	return failedFiles;
+}
+
+inline bool crackWolfXFiles(const WolfXFiles &wolfXFiles, const WolfXDecryptCollection &decryptCollection)
+{
+	const WolfXFiles failedFiles = crackWolfXFiles(wolfXFiles, decryptCollection, nullptr);
+
+	if (!failedFiles.empty())
 	{
-		std::cout << "Retrying " << retryFiles.size() << " files ..." << std::endl;
-		return crackWolfXFiles(retryFiles, decryptCollection, retries + 1);
+		std::cerr << "Failed to decrypt " << failedFiles.size() << " of " << wolfXFiles.size() << " files" << std::endl;
+		return false;
 	}
 
 	return true;
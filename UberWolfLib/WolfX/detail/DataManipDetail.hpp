@@ -27,6 +27,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <immintrin.h>
 #include <vector>
@@ -36,6 +37,12 @@
 
 namespace wolfx::detail::dataManip
 {
+// Decrypts the single byte at idx the same way xorBufferBlob does
+inline uint8_t xorByteBlob(const WolfXData &inBuffer, const DecryptBlob &decryptBlob, const std::size_t &idx)
+{
+	return inBuffer[idx] ^ decryptBlob[(idx - 10) % decryptBlob.size()];
+}
+
 // --- SIMD Implementations ---
 
 inline void xorBufferBlobPlain(const WolfXData &inBuffer, const DecryptBlob &decryptBlob, WolfXData &outBuffer)
@@ -106,30 +113,43 @@ inline void xorBufferBlobAVX2(const WolfXData &inBuffer, const DecryptBlob &decr
 
 using DecryptFunction = void (*)(const WolfXData &, const DecryptBlob &, WolfXData &);
 
-inline DecryptFunction g_decryptFunc = nullptr;
-
-// Initializes the correct function at runtime
-inline void initXorBufferBlobFunc(const simd::CpuFeatures &features)
+inline DecryptFunction selectXorBufferBlobFunc(const simd::CpuFeatures &features)
 {
 	if (features.avx2)
-		g_decryptFunc = xorBufferBlobAVX2;
+		return xorBufferBlobAVX2;
 	else if (features.sse2)
-		g_decryptFunc = xorBufferBlobSSE2;
+		return xorBufferBlobSSE2;
 	else
-		g_decryptFunc = xorBufferBlobPlain;
+		return xorBufferBlobPlain;
 }
 
+// Function chosen with initXorBufferBlobFunc(features), nullptr to use the one detected for this CPU
+inline std::atomic<DecryptFunction> g_decryptFuncOverride = nullptr;
+
+// The features are only detected once, the function is called from several crack threads
+inline DecryptFunction decryptFunc()
+{
+	static const DecryptFunction func = selectXorBufferBlobFunc(simd::detectCpuFeatures());
+
+	const DecryptFunction overrideFunc = g_decryptFuncOverride.load(std::memory_order_relaxed);
+	return overrideFunc ? overrideFunc : func;
+}
+
+// Forces the function for the given features, e.g. to compare the implementations
+inline void initXorBufferBlobFunc(const simd::CpuFeatures &features)
+{
+	g_decryptFuncOverride.store(selectXorBufferBlobFunc(features), std::memory_order_relaxed);
+}
+
+// Detects the function for this CPU ahead of the first use, does not change the selection afterwards
 inline void initXorBufferBlobFunc()
 {
-	initXorBufferBlobFunc(simd::detectCpuFeatures());
+	decryptFunc();
 }
 
 inline void xorBufferBlob(const WolfXData &inBuffer, const DecryptBlob &decryptBlob, WolfXData &outBuffer)
 {
-	if (g_decryptFunc)
-		g_decryptFunc(inBuffer, decryptBlob, outBuffer);
-	else
-		xorBufferBlobPlain(inBuffer, decryptBlob, outBuffer); // Fallback (should not happen if initialized properly)
+	decryptFunc()(inBuffer, decryptBlob, outBuffer);
 }
 
 } // namespace wolfx::detail::dataManip
\ No newline at end of file
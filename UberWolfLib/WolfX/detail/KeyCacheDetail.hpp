@@ -0,0 +1,203 @@
+/*
+ *  File: KeyCacheDetail.hpp
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "../Types.hpp"
+
+namespace wolfx::detail::keyCache
+{
+constexpr uint32_t MAGIC_STR_INDEX_LIMIT = 10000;
+constexpr uint32_t INT_INDEX_LIMIT       = 1000000;
+
+struct CacheEntry
+{
+	std::string key        = "";
+	std::string magicStr   = "";
+	uint32_t magicInt      = 0;
+	uint32_t magicStrIndex = 0;
+	uint32_t intIndex      = 0;
+
+	bool operator==(const CacheEntry &) const = default;
+};
+
+using FolderEntries = std::map<std::string, CacheEntry>;
+using IndexEntries  = std::map<std::pair<uint32_t, uint32_t>, CacheEntry>;
+
+// Remembers the parameters that decrypted a file, by the folder of the file and by its magic string / int index pair
+// All members are thread safe
+class KeyCache
+{
+public:
+	void add(const std::string &folder, const CacheEntry &entry)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const std::pair<uint32_t, uint32_t> index = { entry.magicStrIndex, entry.intIndex };
+
+		// Files decrypted with the cached parameters add them again, this must not mark the cache as changed
+		const auto folderIt = m_folders.find(folder);
+		const auto indexIt  = m_indices.find(index);
+		if (folderIt != m_folders.end() && folderIt->second == entry && indexIt != m_indices.end() && indexIt->second == entry)
+			return;
+
+		m_folders[folder] = entry;
+		setIndex(index, entry);
+		m_changed = true;
+	}
+
+	void add(const std::string &folder, const DecryptResult &decryptResult)
+	{
+		add(folder, { decryptResult.decryptKey.key, decryptResult.magicStr, decryptResult.magicInt, decryptResult.magicStrIndex, decryptResult.intIndex });
+	}
+
+	// Entries which are only known by their index pair, e.g. loaded from a file
+	void addIndex(const CacheEntry &entry)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		setIndex({ entry.magicStrIndex, entry.intIndex }, entry);
+	}
+
+	// Fills decryptResult with the parameters of the folder, marked as successful so they are tried as they are
+	bool findFolder(const std::string &folder, DecryptResult &decryptResult) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const auto it = m_folders.find(folder);
+		if (it == m_folders.end())
+			return false;
+
+		decryptResult.decryptKey = WolfXDecryptKey(folder, it->second.key);
+		decryptResult.magicStr   = it->second.magicStr;
+		decryptResult.magicInt   = it->second.magicInt;
+		decryptResult.success    = true;
+
+		return true;
+	}
+
+	// The cached parameters as a decryption collection, searching it only tries the magic string and int
+	// that worked for the same index pair, so files in new folders can be decrypted without the game data
+	// The collection is built once and shared until the index entries change
+	std::shared_ptr<const WolfXDecryptCollection> collection() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_collection)
+			return m_collection;
+
+		auto pDecryptCollection = std::make_shared<WolfXDecryptCollection>();
+		std::set<std::string> keys;
+
+		for (const auto &[index, entry] : m_indices)
+		{
+			if (keys.insert(entry.key).second)
+				pDecryptCollection->decryptKeys.push_back({ "", entry.key });
+
+			if (entry.magicStrIndex < MAGIC_STR_INDEX_LIMIT)
+				pDecryptCollection->stringValues[entry.magicStrIndex].insert(entry.magicStr);
+
+			if (entry.intIndex < INT_INDEX_LIMIT)
+				pDecryptCollection->intValues[entry.intIndex].insert(entry.magicInt);
+		}
+
+		m_collection = std::move(pDecryptCollection);
+
+		return m_collection;
+	}
+
+	FolderEntries folders() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_folders;
+	}
+
+	IndexEntries indices() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_indices;
+	}
+
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_indices.empty();
+	}
+
+	// True if entries were added since the cache was loaded
+	bool changed() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_changed;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_folders.clear();
+		m_indices.clear();
+		m_collection.reset();
+		m_changed = false;
+	}
+
+	void resetChanged()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_changed = false;
+	}
+
+private:
+	// Stores the entry of an index pair, the shared collection is rebuilt if it differs from the stored one
+	void setIndex(const std::pair<uint32_t, uint32_t> &index, const CacheEntry &entry)
+	{
+		const auto it = m_indices.find(index);
+		if (it != m_indices.end() && it->second == entry)
+			return;
+
+		m_indices[index] = entry;
+		m_collection.reset();
+	}
+
+private:
+	FolderEntries m_folders = {};
+	IndexEntries m_indices  = {};
+	bool m_changed          = false;
+
+	mutable std::shared_ptr<const WolfXDecryptCollection> m_collection = nullptr;
+
+	mutable std::mutex m_mutex;
+};
+
+} // namespace wolfx::detail::keyCache
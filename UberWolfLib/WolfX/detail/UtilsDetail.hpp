@@ -31,6 +31,7 @@
 #include <exception>
 #include <filesystem>
 #include <fstream>
+#include <string>
 #include <vector>
 
 namespace wolfx::detail::utils
@@ -91,7 +92,8 @@ inline WolfXFiles collectWolfXFiles(const std::filesystem::path &baseFolder)
 		if (entry.is_regular_file() && entry.path().extension() == ".wolfx")
 		{
 			const std::filesystem::path path = entry.path();
-			wolfxFiles.push_back({ path.wstring(), std::filesystem::file_size(path) });
+			const std::u8string folder       = path.parent_path().lexically_relative(baseFolder).generic_u8string();
+			wolfxFiles.push_back({ path.wstring(), std::filesystem::file_size(path), std::string(folder.begin(), folder.end()) });
 		}
 	}
 
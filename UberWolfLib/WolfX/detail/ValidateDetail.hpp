@@ -34,6 +34,8 @@
 
 #include "../Types.hpp"
 
+#include "DataManipDetail.hpp"
+
 namespace wolfx::detail::validate
 {
 inline bool validateChecksum(const uint8_t *pData, const std::size_t &dataSize, const std::array<uint8_t, 5> &realChecksum, const bool &verbose = false)
@@ -56,6 +58,31 @@ inline bool validateChecksum(const uint8_t *pData, const std::size_t &dataSize,
 	return false;
 }
 
+// Same check as validateChecksum on the output of xorBufferBlob, but only the stored checksum and the 5 sampled bytes are decrypted
+inline bool validateChecksumSampled(const WolfXData &encData, const DecryptBlob &decryptBlob, const std::size_t &dataOffset, const bool &verbose = false)
+{
+	std::array<uint8_t, 5> realChecksum;
+	std::array<uint8_t, 5> checksum;
+	const std::size_t finalIdx = encData.size() - dataOffset - 1;
+
+	for (std::size_t i = 0; i < 5; i++)
+	{
+		realChecksum[i] = dataManip::xorByteBlob(encData, decryptBlob, 15 + i);
+		checksum[i]     = dataManip::xorByteBlob(encData, decryptBlob, dataOffset + static_cast<std::size_t>(finalIdx * 0.25 * i));
+	}
+
+	if (checksum == realChecksum)
+	{
+		if (verbose)
+			std::cout << "Checksum match" << std::endl;
+		return true;
+	}
+
+	if (verbose)
+		std::cerr << "Checksum mismatch" << std::endl;
+	return false;
+}
+
 inline bool validateChecksum(const std::vector<uint8_t> &data, const std::array<uint8_t, 5> &realChecksum, const bool &verbose = false)
 {
 	if (data.empty())
@@ -26,10 +26,56 @@
 
 #include "WolfXWrapper.h"
 
-#include "WolfRPG/WolfRPG.h"
+#include "WolfRPG/CommonEvents.h"
+#include "WolfRPG/Map.h"
 #include "UberLog.h"
 
 #include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace
+{
+std::string bytes2Hex(const std::string& str)
+{
+	static const char HEX_CHARS[] = "0123456789abcdef";
+
+	std::string hex;
+	hex.reserve(str.size() * 2);
+
+	for (const unsigned char c : str)
+	{
+		hex.push_back(HEX_CHARS[c >> 4]);
+		hex.push_back(HEX_CHARS[c & 0xF]);
+	}
+
+	return hex;
+}
+
+std::string hex2Bytes(const std::string& hex)
+{
+	std::string str;
+
+	for (std::size_t i = 0; i + 1 < hex.size(); i += 2)
+		str.push_back(static_cast<char>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+
+	return str;
+}
+
+nlohmann::ordered_json entry2Json(const wolfx::KeyCacheEntry& entry)
+{
+	return { { "key", bytes2Hex(entry.key) },
+			 { "magicStr", bytes2Hex(entry.magicStr) },
+			 { "magicInt", entry.magicInt },
+			 { "magicStrIndex", entry.magicStrIndex },
+			 { "intIndex", entry.intIndex } };
+}
+
+wolfx::KeyCacheEntry json2Entry(const nlohmann::ordered_json& data)
+{
+	return { hex2Bytes(data.at("key")), hex2Bytes(data.at("magicStr")), data.at("magicInt"), data.at("magicStrIndex"), data.at("intIndex") };
+}
+} // namespace
 
 bool WolfXWrapper::DecryptAll()
 {
@@ -52,45 +98,63 @@ bool WolfXWrapper::DecryptAll()
 
 	INFO_LOG << "Found " << wolfXFiles.size() << " WolfX files" << std::endl;
 
-	collectWolfXDecryptionInfo();
+	loadKeyCache();
+
+	// Try the cached parameters first, the game data only has to be parsed for the files they do not decrypt
+	if (!m_keyCache.empty())
+	{
+		INFO_LOG << "Decrypting WolfX files with cached keys ... " << std::flush;
+		wolfXFiles = wolfx::crackWolfXFiles(wolfXFiles, {}, m_keyCache, false);
+		INFO_LOG << "Done" << std::endl;
+	}
+
+	if (!wolfXFiles.empty())
+	{
+		collectWolfXDecryptionInfo();
+
+		INFO_LOG << "Decrypting WolfX files ... " << std::flush;
+		const wolfx::WolfXFiles failedFiles = wolfx::crackWolfXFiles(wolfXFiles, m_wolfxDecryptCollection, m_keyCache);
+		INFO_LOG << "Done" << std::endl;
+
+		if (!failedFiles.empty())
+			ERROR_LOG << "[WolfXWrapper] Failed to decrypt " << failedFiles.size() << " of " << wolfXFiles.size() << " WolfX files" << std::endl;
+	}
+
+	if (m_keyCache.changed())
+		saveKeyCache();
 
-	INFO_LOG << "Decrypting WolfX files ... " << std::flush;
-	wolfx::crackWolfXFiles(wolfXFiles, m_wolfxDecryptCollection);
-	INFO_LOG << "Done" << std::endl;
 	return true;
 }
 
 void WolfXWrapper::collectWolfXDecryptionInfo()
 {
-	WolfRPG wolfRpg(m_dataFolder, true);
-
 	m_wolfxDecryptCollection.clear();
 	m_wolfxDecryptCollection.decryptKeys.push_back({ "/", "" }); // Add an empty entry to also test the default case
 
-	auto parseCommand = [&wolfxDecryptCollection = m_wolfxDecryptCollection](const Command::CommandShPtr::Command &command) {
-		switch (command->GetType())
+	auto parseCommand = [&wolfxDecryptCollection = m_wolfxDecryptCollection](const Command::CommandView &command) {
+		switch (command.GetType())
 		{
 			case Command::CommandType::SetString:
 			{
-				Command::CommandShPtr::SetString setString = std::dynamic_pointer_cast<Command::CommandSpecialClasses::SetString>(command);
+				const Command::CommandSpecialClasses::SetString setString(command);
 
-				const uint32_t idx = setString->GetID();
-				wolfxDecryptCollection.stringValues[idx].insert(setString->GetString());
+				const uint32_t idx = setString.GetID();
+				wolfxDecryptCollection.stringValues[idx].insert(setString.GetString());
 				break;
 			}
 			case Command::CommandType::SetVariable:
 			{
-				Command::CommandShPtr::SetVariable setVariable = std::dynamic_pointer_cast<Command::CommandSpecialClasses::SetVariable>(command);
+				const Command::CommandSpecialClasses::SetVariable setVariable(command);
 
-				const uint32_t idx = setVariable->GetID();
-				wolfxDecryptCollection.intValues[idx].insert(setVariable->GetValue());
+				const uint32_t idx = setVariable.GetID();
+				wolfxDecryptCollection.intValues[idx].insert(setVariable.GetValue());
 				break;
 			}
 			case Command::CommandType::ProFeature:
 			{
-				Command::CommandShPtr::ProFeature proFeature = std::dynamic_pointer_cast<Command::CommandSpecialClasses::ProFeature>(command);
-				if (proFeature->GetProFeatureType() == Command::CommandSpecialClasses::ProFeature::Type::SetWolfxKey)
-					wolfxDecryptCollection.decryptKeys.push_back({ fileAccessUtils::ws2s(proFeature->GetWolfxFolder()), fileAccessUtils::ws2s(proFeature->GetWolfxKey()) });
+				const Command::CommandSpecialClasses::ProFeature proFeature(command);
+				if (proFeature.GetProFeatureType() == Command::CommandSpecialClasses::ProFeature::Type::SetWolfxKey)
+					wolfxDecryptCollection.decryptKeys.push_back({ fileAccessUtils::ws2s(proFeature.GetWolfxFolder()), fileAccessUtils::ws2s(proFeature.GetWolfxKey()) });
 				break;
 			}
 			default:
@@ -100,23 +164,20 @@ void WolfXWrapper::collectWolfXDecryptionInfo()
 
 	INFO_LOG << "Collecting WolfX decryption information ... " << std::flush;
 
-	for (const Map &map : wolfRpg.GetMaps())
+	// Stream the commands instead of loading the game data, everything except these three command types is skipped
+	Command::CommandScanner scanner({ Command::CommandType::SetString, Command::CommandType::SetVariable, Command::CommandType::ProFeature }, parseCommand);
+
+	const tString mapDataDir = m_dataFolder + L"/MapData/";
+	if (std::filesystem::exists(mapDataDir))
 	{
-		for (const Event &event : map.GetEvents())
+		for (const std::filesystem::directory_entry &p : std::filesystem::directory_iterator(mapDataDir))
 		{
-			for (const Page &page : event.GetPages())
-			{
-				for (const Command::CommandShPtr::Command &command : page.GetCommands())
-					parseCommand(command);
-			}
+			if (p.path().extension() == ".mps")
+				Map::ScanCommands(p.path().wstring(), scanner);
 		}
 	}
 
-	for (const CommonEvent &comEv : wolfRpg.GetCommonEvents().GetEvents())
-	{
-		for (const Command::CommandShPtr::Command &command : comEv.GetCommands())
-			parseCommand(command);
-	}
+	CommonEvents::ScanCommands(m_dataFolder + L"/BasicData/CommonEvent.dat", scanner);
 
 	// Unique the wolfxDecryptInfos
 	std::sort(m_wolfxDecryptCollection.decryptKeys.begin(), m_wolfxDecryptCollection.decryptKeys.end(), [](const wolfx::WolfXDecryptKey &a, const wolfx::WolfXDecryptKey &b) {
@@ -143,3 +204,81 @@ void WolfXWrapper::collectWolfXDecryptionInfo()
 		INFO_LOG << "Folder: \"" << info.folder << "\", Key: \"" << info.key << "\"" << std::endl;
 #endif
 }
+
+std::string WolfXWrapper::keyCacheGameName() const
+{
+	const std::u8string name = std::filesystem::absolute(m_dataFolder).lexically_normal().generic_u8string();
+	return std::string(name.begin(), name.end());
+}
+
+void WolfXWrapper::loadKeyCache()
+{
+	m_keyCache.clear();
+
+	// Return if the cache file does not exist or is empty
+	if (!std::filesystem::exists(KEY_CACHE_FILE_NAME) || std::filesystem::file_size(KEY_CACHE_FILE_NAME) == 0)
+		return;
+
+	try
+	{
+		std::ifstream f(KEY_CACHE_FILE_NAME);
+		const nlohmann::ordered_json data = nlohmann::ordered_json::parse(f);
+		const std::string gameName        = keyCacheGameName();
+
+		if (!data.contains(gameName))
+			return;
+
+		const nlohmann::ordered_json& game = data[gameName];
+
+		if (game.contains("folders"))
+		{
+			for (const auto& [folder, entry] : game["folders"].items())
+				m_keyCache.add(folder, json2Entry(entry));
+		}
+
+		if (game.contains("indices"))
+		{
+			for (const auto& entry : game["indices"])
+				m_keyCache.addIndex(json2Entry(entry));
+		}
+	}
+	catch (const std::exception& e)
+	{
+		ERROR_LOG << "[WolfXWrapper] Failed to load the key cache: " << e.what() << std::endl;
+		m_keyCache.clear();
+	}
+
+	m_keyCache.resetChanged();
+}
+
+void WolfXWrapper::saveKeyCache() const
+{
+	try
+	{
+		nlohmann::ordered_json data = nlohmann::ordered_json::object();
+
+		// Keep the entries of the other games
+		if (std::filesystem::exists(KEY_CACHE_FILE_NAME) && std::filesystem::file_size(KEY_CACHE_FILE_NAME) != 0)
+		{
+			std::ifstream f(KEY_CACHE_FILE_NAME);
+			data = nlohmann::ordered_json::parse(f);
+		}
+
+		nlohmann::ordered_json game = { { "folders", nlohmann::ordered_json::object() }, { "indices", nlohmann::ordered_json::array() } };
+
+		for (const auto& [folder, entry] : m_keyCache.folders())
+			game["folders"][folder] = entry2Json(entry);
+
+		for (const auto& [index, entry] : m_keyCache.indices())
+			game["indices"].push_back(entry2Json(entry));
+
+		data[keyCacheGameName()] = game;
+
+		std::ofstream f(KEY_CACHE_FILE_NAME);
+		f << data.dump(4);
+	}
+	catch (const std::exception& e)
+	{
+		ERROR_LOG << "[WolfXWrapper] Failed to save the key cache: " << e.what() << std::endl;
+	}
+}
@@ -44,10 +44,17 @@ public:
 
 	bool DecryptAll();
 
+	// Sidecar of UberWolfConfig.json which keeps the parameters that decrypted the WolfX files of each game
+	inline static const std::string KEY_CACHE_FILE_NAME = "UberWolfKeyCache.json";
+
 private:
 	void collectWolfXDecryptionInfo();
+	void loadKeyCache();
+	void saveKeyCache() const;
+	std::string keyCacheGameName() const;
 
 private:
 	tString m_dataFolder;
 	wolfx::WolfXDecryptCollection m_wolfxDecryptCollection = {};
+	wolfx::KeyCache m_keyCache                             = {};
 };